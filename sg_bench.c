@@ -0,0 +1,594 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_bench.c
+//  Description    : This is the microbenchmark suite for the driver internals.
+//                   Each component is timed on its own: packet serialization
+//                   and de-serialization, block cache lookups and inserts
+//                   over sweeps of cache and working set sizes, file handle
+//                   lookup over a sweep of open files and node table lookup
+//                   over a sweep of known nodes.  Every measurement is warmed
+//                   up, then repeated, and the best and median runs reported
+//                   in nanoseconds (and cycles where there is a timestamp
+//                   counter) per operation.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <cmpsc311_log.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Project Includes
+#include <sg_defs.h>
+#include <sg_driver.h>
+#include <sg_cache.h>
+#include <sg_local_service.h>
+
+// Defines
+#define SG_BENCH_ARGUMENTS "hvi:r:w:c:s:f:n:b:"
+#define USAGE \
+	"USAGE: sg_bench [-h] [-v] [-i <iterations>] [-r <repeats>] [-w <warmup>]\n" \
+	"                [-c <sizes>] [-s <percents>] [-f <files>] [-n <nodes>]\n" \
+	"                [-b <benchmarks>]\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"    -v - verbose output\n" \
+	"    -i - operations timed in each run, default 20000\n" \
+	"    -r - timed runs of each measurement, default 5\n" \
+	"    -w - operations run untimed before the first run, default 2000\n" \
+	"    -c - comma separated cache sizes (blocks) to sweep\n" \
+	"    -s - comma separated working set sizes (percent of the cache) to sweep\n" \
+	"    -f - comma separated numbers of open files to sweep\n" \
+	"    -n - comma separated numbers of known nodes to sweep\n" \
+	"    -b - comma separated benchmarks to run (packet, cache, file, node),\n" \
+	"         default all\n" \
+	"\n" \
+
+#define SG_BENCH_MAX_SWEEP 16
+#define SG_BENCH_MAX_REPEATS 64
+#define SG_BENCH_KEYS 65536                 // Random keys cycled through (power of 2)
+#define SG_BENCH_NODE_BASE 0x70000000       // First made up node ID (clear of real node IDs)
+#define SG_BENCH_BLOCK_BASE 0x10000         // First block ID of a working set
+
+// Type definitions
+typedef void (*SgBenchFunc)( void *ctx, uint64_t iters );
+
+/* The state of the benchmark being timed */
+typedef struct {
+	uint32_t keys[SG_BENCH_KEYS]; // random indexes into the working set
+	uint32_t range;               // the working set (blocks, files or nodes)
+	uint64_t hits;                // cache hits of the timed lookups
+	uint64_t lookups;
+	SgFHandle *files;
+	char packet[SG_DATA_PACKET_SIZE];
+	char data[SG_BLOCK_SIZE];
+	size_t plen;
+} benchctx_t;
+
+//
+// Global Data
+unsigned long SGServiceLevel; // Service log level (the service library logs to it)
+unsigned long SGDriverLevel; // Controller log level
+uint64_t benchIterations = 20000;
+uint64_t benchWarmup = 2000;
+int benchRepeats = 5;
+
+//
+// Functional Prototypes
+
+int benchRun( const char *name, const char *param, SgBenchFunc func, benchctx_t *ctx, const char *extra );
+uint64_t benchCycles( void );
+int benchParseList( char *arg, uint32_t *list, int *num );
+void benchKeys( benchctx_t *ctx, uint32_t range );
+void benchSerialize( void *ctx, uint64_t iters );
+void benchSerializeBase( void *ctx, uint64_t iters );
+void benchDeserialize( void *ctx, uint64_t iters );
+void benchCacheGet( void *ctx, uint64_t iters );
+void benchCachePut( void *ctx, uint64_t iters );
+void benchFileLookup( void *ctx, uint64_t iters );
+void benchNodeLookup( void *ctx, uint64_t iters );
+int benchAddNodes( uint32_t from, uint32_t to );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the microbenchmark suite
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	uint32_t sizes[SG_BENCH_MAX_SWEEP] = { 64, 256, 1024, 4096 };
+	uint32_t percents[SG_BENCH_MAX_SWEEP] = { 50, 100, 200, 400 };
+	uint32_t files[SG_BENCH_MAX_SWEEP] = { 1, 16, 256, 1024 };
+	uint32_t nodes[SG_BENCH_MAX_SWEEP] = { 1, 4, 16, 64, 256 };
+	int num_sizes = 4, num_percents = 4, num_files = 4, num_nodes = 5;
+	int ch, verbose = 0, run_packet = 1, run_cache = 1, run_file = 1, run_node = 1;
+	const char *org_strings[2] = { "linear", "set" };
+	char param[64], *tok;
+	uint32_t opened = 0, known = 0, max_files = 1;
+	benchctx_t *ctx;
+
+	// Process the command line parameters
+	while ((ch = getopt(argc, argv, SG_BENCH_ARGUMENTS)) != -1) {
+
+		switch (ch) {
+		case 'h': // Help, print usage
+			fprintf( stderr, USAGE );
+			return( -1 );
+
+		case 'v': // Verbose Flag
+			verbose = 1;
+			break;
+
+		case 'i': // Timed operations per run
+			benchIterations = atol( optarg );
+			if ( benchIterations < 1 ) {
+				fprintf( stderr, "Bad number of iterations (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'r': // Timed runs
+			benchRepeats = atoi( optarg );
+			if ( (benchRepeats < 1) || (benchRepeats > SG_BENCH_MAX_REPEATS) ) {
+				fprintf( stderr, "Bad number of repeats (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'w': // Warm up operations
+			benchWarmup = atol( optarg );
+			break;
+
+		case 'c': // Cache sizes
+			if ( benchParseList(optarg, sizes, &num_sizes) ) {
+				fprintf( stderr, "Bad cache sizes, aborting.\n" );
+				return( -1 );
+			}
+			break;
+
+		case 's': // Working set sizes
+			if ( benchParseList(optarg, percents, &num_percents) ) {
+				fprintf( stderr, "Bad working set sizes, aborting.\n" );
+				return( -1 );
+			}
+			break;
+
+		case 'f': // Open files
+			if ( benchParseList(optarg, files, &num_files) ) {
+				fprintf( stderr, "Bad numbers of files, aborting.\n" );
+				return( -1 );
+			}
+			break;
+
+		case 'n': // Known nodes
+			if ( benchParseList(optarg, nodes, &num_nodes) ) {
+				fprintf( stderr, "Bad numbers of nodes, aborting.\n" );
+				return( -1 );
+			}
+			break;
+
+		case 'b': // Benchmarks to run
+			run_packet = run_cache = run_file = run_node = 0;
+			for ( tok = strtok(optarg, ","); tok != NULL; tok = strtok(NULL, ",") ) {
+				if ( strcmp(tok, "packet") == 0 ) {
+					run_packet = 1;
+				} else if ( strcmp(tok, "cache") == 0 ) {
+					run_cache = 1;
+				} else if ( strcmp(tok, "file") == 0 ) {
+					run_file = 1;
+				} else if ( strcmp(tok, "node") == 0 ) {
+					run_node = 1;
+				} else {
+					fprintf( stderr, "Unknown benchmark (%s), aborting.\n", tok );
+					return( -1 );
+				}
+			}
+			break;
+
+		default:  // Default (unknown)
+			fprintf( stderr, "Unknown command line option (%c), aborting.\n", ch );
+			return( -1 );
+		}
+	}
+
+	// Setup the log (the made up nodes would each log an error), the driver runs on the local service
+	initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+	SGServiceLevel = registerLogLevel("SG_SERVICE", 0);
+	SGDriverLevel = registerLogLevel("SG_DRIVER", 0);
+	if ( verbose ) {
+		enableLogLevels( LOG_INFO_LEVEL );
+	} else {
+		disableLogLevels( LOG_ERROR_LEVEL );
+	}
+	sgDriverServicePost = sgLocalServicePost;
+	sgServiceConcurrent = 1;
+	sgInlineEnabled = 1;
+	for (int f = 0; f < num_files; f++) {
+		max_files = (files[f] > max_files) ? files[f] : max_files;
+	}
+	ctx = calloc(1, sizeof(benchctx_t));
+	ctx->files = calloc(max_files, sizeof(SgFHandle));
+	if ( ((ctx->files[0] = sgopen("bench")) == -1) || (sgwrite(ctx->files[0], "b", 1) != 1) ) {
+		fprintf( stderr, "Driver initialization failed, aborting.\n" );
+		return( -1 );
+	}
+	opened = 1;
+	printf( "%-12s %-28s %12s %12s %12s  %s\n", "benchmark", "parameters", "best ns/op", "median ns/op",
+			"cycles/op", "" );
+
+	// Packet serialization (the receiver sequence number given, no node lookup)
+	if ( run_packet ) {
+		memset( ctx->data, 0xa5, SG_BLOCK_SIZE );
+		benchRun( "serialize", "update (data packet)", benchSerialize, ctx, "" );
+		benchRun( "serialize", "obtain (base packet)", benchSerializeBase, ctx, "" );
+		ctx->plen = SG_DATA_PACKET_SIZE;
+		serialize_sg_packet( SG_BENCH_NODE_BASE, SG_BENCH_NODE_BASE, SG_BENCH_BLOCK_BASE, SG_OBTAIN_BLOCK,
+				SG_INITIAL_SEQNO + 1, SG_INITIAL_SEQNO + 1, ctx->data, ctx->packet, &ctx->plen );
+		known = benchAddNodes( 0, 1 );
+		benchRun( "deserialize", "obtain reply (data packet)", benchDeserialize, ctx, "" );
+	}
+
+	// Block cache, each organization over cache sizes and working sets
+	for (int o = 0; run_cache && (o < 2); o++) {
+		for (int s = 0; s < num_sizes; s++) {
+			for (int p = 0; p < num_percents; p++) {
+				closeSGCache();
+				initSGCache( sizes[s], (o == 0) ? SG_CACHE_LINEAR : SG_CACHE_SET_ASSOC );
+				benchKeys( ctx, ((uint64_t)sizes[s] * percents[p] / 100) ? (uint64_t)sizes[s] * percents[p] / 100 : 1 );
+				for (uint32_t b = 0; b < ctx->range; b++) {
+					putSGDataBlock( SG_BENCH_NODE_BASE, SG_BENCH_BLOCK_BASE + b, ctx->data );
+				}
+				snprintf( param, sizeof(param), "%s %u lines, ws %u%%", org_strings[o], sizes[s], percents[p] );
+				benchRun( "cache get", param, benchCacheGet, ctx, "" );
+				benchRun( "cache put", param, benchCachePut, ctx, "" );
+			}
+		}
+	}
+	if ( run_cache ) {
+		closeSGCache();
+		initSGCache( SG_MAX_CACHE_ELEMENTS, sgCacheOrganization );
+	}
+
+	// File handle lookup over the open files (small inline files, no blocks)
+	for (int f = 0; run_file && (f < num_files); f++) {
+		for (; opened < files[f]; opened++) {
+			if ( ((ctx->files[opened] = sgopen("bench")) == -1) || (sgwrite(ctx->files[opened], "b", 1) != 1) ) {
+				fprintf( stderr, "Failed opening file %u, aborting.\n", opened );
+				return( -1 );
+			}
+		}
+		benchKeys( ctx, files[f] );
+		snprintf( param, sizeof(param), "%u files", files[f] );
+		benchRun( "file lookup", param, benchFileLookup, ctx, "(sgseek)" );
+	}
+
+	// Node table lookup over the known nodes
+	for (int n = 0; run_node && (n < num_nodes); n++) {
+		known = benchAddNodes( known, nodes[n] );
+		benchKeys( ctx, nodes[n] );
+		snprintf( param, sizeof(param), "%u nodes", nodes[n] );
+		benchRun( "node lookup", param, benchNodeLookup, ctx, "(serialize, no rseq)" );
+	}
+
+	// Shut down the driver (its node table was used by the benchmark, the local service does not mind)
+	sgshutdown();
+	free( ctx->files );
+	free( ctx );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchRun
+// Description  : Time a benchmark: warm it up, time each run and print the
+//                best and median time per operation
+//
+// Inputs       : name - the component benchmarked
+//                param - the parameters of the measurement
+//                func - the benchmark loop
+//                ctx - the benchmark state
+//                extra - text printed after the times
+// Outputs      : 0 if successful, -1 if failure
+
+int benchRun( const char *name, const char *param, SgBenchFunc func, benchctx_t *ctx, const char *extra ) {
+
+	double nsec[SG_BENCH_MAX_REPEATS], cycles[SG_BENCH_MAX_REPEATS], swap;
+	struct timespec start, end;
+	uint64_t c0, c1;
+	int best = 0;
+
+	func( ctx, benchWarmup );
+	ctx->hits = ctx->lookups = 0;
+	for (int r = 0; r < benchRepeats; r++) {
+		clock_gettime( CLOCK_MONOTONIC, &start );
+		c0 = benchCycles();
+		func( ctx, benchIterations );
+		c1 = benchCycles();
+		clock_gettime( CLOCK_MONOTONIC, &end );
+		nsec[r] = ((double)(end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / benchIterations;
+		cycles[r] = (double)(c1 - c0) / benchIterations;
+		if ( nsec[r] < nsec[best] ) {
+			best = r;
+		}
+	}
+	printf( "%-12s %-28s %12.1f", name, param, nsec[best] );
+
+	// sort the runs for the median
+	for (int r = 1; r < benchRepeats; r++) {
+		for (int s = r; (s > 0) && (nsec[s - 1] > nsec[s]); s--) {
+			swap = nsec[s];
+			nsec[s] = nsec[s - 1];
+			nsec[s - 1] = swap;
+		}
+	}
+	printf( " %12.1f", nsec[benchRepeats / 2] );
+	if ( cycles[best] > 0 ) {
+		printf( " %12.1f", cycles[best] );
+	} else {
+		printf( " %12s", "-" );
+	}
+	if ( ctx->lookups > 0 ) {
+		printf( "  %.1f%% hits", 100.0 * ctx->hits / ctx->lookups );
+		ctx->lookups = 0;
+	}
+	printf( "  %s\n", extra );
+	fflush( stdout );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchCycles
+// Description  : Read the timestamp counter
+//
+// Inputs       : none
+// Outputs      : the counter, 0 if there is none
+
+uint64_t benchCycles( void ) {
+
+#if defined(__x86_64__) || defined(__i386__)
+	return( __rdtsc() );
+#else
+	return( 0 );
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchParseList
+// Description  : Parse a comma separated list of positive numbers
+//
+// Inputs       : arg - the list
+//                list - the numbers (returned)
+//                num - the number of numbers (returned)
+// Outputs      : 0 if successful, -1 if failure
+
+int benchParseList( char *arg, uint32_t *list, int *num ) {
+
+	char *tok;
+
+	*num = 0;
+	for ( tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",") ) {
+		if ( (*num == SG_BENCH_MAX_SWEEP) || (atol(tok) < 1) ) {
+			return( -1 );
+		}
+		list[(*num)++] = atol( tok );
+	}
+	return( (*num > 0) ? 0 : -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchKeys
+// Description  : Fill the random keys cycled through by a benchmark
+//
+// Inputs       : ctx - the benchmark state
+//                range - the keys are 0 to range - 1
+// Outputs      : none
+
+void benchKeys( benchctx_t *ctx, uint32_t range ) {
+
+	uint64_t x = 0x9e3779b97f4a7c15ULL;
+
+	ctx->range = range;
+	for (int k = 0; k < SG_BENCH_KEYS; k++) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		ctx->keys[k] = (uint32_t)(x % range);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchSerialize
+// Description  : Serialize update packets (with a block of data)
+//
+// Inputs       : ctx - the benchmark state
+//                iters - the number of operations
+// Outputs      : none
+
+void benchSerialize( void *ctx, uint64_t iters ) {
+
+	benchctx_t *bc = ctx;
+
+	for (uint64_t i = 0; i < iters; i++) {
+		bc->plen = SG_DATA_PACKET_SIZE;
+		serialize_sg_packet( SG_BENCH_NODE_BASE, SG_BENCH_NODE_BASE + 1, SG_BENCH_BLOCK_BASE + (i & 0xff),
+				SG_UPDATE_BLOCK, SG_INITIAL_SEQNO + 1, SG_INITIAL_SEQNO + 1, bc->data, bc->packet, &bc->plen );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchSerializeBase
+// Description  : Serialize obtain packets (no data)
+//
+// Inputs       : ctx - the benchmark state
+//                iters - the number of operations
+// Outputs      : none
+
+void benchSerializeBase( void *ctx, uint64_t iters ) {
+
+	benchctx_t *bc = ctx;
+
+	for (uint64_t i = 0; i < iters; i++) {
+		bc->plen = SG_BASE_PACKET_SIZE;
+		serialize_sg_packet( SG_BENCH_NODE_BASE, SG_BENCH_NODE_BASE + 1, SG_BENCH_BLOCK_BASE + (i & 0xff),
+				SG_OBTAIN_BLOCK, SG_INITIAL_SEQNO + 1, SG_INITIAL_SEQNO + 1, NULL, bc->packet, &bc->plen );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchDeserialize
+// Description  : De-serialize an obtain reply from a known node
+//
+// Inputs       : ctx - the benchmark state
+//                iters - the number of operations
+// Outputs      : none
+
+void benchDeserialize( void *ctx, uint64_t iters ) {
+
+	benchctx_t *bc = ctx;
+	char data[SG_BLOCK_SIZE];
+	SG_Node_ID loc, rem;
+	SG_Block_ID blk;
+	SG_SeqNum sseq, rseq;
+	SG_System_OP op;
+
+	for (uint64_t i = 0; i < iters; i++) {
+		deserialize_sg_packet( &loc, &rem, &blk, &op, &sseq, &rseq, data, bc->packet, bc->plen );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchCacheGet
+// Description  : Look random blocks of the working set up in the cache,
+//                inserting the ones missed (as the driver does)
+//
+// Inputs       : ctx - the benchmark state
+//                iters - the number of operations
+// Outputs      : none
+
+void benchCacheGet( void *ctx, uint64_t iters ) {
+
+	benchctx_t *bc = ctx;
+	SG_Block_ID blk;
+	char *block;
+
+	for (uint64_t i = 0; i < iters; i++) {
+		blk = SG_BENCH_BLOCK_BASE + bc->keys[i & (SG_BENCH_KEYS - 1)];
+		if ( (block = getSGDataBlock(SG_BENCH_NODE_BASE, blk)) != NULL ) {
+			free( block );
+			bc->hits++;
+		} else {
+			putSGDataBlock( SG_BENCH_NODE_BASE, blk, bc->data );
+		}
+	}
+	bc->lookups += iters;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchCachePut
+// Description  : Insert (or replace) random blocks of the working set
+//
+// Inputs       : ctx - the benchmark state
+//                iters - the number of operations
+// Outputs      : none
+
+void benchCachePut( void *ctx, uint64_t iters ) {
+
+	benchctx_t *bc = ctx;
+
+	for (uint64_t i = 0; i < iters; i++) {
+		putSGDataBlock( SG_BENCH_NODE_BASE, SG_BENCH_BLOCK_BASE + bc->keys[i & (SG_BENCH_KEYS - 1)], bc->data );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchFileLookup
+// Description  : Find random open files by handle (seeking to the start)
+//
+// Inputs       : ctx - the benchmark state
+//                iters - the number of operations
+// Outputs      : none
+
+void benchFileLookup( void *ctx, uint64_t iters ) {
+
+	benchctx_t *bc = ctx;
+
+	for (uint64_t i = 0; i < iters; i++) {
+		sgseek( bc->files[bc->keys[i & (SG_BENCH_KEYS - 1)]], 0 );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchNodeLookup
+// Description  : Serialize packets to random known nodes without a receiver
+//                sequence number, which looks the node up in the node table
+//
+// Inputs       : ctx - the benchmark state
+//                iters - the number of operations
+// Outputs      : none
+
+void benchNodeLookup( void *ctx, uint64_t iters ) {
+
+	benchctx_t *bc = ctx;
+
+	for (uint64_t i = 0; i < iters; i++) {
+		bc->plen = SG_BASE_PACKET_SIZE;
+		serialize_sg_packet( SG_BENCH_NODE_BASE, SG_BENCH_NODE_BASE + bc->keys[i & (SG_BENCH_KEYS - 1)],
+				SG_BENCH_BLOCK_BASE, SG_OBTAIN_BLOCK, SG_INITIAL_SEQNO + 1, SG_SEQNO_UNKNOWN, NULL,
+				bc->packet, &bc->plen );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : benchAddNodes
+// Description  : Make the driver's node table know more made up nodes, by
+//                de-serializing a reply from each
+//
+// Inputs       : from - the nodes known so far
+//                to - the nodes to know
+// Outputs      : the nodes known
+
+int benchAddNodes( uint32_t from, uint32_t to ) {
+
+	char packet[SG_BASE_PACKET_SIZE];
+	SG_Node_ID loc, rem;
+	SG_Block_ID blk;
+	SG_SeqNum sseq, rseq;
+	SG_System_OP op;
+	size_t plen;
+
+	for (uint32_t n = from; n < to; n++) {
+		plen = SG_BASE_PACKET_SIZE;
+		serialize_sg_packet( SG_BENCH_NODE_BASE, SG_BENCH_NODE_BASE + n, SG_BENCH_BLOCK_BASE, SG_OBTAIN_BLOCK,
+				SG_INITIAL_SEQNO + 1, SG_INITIAL_SEQNO + 1, NULL, packet, &plen );
+		deserialize_sg_packet( &loc, &rem, &blk, &op, &sseq, &rseq, NULL, packet, plen );
+	}
+	return( (to > from) ? to : from );
+}
@@ -11,11 +11,18 @@
 
 // Include Files
 #include <stdlib.h>
+#include <malloc.h>
 #include <cmpsc311_log.h>
 
 // Project Includes
 #include <sg_cache.h>
+#include <sg_compress.h>
+#include <sg_setcache.h>
+#include <sg_shmcache.h>
+#include <sg_ssdcache.h>
+#include <sg_trace.h>
 #include <string.h>
+#include <pthread.h>
 
 // Defines
 // struct to hold metadata and block for each line in the cache
@@ -27,6 +34,33 @@ typedef struct cacheline {
     SG_Block_ID blk_id;
     char *block;
 } cacheline_t;
+// struct to hold a compressed (evicted) block in the second level tier
+typedef struct zcacheline {
+    struct zcacheline *next;
+    struct zcacheline *prev;
+    SG_Node_ID rem_id;
+    SG_Block_ID blk_id;
+    size_t clen;
+    char *block;
+} zcacheline_t;
+// struct to remember a recently evicted block (no data) for adaptive sizing
+typedef struct ghostline {
+    int valid;
+    SG_Node_ID rem_id;
+    SG_Block_ID blk_id;
+} ghostline_t;
+// struct to hold a block fetch in flight, which later requesters wait on
+typedef struct flight {
+    struct flight *next;
+    SG_Node_ID rem_id;
+    SG_Block_ID blk_id;
+    int finished;
+    int status;
+    int updated;
+    int waiters;
+    pthread_cond_t done;
+    char block[SG_BLOCK_SIZE];
+} flight_t;
 // struct to hold metadata of the entire cache
 typedef struct cache {
     int queries;
@@ -34,11 +68,56 @@ typedef struct cache {
     int num_items;
     int hits;
     float ratio;
-    uint16_t size;
+    int size;
     cacheline_t *cache_data;
+    // set associative organization (NULL for the array of lines)
+    SG_Cache_Organization org;
+    sgsetcache_t *sets;
+    // blocks shared with other processes (NULL if the cache is private)
+    sgshmcache_t *shared;
+    // adaptive sizing between min_lines and max_lines (max_lines 0 if fixed)
+    int min_lines;
+    int max_lines;
+    int step;
+    int window_queries;
+    int window_tail_hits;
+    int window_ghost_hits;
+    int grows;
+    int shrinks;
+    int peak;
+    int ghost_size;
+    int ghost_next;
+    ghostline_t *ghost;
+    // fetches in flight (single flight of concurrent misses)
+    flight_t *flights;
+    int fetches;
+    int joins;
+    // compressed second level tier, newest first
+    size_t ztier_max;
+    size_t ztier_bytes;
+    int ztier_items;
+    int ztier_hits;
+    int ztier_drops;
+    zcacheline_t *ztier_head;
+    zcacheline_t *ztier_tail;
+    // local disk tier below the memory tiers (NULL if none)
+    sgssdcache_t *ssd;
 } cache_t;
 // Functional Prototypes
 cache_t *cache;
+pthread_mutex_t cacheLock; // Serializes cache access (recursive, gets promote with puts)
+int sgCacheTierInsert( SG_Node_ID nde, SG_Block_ID blk, char *block );
+int sgCacheTierRemove( SG_Node_ID nde, SG_Block_ID blk, char *block );
+void sgCacheTierUnlink( zcacheline_t *line );
+void sgCacheDemote( SG_Node_ID nde, SG_Block_ID blk, char *block );
+int sgCacheResize( int lines );
+void sgCacheSetEvict( SG_Node_ID nde, SG_Block_ID blk, char *block );
+int sgCacheAdapt( void );
+int sgCacheEvict( void );
+void sgCacheGhostInsert( SG_Node_ID nde, SG_Block_ID blk );
+int sgCacheGhostRemove( SG_Node_ID nde, SG_Block_ID blk );
+flight_t *sgCacheFindFlight( SG_Node_ID nde, SG_Block_ID blk );
+void sgCacheReleaseFlight( flight_t *flight );
 //
 // Functions
 
@@ -48,10 +127,17 @@ cache_t *cache;
 // Description  : Initialize the cache of block elements
 //
 // Inputs       : maxElements - maximum number of elements allowed
+//                org - the organization of the cache lines
 // Outputs      : 0 if successful, -1 if failure
 
-int initSGCache( uint16_t maxElements ) {
+int initSGCache( uint32_t maxElements, SG_Cache_Organization org ) {
 
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&cacheLock, &attr);
+    pthread_mutexattr_destroy(&attr);
     cache = malloc(sizeof(cache_t));
     cache->size = maxElements;
 
@@ -61,6 +147,43 @@ int initSGCache( uint16_t maxElements ) {
     cache->hits = 0;
     cache->ratio = 0;
     cache->open = 1;
+    cache->ztier_max = 0;
+    cache->ztier_bytes = 0;
+    cache->ztier_items = 0;
+    cache->ztier_hits = 0;
+    cache->ztier_drops = 0;
+    cache->ztier_head = NULL;
+    cache->ztier_tail = NULL;
+    cache->ssd = NULL;
+    cache->min_lines = maxElements;
+    cache->max_lines = 0;
+    cache->step = 0;
+    cache->window_queries = 0;
+    cache->window_tail_hits = 0;
+    cache->window_ghost_hits = 0;
+    cache->grows = 0;
+    cache->shrinks = 0;
+    cache->peak = maxElements;
+    cache->ghost_size = 0;
+    cache->ghost_next = 0;
+    cache->ghost = NULL;
+    cache->flights = NULL;
+    cache->fetches = 0;
+    cache->joins = 0;
+    cache->org = org;
+    cache->sets = NULL;
+    cache->shared = NULL;
+    cache->cache_data = NULL;
+    if (org == SG_CACHE_SET_ASSOC) {
+        if ((cache->sets = sgSetCacheCreate(maxElements, sgCacheSetEvict)) == NULL) {
+            logMessage(LOG_ERROR_LEVEL, "init_cmpsc311_cache: failed creating set associative cache\n");
+            free(cache);
+            return( -1 );
+        }
+        logMessage(LOG_INFO_LEVEL, "init_cmpsc311_cache: %u sets of %d ways (%s probes)\n",
+                cache->sets->num_sets, SG_SETCACHE_WAYS, sgSetCacheImplementation());
+        return( 0 );
+    }
     cache->cache_data = calloc(maxElements, sizeof(cacheline_t));
     // initialize free value and line numbers of cache, allocate data for cachelines
     for (int i = 0; i < cache->size; i++) {
@@ -73,6 +196,136 @@ int initSGCache( uint16_t maxElements ) {
     return( 0 );
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : initSGCacheShared
+// Description  : Keep the blocks of the cache in a shared memory segment that
+//                every process naming it uses, in place of the private lines
+//
+// Inputs       : name - the segment name
+//                lines - the number of blocks (if the segment is created)
+// Outputs      : 0 if successful, -1 if failure
+
+int initSGCacheShared( const char *name, uint32_t lines ) {
+
+    if ((cache == NULL) || (cache->open == 0)) {
+        return( -1 );
+    }
+    pthread_mutex_lock(&cacheLock);
+    cache->shared = sgShmCacheOpen(name, lines);
+    pthread_mutex_unlock(&cacheLock);
+    return( (cache->shared == NULL) ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : initSGCacheTier
+// Description  : Enable the compressed second level tier of the cache, which
+//                keeps evicted blocks compressed in memory before dropping them
+//
+// Inputs       : maxBytes - maximum number of compressed bytes to hold
+// Outputs      : 0 if successful, -1 if failure
+
+int initSGCacheTier( size_t maxBytes ) {
+
+    if ((cache == NULL) || (cache->open == 0)) {
+        return( -1 );
+    }
+    cache->ztier_max = maxBytes;
+    logMessage(LOG_INFO_LEVEL, "initSGCacheTier: compressed tier enabled [%lu bytes]\n", maxBytes);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : initSGCacheDisk
+// Description  : Enable the local disk (SSD) tier of the cache, which keeps
+//                blocks evicted from memory (and dropped by the compressed
+//                tier) in a file before dropping them
+//
+// Inputs       : path - the file to keep the blocks in
+//                maxBytes - maximum number of bytes of blocks to hold
+// Outputs      : 0 if successful, -1 if failure
+
+int initSGCacheDisk( const char *path, size_t maxBytes ) {
+
+    if ((cache == NULL) || (cache->open == 0) || (cache->ssd != NULL)) {
+        return( -1 );
+    }
+    pthread_mutex_lock(&cacheLock);
+    cache->ssd = sgSsdCacheOpen(path, maxBytes);
+    pthread_mutex_unlock(&cacheLock);
+    return( (cache->ssd == NULL) ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : setSGCacheBudget
+// Description  : Size the cache adaptively between a minimum and maximum byte
+//                budget.  Recently evicted blocks are remembered in a ghost
+//                list; when enough misses hit the ghost list the cache grows,
+//                when the least recently used lines stop getting hits it
+//                shrinks and frees their memory.  Called again at runtime
+//                (e.g. under memory pressure) the cache is resized into the
+//                new budget right away.
+//
+// Inputs       : minBytes - the smallest cache (bytes of blocks)
+//                maxBytes - the largest cache (bytes of blocks)
+// Outputs      : 0 if successful, -1 if failure
+
+int setSGCacheBudget( size_t minBytes, size_t maxBytes ) {
+
+    int min_lines = minBytes / SG_BLOCK_SIZE, max_lines = maxBytes / SG_BLOCK_SIZE;
+
+    if ((cache == NULL) || (cache->open == 0) || (min_lines < 1) || (max_lines < min_lines)) {
+        logMessage(LOG_ERROR_LEVEL, "setSGCacheBudget: bad cache budget [%lu-%lu bytes]\n", minBytes, maxBytes);
+        return( -1 );
+    }
+
+    pthread_mutex_lock(&cacheLock);
+    cache->min_lines = min_lines;
+    cache->max_lines = max_lines;
+    cache->step = (max_lines / 8 > SG_CACHE_MIN_STEP) ? max_lines / 8 : SG_CACHE_MIN_STEP;
+    cache->window_queries = 0;
+    cache->window_tail_hits = 0;
+    cache->window_ghost_hits = 0;
+
+    // the ghost list remembers one step worth of evicted blocks
+    if (cache->ghost_size != cache->step) {
+        free(cache->ghost);
+        cache->ghost = calloc(cache->step, sizeof(ghostline_t));
+        cache->ghost_size = cache->step;
+        cache->ghost_next = 0;
+    }
+    if (cache->size < min_lines) {
+        sgCacheResize(min_lines);
+    } else if (cache->size > max_lines) {
+        sgCacheResize(max_lines);
+    }
+    pthread_mutex_unlock(&cacheLock);
+
+    logMessage(LOG_INFO_LEVEL, "setSGCacheBudget: adaptive cache [%lu-%lu bytes], now %d lines\n", minBytes, maxBytes, cache->size);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : getSGCacheBytes
+// Description  : Get the number of bytes of blocks the cache holds room for
+//
+// Inputs       : none
+// Outputs      : the cache size in bytes
+
+size_t getSGCacheBytes( void ) {
+
+    size_t bytes;
+
+    pthread_mutex_lock(&cacheLock);
+    bytes = (size_t)cache->size * SG_BLOCK_SIZE;
+    pthread_mutex_unlock(&cacheLock);
+    return( bytes );
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Function     : closeSGCache
@@ -93,11 +346,40 @@ int closeSGCache( void ) {
     float queriez = (float)(cache->queries);
     cache->ratio = (hitz/queriez)*100;
     logMessage(LOG_INFO_LEVEL, "Closing cache: %d queries, %d hits (%.2f%c hit rate).\n", cache->queries, cache->hits, cache->ratio, '%');
+    if (cache->ztier_max > 0) {
+        logMessage(LOG_INFO_LEVEL, "Closing compressed tier: %d items, %lu bytes, %d hits, %d dropped.\n",
+                cache->ztier_items, cache->ztier_bytes, cache->ztier_hits, cache->ztier_drops);
+    }
+    if (cache->joins > 0) {
+        logMessage(LOG_INFO_LEVEL, "Closing cache fetches: %d fetched, %d coalesced into fetches in flight.\n",
+                cache->fetches, cache->joins);
+    }
+    if (cache->max_lines > 0) {
+        logMessage(LOG_INFO_LEVEL, "Closing adaptive cache: %d lines (peak %d, range %d-%d), %d grows, %d shrinks.\n",
+                cache->size, cache->peak, cache->min_lines, cache->max_lines, cache->grows, cache->shrinks);
+    }
     // free cache data
-    for (int i = 0; i < cache->size; i++) {
+    if (cache->shared != NULL) {
+        sgShmCacheClose(cache->shared);
+    }
+    if (cache->ssd != NULL) {
+        sgSsdCacheClose(cache->ssd);
+    }
+    while (cache->ztier_head != NULL) {
+        zcacheline_t *line = cache->ztier_head;
+        sgCacheTierUnlink(line);
+        free(line->block);
+        free(line);
+    }
+    for (int i = 0; (cache->sets == NULL) && (i < cache->size); i++) {
         free(cache->cache_data[i].block); 
     }
     free(cache->cache_data);
+    if (cache->sets != NULL) {
+        sgSetCacheFree(cache->sets);
+        free(cache->sets);
+    }
+    free(cache->ghost);
     free(cache);
     // Return successfully
     return( 0 );
@@ -114,13 +396,56 @@ int closeSGCache( void ) {
 
 char * getSGDataBlock( SG_Node_ID nde, SG_Block_ID blk ) {
     
+    SG_TRACE_SCOPE(SG_TEV_CACHE_GET, blk);
+    pthread_mutex_lock(&cacheLock);
     cache->queries++;
-    char  *current = malloc(SG_BLOCK_SIZE);
+    char  *current, *line;
+    int newer, victim;
+    // a shared cache is copied from without locking out the other processes
+    if (cache->shared != NULL) {
+        current = malloc(SG_BLOCK_SIZE);
+        if (sgShmCacheGet(cache->shared, nde, blk, current) == 0) {
+            cache->hits++;
+            pthread_mutex_unlock(&cacheLock);
+            return current;
+        }
+        free(current);
+        pthread_mutex_unlock(&cacheLock);
+        return NULL;
+    }
+    if ((cache->max_lines > 0) && (++cache->window_queries >= SG_CACHE_ADAPT_INTERVAL)) {
+        sgCacheAdapt();
+    }
+    // the set associative organization probes the one set the block can be in
+    if ((cache->sets != NULL) && ((line = sgSetCacheLookup(cache->sets, nde, blk, &victim)) != NULL)) {
+        cache->hits++;
+        current = malloc(SG_BLOCK_SIZE);
+        memcpy(current, line, SG_BLOCK_SIZE);
+        // a hit on the next block its set would evict stands in for the last step of lines
+        if ((cache->max_lines > 0) && victim) {
+            cache->window_tail_hits++;
+        }
+        pthread_mutex_unlock(&cacheLock);
+        return current;
+    }
     // check if we have the block in the cache and update hits if we do
-    for (int i = 0; i < cache->size; i++) {
+    for (int i = 0; (cache->sets == NULL) && (i < cache->size); i++) {
         if ((cache->cache_data[i].rem_id == nde) && (cache->cache_data[i].blk_id == blk)) {
             cache->hits++;
+            current = malloc(SG_BLOCK_SIZE);
             memcpy(current, cache->cache_data[i].block, SG_BLOCK_SIZE);
+            // a hit deeper than a cache one step smaller holds would be lost by shrinking
+            if (cache->max_lines > 0) {
+                newer = 0;
+                for (int j = 0; j < cache->size; j++) {
+                    if (cache->cache_data[j].free && (cache->cache_data[j].LRU < cache->cache_data[i].LRU)) {
+                        newer++;
+                    }
+                }
+                if (newer >= cache->size - cache->step) {
+                    cache->window_tail_hits++;
+                }
+            }
             // if we get a hit, set its LRU to 0 and increment LRUs of all other cache lines
             // the least recently used block will always have the highest LRU value
             cache->cache_data[i].LRU = 0;
@@ -128,15 +453,48 @@ char * getSGDataBlock( SG_Node_ID nde, SG_Block_ID blk ) {
                 cache->cache_data[j].LRU++;
             }
 
-            logMessage(LOG_INFO_LEVEL, "Getting found cache item: %d length 1024\n", cache->cache_data[i].line_num);
+            logMessage(LOG_INFO_LEVEL, "Getting found cache item: %d length %d\n", cache->cache_data[i].line_num, SG_BLOCK_SIZE);
             logMessage(LOG_INFO_LEVEL, "sgDriverObtainBlock: Used cached block [%d], node [%d] in cache.\n", blk, nde); 
+            pthread_mutex_unlock(&cacheLock);
             return current;
         }
     }
     
+    // check the compressed tier, promote the block back into the cache if found
+    if (cache->ztier_items > 0) {
+        current = malloc(SG_BLOCK_SIZE);
+        if (sgCacheTierRemove(nde, blk, current) == 0) {
+            cache->hits++;
+            cache->ztier_hits++;
+            putSGDataBlock(nde, blk, current);
+            logMessage(LOG_INFO_LEVEL, "sgDriverObtainBlock: Used compressed block [%lu], node [%lu].\n", blk, nde);
+            pthread_mutex_unlock(&cacheLock);
+            return current;
+        }
+        free(current);
+    }
+
+    // then the disk tier, the block moves back into memory
+    if (cache->ssd != NULL) {
+        current = malloc(SG_BLOCK_SIZE);
+        if (sgSsdCacheGet(cache->ssd, nde, blk, current) == 0) {
+            cache->hits++;
+            putSGDataBlock(nde, blk, current);
+            logMessage(LOG_INFO_LEVEL, "sgDriverObtainBlock: Used disk tier block [%lu], node [%lu].\n", blk, nde);
+            pthread_mutex_unlock(&cacheLock);
+            return current;
+        }
+        free(current);
+    }
+
+    // a miss on a recently evicted block would have been a hit in a bigger cache
+    if ((cache->max_lines > 0) && (sgCacheGhostRemove(nde, blk) == 0)) {
+        cache->window_ghost_hits++;
+    }
     logMessage(LOG_INFO_LEVEL, "Getting cache item (not found!)\n");
-    logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*1024);
+    logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*SG_BLOCK_SIZE);
 
+    pthread_mutex_unlock(&cacheLock);
     return NULL;
 }
 
@@ -151,6 +509,32 @@ char * getSGDataBlock( SG_Node_ID nde, SG_Block_ID blk ) {
 // Outputs      : 0 if successful, -1 if failure
 
 int putSGDataBlock( SG_Node_ID nde, SG_Block_ID blk, char *block ) {
+
+    SG_TRACE_SCOPE(SG_TEV_CACHE_PUT, blk);
+    pthread_mutex_lock(&cacheLock);
+    // a fetch in flight must not replace this newer version when it completes
+    flight_t *flight = sgCacheFindFlight(nde, blk);
+    if (flight != NULL) {
+        memcpy(flight->block, block, SG_BLOCK_SIZE);
+        flight->updated = 1;
+    }
+    if (cache->shared != NULL) {
+        sgShmCachePut(cache->shared, nde, blk, block);
+        pthread_mutex_unlock(&cacheLock);
+        return 0;
+    }
+    if (cache->sets != NULL) {
+        if (cache->ztier_items > 0) {
+            sgCacheTierRemove(nde, blk, NULL);
+        }
+        if (cache->ssd != NULL) {
+            sgSsdCacheRemove(cache->ssd, nde, blk);
+        }
+        memcpy(sgSetCacheInsert(cache->sets, nde, blk), block, SG_BLOCK_SIZE);
+        cache->num_items = cache->sets->items;
+        pthread_mutex_unlock(&cacheLock);
+        return 0;
+    }
     // first check if we have a previous version of the block stored in the cache to replace
     for (int i = 0; i < cache->size; i++) {
         if ((cache->cache_data[i].rem_id) == nde && (cache->cache_data[i].blk_id == blk)) {
@@ -161,12 +545,20 @@ int putSGDataBlock( SG_Node_ID nde, SG_Block_ID blk, char *block ) {
                 cache->cache_data[j].LRU++;
             }
 
-            logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*1024);
-            logMessage(LOG_INFO_LEVEL, "Added cache item %d, length 1024\n", cache->cache_data[i].line_num);
+            logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*SG_BLOCK_SIZE);
+            logMessage(LOG_INFO_LEVEL, "Added cache item %d, length %d\n", cache->cache_data[i].line_num, SG_BLOCK_SIZE);
             logMessage(LOG_INFO_LEVEL, "Inserted block [%d], node [%d] into cache.\n", blk, nde);
+            pthread_mutex_unlock(&cacheLock);
             return 0;
         }
     }
+    // a newer version of the block makes any compressed or disk copy stale
+    if (cache->ztier_items > 0) {
+        sgCacheTierRemove(nde, blk, NULL);
+    }
+    if (cache->ssd != NULL) {
+        sgSsdCacheRemove(cache->ssd, nde, blk);
+    }
     // check if any lines of the cache are free to place the data block into
     for (int i = 0; i < cache->size; i++) {
         if (cache->cache_data[i].free == 0) {
@@ -180,9 +572,10 @@ int putSGDataBlock( SG_Node_ID nde, SG_Block_ID blk, char *block ) {
                 cache->cache_data[j].LRU++;
             }
             cache->num_items++;
-            logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*1024);
-            logMessage(LOG_INFO_LEVEL, "Added cache item %d, length 1024\n", cache->cache_data[i].line_num);
+            logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*SG_BLOCK_SIZE);
+            logMessage(LOG_INFO_LEVEL, "Added cache item %d, length %d\n", cache->cache_data[i].line_num, SG_BLOCK_SIZE);
             logMessage(LOG_INFO_LEVEL, "Inserted block [%d], node [%d] into cache.\n", blk, nde);
+            pthread_mutex_unlock(&cacheLock);
             return 0;
         }
     }
@@ -195,9 +588,14 @@ int putSGDataBlock( SG_Node_ID nde, SG_Block_ID blk, char *block ) {
         }
     }
 
-    logMessage(LOG_INFO_LEVEL, "Ejecting cache item %d, length 1024\n",current->line_num);
+    logMessage(LOG_INFO_LEVEL, "Ejecting cache item %d, length %d\n",current->line_num, SG_BLOCK_SIZE);
+    SG_TRACE_INSTANT(SG_TEV_CACHE_EVICT, current->blk_id);
+    sgCacheDemote(current->rem_id, current->blk_id, current->block);
+    if (cache->max_lines > 0) {
+        sgCacheGhostInsert(current->rem_id, current->blk_id);
+    }
     cache->num_items--;
-    logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*1024);
+    logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*SG_BLOCK_SIZE);
     current->rem_id = nde;
     current->blk_id = blk;
     memcpy(current->block, block, SG_BLOCK_SIZE);
@@ -209,11 +607,500 @@ int putSGDataBlock( SG_Node_ID nde, SG_Block_ID blk, char *block ) {
 
     if (current->block != NULL) {
         cache->num_items++;
-        logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*1024);
-        logMessage(LOG_INFO_LEVEL, "Added cache item %d, length 1024\n", current->line_num);
+        logMessage(LOG_INFO_LEVEL, "Cache state [%d items, %d bytes used]\n", cache->num_items, (cache->num_items)*SG_BLOCK_SIZE);
+        logMessage(LOG_INFO_LEVEL, "Added cache item %d, length %d\n", current->line_num, SG_BLOCK_SIZE);
         logMessage(LOG_INFO_LEVEL, "Inserted block [%d], node [%d] into cache.\n", blk, nde);
+        pthread_mutex_unlock(&cacheLock);
         return 0;
     }
 
+    pthread_mutex_unlock(&cacheLock);
+    return( -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : beginSGDataFetch
+// Description  : Get a block from the cache, or start fetching it.  Only one
+//                fetch of a block is in flight at a time: the first caller to
+//                miss leads the fetch, later callers wait for it to complete
+//                and get its block instead of fetching the block again.
+//
+// Inputs       : nde - node ID of the block
+//                blk - block ID of the block
+//                block - the buffer to place the block in (SG_BLOCK_SIZE)
+//                wait - wait for a fetch in flight (else return SG_FETCH_BUSY)
+// Outputs      : SG_FETCH_CACHED/JOINED if the block was placed in the buffer,
+//                SG_FETCH_LEAD if the caller must fetch it and end the fetch,
+//                SG_FETCH_BUSY if it is being fetched and the caller won't wait
+
+SG_Fetch_Status beginSGDataFetch( SG_Node_ID nde, SG_Block_ID blk, char *block, int wait ) {
+
+    flight_t *flight;
+    char *current;
+    int status;
+    uint64_t tstart;
+
+    pthread_mutex_lock(&cacheLock);
+    while (1) {
+        if ((current = getSGDataBlock(nde, blk)) != NULL) {
+            memcpy(block, current, SG_BLOCK_SIZE);
+            free(current);
+            pthread_mutex_unlock(&cacheLock);
+            return( SG_FETCH_CACHED );
+        }
+
+        // start a new fetch if there is none in flight
+        if ((flight = sgCacheFindFlight(nde, blk)) == NULL) {
+            flight = calloc(1, sizeof(flight_t));
+            flight->rem_id = nde;
+            flight->blk_id = blk;
+            pthread_cond_init(&flight->done, NULL);
+            flight->next = cache->flights;
+            cache->flights = flight;
+            cache->fetches++;
+            pthread_mutex_unlock(&cacheLock);
+            return( SG_FETCH_LEAD );
+        }
+        if (!wait) {
+            pthread_mutex_unlock(&cacheLock);
+            return( SG_FETCH_BUSY );
+        }
+
+        // wait for the fetch in flight, try again if it failed
+        tstart = SG_TRACE_START();
+        flight->waiters++;
+        while (!flight->finished) {
+            pthread_cond_wait(&flight->done, &cacheLock);
+        }
+        flight->waiters--;
+        SG_TRACE_SPAN(SG_TEV_FETCH_WAIT, tstart, blk);
+        if ((status = flight->status) == 0) {
+            memcpy(block, flight->block, SG_BLOCK_SIZE);
+            cache->joins++;
+        }
+        sgCacheReleaseFlight(flight);
+        if (status == 0) {
+            pthread_mutex_unlock(&cacheLock);
+            logMessage(LOG_INFO_LEVEL, "beginSGDataFetch: joined fetch of block [%lu], node [%lu].\n", blk, nde);
+            return( SG_FETCH_JOINED );
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : endSGDataFetch
+// Description  : Complete a fetch started with beginSGDataFetch, caching the
+//                block and handing it to the callers waiting on the fetch.  If
+//                the block was updated while in flight the newer version wins.
+//
+// Inputs       : nde - node ID of the block
+//                blk - block ID of the block
+//                block - the fetched block (replaced by a newer version)
+//                status - 0 if the fetch succeeded, -1 if it failed
+// Outputs      : 0 if successful, -1 if failure
+
+int endSGDataFetch( SG_Node_ID nde, SG_Block_ID blk, char *block, int status ) {
+
+    flight_t *flight;
+
+    pthread_mutex_lock(&cacheLock);
+    if ((flight = sgCacheFindFlight(nde, blk)) == NULL) {
+        pthread_mutex_unlock(&cacheLock);
+        return( -1 );
+    }
+    flight->finished = 1;
+    flight->status = status;
+    if ((status == 0) && flight->updated) {
+        memcpy(block, flight->block, SG_BLOCK_SIZE);
+    } else if (status == 0) {
+        memcpy(flight->block, block, SG_BLOCK_SIZE);
+        putSGDataBlock(nde, blk, block);
+    }
+    pthread_cond_broadcast(&flight->done);
+    sgCacheReleaseFlight(flight);
+    pthread_mutex_unlock(&cacheLock);
+    return( 0 );
+}
+
+//
+// Single flight support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheFindFlight
+// Description  : Find the unfinished fetch of a block (cache lock held)
+//
+// Inputs       : nde - node ID to find
+//                blk - block ID to find
+// Outputs      : the fetch or NULL if not in flight
+
+flight_t *sgCacheFindFlight( SG_Node_ID nde, SG_Block_ID blk ) {
+
+    flight_t *flight;
+
+    for (flight = cache->flights; flight != NULL; flight = flight->next) {
+        if (!flight->finished && (flight->rem_id == nde) && (flight->blk_id == blk)) {
+            return( flight );
+        }
+    }
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheReleaseFlight
+// Description  : Free a finished fetch once no caller waits on it (cache lock
+//                held)
+//
+// Inputs       : flight - the fetch
+// Outputs      : none
+
+void sgCacheReleaseFlight( flight_t *flight ) {
+
+    flight_t **prev;
+
+    if (!flight->finished || (flight->waiters > 0)) {
+        return;
+    }
+    for (prev = &cache->flights; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == flight) {
+            *prev = flight->next;
+            pthread_cond_destroy(&flight->done);
+            free(flight);
+            return;
+        }
+    }
+}
+
+//
+// Adaptive sizing support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheAdapt
+// Description  : Decide whether to grow or shrink the cache from the last
+//                window of queries (cache lock held)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int sgCacheAdapt( void ) {
+
+    int threshold = SG_CACHE_ADAPT_INTERVAL / SG_CACHE_ADAPT_GAIN, lines = cache->size;
+
+    // grow if one more step of lines would have turned enough misses into hits,
+    // shrink if the last step of lines is (almost) never hit
+    if ((cache->window_ghost_hits >= threshold) && (cache->size < cache->max_lines)) {
+        lines = cache->size + cache->step;
+        lines = (lines > cache->max_lines) ? cache->max_lines : lines;
+    } else if ((cache->window_tail_hits < threshold / 2) && (cache->size > cache->min_lines)) {
+        lines = cache->size - cache->step;
+        lines = (lines < cache->min_lines) ? cache->min_lines : lines;
+    }
+    logMessage(LOG_INFO_LEVEL, "sgCacheAdapt: %d queries, %d ghost hits, %d tail hits, %d -> %d lines\n",
+            cache->window_queries, cache->window_ghost_hits, cache->window_tail_hits, cache->size, lines);
+    cache->window_queries = 0;
+    cache->window_tail_hits = 0;
+    cache->window_ghost_hits = 0;
+    if (lines != cache->size) {
+        return( sgCacheResize(lines) );
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheResize
+// Description  : Resize the cache to a number of lines, evicting the least
+//                recently used blocks and releasing their memory when
+//                shrinking (cache lock held)
+//
+// Inputs       : lines - the new number of lines
+// Outputs      : 0 if successful, -1 if failure
+
+int sgCacheResize( int lines ) {
+
+    cacheline_t *data;
+    int i, j;
+
+    // the set associative organization rebuilds its sets, freeing the old arena
+    if (cache->sets != NULL) {
+        if (sgSetCacheResize(cache->sets, lines)) {
+            logMessage(LOG_ERROR_LEVEL, "sgCacheResize: failed resizing cache to %d lines\n", lines);
+            return( -1 );
+        }
+        cache->num_items = cache->sets->items;
+        if (lines > cache->size) {
+            cache->grows++;
+        } else {
+            cache->shrinks++;
+        }
+    } else if (lines > cache->size) {
+        if ((data = realloc(cache->cache_data, lines * sizeof(cacheline_t))) == NULL) {
+            logMessage(LOG_ERROR_LEVEL, "sgCacheResize: failed growing cache to %d lines\n", lines);
+            return( -1 );
+        }
+        cache->cache_data = data;
+        for (i = cache->size; i < lines; i++) {
+            memset(&cache->cache_data[i], 0x0, sizeof(cacheline_t));
+            cache->cache_data[i].block = malloc(SG_BLOCK_SIZE);
+            cache->cache_data[i].line_num = i;
+        }
+        cache->grows++;
+    } else {
+        // evict down to the new size, then move the remaining blocks to the front
+        while (cache->num_items > lines) {
+            sgCacheEvict();
+        }
+        for (i = 0, j = 0; i < cache->size; i++) {
+            if (cache->cache_data[i].free) {
+                if (i != j) {
+                    cacheline_t line = cache->cache_data[j];
+                    cache->cache_data[j] = cache->cache_data[i];
+                    cache->cache_data[i] = line;
+                }
+                cache->cache_data[j].line_num = j;
+                j++;
+            }
+        }
+        for (i = lines; i < cache->size; i++) {
+            free(cache->cache_data[i].block);
+        }
+        cache->cache_data = realloc(cache->cache_data, lines * sizeof(cacheline_t));
+        malloc_trim(0);
+        cache->shrinks++;
+    }
+    logMessage(LOG_INFO_LEVEL, "sgCacheResize: cache resized from %d to %d lines\n", cache->size, lines);
+    cache->size = lines;
+    cache->peak = (lines > cache->peak) ? lines : cache->peak;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheEvict
+// Description  : Evict the least recently used block of the cache (cache lock
+//                held)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if the cache is empty
+
+int sgCacheEvict( void ) {
+
+    cacheline_t *current = NULL;
+
+    for (int i = 0; i < cache->size; i++) {
+        if (cache->cache_data[i].free && ((current == NULL) || (current->LRU < cache->cache_data[i].LRU))) {
+            current = &cache->cache_data[i];
+        }
+    }
+    if (current == NULL) {
+        return( -1 );
+    }
+    logMessage(LOG_INFO_LEVEL, "Ejecting cache item %d, length %d\n", current->line_num, SG_BLOCK_SIZE);
+    SG_TRACE_INSTANT(SG_TEV_CACHE_EVICT, current->blk_id);
+    sgCacheDemote(current->rem_id, current->blk_id, current->block);
+    sgCacheGhostInsert(current->rem_id, current->blk_id);
+    current->free = 0;
+    current->rem_id = 0;
+    current->blk_id = 0;
+    cache->num_items--;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheSetEvict
+// Description  : Handle a block evicted by the set associative organization
+//                (cache lock held)
+//
+// Inputs       : nde - node ID of the block
+//                blk - block ID of the block
+//                block - the block data
+// Outputs      : none
+
+void sgCacheSetEvict( SG_Node_ID nde, SG_Block_ID blk, char *block ) {
+
+    logMessage(LOG_INFO_LEVEL, "Ejecting cache block [%lu], node [%lu]\n", blk, nde);
+    SG_TRACE_INSTANT(SG_TEV_CACHE_EVICT, blk);
+    sgCacheDemote(nde, blk, block);
+    if (cache->max_lines > 0) {
+        sgCacheGhostInsert(nde, blk);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheGhostInsert
+// Description  : Remember an evicted block in the ghost list, replacing the
+//                oldest entry
+//
+// Inputs       : nde - node ID of the block
+//                blk - block ID of the block
+// Outputs      : none
+
+void sgCacheGhostInsert( SG_Node_ID nde, SG_Block_ID blk ) {
+
+    cache->ghost[cache->ghost_next].valid = 1;
+    cache->ghost[cache->ghost_next].rem_id = nde;
+    cache->ghost[cache->ghost_next].blk_id = blk;
+    cache->ghost_next = (cache->ghost_next + 1) % cache->ghost_size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheGhostRemove
+// Description  : Find and forget a block in the ghost list
+//
+// Inputs       : nde - node ID to find
+//                blk - block ID to find
+// Outputs      : 0 if found, -1 if not found
+
+int sgCacheGhostRemove( SG_Node_ID nde, SG_Block_ID blk ) {
+
+    for (int i = 0; i < cache->ghost_size; i++) {
+        if (cache->ghost[i].valid && (cache->ghost[i].rem_id == nde) && (cache->ghost[i].blk_id == blk)) {
+            cache->ghost[i].valid = 0;
+            return( 0 );
+        }
+    }
+    return( -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheDemote
+// Description  : Move a block evicted from memory down a tier: into the
+//                compressed tier if it compresses, else the disk tier
+//
+// Inputs       : nde - node ID of the block
+//                blk - block ID of the block
+//                block - the block data
+// Outputs      : none
+
+void sgCacheDemote( SG_Node_ID nde, SG_Block_ID blk, char *block ) {
+
+    if ((cache->ztier_max > 0) && (sgCacheTierInsert(nde, blk, block) == 0)) {
+        return;
+    }
+    if (cache->ssd != NULL) {
+        sgSsdCacheInsert(cache->ssd, nde, blk, block);
+    }
+}
+
+//
+// Compressed tier support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheTierInsert
+// Description  : Compress an evicted block into the second level tier, dropping
+//                the oldest compressed blocks to stay within the byte budget
+//
+// Inputs       : nde - node ID of the block
+//                blk - block ID of the block
+//                block - the block data
+// Outputs      : 0 if inserted, -1 if the block was not kept
+
+int sgCacheTierInsert( SG_Node_ID nde, SG_Block_ID blk, char *block ) {
+
+    char zblock[SG_BLOCK_SIZE], dblock[SG_BLOCK_SIZE];
+    zcacheline_t *line;
+    int clen;
+
+    // only keep blocks that actually get smaller
+    clen = sgCompress(block, SG_BLOCK_SIZE, zblock, SG_BLOCK_SIZE - 1);
+    if ((clen < 0) || ((size_t)clen > cache->ztier_max)) {
+        cache->ztier_drops++;
+        return( -1 );
+    }
+
+    // make room by dropping the oldest compressed blocks (down to the disk tier if there is one)
+    while (cache->ztier_bytes + clen > cache->ztier_max) {
+        line = cache->ztier_tail;
+        sgCacheTierUnlink(line);
+        if ((cache->ssd != NULL) && (sgDecompress(line->block, line->clen, dblock, SG_BLOCK_SIZE) == SG_BLOCK_SIZE)) {
+            sgSsdCacheInsert(cache->ssd, line->rem_id, line->blk_id, dblock);
+        }
+        free(line->block);
+        free(line);
+        cache->ztier_drops++;
+    }
+
+    // add the new block at the head of the tier
+    line = malloc(sizeof(zcacheline_t));
+    line->rem_id = nde;
+    line->blk_id = blk;
+    line->clen = clen;
+    line->block = malloc(clen);
+    memcpy(line->block, zblock, clen);
+    line->prev = NULL;
+    line->next = cache->ztier_head;
+    if (cache->ztier_head != NULL) {
+        cache->ztier_head->prev = line;
+    }
+    cache->ztier_head = line;
+    if (cache->ztier_tail == NULL) {
+        cache->ztier_tail = line;
+    }
+    cache->ztier_items++;
+    cache->ztier_bytes += clen;
+    logMessage(LOG_INFO_LEVEL, "Compressed evicted block [%lu], node [%lu] to %d bytes.\n", blk, nde, clen);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheTierRemove
+// Description  : Remove a block from the compressed tier
+//
+// Inputs       : nde - node ID to find
+//                blk - block ID to find
+//                block - buffer to decompress the block into (or NULL)
+// Outputs      : 0 if found, -1 if not found
+
+int sgCacheTierRemove( SG_Node_ID nde, SG_Block_ID blk, char *block ) {
+
+    zcacheline_t *line = cache->ztier_head;
+    int found = -1;
+
+    while (line != NULL) {
+        if ((line->rem_id == nde) && (line->blk_id == blk)) {
+            if ((block == NULL) || (sgDecompress(line->block, line->clen, block, SG_BLOCK_SIZE) == SG_BLOCK_SIZE)) {
+                found = 0;
+            }
+            sgCacheTierUnlink(line);
+            free(line->block);
+            free(line);
+            return( found );
+        }
+        line = line->next;
+    }
     return( -1 );
 }
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCacheTierUnlink
+// Description  : Unlink a line from the compressed tier list
+//
+// Inputs       : line - the line to unlink
+// Outputs      : none
+
+void sgCacheTierUnlink( zcacheline_t *line ) {
+
+    if (line->prev != NULL) {
+        line->prev->next = line->next;
+    } else {
+        cache->ztier_head = line->next;
+    }
+    if (line->next != NULL) {
+        line->next->prev = line->prev;
+    } else {
+        cache->ztier_tail = line->prev;
+    }
+    cache->ztier_items--;
+    cache->ztier_bytes -= line->clen;
+}
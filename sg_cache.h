@@ -17,13 +17,46 @@
 //
 // Defines
 #define SG_MAX_CACHE_ELEMENTS 128
+#define SG_MAX_CACHE_TIER_BYTES (SG_MAX_CACHE_ELEMENTS * SG_BLOCK_SIZE)
+#define SG_CACHE_ADAPT_INTERVAL 256 // Queries between adaptive sizing decisions
+#define SG_CACHE_ADAPT_GAIN 64 // Grow when ghost hits reach 1/GAIN of queries
+#define SG_CACHE_MIN_STEP 16 // Smallest grow/shrink step (lines)
+
+// Type definitions
+typedef enum {
+    SG_CACHE_LINEAR    = 0, // Array of lines, LRU counters, full scan lookups
+    SG_CACHE_SET_ASSOC = 1, // Set associative, SIMD tag probes, CLOCK per set
+    SG_CACHE_MAXVAL    = 2  // Maximum value of the organization
+} SG_Cache_Organization;
+
+typedef enum {
+    SG_FETCH_CACHED = 0, // The block was in the cache
+    SG_FETCH_JOINED = 1, // Another caller fetched the block
+    SG_FETCH_LEAD   = 2, // The caller must fetch the block, then end the fetch
+    SG_FETCH_BUSY   = 3  // Another caller is fetching the block (not waiting)
+} SG_Fetch_Status;
 
 // 
 // Cache functions
 
-int initSGCache( uint16_t maxElements );
+int initSGCache( uint32_t maxElements, SG_Cache_Organization org );
     // Initialize the cache of block elements
 
+int setSGCacheBudget( size_t minBytes, size_t maxBytes );
+    // Size the cache adaptively between byte budgets (also to shed memory)
+
+size_t getSGCacheBytes( void );
+    // Get the number of bytes of blocks the cache currently holds room for
+
+int initSGCacheShared( const char *name, uint32_t lines );
+    // Keep the cache in a shared memory segment used by all processes naming it
+
+int initSGCacheTier( size_t maxBytes );
+    // Enable the compressed second level tier of the cache
+
+int initSGCacheDisk( const char *path, size_t maxBytes );
+    // Enable the local disk (SSD) tier of the cache, kept in the file path
+
 int closeSGCache( void );
     // Close the cache of block elements, clean up remaining data
 
@@ -33,4 +66,10 @@ char *getSGDataBlock( SG_Node_ID nde, SG_Block_ID blk );
 int putSGDataBlock( SG_Node_ID nde, SG_Block_ID blk, char *block );
     // Get the data block from the block cache
 
+SG_Fetch_Status beginSGDataFetch( SG_Node_ID nde, SG_Block_ID blk, char *block, int wait );
+    // Get a block from the cache, or from (or as) the one fetch in flight for it
+
+int endSGDataFetch( SG_Node_ID nde, SG_Block_ID blk, char *block, int status );
+    // Complete a fetch, caching the block and handing it to the waiters
+
 #endif
\ No newline at end of file
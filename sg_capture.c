@@ -0,0 +1,354 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_capture.c
+//  Description    : This file contains the I/O capture log of the scatter
+//                   gather driver: the writer the driver appends its calls
+//                   to, and the memory mapped reader sg_sim replays them
+//                   from.  Records are gathered in a buffer under one lock
+//                   (a copy of 40 bytes per call) and written out as it
+//                   fills, so the log keeps the order the calls returned in.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_capture.h>
+#include <sg_crc.h>
+
+// Defines
+#define SG_CAPTURE_ALIGNED(x) (((x) + SG_CAPTURE_ALIGN - 1) & ~((uint64_t)SG_CAPTURE_ALIGN - 1))
+
+// Functional Prototypes
+int sgCaptureFlush( void );
+
+//
+// Global Data
+volatile int sgCaptureEnabled = 0;
+int sgCaptureFd = -1;           // The log being written
+int sgCaptureHashing = 0;       // Hash the data of reads and writes
+uint64_t sgCaptureBase = 0;     // The time the capture started
+char *sgCaptureBuffer = NULL;   // Records not yet written out (capture lock)
+size_t sgCaptureFill = 0;
+unsigned long sgCaptureCalls = 0;
+int sgCaptureFailed = 0;        // A write to the log failed, capturing stopped
+pthread_mutex_t sgCaptureLock = PTHREAD_MUTEX_INITIALIZER; // Protects the buffer and the log
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : initSGCapture
+// Description  : Start capturing the driver calls
+//
+// Inputs       : path - the log file (created or truncated)
+//                hashes - record a CRC32C of the data read and written
+// Outputs      : 0 if successful, -1 if failure
+
+int initSGCapture( const char *path, int hashes ) {
+
+    sg_capture_header_t hdr;
+
+    if (sgCaptureEnabled) {
+        logMessage(LOG_ERROR_LEVEL, "initSGCapture: already capturing");
+        return( -1 );
+    }
+    if ((sgCaptureFd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+        logMessage(LOG_ERROR_LEVEL, "initSGCapture: unable to create capture log [%s]", path);
+        return( -1 );
+    }
+    memset(&hdr, 0x0, sizeof(hdr));
+    hdr.magic = SG_CAPTURE_MAGIC;
+    hdr.version = SG_CAPTURE_VERSION;
+    hdr.flags = hashes ? SG_CAPTURE_HASHED : 0;
+    hdr.started = time(NULL);
+    if (write(sgCaptureFd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        logMessage(LOG_ERROR_LEVEL, "initSGCapture: unable to write capture log [%s]", path);
+        close(sgCaptureFd);
+        sgCaptureFd = -1;
+        return( -1 );
+    }
+    sgCaptureBuffer = malloc(SG_CAPTURE_BUFFER_BYTES);
+    sgCaptureFill = 0;
+    sgCaptureCalls = 0;
+    sgCaptureFailed = 0;
+    sgCaptureHashing = hashes;
+    sgCaptureBase = sgCaptureNow();
+    sgCaptureEnabled = 1;
+    logMessage(LOG_INFO_LEVEL, "initSGCapture: capturing calls to [%s]%s", path, hashes ? " with data hashes" : "");
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : closeSGCapture
+// Description  : Stop capturing, write out the buffered records
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int closeSGCapture( void ) {
+
+    int ret;
+
+    if (sgCaptureFd == -1) {
+        return( -1 );
+    }
+    pthread_mutex_lock(&sgCaptureLock);
+    sgCaptureEnabled = 0;
+    ret = sgCaptureFlush();
+    if ((close(sgCaptureFd) != 0) || sgCaptureFailed) {
+        ret = -1;
+    }
+    sgCaptureFd = -1;
+    free(sgCaptureBuffer);
+    sgCaptureBuffer = NULL;
+    pthread_mutex_unlock(&sgCaptureLock);
+    if (ret) {
+        logMessage(LOG_ERROR_LEVEL, "closeSGCapture: capture log incomplete, writing it failed");
+        return( -1 );
+    }
+    logMessage(LOG_INFO_LEVEL, "Capture: %lu calls captured.", sgCaptureCalls);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCaptureNow
+// Description  : Get the time calls are stamped with
+//
+// Inputs       : none
+// Outputs      : nsec (monotonic)
+
+uint64_t sgCaptureNow( void ) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return( (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCaptureRecord
+// Description  : Append a call to the capture log
+//
+// Inputs       : op - the call
+//                start - when it was made (sgCaptureNow)
+//                fh - the file handle
+//                off - the file position at the call (the target of a seek)
+//                size - the bytes asked for
+//                result - what the call returned
+//                data - the data read or written, the path of an open
+// Outputs      : none
+
+void sgCaptureRecord( SG_Capture_Op op, uint64_t start, SgFHandle fh, uint64_t off,
+        size_t size, int result, const char *data ) {
+
+    sg_capture_rec_t rec;
+    uint64_t now = sgCaptureNow();
+    size_t extra = 0;
+
+    memset(&rec, 0x0, sizeof(rec));
+    rec.time = (start > sgCaptureBase) ? start - sgCaptureBase : 0;
+    rec.off = off;
+    rec.dur = (now - start > UINT32_MAX) ? UINT32_MAX : (uint32_t)(now - start);
+    rec.fh = fh;
+    rec.size = size;
+    rec.result = result;
+    rec.op = op;
+    if (op == SG_CAPTURE_OPEN) {
+        rec.size = strlen(data) + 1;
+        extra = SG_CAPTURE_ALIGNED(rec.size);
+    } else if (sgCaptureHashing && (data != NULL) && (result > 0)) {
+        rec.hash = sgCrc32c(0, data, (op == SG_CAPTURE_READ) ? (size_t)result : size);
+    }
+
+    // calls go into the log in the order they return
+    pthread_mutex_lock(&sgCaptureLock);
+    if (!sgCaptureEnabled) {
+        pthread_mutex_unlock(&sgCaptureLock);
+        return;
+    }
+    if ((sgCaptureFill + sizeof(rec) + extra > SG_CAPTURE_BUFFER_BYTES) && sgCaptureFlush()) {
+        pthread_mutex_unlock(&sgCaptureLock);
+        return;
+    }
+    memcpy(&sgCaptureBuffer[sgCaptureFill], &rec, sizeof(rec));
+    sgCaptureFill += sizeof(rec);
+    if (extra > 0) {
+        memset(&sgCaptureBuffer[sgCaptureFill], 0x0, extra);
+        memcpy(&sgCaptureBuffer[sgCaptureFill], data, rec.size);
+        sgCaptureFill += extra;
+    }
+    sgCaptureCalls++;
+    pthread_mutex_unlock(&sgCaptureLock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCaptureIsLog
+// Description  : Check if a file is a capture log
+//
+// Inputs       : path - the filename
+// Outputs      : 1 if a capture log, 0 if not (or it can't be read)
+
+int sgCaptureIsLog( const char *path ) {
+
+    uint32_t magic = 0;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        return( 0 );
+    }
+    if (read(fd, &magic, sizeof(magic)) != sizeof(magic)) {
+        magic = 0;
+    }
+    close(fd);
+    return( magic == SG_CAPTURE_MAGIC );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCaptureOpen
+// Description  : Map a capture log and validate its header
+//
+// Inputs       : cap - the log to open
+//                path - the log filename
+// Outputs      : 0 if successful, -1 if failure
+
+int sgCaptureOpen( sg_capture_t *cap, const char *path ) {
+
+    struct stat st;
+
+    memset(cap, 0x0, sizeof(sg_capture_t));
+    if (((cap->fd = open(path, O_RDONLY)) == -1) || (fstat(cap->fd, &st) == -1)) {
+        logMessage( LOG_ERROR_LEVEL, "sgCaptureOpen: failed opening capture log [%s]", path );
+        if (cap->fd != -1) {
+            close(cap->fd);
+        }
+        return( -1 );
+    }
+    if (st.st_size < (off_t)sizeof(sg_capture_header_t)) {
+        logMessage( LOG_ERROR_LEVEL, "sgCaptureOpen: capture log [%s] too short", path );
+        close(cap->fd);
+        return( -1 );
+    }
+    cap->length = st.st_size;
+    cap->base = mmap(NULL, cap->length, PROT_READ, MAP_PRIVATE, cap->fd, 0);
+    if (cap->base == MAP_FAILED) {
+        logMessage( LOG_ERROR_LEVEL, "sgCaptureOpen: failed mapping capture log [%s]", path );
+        close(cap->fd);
+        return( -1 );
+    }
+    madvise((void *)cap->base, cap->length, MADV_SEQUENTIAL);
+    cap->hdr = (const sg_capture_header_t *)cap->base;
+    if ((cap->hdr->magic != SG_CAPTURE_MAGIC) || (cap->hdr->version != SG_CAPTURE_VERSION)) {
+        logMessage( LOG_ERROR_LEVEL, "sgCaptureOpen: [%s] is not a capture log this version reads", path );
+        sgCaptureClose(cap);
+        return( -1 );
+    }
+    cap->next = sizeof(sg_capture_header_t);
+    logMessage( LOG_INFO_LEVEL, "Opened capture log [%s], %lu bytes%s.", path,
+            (unsigned long)cap->length, (cap->hdr->flags & SG_CAPTURE_HASHED) ? ", data hashed" : "" );
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCaptureNext
+// Description  : Get the next record of a capture log
+//
+// Inputs       : cap - the log
+//                path - set to the path of an open record (NULL otherwise)
+// Outputs      : the record, NULL at the end or if it is corrupt
+
+const sg_capture_rec_t *sgCaptureNext( sg_capture_t *cap, const char **path ) {
+
+    const sg_capture_rec_t *rec;
+    uint64_t extra = 0;
+
+    *path = NULL;
+    if (cap->length - cap->next < sizeof(sg_capture_rec_t)) {
+        if (cap->next != cap->length) {
+            logMessage( LOG_ERROR_LEVEL, "sgCaptureNext: capture log truncated after record %lu", (unsigned long)cap->count );
+        }
+        return( NULL );
+    }
+    rec = (const sg_capture_rec_t *)(cap->base + cap->next);
+    if (rec->op == SG_CAPTURE_OPEN) {
+        extra = SG_CAPTURE_ALIGNED((uint64_t)rec->size);
+        if ((rec->size == 0) || (extra > cap->length - cap->next - sizeof(sg_capture_rec_t)) ||
+            (cap->base[cap->next + sizeof(sg_capture_rec_t) + rec->size - 1] != '\0')) {
+            logMessage( LOG_ERROR_LEVEL, "sgCaptureNext: bad path in record %lu", (unsigned long)cap->count );
+            return( NULL );
+        }
+        *path = cap->base + cap->next + sizeof(sg_capture_rec_t);
+    } else if (rec->op >= SG_CAPTURE_MAXVAL) {
+        logMessage( LOG_ERROR_LEVEL, "sgCaptureNext: bad call in record %lu", (unsigned long)cap->count );
+        return( NULL );
+    }
+    cap->next += sizeof(sg_capture_rec_t) + extra;
+    cap->count++;
+    return( rec );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCaptureClose
+// Description  : Unmap a capture log
+//
+// Inputs       : cap - the log
+// Outputs      : 0 if successful, -1 if failure
+
+int sgCaptureClose( sg_capture_t *cap ) {
+
+    if (cap->base != NULL) {
+        munmap((void *)cap->base, cap->length);
+        close(cap->fd);
+    }
+    memset(cap, 0x0, sizeof(sg_capture_t));
+    return( 0 );
+}
+
+//
+// Capture support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCaptureFlush
+// Description  : Write the buffered records out (capture lock held)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int sgCaptureFlush( void ) {
+
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < sgCaptureFill) {
+        if ((n = write(sgCaptureFd, &sgCaptureBuffer[done], sgCaptureFill - done)) <= 0) {
+            logMessage(LOG_ERROR_LEVEL, "sgCaptureFlush: failed writing capture log, capturing stopped");
+            sgCaptureFailed = 1;
+            sgCaptureEnabled = 0;
+            return( -1 );
+        }
+        done += n;
+    }
+    sgCaptureFill = 0;
+    return( 0 );
+}
@@ -0,0 +1,113 @@
+#ifndef SG_CAPTURE_INCLUDED
+#define SG_CAPTURE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_capture.h
+//  Description    : This is the declaration of the I/O capture log of the
+//                   scatter gather driver.  While capturing, every sgopen,
+//                   sgread, sgwrite, sgseek and sgclose call is appended to
+//                   a binary log with its handle, file position, size,
+//                   result and timing, and optionally a CRC32C of its data
+//                   (never the data itself), so that the call stream of a
+//                   real application can be replayed by sg_sim later.
+//
+//                   Layout (all values little endian)
+//
+//                     header  : sg_capture_header_t
+//                     records : sg_capture_rec_t, each open record followed
+//                               by its path (size bytes, NUL terminated,
+//                               padded to SG_CAPTURE_ALIGN)
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <stdint.h>
+#include <stddef.h>
+#include <sg_defs.h>
+
+// Defines
+#define SG_CAPTURE_MAGIC 0x50434753     // "SGCP"
+#define SG_CAPTURE_VERSION 1
+#define SG_CAPTURE_ALIGN 8
+#define SG_CAPTURE_HASHED 0x1           // Header flag, the records carry data hashes
+#define SG_CAPTURE_BUFFER_BYTES (1 << 20) // Records buffered before they are written out
+
+// Type definitions
+typedef enum {
+    SG_CAPTURE_OPEN   = 0,  // sgopen (fh and result are the handle opened)
+    SG_CAPTURE_READ   = 1,  // sgread
+    SG_CAPTURE_WRITE  = 2,  // sgwrite
+    SG_CAPTURE_SEEK   = 3,  // sgseek (off is the position sought)
+    SG_CAPTURE_CLOSE  = 4,  // sgclose
+    SG_CAPTURE_MAXVAL = 5   // Maximum value of the call
+} SG_Capture_Op;
+
+typedef struct {
+    uint32_t magic;    // SG_CAPTURE_MAGIC
+    uint32_t version;  // SG_CAPTURE_VERSION
+    uint32_t flags;    // SG_CAPTURE_HASHED
+    uint32_t reserved;
+    uint64_t started;  // Wall clock time the capture started (sec)
+} sg_capture_header_t;
+
+typedef struct {
+    uint64_t time;     // When the call was made (nsec since the capture started)
+    uint64_t off;      // The file position at the call (the position sought by a seek)
+    uint32_t dur;      // How long the call took (nsec, saturated)
+    uint32_t fh;       // The file handle
+    uint32_t size;     // The bytes asked for (read/write), the path length (open)
+    int32_t result;    // What the call returned
+    uint32_t hash;     // CRC32C of the data written or read (0 if not hashed)
+    uint32_t op;       // The call (SG_Capture_Op)
+} sg_capture_rec_t;
+
+typedef struct {
+    int fd;                          // The file descriptor of the mapping
+    size_t length;                   // The length of the mapping
+    const char *base;                // The mapped log
+    const sg_capture_header_t *hdr;  // The header
+    uint64_t next;                   // The offset of the next record
+    uint64_t count;                  // The records returned so far
+} sg_capture_t;
+
+//
+// Global interface definitions
+
+extern volatile int sgCaptureEnabled;
+    // Calls are being captured
+
+//
+// Capture functions (driver)
+
+int initSGCapture( const char *path, int hashes );
+    // Start capturing calls to the log at path, hashing their data if asked
+
+int closeSGCapture( void );
+    // Write out the buffered records and close the log
+
+uint64_t sgCaptureNow( void );
+    // Get the time calls are stamped with (nsec, monotonic)
+
+void sgCaptureRecord( SG_Capture_Op op, uint64_t start, SgFHandle fh, uint64_t off,
+        size_t size, int result, const char *data );
+    // Append a call that started at start to the log (data is the path of an open)
+
+//
+// Capture log functions (replay)
+
+int sgCaptureIsLog( const char *path );
+    // Check if a file is a capture log
+
+int sgCaptureOpen( sg_capture_t *cap, const char *path );
+    // Map a capture log and validate its header
+
+const sg_capture_rec_t *sgCaptureNext( sg_capture_t *cap, const char **path );
+    // Get the next record of the log (NULL at the end), with the path of an open
+
+int sgCaptureClose( sg_capture_t *cap );
+    // Unmap a capture log
+
+#endif
@@ -0,0 +1,432 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_compress.c
+//  Description    : This file contains the block compression stage (a small
+//                   LZ4-style compressor) and the packed block format used to
+//                   store several logical file blocks in one service block.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdlib.h>
+#include <string.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_compress.h>
+
+// Defines
+#define SG_LZ_HASH_BITS 12       // Size of the match finder hash table (log2)
+#define SG_LZ_MIN_MATCH 4        // Shortest match worth encoding
+#define SG_LZ_MAX_OFFSET 65535   // Largest back reference (16 bit offset)
+
+// Functional Prototypes
+int sgCompressEmit( char *dst, size_t dmax, size_t *op, const char *lit, size_t llen,
+        size_t off, size_t mlen );
+int sgCompressLength( char *dst, size_t dmax, size_t *op, size_t len );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCompress
+// Description  : Compress a buffer into sequences of (literals, back reference)
+//                pairs.  Each sequence starts with a token whose high nibble is
+//                the literal count and low nibble the match length - 4, with
+//                255-byte extensions for long runs (the LZ4 block layout).
+//
+// Inputs       : src - the data to compress
+//                slen - the length of the data
+//                dst - the buffer to place the compressed data
+//                dmax - the size of the destination buffer
+// Outputs      : compressed length if successful, -1 if it did not fit
+
+int sgCompress( const char *src, size_t slen, char *dst, size_t dmax ) {
+
+    uint32_t table[1 << SG_LZ_HASH_BITS];
+    size_t ip = 0, anchor = 0, op = 0, ref, mlen;
+    uint32_t seq, hash;
+
+    // positions are stored + 1 so that zero means an empty table entry
+    memset(table, 0, sizeof(table));
+    while (ip + SG_LZ_MIN_MATCH <= slen) {
+
+        // look up the last position of this 4 byte sequence
+        memcpy(&seq, src + ip, sizeof(seq));
+        hash = (seq * 2654435761U) >> (32 - SG_LZ_HASH_BITS);
+        ref = table[hash];
+        table[hash] = (uint32_t)(ip + 1);
+        if ((ref == 0) || (ip - (ref - 1) > SG_LZ_MAX_OFFSET) ||
+                (memcmp(src + ref - 1, src + ip, SG_LZ_MIN_MATCH) != 0)) {
+            ip++;
+            continue;
+        }
+
+        // extend the match as far as it goes and emit the sequence
+        ref--;
+        mlen = SG_LZ_MIN_MATCH;
+        while ((ip + mlen < slen) && (src[ref + mlen] == src[ip + mlen])) {
+            mlen++;
+        }
+        if (sgCompressEmit(dst, dmax, &op, src + anchor, ip - anchor, ip - ref, mlen)) {
+            return( -1 );
+        }
+        ip += mlen;
+        anchor = ip;
+    }
+
+    // the last sequence only carries the trailing literals
+    if (sgCompressEmit(dst, dmax, &op, src + anchor, slen - anchor, 0, 0)) {
+        return( -1 );
+    }
+    return( (int)op );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDecompress
+// Description  : Decompress a buffer created by sgCompress
+//
+// Inputs       : src - the compressed data
+//                slen - the length of the compressed data
+//                dst - the buffer to place the decompressed data
+//                dmax - the size of the destination buffer
+// Outputs      : decompressed length if successful, -1 if failure
+
+int sgDecompress( const char *src, size_t slen, char *dst, size_t dmax ) {
+
+    const uint8_t *in = (const uint8_t *)src;
+    size_t ip = 0, op = 0, llen, mlen, off;
+    uint8_t token, ext;
+
+    while (ip < slen) {
+
+        // read the literal run length and copy the literals
+        token = in[ip++];
+        llen = token >> 4;
+        if (llen == 15) {
+            do {
+                if (ip >= slen) {
+                    return( -1 );
+                }
+                ext = in[ip++];
+                llen += ext;
+            } while (ext == 255);
+        }
+        if ((ip + llen > slen) || (op + llen > dmax)) {
+            return( -1 );
+        }
+        memcpy(dst + op, src + ip, llen);
+        ip += llen;
+        op += llen;
+
+        // the final sequence has no back reference
+        if (ip == slen) {
+            break;
+        }
+
+        // read the back reference and copy the (possibly overlapping) match
+        if (ip + 2 > slen) {
+            return( -1 );
+        }
+        off = (size_t)in[ip] | ((size_t)in[ip + 1] << 8);
+        ip += 2;
+        mlen = (token & 0x0f) + SG_LZ_MIN_MATCH;
+        if ((token & 0x0f) == 15) {
+            do {
+                if (ip >= slen) {
+                    return( -1 );
+                }
+                ext = in[ip++];
+                mlen += ext;
+            } while (ext == 255);
+        }
+        if ((off == 0) || (off > op) || (op + mlen > dmax)) {
+            return( -1 );
+        }
+        for (size_t i = 0; i < mlen; i++) {
+            dst[op + i] = dst[op - off + i];
+        }
+        op += mlen;
+    }
+
+    return( (int)op );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCompressEmit
+// Description  : Emit one compressed sequence (token, literals, back reference)
+//
+// Inputs       : dst - the compressed output buffer
+//                dmax - the size of the output buffer
+//                op - the current output position (updated)
+//                lit - the literal bytes
+//                llen - the number of literal bytes
+//                off - the back reference offset
+//                mlen - the match length, 0 for the last sequence
+// Outputs      : 0 if successful, -1 if the output buffer is full
+
+int sgCompressEmit( char *dst, size_t dmax, size_t *op, const char *lit, size_t llen,
+        size_t off, size_t mlen ) {
+
+    uint8_t token;
+
+    // build the token from the two run lengths
+    token = (uint8_t)(((llen < 15) ? llen : 15) << 4);
+    if (mlen != 0) {
+        token |= (uint8_t)(((mlen - SG_LZ_MIN_MATCH) < 15) ? (mlen - SG_LZ_MIN_MATCH) : 15);
+    }
+    if (*op + 1 > dmax) {
+        return( -1 );
+    }
+    dst[(*op)++] = (char)token;
+
+    // literal length extension, then the literals themselves
+    if ((llen >= 15) && sgCompressLength(dst, dmax, op, llen - 15)) {
+        return( -1 );
+    }
+    if (*op + llen > dmax) {
+        return( -1 );
+    }
+    memcpy(dst + *op, lit, llen);
+    *op += llen;
+
+    // back reference (little endian offset) and match length extension
+    if (mlen != 0) {
+        if (*op + 2 > dmax) {
+            return( -1 );
+        }
+        dst[(*op)++] = (char)(off & 0xff);
+        dst[(*op)++] = (char)((off >> 8) & 0xff);
+        if ((mlen - SG_LZ_MIN_MATCH >= 15) &&
+                sgCompressLength(dst, dmax, op, mlen - SG_LZ_MIN_MATCH - 15)) {
+            return( -1 );
+        }
+    }
+
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCompressLength
+// Description  : Emit a run length extension (255, 255, ..., remainder)
+//
+// Inputs       : dst - the compressed output buffer
+//                dmax - the size of the output buffer
+//                op - the current output position (updated)
+//                len - the remaining length to encode
+// Outputs      : 0 if successful, -1 if the output buffer is full
+
+int sgCompressLength( char *dst, size_t dmax, size_t *op, size_t len ) {
+
+    while (len >= 255) {
+        if (*op + 1 > dmax) {
+            return( -1 );
+        }
+        dst[(*op)++] = (char)255;
+        len -= 255;
+    }
+    if (*op + 1 > dmax) {
+        return( -1 );
+    }
+    dst[(*op)++] = (char)len;
+    return( 0 );
+}
+
+//
+// Packed block functions
+//
+// A packed block is a service block holding several compressed logical
+// blocks.  The layout is a slot count, the slot table and then the
+// compressed data of each slot.  A zero filled block is an empty pack.
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPackSlots
+// Description  : Return the number of slots (used and free) in a packed block
+//
+// Inputs       : pack - the packed block
+// Outputs      : the number of slots
+
+int sgPackSlots( const char *pack ) {
+
+    uint32_t count;
+
+    memcpy(&count, pack, sizeof(count));
+    if (count > SG_PACK_MAX_SLOTS) {
+        return( 0 );
+    }
+    return( (int)count );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPackUsedSlots
+// Description  : Return the number of slots holding data in a packed block
+//
+// Inputs       : pack - the packed block
+// Outputs      : the number of used slots
+
+int sgPackUsedSlots( const char *pack ) {
+
+    sg_pack_slot_t slot;
+    int used = 0;
+
+    for (int i = 0; i < sgPackSlots(pack); i++) {
+        memcpy(&slot, pack + SG_PACK_HEADER_SIZE(i), sizeof(slot));
+        if (slot.rlen != SG_PACK_FREE_SLOT) {
+            used++;
+        }
+    }
+    return( used );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPackRead
+// Description  : Extract (decompress) a slot of a packed block
+//
+// Inputs       : pack - the packed block
+//                slot - the slot to extract
+//                data - the buffer to place the data (SG_BLOCK_SIZE)
+// Outputs      : raw length of the slot if successful, -1 if failure
+
+int sgPackRead( const char *pack, int slot, char *data ) {
+
+    sg_pack_slot_t entry;
+    int len;
+
+    // find the slot and sanity check it against the block
+    if ((slot < 0) || (slot >= sgPackSlots(pack))) {
+        logMessage(LOG_ERROR_LEVEL, "sgPackRead: bad pack slot [%d]", slot);
+        return( -1 );
+    }
+    memcpy(&entry, pack + SG_PACK_HEADER_SIZE(slot), sizeof(entry));
+    if ((entry.rlen == SG_PACK_FREE_SLOT) || (entry.offset + entry.clen > SG_BLOCK_SIZE)) {
+        logMessage(LOG_ERROR_LEVEL, "sgPackRead: corrupt pack slot [%d]", slot);
+        return( -1 );
+    }
+
+    // decompress the slot data
+    len = sgDecompress(pack + entry.offset, entry.clen, data, SG_BLOCK_SIZE);
+    if (len != (int)entry.rlen) {
+        logMessage(LOG_ERROR_LEVEL, "sgPackRead: failed decompressing slot [%d]", slot);
+        return( -1 );
+    }
+    return( len );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPackWrite
+// Description  : Replace (or add, if slot is the slot count) the data of a slot
+//                of a packed block.  The block is left unchanged if the new
+//                contents do not fit.
+//
+// Inputs       : pack - the packed block
+//                slot - the slot to write
+//                data - the raw data for the slot
+//                len - the length of the data
+// Outputs      : 0 if successful, -1 if the data does not fit
+
+int sgPackWrite( char *pack, int slot, const char *data, size_t len ) {
+
+    char newpack[SG_BLOCK_SIZE];
+    sg_pack_slot_t entry, newentry;
+    uint32_t count = (uint32_t)sgPackSlots(pack);
+    uint32_t newcount = count;
+    size_t off;
+    int clen;
+
+    // check the slot is in the pack or the next one to add
+    if ((slot < 0) || (slot > (int)count) || (len == 0) || (len > SG_BLOCK_SIZE)) {
+        return( -1 );
+    }
+    if (slot == (int)count) {
+        if (count == SG_PACK_MAX_SLOTS) {
+            return( -1 );
+        }
+        newcount++;
+    }
+
+    // lay out the new block: header first, then each slot's compressed data
+    memset(newpack, 0x0, SG_BLOCK_SIZE);
+    memcpy(newpack, &newcount, sizeof(newcount));
+    off = SG_PACK_HEADER_SIZE(newcount);
+    for (uint32_t i = 0; i < newcount; i++) {
+
+        if (i == (uint32_t)slot) {
+            clen = sgCompress(data, len, newpack + off, SG_BLOCK_SIZE - off);
+            if (clen < 0) {
+                return( -1 );
+            }
+            newentry.rlen = (uint32_t)len;
+        } else {
+            memcpy(&entry, pack + SG_PACK_HEADER_SIZE(i), sizeof(entry));
+            clen = (entry.rlen == SG_PACK_FREE_SLOT) ? 0 : (int)entry.clen;
+            if (off + clen > SG_BLOCK_SIZE) {
+                return( -1 );
+            }
+            memcpy(newpack + off, pack + entry.offset, clen);
+            newentry.rlen = entry.rlen;
+        }
+        newentry.offset = (uint32_t)off;
+        newentry.clen = (uint32_t)clen;
+        memcpy(newpack + SG_PACK_HEADER_SIZE(i), &newentry, sizeof(newentry));
+        off += clen;
+    }
+
+    memcpy(pack, newpack, SG_BLOCK_SIZE);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPackFree
+// Description  : Release a slot of the packed block (slot numbers of the
+//                other slots are unchanged)
+//
+// Inputs       : pack - the packed block
+//                slot - the slot to free
+// Outputs      : 0 if successful, -1 if failure
+
+int sgPackFree( char *pack, int slot ) {
+
+    sg_pack_slot_t entry;
+
+    if ((slot < 0) || (slot >= sgPackSlots(pack))) {
+        return( -1 );
+    }
+    memcpy(&entry, pack + SG_PACK_HEADER_SIZE(slot), sizeof(entry));
+    entry.clen = 0;
+    entry.rlen = SG_PACK_FREE_SLOT;
+    memcpy(pack + SG_PACK_HEADER_SIZE(slot), &entry, sizeof(entry));
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPackFreeSlot
+// Description  : Find a slot to add data at, reusing released slots first
+//
+// Inputs       : pack - the packed block
+// Outputs      : the slot (the slot count to add one), -1 if the pack is full
+
+int sgPackFreeSlot( const char *pack ) {
+
+    sg_pack_slot_t entry;
+    int count = sgPackSlots(pack);
+
+    for (int i = 0; i < count; i++) {
+        memcpy(&entry, pack + SG_PACK_HEADER_SIZE(i), sizeof(entry));
+        if (entry.rlen == SG_PACK_FREE_SLOT) {
+            return( i );
+        }
+    }
+    return( (count < SG_PACK_MAX_SLOTS) ? count : -1 );
+}
@@ -0,0 +1,67 @@
+#ifndef SG_COMPRESS_INCLUDED
+#define SG_COMPRESS_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_compress.h
+//  Description    : This is the declaration of the block compression stage
+//                   and the packed block format for the scatter gather
+//                   system.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <sg_defs.h>
+
+//
+// Defines
+#define SG_PACK_MAX_SLOTS 8      // Maximum logical blocks in a packed block
+#define SG_PACK_MIN_RATIO 2      // Minimum compression ratio for packing
+#define SG_PACK_FREE_SLOT 0      // Raw length of an unused pack slot
+
+// Size of the packed block header for a given number of slots
+#define SG_PACK_HEADER_SIZE(n) (sizeof(uint32_t) + ((n) * sizeof(sg_pack_slot_t)))
+
+// Worst case compressed size of len input bytes
+#define SG_COMPRESS_BOUND(len) ((len) + ((len) / 255) + 16)
+
+// Type definitions
+typedef struct {
+    uint32_t offset;   // Offset of the compressed data in the packed block
+    uint32_t clen;     // Compressed length of the slot
+    uint32_t rlen;     // Raw (logical) length of the slot, 0 if free
+} sg_pack_slot_t;
+
+//
+// Compression functions
+
+int sgCompress( const char *src, size_t slen, char *dst, size_t dmax );
+    // Compress a buffer, returns compressed length or -1 if it does not fit
+
+int sgDecompress( const char *src, size_t slen, char *dst, size_t dmax );
+    // Decompress a buffer, returns the decompressed length or -1 on failure
+
+//
+// Packed block functions
+
+int sgPackSlots( const char *pack );
+    // Return the number of slots (used and free) in a packed block
+
+int sgPackUsedSlots( const char *pack );
+    // Return the number of slots holding data in a packed block
+
+int sgPackRead( const char *pack, int slot, char *data );
+    // Extract (decompress) a slot of a packed block, returns the raw length
+
+int sgPackWrite( char *pack, int slot, const char *data, size_t len );
+    // Replace (or add at slot == count) a slot in a packed block
+
+int sgPackFree( char *pack, int slot );
+    // Release a slot of the packed block
+
+int sgPackFreeSlot( const char *pack );
+    // Return a free slot to add data at (the slot count if none), -1 if full
+
+#endif
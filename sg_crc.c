@@ -0,0 +1,293 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_crc.c
+//  Description    : This file contains the CRC32C block checksums.  The CRC is
+//                   computed with the SSE4.2 or ARMv8 CRC instructions when the
+//                   processor has them, and with a slicing-by-8 table otherwise.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+// Project Includes
+#include <sg_crc.h>
+
+// Defines
+#define SG_CRC_STRIPE 336  // Bytes per stream when running three CRC streams
+
+// Functional Prototypes
+typedef uint32_t (*sg_crc_func_t)( uint32_t crc, const uint8_t *buf, size_t len );
+uint32_t sgCrc32cTable( uint32_t crc, const uint8_t *buf, size_t len );
+uint32_t sgCrc32cHardware( uint32_t crc, const uint8_t *buf, size_t len );
+uint32_t sgCrc32cShift( uint32_t crc );
+void sgCrc32cInit( void );
+
+//
+// Global Data
+uint32_t sgCrcTable[8][256];     // The slicing-by-8 lookup tables
+uint32_t sgCrcShift[4][256];     // Advances a crc over SG_CRC_STRIPE zero bytes
+sg_crc_func_t sgCrcFunc = NULL;  // The implementation selected at first use
+pthread_once_t sgCrcOnce = PTHREAD_ONCE_INIT;  // Guards the one time table setup
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCrc32c
+// Description  : Compute (or continue, from a previous crc) the CRC32C of a
+//                buffer
+//
+// Inputs       : crc - the previous crc (0 to start a new checksum)
+//                buf - the data to checksum
+//                len - the length of the data
+// Outputs      : the crc of the data
+
+uint32_t sgCrc32c( uint32_t crc, const void *buf, size_t len ) {
+
+    pthread_once(&sgCrcOnce, sgCrc32cInit);
+    return( ~sgCrcFunc(~crc, (const uint8_t *)buf, len) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCrc32cImplementation
+// Description  : Return the name of the implementation in use
+//
+// Inputs       : none
+// Outputs      : the implementation name
+
+const char *sgCrc32cImplementation( void ) {
+
+    pthread_once(&sgCrcOnce, sgCrc32cInit);
+    return( (sgCrcFunc == sgCrc32cTable) ? "table" : "hardware" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCrc32cInit
+// Description  : Build the lookup tables and select the implementation
+//
+// Inputs       : none
+// Outputs      : none
+
+void sgCrc32cInit( void ) {
+
+    uint32_t crc;
+
+    // the first table is the classic bytewise table, the others advance it
+    for (int i = 0; i < 256; i++) {
+        crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ SG_CRC32C_POLY) : (crc >> 1);
+        }
+        sgCrcTable[0][i] = crc;
+    }
+    for (int i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            sgCrcTable[t][i] = (sgCrcTable[t - 1][i] >> 8) ^ sgCrcTable[0][sgCrcTable[t - 1][i] & 0xff];
+        }
+    }
+
+    // the stripe shift is linear in the crc, so tabulate it a byte at a time
+    for (int k = 0; k < 4; k++) {
+        for (int i = 0; i < 256; i++) {
+            crc = (uint32_t)i << (8 * k);
+            for (int j = 0; j < SG_CRC_STRIPE; j++) {
+                crc = (crc >> 8) ^ sgCrcTable[0][crc & 0xff];
+            }
+            sgCrcShift[k][i] = crc;
+        }
+    }
+
+    // use the CRC instructions when the processor supports them
+    sgCrcFunc = sgCrc32cTable;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        sgCrcFunc = sgCrc32cHardware;
+    }
+#elif defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        sgCrcFunc = sgCrc32cHardware;
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCrc32cTable
+// Description  : Table driven (slicing-by-8) CRC32C, eight bytes per step
+//
+// Inputs       : crc - the running (inverted) crc
+//                buf - the data to checksum
+//                len - the length of the data
+// Outputs      : the running (inverted) crc
+
+uint32_t sgCrc32cTable( uint32_t crc, const uint8_t *buf, size_t len ) {
+
+    uint64_t word;
+
+    while (len >= 8) {
+        memcpy(&word, buf, sizeof(word));
+        word ^= crc;
+        crc = sgCrcTable[7][word & 0xff] ^
+              sgCrcTable[6][(word >> 8) & 0xff] ^
+              sgCrcTable[5][(word >> 16) & 0xff] ^
+              sgCrcTable[4][(word >> 24) & 0xff] ^
+              sgCrcTable[3][(word >> 32) & 0xff] ^
+              sgCrcTable[2][(word >> 40) & 0xff] ^
+              sgCrcTable[1][(word >> 48) & 0xff] ^
+              sgCrcTable[0][word >> 56];
+        buf += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = (crc >> 8) ^ sgCrcTable[0][(crc ^ *buf) & 0xff];
+        buf++;
+        len--;
+    }
+    return( crc );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCrc32cShift
+// Description  : Advance a crc over SG_CRC_STRIPE zero bytes, used to combine
+//                the crcs of independently computed stripes
+//
+// Inputs       : crc - the running (inverted) crc
+// Outputs      : the crc advanced over the stripe
+
+uint32_t sgCrc32cShift( uint32_t crc ) {
+
+    return( sgCrcShift[0][crc & 0xff] ^ sgCrcShift[1][(crc >> 8) & 0xff] ^
+            sgCrcShift[2][(crc >> 16) & 0xff] ^ sgCrcShift[3][crc >> 24] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgCrc32cHardware
+// Description  : CRC32C using the processor CRC instructions, eight bytes per
+//                instruction.  Large buffers run three independent streams
+//                so the instruction latency is hidden, then combine them.
+//
+// Inputs       : crc - the running (inverted) crc
+//                buf - the data to checksum
+//                len - the length of the data
+// Outputs      : the running (inverted) crc
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+uint32_t sgCrc32cHardware( uint32_t crc, const uint8_t *buf, size_t len ) {
+
+    uint64_t word, crc64 = crc, crc1, crc2;
+
+    while (len >= 3 * SG_CRC_STRIPE) {
+        crc1 = 0;
+        crc2 = 0;
+        for (int i = 0; i < SG_CRC_STRIPE; i += 8) {
+            memcpy(&word, buf + i, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+            memcpy(&word, buf + SG_CRC_STRIPE + i, sizeof(word));
+            crc1 = _mm_crc32_u64(crc1, word);
+            memcpy(&word, buf + (2 * SG_CRC_STRIPE) + i, sizeof(word));
+            crc2 = _mm_crc32_u64(crc2, word);
+        }
+        crc64 = sgCrc32cShift(sgCrc32cShift((uint32_t)crc64) ^ (uint32_t)crc1) ^ (uint32_t)crc2;
+        buf += 3 * SG_CRC_STRIPE;
+        len -= 3 * SG_CRC_STRIPE;
+    }
+    while (len >= 8) {
+        memcpy(&word, buf, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        buf += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (len > 0) {
+        crc = _mm_crc32_u8(crc, *buf);
+        buf++;
+        len--;
+    }
+    return( crc );
+}
+
+#elif defined(__i386__)
+
+__attribute__((target("sse4.2")))
+uint32_t sgCrc32cHardware( uint32_t crc, const uint8_t *buf, size_t len ) {
+
+    uint32_t word;
+
+    while (len >= 4) {
+        memcpy(&word, buf, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        buf += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        crc = _mm_crc32_u8(crc, *buf);
+        buf++;
+        len--;
+    }
+    return( crc );
+}
+
+#elif defined(__aarch64__)
+
+__attribute__((target("+crc")))
+uint32_t sgCrc32cHardware( uint32_t crc, const uint8_t *buf, size_t len ) {
+
+    uint64_t word;
+    uint32_t crc1, crc2;
+
+    while (len >= 3 * SG_CRC_STRIPE) {
+        crc1 = 0;
+        crc2 = 0;
+        for (int i = 0; i < SG_CRC_STRIPE; i += 8) {
+            memcpy(&word, buf + i, sizeof(word));
+            crc = __crc32cd(crc, word);
+            memcpy(&word, buf + SG_CRC_STRIPE + i, sizeof(word));
+            crc1 = __crc32cd(crc1, word);
+            memcpy(&word, buf + (2 * SG_CRC_STRIPE) + i, sizeof(word));
+            crc2 = __crc32cd(crc2, word);
+        }
+        crc = sgCrc32cShift(sgCrc32cShift(crc) ^ crc1) ^ crc2;
+        buf += 3 * SG_CRC_STRIPE;
+        len -= 3 * SG_CRC_STRIPE;
+    }
+    while (len >= 8) {
+        memcpy(&word, buf, sizeof(word));
+        crc = __crc32cd(crc, word);
+        buf += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = __crc32cb(crc, *buf);
+        buf++;
+        len--;
+    }
+    return( crc );
+}
+
+#else
+
+uint32_t sgCrc32cHardware( uint32_t crc, const uint8_t *buf, size_t len ) {
+    return( sgCrc32cTable(crc, buf, len) );
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef SG_CRC_INCLUDED
+#define SG_CRC_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_crc.h
+//  Description    : This is the declaration of the CRC32C (Castagnoli) block
+//                   checksum functions for the scatter gather system.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Defines
+#define SG_CRC32C_POLY 0x82f63b78  // Reflected CRC32C polynomial
+
+//
+// Checksum functions
+
+uint32_t sgCrc32c( uint32_t crc, const void *buf, size_t len );
+    // Compute (or continue, from a previous crc) the CRC32C of a buffer
+
+const char *sgCrc32cImplementation( void );
+    // Return the name of the implementation in use (hardware or table)
+
+#endif
@@ -15,7 +15,24 @@
 #include <cmpsc311_log.h>
 
 // Defines 
-#define SG_BLOCK_SIZE 1024
+#ifndef SG_BLOCK_SIZE
+#define SG_BLOCK_SIZE 1024    // Block size, set at build time (make BLOCK_SIZE=...)
+#endif
+#define SG_SERVICE_BLOCK_SIZE 1024 // Block size the ScatterGather service library speaks
+
+// The block size is fixed at compile time, offsets split with a shift and mask
+#if SG_BLOCK_SIZE == 1024
+#define SG_BLOCK_SHIFT 10
+#elif SG_BLOCK_SIZE == 4096
+#define SG_BLOCK_SHIFT 12
+#elif SG_BLOCK_SIZE == 16384
+#define SG_BLOCK_SHIFT 14
+#elif SG_BLOCK_SIZE == 65536
+#define SG_BLOCK_SHIFT 16
+#else
+#error "SG_BLOCK_SIZE must be 1024, 4096, 16384 or 65536"
+#endif
+#define SG_BLOCK_MASK (SG_BLOCK_SIZE - 1)
 #define SG_MAX_BLOCKS_PER_FILE 264
 #define SG_MAGIC_VALUE (uint32_t)0xfefe
 #define SG_BLOCK_UNKNOWN ((uint32_t)-1)
@@ -23,6 +40,14 @@
 #define SG_SEQNO_UNKNOWN ((uint16_t)-1)
 #define SG_INITIAL_SEQNO 10000
 
+// Sequence numbers cycle through 1 .. SG_SEQNO_SPACE, 0 and unknown are never sent
+#define SG_SEQNO_SPACE ((int)SG_SEQNO_UNKNOWN - 1)
+#define SG_SEQNO_NEXT(s) ((SG_SeqNum)(((s) >= SG_SEQNO_SPACE) ? 1 : (s) + 1))
+#define SG_SEQNO_PREV(s) ((SG_SeqNum)(((s) <= 1) ? SG_SEQNO_SPACE : (s) - 1))
+// Signed distance from b to a, going the short way around the cycle
+#define SG_SEQNO_DIFF(a, b) (((((int)(a) - (int)(b)) + SG_SEQNO_SPACE + (SG_SEQNO_SPACE / 2)) % SG_SEQNO_SPACE) \
+        - (SG_SEQNO_SPACE / 2))
+
 // The basic ScatterGather packet size
 #define SG_BASE_PACKET_SIZE (\
         sizeof(uint32_t) +        /* magic number */ \
@@ -36,6 +61,26 @@
 // The basic ScatterGather packet size WITH block
 #define SG_DATA_PACKET_SIZE (SG_BASE_PACKET_SIZE + SG_BLOCK_SIZE)
 
+// A patch packet carries a byte range of the block in place of the block
+#define SG_PATCH_DATA 2           // Data indicator of a byte range (offset, length, bytes)
+#define SG_PATCH_HEADER_SIZE (sizeof(uint32_t)*2) // offset, length
+#define SG_PATCH_PACKET_SIZE(len) (SG_BASE_PACKET_SIZE + SG_PATCH_HEADER_SIZE + (len))
+
+// A compound packet carries a vector of block operations on one node in place of
+// the block: a count, then per operation its block ID, operation, status and data
+// indicator, followed by the block if the indicator is set
+#define SG_COMPOUND_DATA 3        // Data indicator of a vector of operations
+#define SG_COMPOUND_MAX_OPS 16    // Most operations in a compound packet
+#define SG_COMPOUND_OP_SIZE (sizeof(SG_Block_ID) + sizeof(uint8_t)*3) // block id, op, status, data indicator
+#define SG_COMPOUND_PACKET_SIZE(n) (SG_BASE_PACKET_SIZE + sizeof(uint32_t) + \
+        (size_t)(n) * (SG_COMPOUND_OP_SIZE + SG_BLOCK_SIZE))
+
+// Features a service advertises in the block ID of its SG_INIT_ENDPOINT reply
+#define SG_FEATURE_TAG ((uint64_t)0x53474654 << 32) // "SGFT" in the high word, the features in the low
+#define SG_FEATURE_MASK ((uint64_t)0xffffffff)
+#define SG_FEATURE_PATCH 0x1      // SG_PATCH_BLOCK is supported
+#define SG_FEATURE_COMPOUND 0x2   // SG_COMPOUND_OPS is supported
+
 // Type definitions
 typedef int32_t SgFHandle;
 typedef uint64_t SG_Node_ID;   // The type for node identifiers
@@ -51,7 +96,9 @@ typedef enum {
     SG_UPDATE_BLOCK    = 3,   // Update a block
     SG_OBTAIN_BLOCK    = 4,   // Get the block (or be redirected)
     SG_DELETE_BLOCK    = 5,   // Delete the block
-    SG_MAXVAL_OP       = 6    // Maximum value of the opcode
+    SG_PATCH_BLOCK     = 6,   // Replace a byte range of the block, the old bytes are returned
+    SG_COMPOUND_OPS    = 7,   // Perform a vector of block operations on one node
+    SG_MAXVAL_OP       = 8    // Maximum value of the opcode
 } SG_System_OP;  
 
 // A packet information structure 
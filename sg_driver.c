@@ -17,8 +17,47 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/userfaultfd.h>
 #include<sg_cache.h>
+#include <sg_compress.h>
+#include <sg_crc.h>
+#include <sg_placement.h>
+#include <sg_local_service.h>
+#include <sg_shmcache.h>
+#include <sg_sched.h>
+#include <sg_trace.h>
+#include <sg_capture.h>
 // Defines
+#define SG_MAX_FILE_BLOCKS 200
+#define SG_NOT_PACKED -1
+#define SG_MAX_FANOUT 8          // Maximum threads fetching blocks in parallel
+#define SG_MAX_FANOUT_BLOCKS 32  // Maximum blocks fetched in one round
+#define SG_INLINE_MAX_BYTES (SG_BLOCK_SIZE / 4)  // Largest file kept inline in its metadata
+#define SG_TAIL_MAX_BYTES (SG_BLOCK_SIZE / 2)    // Largest file tail kept in a shared pack
+#define SG_APPEND_MAX_BUFFERS 64  // Most files with a new last block buffered at once
+#define SG_DRIVER_SEQ_WINDOW 256  // Sequence numbers in flight to a node or from the driver (multiple of 64)
+#if SG_DRIVER_SEQ_WINDOW >= SG_LOCAL_SEQ_WINDOW
+#error "SG_DRIVER_SEQ_WINDOW must stay below the service's SG_LOCAL_SEQ_WINDOW"
+#endif
+#define SG_REPLICA_TRIES 3        // Creates tried for a copy before going without it
+#define SG_HEDGE_SAMPLES 256      // Recent obtain latencies the hedge deadline is taken from
+#define SG_HEDGE_INTERVAL 64      // Obtains between recomputing the hedge deadline
+#define SG_HEDGE_PERCENTILE 95    // A read waits this percentile of obtain latency before hedging
+#define SG_PREFETCH_WORKERS 2     // Threads obtaining blocks read ahead
+#define SG_PREFETCH_MAX_QUEUED 64 // Most blocks waiting to be read ahead
+#define SG_PATCH_MAX_BYTES (SG_BLOCK_SIZE / 2)   // Largest write into a block sent as a patch
+#define SG_STAT_ADD(stat, n) __atomic_add_fetch(&sgDriverStats.stat, (n), __ATOMIC_RELAXED)
 //struct for block info
 typedef struct block {
     int block_number;
@@ -27,6 +66,12 @@ typedef struct block {
     SG_Block_ID blk_id;
     SG_SeqNum rseqq;
     char *blk_ptr;
+    int pack_slot;  //slot in a packed block, SG_NOT_PACKED if the block is its own
+    int tail;       //the pack is a shared pack of file tails
+    uint32_t crc;   //CRC32C of the logical block contents
+    int replicas;   //copies of the block on other nodes (blocks of their own only)
+    SG_Node_ID rep_rem[SG_MAX_REPLICAS - 1];
+    SG_Block_ID rep_blk[SG_MAX_REPLICAS - 1];
 } block_t;
 //struct for file info
 typedef struct File {
@@ -35,16 +80,168 @@ typedef struct File {
     size_t file_ptr;
     size_t file_size;
     char filename;
-    block_t data[200];
+    block_t data[SG_MAX_FILE_BLOCKS];
     int num_blocks;
     int open;
+    size_t read_next;  //the offset a sequential read continues from
+    int prefetched;    //blocks before this index were queued for read ahead (0 if none)
+    char inline_data[SG_INLINE_MAX_BYTES];  //contents of a small file (no blocks yet)
+    char *append_buf;  //contents of the new last block (num_blocks) not created yet, or NULL
+    pthread_mutex_t lock;  //held for the duration of each operation on the file
 } File_t;
 
+//struct for the sequence numbers handed out and not yet completed
+typedef struct seqwin {
+    SG_SeqNum base;     //the oldest sequence number that may still be in flight
+    int basepos;        //the bit of base in the in-flight window
+    int inflight;       //the number of requests in flight
+    uint64_t window[SG_DRIVER_SEQ_WINDOW / 64]; //bit (basepos + distance from base) set while in flight
+} seqwin_t;
+
 typedef struct map {
     struct map *next;
     SG_Node_ID node_id;
-    SG_SeqNum rseq;
+    SG_SeqNum rseq;     //the last receiver sequence number used with the node
+    seqwin_t win;       //the receiver sequence numbers in flight to the node
 } map_t;
+//struct for driver statistics
+typedef struct stats {
+    unsigned long crc_verified;
+    unsigned long crc_failures;
+    unsigned long crc_recovered;
+    unsigned long fanout_rounds;
+    unsigned long fanout_blocks;
+    unsigned long inline_reads;
+    unsigned long inline_spills;
+    unsigned long tail_packs;
+    unsigned long tail_blocks;
+    unsigned long tail_spills;
+    unsigned long append_writes;
+    unsigned long append_flushes;
+    unsigned long seq_wraps;
+    unsigned long seq_waits;
+    unsigned long replica_blocks;
+    unsigned long replica_misses;
+    unsigned long hedge_reads;
+    unsigned long hedges;
+    unsigned long hedge_wins;
+    unsigned long failovers;
+    unsigned long prefetch_queued;
+    unsigned long prefetch_dropped;
+    unsigned long prefetch_obtained;
+    unsigned long prefetch_cancelled;
+    unsigned long updates_deferred;
+    unsigned long updates_merged;
+    unsigned long update_bursts;
+    unsigned long update_posts;
+    unsigned long patches;
+    unsigned long patch_misses;
+    unsigned long patch_bytes;
+    unsigned long compounds;
+    unsigned long compound_ops;
+    unsigned long map_views;
+    unsigned long map_faults;
+    unsigned long map_refreshes;
+    unsigned long sent_bytes;
+} stats_t;
+//struct for a service block being fetched
+typedef struct fetch {
+    SG_Node_ID rem_id;
+    SG_Block_ID blk_id;
+    int cached;
+    int lead;       //this caller fetches the block for everyone missing on it
+    int status;
+    char *data;
+    block_t *block; //the file block, if it has copies to hedge the read over (or NULL)
+} fetch_t;
+//struct for the work of one fan out thread
+typedef struct fanout {
+    fetch_t *fetches;
+    int num_fetches;
+    SG_Node_ID *nodes;
+    int num_nodes;
+    int *order;     //the fetches in node and block ID order
+    int thread;
+    int num_threads;
+} fanout_t;
+//struct for a read hedged over the copies of a block
+typedef struct hedge {
+    SG_Node_ID rem_id[SG_MAX_REPLICAS];
+    SG_Block_ID blk_id[SG_MAX_REPLICAS];
+    int copies;
+    int issued;     //requests started, copies are tried in order
+    int next;       //the copy the next request thread takes
+    int failed;     //requests that failed
+    int done;       //a request succeeded and data holds the block
+    int winner;     //the copy that answered first
+    int refs;       //the reader and each request thread still running
+    char data[SG_BLOCK_SIZE];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} hedge_t;
+//struct for a byte range patch of a block
+typedef struct patch {
+    uint32_t off;   //the range in the block
+    uint32_t len;
+    char bytes[SG_PATCH_MAX_BYTES]; //the new bytes, the old bytes once posted
+} patch_t;
+//struct for one block operation of a compound packet
+typedef struct blockop {
+    SG_Block_ID blk_id;  //the block (a create's new block from the reply)
+    SG_System_OP op;
+    int status;          //0 if the service performed the operation
+    char *data;          //the block sent (create/update) or received (obtain)
+} blockop_t;
+//struct for a compound packet of block operations on one node
+typedef struct compound {
+    int num;
+    blockop_t ops[SG_COMPOUND_MAX_OPS];
+    char packet[SG_COMPOUND_PACKET_SIZE(SG_COMPOUND_MAX_OPS)];
+    char reply[SG_COMPOUND_PACKET_SIZE(SG_COMPOUND_MAX_OPS)];
+} compound_t;
+//struct for a mapped view of a file range
+typedef struct mapview {
+    struct mapview *next;
+    SgFHandle file_h;
+    char *base;         //the mapping (page aligned)
+    size_t length;      //the length of the mapping (whole pages)
+    size_t pos;         //the file position of the first byte of the mapping
+    const char *view;   //the view handed out (the range's place in its first page)
+    int lazy;           //pages are filled as they are touched (userfaultfd), not up front
+} mapview_t;
+//struct for a page fault waiting for the lock of its file
+typedef struct mapfault {
+    uint64_t addr;      //the address touched
+    uint32_t ptid;      //the thread touching it (0 if not known)
+} mapfault_t;
+//struct for a block waiting to be read ahead
+typedef struct prefetch {
+    SgFHandle file_h;
+    SG_Node_ID rem_id;
+    SG_Block_ID blk_id;
+} prefetch_t;
+//struct for an update held back to be merged and posted in its node's burst
+typedef struct pending {
+    struct pending *next;   //the next update of the node (ascending block IDs)
+    SG_Block_ID blk_id;
+    unsigned long gen;      //bumped each time a newer update replaces the data
+    char data[SG_BLOCK_SIZE];
+} pending_t;
+//struct for a new block held back to be created with the others of its node as a write ends
+typedef struct pcreate {
+    struct pcreate *next;   //the next create of the write
+    int index;              //the logical block index in the file
+    SG_Node_ID target;      //the node placement chose
+    char data[SG_BLOCK_SIZE];
+} pcreate_t;
+//struct for the held back updates of a node
+typedef struct pnode {
+    struct pnode *next;     //the next node (ascending node IDs)
+    SG_Node_ID node_id;
+    pending_t *updates;
+    int count;
+    int status;             //the result of the node's last burst posted on a thread of its own
+} pnode_t;
 //
 // Global Data
 SgFHandle file_handle = 0;
@@ -58,11 +255,149 @@ int global_flag = 0;
 // Global data
 //initialize file_handle assignment, # of files, and head node of file linked list
 int sgDriverInitialized = 0; // The flag indicating the driver initialized
+int sgCompressionEnabled = 0; // The flag indicating blocks are compressed/packed
+int sgChecksumEnabled = 1; // The flag indicating block checksums are verified
+int sgChecksumCacheHits = 0; // The flag indicating cache hits are verified too
+int sgInlineEnabled = 0; // The flag indicating small files are inline and tails packed
+int sgAppendBuffering = 0; // The flag indicating new last blocks are buffered until full
+int sgAppendBuffers = 0; // The number of append buffers in use
+stats_t sgDriverStats; // The driver statistics
+#if SG_BLOCK_SIZE == SG_SERVICE_BLOCK_SIZE
+SgServicePostFunc sgDriverServicePost = sgServicePost; // The service packets are posted to
+#else
+SgServicePostFunc sgDriverServicePost = sgLocalServicePost; // The service library only speaks its own block size
+#endif
+int sgServiceConcurrent = 0; // The flag indicating the service takes concurrent posts
+SG_Placement_Policy sgPlacementPolicy = SG_PLACE_SERVICE; // The block placement policy
+SG_Cache_Organization sgCacheOrganization = SG_CACHE_LINEAR; // The organization of the block cache
+size_t sgCacheMinBytes = 0; // The adaptive cache budget (0 for a fixed size cache)
+size_t sgCacheMaxBytes = 0;
+char *sgCacheSharedName = NULL; // The shared memory segment of a cache shared by processes (NULL if private)
+char *sgCacheDiskPath = NULL; // The file of the local disk tier of the cache (NULL for none)
+size_t sgCacheDiskBytes = 0; // The bytes of blocks the disk tier holds
+int sgReplicas = 1; // The number of copies of each block (reads are hedged over them)
+uint64_t sgHedgeSamples[SG_HEDGE_SAMPLES]; // Recent obtain latencies (packet lock)
+unsigned long sgHedgeCount = 0;
+uint64_t sgHedgeDeadline = 0; // The wait before hedging a read (nsec, 0 until known)
+int sgHedgeThreads = 0; // Hedged read requests still running
+pthread_mutex_t sgDriverHedgeLock = PTHREAD_MUTEX_INITIALIZER; // Protects the running request count
+pthread_cond_t sgDriverHedgeCond = PTHREAD_COND_INITIALIZER; // Signalled as hedged requests finish
+int sgPrefetchBlocks = 0; // The blocks read ahead of a sequential reader (0 for none)
+uint32_t sgSchedFileRate = 0; // The block operations per second of each file (0 unlimited)
+prefetch_t sgPrefetchQueue[SG_PREFETCH_MAX_QUEUED]; // Blocks waiting to be read ahead (prefetch lock)
+int sgPrefetchHead = 0;
+int sgPrefetchCount = 0;
+int sgPrefetchStop = 0;
+pthread_t sgPrefetchThreads[SG_PREFETCH_WORKERS];
+int sgPrefetchWorkers = 0;
+pthread_mutex_t sgDriverPrefetchLock = PTHREAD_MUTEX_INITIALIZER; // Protects the read ahead queue
+pthread_cond_t sgDriverPrefetchCond = PTHREAD_COND_INITIALIZER; // Signalled as blocks are queued
+char *sgTracePath = NULL; // The file trace events are written to (NULL if not tracing)
+char *sgCapturePath = NULL; // The log calls are captured to (NULL if not capturing)
+int sgCaptureHashes = 1; // The flag indicating captured reads and writes carry a hash of their data
+int sgPendingUpdates = 0; // The updates held back to merge and post per node (0 to post at once)
+int sgPatchEnabled = 1; // The flag indicating small writes are sent as patches (if the service takes them)
+int sgCompoundEnabled = 1; // The flag indicating block operations on a node are sent together (if the service takes them)
+uint32_t sgServiceFeatures = 0; // The extensions of the service in use (advertised at init and enabled)
+__thread int sgWriteBatch = 0; // The updates of this thread's write are held back until it ends
+__thread pcreate_t *sgWriteCreates = NULL; // The creates of this thread's write held back until it ends
+pnode_t *sgPendingNodes = NULL; // The nodes with held back updates (pending lock)
+mapview_t *sgMapViews = NULL; // The mapped views (map lock)
+pthread_mutex_t sgDriverMapLock = PTHREAD_MUTEX_INITIALIZER; // Protects the mapped views
+int sgMapFaultFd = -1; // The userfaultfd the pages of views fault to (-1 if not started, -2 if unavailable)
+int sgMapStopFd = -1; // Wakes the fault thread to stop
+pthread_t sgMapThread; // Fills the pages of views as they are touched
+size_t sgMapPageSize = 0;
+uint64_t sgMapFilling = 0; // The page the fault thread is copying in, 0 if none (map lock)
+pthread_cond_t sgMapFillCond = PTHREAD_COND_INITIALIZER; // Signals a page copied in
+int sgPendingCount = 0; // The updates held back (changed under the pending lock, read without it atomically)
+pthread_mutex_t sgDriverPendingLock = PTHREAD_MUTEX_INITIALIZER; // Protects the held back updates
+pthread_mutex_t sgDriverFlushLock = PTHREAD_MUTEX_INITIALIZER; // Lets one caller at a time post held back updates
+pthread_mutex_t sgDriverPacketLock = PTHREAD_MUTEX_INITIALIZER; // Protects sequence numbers and node map
+pthread_cond_t sgDriverSeqCond = PTHREAD_COND_INITIALIZER; // Signalled as requests leave a node's window
+pthread_mutex_t sgDriverServiceLock = PTHREAD_MUTEX_INITIALIZER; // Orders posts to a non-concurrent service
+pthread_mutex_t sgDriverFileLock = PTHREAD_MUTEX_INITIALIZER; // Protects the file list and initialization
+pthread_mutex_t sgDriverTailLock = PTHREAD_MUTEX_INITIALIZER; // Orders changes to the shared tail packs
+SG_Node_ID sgTailPackNode;   // The shared pack new file tails are added to
+SG_Block_ID sgTailPackBlock;
+int sgTailPackValid = 0;
 SG_Block_ID sgLocalNodeId;   // The local node identifier
 SG_SeqNum sgLocalSeqno = SG_INITIAL_SEQNO;  // The local sequence number
+seqwin_t sgLocalSeqWindow;  // The sender sequence numbers in flight
 
 // Driver support functions
+SgFHandle sgDriverOpen( const char *path ); // Open a file (not captured)
+int sgDriverRead( SgFHandle fh, char *buf, size_t len ); // Read from a file (not captured)
+int sgDriverWrite( SgFHandle fh, char *buf, size_t len ); // Write to a file (not captured)
+int sgDriverSeek( SgFHandle fh, size_t off ); // Seek in a file (not captured)
+int sgDriverClose( SgFHandle fh ); // Close a file (not captured)
 int sgInitEndpoint( void ); // Initialize the endpoint
+File_t *sgFindFile( SgFHandle fh ); // Find the file for a file handle
+size_t sgDriverFilePos( SgFHandle fh ); // The position in a file
+int sgReadFileRange( File_t *file, size_t pos, char *buf, size_t len ); // Read bytes of a file
+int sgReadFileBlock( File_t *file, int index, char *data ); // Read a logical block
+int sgReadFileBlocks( File_t *file, int first, int count, char *data ); // Read logical blocks
+int sgVerifyFileBlock( File_t *file, int index, char *data, int cached ); // Check a block checksum
+int sgMapFill( File_t *file, size_t pos, char *page, size_t len ); // Fill pages of a view
+int sgMapStart( void ); // Start filling views on fault
+void sgMapDrop( File_t *file, size_t pos, size_t len ); // Refresh the views of written bytes
+void *sgMapFaultThread( void *arg ); // Fill the pages of views as they are touched
+int sgMapFault( int fd, uint64_t addr, char *page ); // Fill a touched page of a view
+int sgMapFaultRetry( int fd, mapfault_t *fault, char *page ); // Fill a touched page, SIGBUS on failure
+int sgLoadFileBlock( File_t *file, int index, char *data, int refetch, int *cached ); // Unpack a logical block
+int sgWriteFileBlock( File_t *file, int index, char *data, size_t len ); // Write a logical block
+int sgPatchFileBlock( File_t *file, int index, int off, char *data, size_t len ); // Write bytes of a logical block
+int sgPackFileBlock( File_t *file, int index, char *data, size_t len ); // Pack a new logical block
+int sgSpillInline( File_t *file ); // Move a small file's inline data to a block
+int sgAppendBuffer( File_t *file, char *data ); // Buffer a new last block
+int sgAppendFlush( File_t *file ); // Create the buffered last block
+void sgAppendRelease( File_t *file ); // Free the append buffer
+int sgTailAddBlock( File_t *file, int index, char *data, size_t len ); // Add a file tail to a shared pack
+int sgTailUpdateBlock( File_t *file, int index, char *data, size_t len ); // Rewrite a file tail
+int sgDriverObtainBlock( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data, int *cached ); // Get a block
+int sgDriverFetchBlock( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data ); // Obtain a block
+int sgDriverLeadFetch( SG_Node_ID rem_id, SG_Block_ID blk_id, block_t *aBlock, char *data ); // Obtain a block for all waiting on it
+int sgDriverObtainCopy( SG_Node_ID rem_id, SG_Block_ID blk_id, block_t *aBlock, char *data ); // Obtain from any copy
+int sgDriverHedgedObtain( block_t *aBlock, char *data ); // Obtain a block, hedging over its copies
+void *sgDriverHedgeThread( void *arg ); // Obtain one copy for a hedged read
+void sgDriverHedgeRecord( uint64_t nsec ); // Sample an obtain latency
+int sgReplicateFileBlock( File_t *file, int index, char *data ); // Create the copies of a block
+int sgReplicaUpdate( block_t *aBlock, char *data ); // Update the copies of a block
+int sgDriverObtainBlocks( fetch_t *fetches, int num ); // Get blocks, fanning out over nodes
+int sgDriverFetchNode( fetch_t *fetches, int *order, int num, SG_Node_ID node ); // Obtain the blocks of a node
+int sgDriverFetchCompound( SG_Node_ID node, fetch_t **batch, int num ); // Obtain blocks in one packet
+int sgDriverJoinFetches( fetch_t *fetches, int num ); // Wait for blocks fetched by others
+void *sgDriverFanoutThread( void *arg ); // Fetch the blocks of some nodes
+int sgDriverCreateBlock( char *data, SG_Node_ID target, SG_Node_ID *rem_id, SG_Block_ID *blk_id ); // Create a block
+int sgDriverDeferCreate( File_t *file, int index, char *data, SG_Node_ID target ); // Hold a create back
+int sgDriverFlushCreates( File_t *file ); // Create the held back blocks, node by node
+int sgDriverUpdateBlock( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data ); // Update a block
+int sgDriverDeferUpdate( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data ); // Hold an update back
+int sgDriverFlushUpdates( void ); // Post the held back updates, node by node
+void *sgDriverFlushThread( void *arg ); // Post the held back updates of a node
+int sgDriverFlushNode( pnode_t *pn ); // Post a node's held back updates in block order
+int sgDriverPendingLookup( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data ); // Get a held back update
+void sgDriverSortFetches( fetch_t *fetches, int num, int *order ); // Order fetches by node and block
+int sgDriverPostBlockOp( SG_System_OP op, SG_Node_ID *rem_id, SG_Block_ID *blk_id, char *data ); // Send a block op
+int sgDriverScheduleBlockOp( SG_Sched_Class cls, int tenant, SG_System_OP op, SG_Node_ID *rem_id,
+        SG_Block_ID *blk_id, char *data ); // Send a block op when the scheduler dispatches it
+void sgPrefetchFileBlocks( File_t *file, int first, int count ); // Queue the blocks after a sequential read
+void sgPrefetchCancel( File_t *file ); // Drop a file's queued read ahead
+void *sgDriverPrefetchThread( void *arg ); // Obtain queued read ahead blocks
+int sgDriverExchangeBlockOp( SG_System_OP op, SG_Node_ID *rem_id, SG_Block_ID *blk_id, char *data ); // Post and unpack
+void sgDriverPackPatch( char *packet, size_t *plen, patch_t *patch ); // Add a byte range to a packet
+int sgDriverUnpackPatch( char *packet, size_t plen, patch_t *patch ); // Get the old bytes from a reply
+size_t sgDriverPackCompound( char *packet, compound_t *cmp ); // Add block operations to a packet
+int sgDriverUnpackCompound( char *packet, size_t plen, compound_t *cmp ); // Get the results of block operations
+SG_SeqNum sgDriverNextSeqno( void ); // Take the next sender sequence number
+map_t *sgDriverFindNodeMap( SG_Node_ID rem_id ); // Find the sequence state of a node
+SG_SeqNum sgDriverSeqIssue( SG_Node_ID rem_id ); // Take a receiver sequence number for a node
+void sgDriverSeqComplete( SG_Node_ID rem_id, SG_SeqNum rseq ); // Retire a receiver sequence number
+int sgDriverWindowFull( seqwin_t *win, SG_SeqNum next ); // Check if a sequence number is past the window
+void sgDriverWindowAdd( seqwin_t *win, SG_SeqNum seq ); // Mark a sequence number in flight
+void sgDriverWindowRemove( seqwin_t *win, SG_SeqNum seq ); // Retire a sequence number from the window
+SG_SeqNum sgDriverSendIssue( void ); // Take a sender sequence number and mark it in flight
+void sgDriverSendComplete( SG_SeqNum sseq ); // Retire a sender sequence number
 
 //
 // Functions
@@ -80,11 +415,239 @@ int sgInitEndpoint( void ); // Initialize the endpoint
 
 SgFHandle sgopen(const char *path) {
 
+    // the first open starts the capture, so it is timed either way
+    uint64_t start = sgCaptureNow();
+    SgFHandle fh = sgDriverOpen(path);
+
+    if (sgCaptureEnabled) {
+        sgCaptureRecord(SG_CAPTURE_OPEN, start, fh, 0, 0, fh, path);
+    }
+    return( fh );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgread
+// Description  : Read data from the file
+//
+// Inputs       : fh - file handle for the file to read from
+//                buf - place to put the data
+//                len - the length of the read
+// Outputs      : number of bytes read, -1 if failure
+
+int sgread(SgFHandle fh, char *buf, size_t len) {
+
+    uint64_t start, off;
+    int ret;
+
+    if (!sgCaptureEnabled) {
+        return( sgDriverRead(fh, buf, len) );
+    }
+    start = sgCaptureNow();
+    off = sgDriverFilePos(fh);
+    ret = sgDriverRead(fh, buf, len);
+    sgCaptureRecord(SG_CAPTURE_READ, start, fh, off, len, ret, buf);
+    return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgwrite
+// Description  : write data to the file
+//
+// Inputs       : fh - file handle for the file to write to
+//                buf - pointer to data to write
+//                len - the length of the write
+// Outputs      : number of bytes written if successful test, -1 if failure
+
+int sgwrite(SgFHandle fh, char *buf, size_t len) {
+
+    uint64_t start, off;
+    int ret;
+
+    if (!sgCaptureEnabled) {
+        return( sgDriverWrite(fh, buf, len) );
+    }
+    start = sgCaptureNow();
+    off = sgDriverFilePos(fh);
+    ret = sgDriverWrite(fh, buf, len);
+    sgCaptureRecord(SG_CAPTURE_WRITE, start, fh, off, len, ret, buf);
+    return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgseek
+// Description  : Seek to a specific place in the file
+//
+// Inputs       : fh - the file handle of the file to seek in
+//                off - offset within the file to seek to
+// Outputs      : new position if successful, -1 if failure
+
+int sgseek(SgFHandle fh, size_t off) {
+
+    uint64_t start;
+    int ret;
+
+    if (!sgCaptureEnabled) {
+        return( sgDriverSeek(fh, off) );
+    }
+    start = sgCaptureNow();
+    ret = sgDriverSeek(fh, off);
+    sgCaptureRecord(SG_CAPTURE_SEEK, start, fh, off, 0, ret, NULL);
+    return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgclose
+// Description  : Close the file
+//
+// Inputs       : fh - the file handle of the file to close
+// Outputs      : 0 if successful test, -1 if failure
+
+int sgclose(SgFHandle fh) {
+
+    uint64_t start;
+    int ret;
+
+    if (!sgCaptureEnabled) {
+        return( sgDriverClose(fh) );
+    }
+    start = sgCaptureNow();
+    ret = sgDriverClose(fh);
+    sgCaptureRecord(SG_CAPTURE_CLOSE, start, fh, 0, 0, ret, NULL);
+    return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgmap
+// Description  : Map a range of a file into memory, read only.  The pages of
+//                the view are filled from the cache (or the SG system) as
+//                they are first touched, so only the parts read are fetched
+//                and reading them again is a plain load.  Writes through
+//                sgwrite refresh the pages they cover.  The view stays valid
+//                after the file is closed, until sgunmap or sgshutdown.  It
+//                must not be passed to sgwrite of the file it maps.
+//
+// Inputs       : fh - the file handle of the file to map
+//                off - the file position of the range
+//                len - the length of the range
+// Outputs      : the view of the range if successful, NULL if failure
+
+const char *sgmap( SgFHandle fh, size_t off, size_t len ) {
+
+    struct uffdio_register reg;
+    File_t *aFile;
+    mapview_t *view;
+    int lazy;
+
+    aFile = sgFindFile(fh);
+    if (aFile == NULL) {
+        return( NULL );
+    }
+    lazy = (sgMapStart() == 0);
+    pthread_mutex_lock(&aFile->lock);
+    if ((aFile->open == 0) || (len == 0) || (off + len > aFile->file_size)) {
+        pthread_mutex_unlock(&aFile->lock);
+        logMessage( LOG_ERROR_LEVEL, "sgmap: bad range [%lu, %lu] of file [%d]", off, len, fh );
+        return( NULL );
+    }
+
+    //the mapping covers the whole pages of the range
+    view = malloc(sizeof(mapview_t));
+    view->file_h = fh;
+    view->pos = off & ~(sgMapPageSize - 1);
+    view->length = (off + len - view->pos + sgMapPageSize - 1) & ~(sgMapPageSize - 1);
+    view->base = mmap(NULL, view->length, lazy ? PROT_READ : (PROT_READ | PROT_WRITE),
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (view->base == MAP_FAILED) {
+        pthread_mutex_unlock(&aFile->lock);
+        logMessage( LOG_ERROR_LEVEL, "sgmap: unable to map [%lu] bytes [%s]", view->length, strerror(errno) );
+        free(view);
+        return( NULL );
+    }
+    view->view = view->base + (off - view->pos);
+
+    //its pages fault to the fault thread, or without it are read in now
+    if (lazy) {
+        reg.range.start = (uintptr_t)view->base;
+        reg.range.len = view->length;
+        reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+        lazy = (ioctl(sgMapFaultFd, UFFDIO_REGISTER, &reg) == 0);
+    }
+    view->lazy = lazy;
+    if (!lazy && (mprotect(view->base, view->length, PROT_READ | PROT_WRITE) ||
+            sgMapFill(aFile, view->pos, view->base, view->length) || mprotect(view->base, view->length, PROT_READ))) {
+        pthread_mutex_unlock(&aFile->lock);
+        logMessage( LOG_ERROR_LEVEL, "sgmap: unable to read in range [%lu, %lu] of file [%d]", off, len, fh );
+        munmap(view->base, view->length);
+        free(view);
+        return( NULL );
+    }
+    pthread_mutex_lock(&sgDriverMapLock);
+    view->next = sgMapViews;
+    __atomic_store_n(&sgMapViews, view, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&sgDriverMapLock);
+    pthread_mutex_unlock(&aFile->lock);
+    SG_STAT_ADD(map_views, 1);
+    return( view->view );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgunmap
+// Description  : Release a view of a file range
+//
+// Inputs       : view - the view (from sgmap)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgunmap( const char *view ) {
+
+    mapview_t **prev, *aView;
+
+    pthread_mutex_lock(&sgDriverMapLock);
+    for (prev = &sgMapViews; (*prev != NULL) && ((*prev)->view != view); prev = &(*prev)->next);
+    aView = *prev;
+    if (aView != NULL) {
+        __atomic_store_n(prev, aView->next, __ATOMIC_RELEASE);
+
+        //a page on its way in must not land in a later mapping at the same address
+        while ((sgMapFilling >= (uintptr_t)aView->base) && (sgMapFilling < (uintptr_t)aView->base + aView->length)) {
+            pthread_cond_wait(&sgMapFillCond, &sgDriverMapLock);
+        }
+    }
+    pthread_mutex_unlock(&sgDriverMapLock);
+    if (aView == NULL) {
+        logMessage( LOG_ERROR_LEVEL, "sgunmap: unknown view [%p]", view );
+        return( -1 );
+    }
+    munmap(aView->base, aView->length);
+    free(aView);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverOpen
+// Description  : Open the file for for reading and writing (sgopen, not captured)
+//
+// Inputs       : path - the path/filename of the file to be read
+// Outputs      : file handle if successful test, -1 if failure
+
+SgFHandle sgDriverOpen(const char *path) {
+
+    SgFHandle fh;
+    SG_TRACE_SCOPE(SG_TEV_OPEN, 0);
+
     // First check to see if we have been initialized
+    pthread_mutex_lock(&sgDriverFileLock);
     if (!sgDriverInitialized) {
 
         // Call the endpoint initialization 
         if ( sgInitEndpoint() ) {
+            pthread_mutex_unlock(&sgDriverFileLock);
             logMessage( LOG_ERROR_LEVEL, "sgopen: Scatter/Gather endpoint initialization failed." );
             return( -1 );
         }
@@ -96,6 +659,7 @@ SgFHandle sgopen(const char *path) {
     //if the file path did not exist and the head file node is empty
     if (num_of_files == 0) {
         
+        pthread_mutex_init(&headd->lock, NULL);
         headd->file_h = file_handle;
         file_handle++;
         num_of_files++;
@@ -103,9 +667,14 @@ SgFHandle sgopen(const char *path) {
         headd->file_size = 0;
         headd->filename = *path;
         headd->num_blocks = 0;
+        headd->append_buf = NULL;
+        headd->read_next = 0;
+        headd->prefetched = 0;
         headd->open = 1;
         headd->next = NULL;
-        return headd->file_h;
+        fh = headd->file_h;
+        pthread_mutex_unlock(&sgDriverFileLock);
+        return fh;
     }
     
     //if the head file node is not empty and the file did not previously exist
@@ -119,6 +688,10 @@ SgFHandle sgopen(const char *path) {
     aFile->filename = *path;
     aFile->open = 1;
     aFile->num_blocks = 0;
+    aFile->append_buf = NULL;
+    aFile->read_next = 0;
+    aFile->prefetched = 0;
+    pthread_mutex_init(&aFile->lock, NULL);
     
     File_t *current = headd;
     //set the new files location in the file linked list
@@ -128,99 +701,71 @@ SgFHandle sgopen(const char *path) {
     
     current->next = aFile;
     aFile->next = NULL;
+    fh = aFile->file_h;
+    pthread_mutex_unlock(&sgDriverFileLock);
 
     // Return the file handle 
-    return( aFile->file_h );
+    return( fh );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : sgread
-// Description  : Read data from the file
+// Function     : sgDriverRead
+// Description  : Read data from the file (sgread, not captured)
 //
 // Inputs       : fh - file handle for the file to read from
 //                buf - place to put the data
 //                len - the length of the read
 // Outputs      : number of bytes read, -1 if failure
 
-int sgread(SgFHandle fh, char *buf, size_t len) {
+int sgDriverRead(SgFHandle fh, char *buf, size_t len) {
     
-    File_t *current = headd;
     File_t *aFile;
-    char the_data[SG_BLOCK_SIZE];
-
-    char initPacket[SG_BASE_PACKET_SIZE], recvPacket[SG_DATA_PACKET_SIZE];
-    size_t pktlen, rpktlen;
-    SG_Node_ID loc, rem;
-    SG_Block_ID blkid;
-    SG_SeqNum sloc, srem;
-    SG_System_OP op;
-    SG_Packet_Status ret;
+    int first, count;
+    SG_TRACE_SCOPE(SG_TEV_READ, len);
 
-    //look for the file handle we are looking for
-    for (int i = 0; i < num_of_files; i++) {
-        if (current->file_h == fh) {
-            aFile = current;
-        }
-        else {
-            current = current->next;
-        }
-    }
-    
-    //check if the file handle is bad or if it was not previously open
-    if (aFile->file_h != fh) {
-        return -1; 
+    //look for the file handle, check if it is bad or if it was not previously open
+    aFile = sgFindFile(fh);
+    if (aFile == NULL) {
+        return -1;
     }
+    sgSchedThrottle(fh, (len >> SG_BLOCK_SHIFT) + 1);
+    pthread_mutex_lock(&aFile->lock);
     if (aFile->open == 0) {
+        pthread_mutex_unlock(&aFile->lock);
         return -1;
     }
 
-    //reset the len parameter if it wants to read longer than the file's length
-    if (aFile->file_size < len) {
-        len = aFile->file_size;
+    //reset the len parameter if it wants to read past the end of the file
+    if (aFile->file_ptr + len > aFile->file_size) {
+        len = aFile->file_size - aFile->file_ptr;
     }
     
-    //get index for block array in the file
-    int index = (aFile->file_ptr) / SG_BLOCK_SIZE;
-    int mod = (aFile->file_ptr) % SG_BLOCK_SIZE;
-    //try to retreive the block in the cache
-    char *cache_block = malloc(SG_BLOCK_SIZE);
-    cache_block = getSGDataBlock(aFile->data[index].rem_id, aFile->data[index].blk_id);
-    //if we find the block, copy data from the cache into the buf
-    if (cache_block != NULL) {
-        memcpy(buf, cache_block + mod, len);
-    }
-    //if we did not find the block in cache, obtain the block regularly from the SG system
-    else {
-        pktlen = SG_BASE_PACKET_SIZE;
-        if ( (ret = serialize_sg_packet(sgLocalNodeId, // Local ID
-                                        aFile->data[index].rem_id,   // Remote ID
-                                        aFile->data[index].blk_id,  // Block ID
-                                        SG_OBTAIN_BLOCK,  // Operation
-                                        sgLocalSeqno,    // Sender sequence number
-                                        SG_SEQNO_UNKNOWN,  // Receiver sequence number
-                                        NULL, initPacket, &pktlen)) != SG_PACKT_OK ) {
-            return( -1 );
-        }
-        sgLocalSeqno++;
-        // Send the packet
-        rpktlen = SG_DATA_PACKET_SIZE;
-        if ( sgServicePost(initPacket, &pktlen, recvPacket, &rpktlen) ) {
-            return( -1 );
-        }
-        // Unpack the recieived data
-        if ( (ret = deserialize_sg_packet(&loc, &rem, &blkid, &op, &sloc, 
-                                        &srem, the_data, recvPacket, rpktlen)) != SG_PACKT_OK ) {
-            return( -1 );
-        }
+    if (len == 0) {
+        pthread_mutex_unlock(&aFile->lock);
+        return( 0 );
+    }
 
-        //copy the data into the buffer of 'len' bytes
-        memcpy(buf, the_data + mod, len);
-        //place the block in cache since we did not find it earlier
-        putSGDataBlock(aFile->data[index].rem_id, aFile->data[index].blk_id, the_data);
+    //get the data from the file's metadata, or its blocks from the cache or the SG system
+    if (sgReadFileRange(aFile, aFile->file_ptr, buf, len)) {
+        pthread_mutex_unlock(&aFile->lock);
+        return( -1 );
+    }
+
+    //a sequential reader has the blocks after it read ahead, anyone else loses its read ahead
+    if ((sgPrefetchBlocks > 0) && (aFile->num_blocks > 0)) {
+        first = aFile->file_ptr >> SG_BLOCK_SHIFT;
+        count = ((aFile->file_ptr + len - 1) >> SG_BLOCK_SHIFT) - first + 1;
+        if (aFile->file_ptr == aFile->read_next) {
+            sgPrefetchFileBlocks(aFile, first, count);
+        } else if (aFile->prefetched > 0) {
+            sgPrefetchCancel(aFile);
+        }
+        aFile->read_next = aFile->file_ptr + len;
     }
     
     aFile->file_ptr += len;
+    pthread_mutex_unlock(&aFile->lock);
 
     // Return the bytes processed
     return( len );
@@ -228,173 +773,155 @@ int sgread(SgFHandle fh, char *buf, size_t len) {
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : sgwrite
-// Description  : write data to the file
+// Function     : sgDriverWrite
+// Description  : Write data to the file (sgwrite, not captured)
 //
 // Inputs       : fh - file handle for the file to write to
 //                buf - pointer to data to write
 //                len - the length of the write
 // Outputs      : number of bytes written if successful test, -1 if failure
 
-int sgwrite(SgFHandle fh, char *buf, size_t len) {
+int sgDriverWrite(SgFHandle fh, char *buf, size_t len) {
     
-    File_t *current = headd;
-    File_t *aFile = headd;
-    block_t aBlock;
+    File_t *aFile;
     char the_data[SG_BLOCK_SIZE];
-    int update = 0;
-    int update_middle = 0;
-    
-    char initPacket[SG_DATA_PACKET_SIZE], recvPacket[SG_BASE_PACKET_SIZE];
-    size_t pktlen, rpktlen;
-    SG_Node_ID loc, rem;
-    SG_Block_ID blkid;
-    SG_SeqNum sloc, srem;
-    SG_System_OP op;
-    SG_Packet_Status ret;
-    int file_found = 0;
+    size_t done = 0, chunk, end, blen;
+    int index, mod, pending, status = 0;
+    SG_TRACE_SCOPE(SG_TEV_WRITE, len);
 
     //look for the file handle
-    for (int i = 0; i < num_of_files; i++) {
-        if (current->file_h == fh) {
-            file_found = 1;
-            aFile = current;
-        }
-        else {
-            current = current->next;
-        }
+    aFile = sgFindFile(fh);
+    if (aFile == NULL) {
+        return -1;
     }
-    
-    if (file_found == 0) {
+    sgSchedThrottle(fh, (len >> SG_BLOCK_SHIFT) + 1);
+    pthread_mutex_lock(&aFile->lock);
+    if (aFile->open == 0) {
+        pthread_mutex_unlock(&aFile->lock);
         return -1;
     }
 
-    int mod = (aFile->file_ptr)%SG_BLOCK_SIZE;
-    int index = (aFile->file_ptr)/SG_BLOCK_SIZE;
-    char *cache_block = malloc(SG_BLOCK_SIZE);
-
-    //check if we are creating a block rather than updating
-    if ((mod == 0) && (aFile->file_ptr == aFile->file_size)) {
-        
-        pktlen = SG_DATA_PACKET_SIZE;
-        if ( (ret = serialize_sg_packet( sgLocalNodeId, // Local ID
-                                        SG_NODE_UNKNOWN,   // Remote ID
-                                        SG_BLOCK_UNKNOWN,  // Block ID
-                                        SG_CREATE_BLOCK,  // Operation
-                                        sgLocalSeqno,    // Sender sequence number
-                                        SG_SEQNO_UNKNOWN,  // Receiver sequence number
-                                        buf, initPacket, &pktlen)) != SG_PACKT_OK ) {
+    //a small file stays inline in its metadata until it outgrows it
+    if (sgInlineEnabled && (aFile->num_blocks == 0) && (aFile->append_buf == NULL)) {
+        if (aFile->file_ptr + len <= SG_INLINE_MAX_BYTES) {
+            memcpy(aFile->inline_data + aFile->file_ptr, buf, len);
+            aFile->file_ptr += len;
+            if (aFile->file_ptr > aFile->file_size) {
+                aFile->file_size = aFile->file_ptr;
+            }
+            pthread_mutex_unlock(&aFile->lock);
+            return( len );
+        }
+        if ((aFile->file_size > 0) && sgSpillInline(aFile)) {
+            pthread_mutex_unlock(&aFile->lock);
             return( -1 );
         }
-        sgLocalSeqno++;
     }
-    else {
-        update = 1;
-        //determine if we are writing to a block in the middle of the file or second half of the last block
-        if (aFile->file_ptr < aFile->file_size) {
-            update_middle = 1;
-        }
-
-        cache_block = getSGDataBlock(aFile->data[index].rem_id, aFile->data[index].blk_id);
-        //push the update through the cache if we find the block in cache
-        if (cache_block != NULL) {
-            memcpy(cache_block + mod, buf, len);
-            putSGDataBlock(aFile->data[index].rem_id, aFile->data[index].blk_id, cache_block);
-            //update block - obtain block, change correct bytes, send block back with update block
-            pktlen = SG_DATA_PACKET_SIZE;
-            if ( (ret = serialize_sg_packet(sgLocalNodeId, // Local ID
-                                            aFile->data[index].rem_id,  // Remote ID
-                                            aFile->data[index].blk_id,  // Block ID
-                                            SG_UPDATE_BLOCK,   // Operation
-                                            sgLocalSeqno,    // Sender sequence number
-                                            SG_SEQNO_UNKNOWN,  // Receiver sequence number
-                                            getSGDataBlock(aFile->data[index].rem_id, aFile->data[index].blk_id), initPacket, &pktlen)) != SG_PACKT_OK ) {
-                return( -1 );
-            }
-            sgLocalSeqno++;   
+
+    //the updates of a write over several blocks are held back and posted node by node as it ends
+    sgWriteBatch = (sgServiceFeatures & SG_FEATURE_COMPOUND) && (sgPendingUpdates == 0) &&
+            ((aFile->file_ptr & SG_BLOCK_MASK) + len > SG_BLOCK_SIZE);
+
+    //write the data one block at a time
+    while (done < len) {
+        index = (aFile->file_ptr + done) >> SG_BLOCK_SHIFT;
+        mod = (aFile->file_ptr + done) & SG_BLOCK_MASK;
+        chunk = SG_BLOCK_SIZE - mod;
+        if (chunk > len - done) {
+            chunk = len - done;
         }
-        //if block was not in the cache, use the SG system to obtain and update it regularly
-        else {
-            pktlen = SG_BASE_PACKET_SIZE;
-            if ( (ret = serialize_sg_packet(sgLocalNodeId, // Local ID
-                                            aFile->data[index].rem_id,   // Remote ID
-                                            aFile->data[index].blk_id,  // Block ID
-                                            SG_OBTAIN_BLOCK,  // Operation
-                                            sgLocalSeqno,    // Sender sequence number
-                                            SG_SEQNO_UNKNOWN,  // Receiver sequence number
-                                            NULL, initPacket, &pktlen)) != SG_PACKT_OK ) {
-                return( -1 );
+        if (index >= SG_MAX_FILE_BLOCKS) {
+            logMessage( LOG_ERROR_LEVEL, "sgwrite: file too large [%d blocks]", index );
+            status = -1;
+            break;
+        }
+
+        //figure out how many bytes of this block are in the file after the write
+        end = aFile->file_ptr + done + chunk;
+        if (end < aFile->file_size) {
+            end = aFile->file_size;
+        }
+        blen = end - ((size_t)index << SG_BLOCK_SHIFT);
+        if (blen > SG_BLOCK_SIZE) {
+            blen = SG_BLOCK_SIZE;
+        }
+
+        //a small write into a block of its own only sends the bytes it changes, unless a full
+        //update held back (say from a failed flush) would be posted over the patch later
+        if ((index < aFile->num_blocks) && (chunk <= SG_PATCH_MAX_BYTES) &&
+                (sgServiceFeatures & SG_FEATURE_PATCH) && (sgPendingUpdates == 0) &&
+                (__atomic_load_n(&sgPendingCount, __ATOMIC_ACQUIRE) == 0) &&
+                (aFile->data[index].pack_slot == SG_NOT_PACKED)) {
+            if (sgPatchFileBlock(aFile, index, mod, buf + done, chunk)) {
+                status = -1;
+                break;
+            }
+            done += chunk;
+            if (aFile->file_ptr + done > aFile->file_size) {
+                aFile->file_size = aFile->file_ptr + done;
             }
-            sgLocalSeqno++;
+            continue;
+        }
 
-            // Send the packet
-            rpktlen = SG_DATA_PACKET_SIZE;
-            if ( sgServicePost(initPacket, &pktlen, recvPacket, &rpktlen) ) {
-                return( -1 );
+        //writing past the last block creates a block, otherwise obtain the block and change the correct bytes
+        if (index < aFile->num_blocks) {
+            if (sgReadFileBlock(aFile, index, the_data)) {
+                status = -1;
+                break;
             }
-            // Unpack the recieived data
-            if ( (ret = deserialize_sg_packet(&loc, &rem, &blkid, &op, &sloc, 
-                                            &srem, the_data, recvPacket, rpktlen)) != SG_PACKT_OK ) {
-                return( -1 );
+        }
+        else if (aFile->append_buf != NULL) {
+            memcpy(the_data, aFile->append_buf, SG_BLOCK_SIZE);
+        }
+        else {
+            memset(the_data, 0x0, SG_BLOCK_SIZE);
+        }
+        memcpy(the_data + mod, buf + done, chunk);
+
+        //a new last block that is not full yet waits in the append buffer
+        pending = (index == aFile->num_blocks);
+        if (pending && (blen < SG_BLOCK_SIZE) && sgAppendBuffer(aFile, the_data)) {
+            SG_STAT_ADD(append_writes, 1);
+        }
+        else {
+            if (sgWriteFileBlock(aFile, index, the_data, blen)) {
+                status = -1;
+                break;
             }
-            //place the block because it was not in the cache
-            memcpy(the_data + mod, buf, len);
-            putSGDataBlock(aFile->data[index].rem_id, aFile->data[index].blk_id, the_data);
-
-            //update block - obtain block, change correct bytes, send block back with update block
-            pktlen = SG_DATA_PACKET_SIZE;
-            if ( (ret = serialize_sg_packet(sgLocalNodeId, // Local ID
-                                            aFile->data[index].rem_id,  // Remote ID
-                                            aFile->data[index].blk_id,  // Block ID
-                                            SG_UPDATE_BLOCK,   // Operation
-                                            sgLocalSeqno,    // Sender sequence number
-                                            SG_SEQNO_UNKNOWN,  // Receiver sequence number
-                                            the_data, initPacket, &pktlen)) != SG_PACKT_OK ) {
-                return( -1 );
+            if (pending) {
+                sgAppendRelease(aFile);
             }
-            sgLocalSeqno++;
-            
         }
-    }
-    
-    // Send the packet
-    rpktlen = SG_BASE_PACKET_SIZE;
-    if ( sgServicePost(initPacket, &pktlen, recvPacket, &rpktlen) ) {
-        return( -1 );
+        done += chunk;
+
+        //writing past the end of the file increases the file size
+        if (aFile->file_ptr + done > aFile->file_size) {
+            aFile->file_size = aFile->file_ptr + done;
+        }
     }
 
-    // Unpack the recieived data
-    if ( (ret = deserialize_sg_packet(&loc, &rem, &blkid, &op, &sloc, 
-                                    &srem, NULL, recvPacket, rpktlen)) != SG_PACKT_OK ) {
-        return( -1 );
+    //create the blocks and post the updates held back (failed updates stay held back for the next flush)
+    if (sgWriteBatch) {
+        sgWriteBatch = 0;
+        if (sgDriverFlushCreates(aFile)) {
+            status = -1;
+        }
+        if (sgDriverFlushUpdates()) {
+            status = -1;
+        }
     }
 
-    //add block data to block list, update number of blocks and the file's size
-    aBlock.rem_id = rem;
-    aBlock.blk_id = blkid;
-    
-    if (node_head->node_id == 0) {
-        node_head->node_id = rem;
-        node_head->rseq = srem;
-        node_head->next = NULL;
+    //views of the bytes written (even in part) are refreshed, the list is only changed under the map lock
+    if (__atomic_load_n(&sgMapViews, __ATOMIC_ACQUIRE) != NULL) {
+        sgMapDrop(aFile, aFile->file_ptr, len);
     }
-    
-    // if we created a block
-    if (update == 0) {
-        aFile->data[aFile->num_blocks] = aBlock;
-        aFile->num_blocks++;
-        aBlock.block_number = aFile->num_blocks;
-        putSGDataBlock(aFile->data[index].rem_id, aFile->data[index].blk_id, buf);
-    }
-    // if we updated the last block in the file (write to second half of last block)
-    if (update_middle == 0) {
-        aFile->file_size += len;
-        aFile->file_ptr = aFile->file_size;
-    }
-    // if we updated a block in the middle of the file we do not increase the file size
-    else {
-        aFile->file_ptr += len;
+    if (status) {
+        pthread_mutex_unlock(&aFile->lock);
+        return( -1 );
     }
+
+    aFile->file_ptr += len;
+    pthread_mutex_unlock(&aFile->lock);
     
     // Log the write, return bytes written
     return( len );
@@ -402,44 +929,34 @@ int sgwrite(SgFHandle fh, char *buf, size_t len) {
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : sgseek
-// Description  : Seek to a specific place in the file
+// Function     : sgDriverSeek
+// Description  : Seek to a specific place in the file (sgseek, not captured)
 //
 // Inputs       : fh - the file handle of the file to seek in
 //                off - offset within the file to seek to
 // Outputs      : new position if successful, -1 if failure
 
-int sgseek(SgFHandle fh, size_t off) {
+int sgDriverSeek(SgFHandle fh, size_t off) {
     
-    File_t *current = headd;
     File_t *aFile;
+    SG_TRACE_SCOPE(SG_TEV_SEEK, off);
     //look for the file handle 
-    
-    for (int i = 0; i < num_of_files; i++) {
-        
-        if (current->file_h == fh) {
-            aFile = current;
-        }
-        else {
-            current = current->next;
-        }
-    }
+    aFile = sgFindFile(fh);
     
     //return error if file handle is bad or file is not open or if the offset points to EOF
-    if (aFile->file_h != fh) {
+    if (aFile == NULL) {
         return -1;
     }
 
-    if (aFile->open == 0) {
-        return -1;
-    }
-    
-    if (aFile->file_size <= (int)off) {
+    pthread_mutex_lock(&aFile->lock);
+    if ((aFile->open == 0) || (aFile->file_size <= (int)off)) {
+        pthread_mutex_unlock(&aFile->lock);
         return -1;
     }
     
     //set the file pointer to the offset
     aFile->file_ptr = off;
+    pthread_mutex_unlock(&aFile->lock);
     
     // Return new position
     return( off );
@@ -447,31 +964,38 @@ int sgseek(SgFHandle fh, size_t off) {
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : sgclose
-// Description  : Close the file
+// Function     : sgDriverClose
+// Description  : Close the file (sgclose, not captured)
 //
 // Inputs       : fh - the file handle of the file to close
 // Outputs      : 0 if successful test, -1 if failure
 
-int sgclose(SgFHandle fh) {
+int sgDriverClose(SgFHandle fh) {
 
-    File_t *current = headd;
     File_t *aFile;
+    SG_TRACE_SCOPE(SG_TEV_CLOSE, fh);
     //find the file handle 
-    for (int i = 0; i < num_of_files; i++) {
-        if (current->file_h == fh) {
-            aFile = current;
-        }
-        else {
-            current = current->next;
-        }
-    }
+    aFile = sgFindFile(fh);
     //return error if file handle bad or file not open
-    if ((aFile->file_h != fh) || (aFile->open == 0)) {
+    if (aFile == NULL) {
+        return -1;
+    }
+    pthread_mutex_lock(&aFile->lock);
+    if (aFile->open == 0) {
+        pthread_mutex_unlock(&aFile->lock);
+        return -1;
+    }
+    //close the file, creating its buffered last block, its read ahead is no longer wanted
+    if (sgAppendFlush(aFile) || ((__atomic_load_n(&sgPendingCount, __ATOMIC_ACQUIRE) > 0) && sgDriverFlushUpdates())) {
+        pthread_mutex_unlock(&aFile->lock);
         return -1;
     }
-    //close the file
+    if (aFile->prefetched > 0) {
+        sgPrefetchCancel(aFile);
+    }
+    aFile->read_next = 0;
     aFile->open = 0;
+    pthread_mutex_unlock(&aFile->lock);
 
     // Return successfully
     return( 0 );
@@ -495,22 +1019,73 @@ int sgshutdown(void) {
     SG_SeqNum sloc, srem;
     SG_System_OP op;
     SG_Packet_Status ret;
+    File_t *aFile;
 
-    // Setup the packet with the SG_STOP_ENDPOINT op code to shut down the system
-    pktlen = SG_BASE_PACKET_SIZE;
-    if ( (ret = serialize_sg_packet( SG_NODE_UNKNOWN, // Local ID
-                                    SG_NODE_UNKNOWN,   // Remote ID
-                                    SG_BLOCK_UNKNOWN,  // Block ID
-                                    SG_STOP_ENDPOINT,  // Operation
-                                    sgLocalSeqno++,    // Sender sequence number
-                                    SG_SEQNO_UNKNOWN,  // Receiver sequence number
-                                    NULL, initPacket, &pktlen)) != SG_PACKT_OK ) {
-        return( -1 );
+    // Create the blocks still waiting in append buffers
+    aFile = headd;
+    for (int i = 0; (i < num_of_files) && (aFile != NULL); i++, aFile = aFile->next) {
+        pthread_mutex_lock(&aFile->lock);
+        ret = sgAppendFlush(aFile);
+        pthread_mutex_unlock(&aFile->lock);
+        if (ret) {
+            return( -1 );
+        }
+    }
+
+    // Post the updates still held back
+    if (sgDriverFlushUpdates()) {
+        return( -1 );
+    }
+    while (sgPendingNodes != NULL) {
+        pnode_t *pn = sgPendingNodes;
+        sgPendingNodes = pn->next;
+        free(pn);
+    }
+
+    // Release the views still mapped and stop filling them
+    while (sgMapViews != NULL) {
+        sgunmap(sgMapViews->view);
+    }
+    if (sgMapFaultFd >= 0) {
+        uint64_t stop = 1;
+        if (write(sgMapStopFd, &stop, sizeof(stop)) == sizeof(stop)) {
+            pthread_join(sgMapThread, NULL);
+        }
+        close(sgMapStopFd);
+        close(sgMapFaultFd);
+    }
+    sgMapFaultFd = -1;
+
+    // Stop reading ahead, then let the requests that lost hedged reads finish before the service goes away
+    pthread_mutex_lock(&sgDriverPrefetchLock);
+    sgPrefetchStop = 1;
+    sgPrefetchCount = 0;
+    pthread_cond_broadcast(&sgDriverPrefetchCond);
+    pthread_mutex_unlock(&sgDriverPrefetchLock);
+    for (int t = 0; t < sgPrefetchWorkers; t++) {
+        pthread_join(sgPrefetchThreads[t], NULL);
+    }
+    pthread_mutex_lock(&sgDriverHedgeLock);
+    while (sgHedgeThreads > 0) {
+        pthread_cond_wait(&sgDriverHedgeCond, &sgDriverHedgeLock);
+    }
+    pthread_mutex_unlock(&sgDriverHedgeLock);
+
+    // Setup the packet with the SG_STOP_ENDPOINT op code to shut down the system
+    pktlen = SG_BASE_PACKET_SIZE;
+    if ( (ret = serialize_sg_packet( SG_NODE_UNKNOWN, // Local ID
+                                    SG_NODE_UNKNOWN,   // Remote ID
+                                    SG_BLOCK_UNKNOWN,  // Block ID
+                                    SG_STOP_ENDPOINT,  // Operation
+                                    sgDriverNextSeqno(), // Sender sequence number
+                                    SG_SEQNO_UNKNOWN,  // Receiver sequence number
+                                    NULL, initPacket, &pktlen)) != SG_PACKT_OK ) {
+        return( -1 );
     }
 
     // Send the packet
     rpktlen = SG_BASE_PACKET_SIZE;
-    if ( sgServicePost(initPacket, &pktlen, recvPacket, &rpktlen) ) {
+    if ( sgDriverServicePost(initPacket, &pktlen, recvPacket, &rpktlen) ) {
         return( -1 );
     }
 
@@ -521,6 +1096,57 @@ int sgshutdown(void) {
     }
 
     closeSGCache();
+    closeSGPlacement();
+    closeSGSched();
+    if (sgPrefetchBlocks > 0) {
+        logMessage( LOG_INFO_LEVEL, "Read ahead: %lu blocks queued, %lu dropped, %lu obtained, %lu cancelled.",
+                sgDriverStats.prefetch_queued, sgDriverStats.prefetch_dropped, sgDriverStats.prefetch_obtained,
+                sgDriverStats.prefetch_cancelled );
+    }
+    if (sgDriverStats.fanout_rounds > 0) {
+        logMessage( LOG_INFO_LEVEL, "Parallel reads: %lu rounds, %lu blocks fetched.",
+                sgDriverStats.fanout_rounds, sgDriverStats.fanout_blocks );
+    }
+    if (sgInlineEnabled) {
+        logMessage( LOG_INFO_LEVEL, "Small files: %lu inline reads, %lu spilled, %lu tails in %lu shared packs, %lu spilled.",
+                sgDriverStats.inline_reads, sgDriverStats.inline_spills, sgDriverStats.tail_blocks,
+                sgDriverStats.tail_packs, sgDriverStats.tail_spills );
+    }
+    if (sgDriverStats.seq_wraps || sgDriverStats.seq_waits) {
+        logMessage( LOG_INFO_LEVEL, "Sequence numbers: %lu wraps, %lu waits for a node's window.",
+                sgDriverStats.seq_wraps, sgDriverStats.seq_waits );
+    }
+    if (sgReplicas > 1) {
+        logMessage( LOG_INFO_LEVEL, "Replication: %lu copies created, %lu missed; %lu reads, %lu hedged (%lu won by a copy), %lu failed over, deadline %lu ns.",
+                sgDriverStats.replica_blocks, sgDriverStats.replica_misses, sgDriverStats.hedge_reads, sgDriverStats.hedges,
+                sgDriverStats.hedge_wins, sgDriverStats.failovers, sgHedgeDeadline );
+    }
+    if (sgPendingUpdates > 0) {
+        logMessage( LOG_INFO_LEVEL, "Update merging: %lu updates held back, %lu merged, %lu posted in %lu node bursts.",
+                sgDriverStats.updates_deferred, sgDriverStats.updates_merged, sgDriverStats.update_posts,
+                sgDriverStats.update_bursts );
+    }
+    if (sgDriverStats.patches > 0) {
+        logMessage( LOG_INFO_LEVEL, "Block patches: %lu writes patched (%lu bytes), %lu of them not cached.",
+                sgDriverStats.patches, sgDriverStats.patch_bytes, sgDriverStats.patch_misses );
+    }
+    if (sgDriverStats.compounds > 0) {
+        logMessage( LOG_INFO_LEVEL, "Compound packets: %lu posted, carrying %lu block operations.",
+                sgDriverStats.compounds, sgDriverStats.compound_ops );
+    }
+    if (sgDriverStats.map_views > 0) {
+        logMessage( LOG_INFO_LEVEL, "Mapped views: %lu mapped, %lu pages filled as touched, %lu refreshed by writes.",
+                sgDriverStats.map_views, sgDriverStats.map_faults, sgDriverStats.map_refreshes );
+    }
+    logMessage( LOG_INFO_LEVEL, "Service traffic: %lu bytes sent in block requests.", sgDriverStats.sent_bytes );
+    if (sgAppendBuffering) {
+        logMessage( LOG_INFO_LEVEL, "Append buffering: %lu writes buffered, %lu partial blocks flushed.",
+                sgDriverStats.append_writes, sgDriverStats.append_flushes );
+    }
+    if (sgChecksumEnabled) {
+        logMessage( LOG_INFO_LEVEL, "Block checksums (crc32c, %s): %lu verified, %lu failures, %lu recovered.",
+                sgCrc32cImplementation(), sgDriverStats.crc_verified, sgDriverStats.crc_failures, sgDriverStats.crc_recovered );
+    }
 
     map_t *curr = node_head;
     map_t *delete = node_head;
@@ -531,7 +1157,13 @@ int sgshutdown(void) {
         free(delete);
     }
 
-    // Log, return successfully
+    // Write out the trace and the capture log, log, return successfully
+    if (sgTracePath != NULL) {
+        closeSGTrace();
+    }
+    if (sgCapturePath != NULL) {
+        closeSGCapture();
+    }
     logMessage( LOG_INFO_LEVEL, "Shut down Scatter/Gather driver." );
     return( 0 );
 }
@@ -559,21 +1191,26 @@ SG_Packet_Status serialize_sg_packet(SG_Node_ID loc, SG_Node_ID rem, SG_Block_ID
     uint8_t data_indicator;
     SG_Packet_Status status;
     uint32_t magic = SG_MAGIC_VALUE;
-    // check if the head node has a matching node ID and pass it in if it does and increment
+    SG_TRACE_SCOPE(SG_TEV_SERIALIZE, op);
+    // a receiver sequence number not handed out by the caller comes from the node mapping
+    // (creates carry none, the service numbers them on whichever node it places the block)
     map_t *crt = node_head;
-    int found = 0;
-    if (crt->node_id == rem) {
-        crt->rseq++;
+    int found = (rseq != SG_SEQNO_UNKNOWN) || (op == SG_CREATE_BLOCK);
+    if (found == 0 && crt->node_id == rem) {
+        crt->rseq = SG_SEQNO_NEXT(crt->rseq);
         rseq = crt->rseq;
         found = 1;
     }
     // if our node ID was not the head, check the rest of the linked list for that node ID and pass it in if found
+    // (the increment is kept so concurrent requests to a node get distinct numbers, creates go to no node yet)
     while (crt->next != NULL && found == 0) {
         crt = crt->next;
 
         if (crt->node_id == rem) {
-            rseq = crt->rseq;
-            rseq += 1;
+            rseq = SG_SEQNO_NEXT(crt->rseq);
+            if (rem != SG_NODE_UNKNOWN) {
+                crt->rseq = rseq;
+            }
             found = 1;
         }
     }
@@ -609,7 +1246,7 @@ SG_Packet_Status serialize_sg_packet(SG_Node_ID loc, SG_Node_ID rem, SG_Block_ID
         return status;
     }
 
-    if ((op > 6) || (op < 0)) {
+    if ((op >= SG_MAXVAL_OP) || (op < 0)) {
         status = 4;
         return status;
     }
@@ -673,6 +1310,7 @@ SG_Packet_Status deserialize_sg_packet(SG_Node_ID *loc, SG_Node_ID *rem, SG_Bloc
     SG_Packet_Status status;
     uint8_t data_indicator;
     uint32_t magic = SG_MAGIC_VALUE;
+    SG_TRACE_SCOPE(SG_TEV_DESERIALIZE, plen);
     
     // copy loc value from packet and verify that it is correct
 
@@ -701,7 +1339,7 @@ SG_Packet_Status deserialize_sg_packet(SG_Node_ID *loc, SG_Node_ID *rem, SG_Bloc
     // copy op value from packet and verify that it is correct
 
     memcpy(op, packet + sizeof(magic) + sizeof(loc) + sizeof(rem) + sizeof(blk), sizeof(int));
-    if ((*op > 6) || (*op < 0)) {
+    if ((*op >= SG_MAXVAL_OP) || (*op < 0)) {
         status = 4;
         return status;
     }
@@ -721,21 +1359,26 @@ SG_Packet_Status deserialize_sg_packet(SG_Node_ID *loc, SG_Node_ID *rem, SG_Bloc
     map_t *crt = node_head;
     int found = 0;
     // check if the head node is our node id in deserialize and save its most recent rseq value
+    // (replies to concurrent requests can arrive out of order, so only move forward)
     if (crt->node_id == *rem) {
-        crt->rseq = *rseq;
+        if (SG_SEQNO_DIFF(*rseq, crt->rseq) > 0) {
+            crt->rseq = *rseq;
+        }
         found = 1;
     }
     // if it was not found, check rest of mapping and save newest rseq value if found
     while (crt->next != NULL && found == 0) {
         crt = crt->next;
         if (crt->node_id == *rem) {
-            crt->rseq = *rseq;
+            if (SG_SEQNO_DIFF(*rseq, crt->rseq) > 0) {
+                crt->rseq = *rseq;
+            }
             found = 1;
         }
     }
     // the node id does not exist in our mapping so allocate mem for a new node, assign its metadata, and set it to the end of the linked list
     if (found == 0) {
-        map_t *newnde = malloc(sizeof(map_t));
+        map_t *newnde = calloc(1, sizeof(map_t));
         newnde->node_id = *rem;
         newnde->rseq = *rseq;
         newnde->next = NULL;
@@ -776,68 +1419,2742 @@ SG_Packet_Status deserialize_sg_packet(SG_Node_ID *loc, SG_Node_ID *rem, SG_Bloc
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : sgInitEndpoint
-// Description  : Initialize the endpoint
+// Function     : sgFindFile
+// Description  : Find the file structure for a file handle
 //
-// Inputs       : none
-// Outputs      : 0 if successfull, -1 if failure
+// Inputs       : fh - the file handle to look for
+// Outputs      : pointer to the file or NULL if not found
 
-int sgInitEndpoint( void ) {
+File_t *sgFindFile( SgFHandle fh ) {
 
-    // Local variables
-    char initPacket[SG_BASE_PACKET_SIZE], recvPacket[SG_BASE_PACKET_SIZE];
-    size_t pktlen, rpktlen;
-    SG_Node_ID loc, rem;
-    SG_Block_ID blkid;
-    SG_SeqNum sloc, srem;
-    SG_System_OP op;
-    SG_Packet_Status ret;
-    
-    // initializing the file linked list, nodeid/rseq linked list, and cache
-    headd = (File_t *) malloc(sizeof(File_t));
-    headd->file_h = 0;
-    headd->next = NULL;
-    node_head = (map_t *) calloc(1, sizeof(map_t));
-    global_flag = 1;
-    node_head->next = NULL;
-    initSGCache(SG_MAX_CACHE_ELEMENTS);
+    File_t *current;
 
-    // Local and do some initial setup
-    logMessage( LOG_INFO_LEVEL, "Initializing local endpoint ..." );
-    sgLocalSeqno = SG_INITIAL_SEQNO;
+    //walk the file linked list looking for the file handle, files are never removed from it
+    pthread_mutex_lock(&sgDriverFileLock);
+    current = headd;
+    for (int i = 0; (i < num_of_files) && (current != NULL); i++) {
+        if (current->file_h == fh) {
+            pthread_mutex_unlock(&sgDriverFileLock);
+            return( current );
+        }
+        current = current->next;
+    }
+    pthread_mutex_unlock(&sgDriverFileLock);
+    return( NULL );
+}
 
-    // Setup the packet
-    pktlen = SG_BASE_PACKET_SIZE;
-    if ( (ret = serialize_sg_packet( SG_NODE_UNKNOWN, // Local ID
-                                    SG_NODE_UNKNOWN,   // Remote ID
-                                    SG_BLOCK_UNKNOWN,  // Block ID
-                                    SG_INIT_ENDPOINT,  // Operation
-                                    sgLocalSeqno++,    // Sender sequence number
-                                    SG_SEQNO_UNKNOWN,  // Receiver sequence number
-                                    NULL, initPacket, &pktlen)) != SG_PACKT_OK ) {
-        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: failed serialization of packet [%d].", ret );
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFilePos
+// Description  : Get the position in a file (for the capture log)
+//
+// Inputs       : fh - the file handle
+// Outputs      : the file position, 0 if the handle is bad
+
+size_t sgDriverFilePos( SgFHandle fh ) {
+
+    File_t *aFile = sgFindFile(fh);
+    size_t pos = 0;
+
+    if (aFile != NULL) {
+        pthread_mutex_lock(&aFile->lock);
+        pos = aFile->file_ptr;
+        pthread_mutex_unlock(&aFile->lock);
+    }
+    return( pos );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgReadFileRange
+// Description  : Get bytes of a file (file lock held, the range is in the file)
+//
+// Inputs       : file - the file to read from
+//                pos - the file position of the first byte
+//                buf - the buffer to place the data
+//                len - the number of bytes
+// Outputs      : 0 if successful, -1 if failure
+
+int sgReadFileRange( File_t *file, size_t pos, char *buf, size_t len ) {
+
+    char the_data[SG_BLOCK_SIZE], *blocks;
+    int first, count, pending;
+
+    //a small file is read straight out of its metadata
+    if ((file->num_blocks == 0) && (file->append_buf == NULL)) {
+        memcpy(buf, file->inline_data + pos, len);
+        SG_STAT_ADD(inline_reads, 1);
+        return( 0 );
+    }
+
+    //get the blocks the range covers from the cache or the SG system, then copy the data out
+    first = pos >> SG_BLOCK_SHIFT;
+    count = ((pos + len - 1) >> SG_BLOCK_SHIFT) - first + 1;
+    blocks = (count == 1) ? the_data : malloc((size_t)count * SG_BLOCK_SIZE);
+
+    //a new last block still in the append buffer is read out of memory
+    pending = (first + count - 1 == file->num_blocks);
+    if (pending) {
+        memcpy(blocks + ((size_t)(count - 1) * SG_BLOCK_SIZE), file->append_buf, SG_BLOCK_SIZE);
+    }
+    if ((count > pending) && sgReadFileBlocks(file, first, count - pending, blocks)) {
+        if (blocks != the_data) {
+            free(blocks);
+        }
         return( -1 );
     }
+    memcpy(buf, blocks + (pos & SG_BLOCK_MASK), len);
+    if (blocks != the_data) {
+        free(blocks);
+    }
+    return( 0 );
+}
 
-    // Send the packet
-    rpktlen = SG_BASE_PACKET_SIZE;
-    if ( sgServicePost(initPacket, &pktlen, recvPacket, &rpktlen) ) {
-        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: failed packet post" );
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgReadFileBlock
+// Description  : Get the contents of a logical block of a file
+//
+// Inputs       : file - the file to read from
+//                index - the logical block index in the file
+//                data - the buffer to place the data (SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgReadFileBlock( File_t *file, int index, char *data ) {
+
+    return( sgReadFileBlocks(file, index, 1, data) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgReadFileBlocks
+// Description  : Get the contents of consecutive logical blocks of a file.  The
+//                service blocks holding them are looked up in the cache and
+//                the missing ones are fetched from their nodes in parallel.
+//
+// Inputs       : file - the file to read from
+//                first - the first logical block index
+//                count - the number of blocks
+//                data - the buffer to place the data (count * SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgReadFileBlocks( File_t *file, int first, int count, char *data ) {
+
+    fetch_t fetches[SG_MAX_FANOUT_BLOCKS];
+    int which[SG_MAX_FANOUT_BLOCKS];
+    char *blocks, *out;
+    block_t *aBlock;
+    int base, num, n, f;
+
+    if ((first < 0) || (count < 1) || (first + count > file->num_blocks)) {
+        logMessage( LOG_ERROR_LEVEL, "sgReadFileBlocks: bad block range [%d, %d] of file [%d]", first, count, file->file_h );
         return( -1 );
     }
+    blocks = malloc((size_t)SG_MAX_FANOUT_BLOCKS * SG_BLOCK_SIZE);
 
-    // Unpack the recieived data
-    if ( (ret = deserialize_sg_packet(&loc, &rem, &blkid, &op, &sloc, 
-                                    &srem, NULL, recvPacket, rpktlen)) != SG_PACKT_OK ) {
-        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: failed deserialization of packet [%d]", ret );
+    for (base = 0; base < count; base += SG_MAX_FANOUT_BLOCKS) {
+        num = ((count - base) < SG_MAX_FANOUT_BLOCKS) ? (count - base) : SG_MAX_FANOUT_BLOCKS;
+
+        //one fetch per distinct service block (packed blocks can share one)
+        n = 0;
+        for (int i = 0; i < num; i++) {
+            aBlock = &file->data[first + base + i];
+            for (f = 0; f < n; f++) {
+                if ((fetches[f].rem_id == aBlock->rem_id) && (fetches[f].blk_id == aBlock->blk_id)) {
+                    break;
+                }
+            }
+            if (f == n) {
+                fetches[n].rem_id = aBlock->rem_id;
+                fetches[n].blk_id = aBlock->blk_id;
+                fetches[n].data = blocks + ((size_t)n * SG_BLOCK_SIZE);
+                fetches[n].block = (aBlock->replicas > 0) ? aBlock : NULL;
+                n++;
+            }
+            which[i] = f;
+        }
+        if (sgDriverObtainBlocks(fetches, n)) {
+            free(blocks);
+            return( -1 );
+        }
+
+        //unpack each logical block and check it
+        for (int i = 0; i < num; i++) {
+            aBlock = &file->data[first + base + i];
+            out = data + ((size_t)(base + i) * SG_BLOCK_SIZE);
+            if (aBlock->pack_slot == SG_NOT_PACKED) {
+                memcpy(out, fetches[which[i]].data, SG_BLOCK_SIZE);
+            }
+            else {
+                memset(out, 0x0, SG_BLOCK_SIZE);
+                if (sgPackRead(fetches[which[i]].data, aBlock->pack_slot, out) < 0) {
+                    logMessage( LOG_ERROR_LEVEL, "sgReadFileBlocks: failed unpacking block [%d] of file [%d]", first + base + i, file->file_h );
+                    free(blocks);
+                    return( -1 );
+                }
+            }
+            if (sgVerifyFileBlock(file, first + base + i, out, fetches[which[i]].cached)) {
+                free(blocks);
+                return( -1 );
+            }
+        }
+    }
+
+    free(blocks);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgVerifyFileBlock
+// Description  : Verify the checksum of a logical block.  Blocks from the SG
+//                system are always verified, cache hits only if asked to.  A
+//                cached block that fails is obtained again from the SG system.
+//
+// Inputs       : file - the file the block belongs to
+//                index - the logical block index in the file
+//                data - the block contents (replaced if re-obtained)
+//                cached - 1 if the block came from the cache
+// Outputs      : 0 if the block is good, -1 if it is corrupt
+
+int sgVerifyFileBlock( File_t *file, int index, char *data, int cached ) {
+
+    block_t *aBlock = &file->data[index];
+
+    if (!sgChecksumEnabled || (cached && !sgChecksumCacheHits)) {
+        return( 0 );
+    }
+    SG_STAT_ADD(crc_verified, 1);
+    if (sgCrc32c(0, data, SG_BLOCK_SIZE) == aBlock->crc) {
+        return( 0 );
+    }
+    SG_STAT_ADD(crc_failures, 1);
+    logMessage( LOG_ERROR_LEVEL, "sgVerifyFileBlock: checksum mismatch on block [%d] of file [%d] (%s)",
+            index, file->file_h, cached ? "cache" : "service" );
+
+    //a corrupt cached copy can be replaced from the SG system
+    if (cached) {
+        if (sgLoadFileBlock(file, index, data, 1, &cached)) {
+            return( -1 );
+        }
+        SG_STAT_ADD(crc_verified, 1);
+        if (sgCrc32c(0, data, SG_BLOCK_SIZE) == aBlock->crc) {
+            SG_STAT_ADD(crc_recovered, 1);
+            return( 0 );
+        }
+        SG_STAT_ADD(crc_failures, 1);
+    }
+    return( -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgMapFill
+// Description  : Fill pages of a view with the bytes of the file they map,
+//                zeros past its end (file lock held)
+//
+// Inputs       : file - the file mapped
+//                pos - the file position of the first page
+//                page - the first page
+//                len - the length of the pages
+// Outputs      : 0 if successful, -1 if failure
+
+int sgMapFill( File_t *file, size_t pos, char *page, size_t len ) {
+
+    size_t avail = (pos < file->file_size) ? file->file_size - pos : 0;
+
+    if (avail > len) {
+        avail = len;
+    }
+    if ((avail > 0) && sgReadFileRange(file, pos, page, avail)) {
         return( -1 );
     }
+    memset(page + avail, 0x0, len - avail);
+    return( 0 );
+}
 
-    // Sanity check the return value
-    if ( loc == SG_NODE_UNKNOWN ) {
-        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: bad local ID returned [%ul]", loc );
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgMapStart
+// Description  : Start the thread filling the pages of views as they are
+//                touched, once.  Without userfaultfd views are read in when
+//                they are mapped.
+//
+// Inputs       : none
+// Outputs      : 0 if pages are filled on fault, -1 if not
+
+int sgMapStart( void ) {
+
+    struct uffdio_api api;
+    int fd;
+
+    pthread_mutex_lock(&sgDriverMapLock);
+    if (sgMapFaultFd != -1) {
+        pthread_mutex_unlock(&sgDriverMapLock);
+        return( (sgMapFaultFd >= 0) ? 0 : -1 );
+    }
+    sgMapPageSize = sysconf(_SC_PAGESIZE);
+
+    //faults from the kernel (views passed to system calls) need privilege, user faults do not
+    fd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+#ifdef UFFD_USER_MODE_ONLY
+    if ((fd < 0) && (errno == EPERM)) {
+        fd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+    }
+#endif
+    memset(&api, 0x0, sizeof(api));
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_THREAD_ID;
+    if ((fd >= 0) && ioctl(fd, UFFDIO_API, &api)) {
+        close(fd);
+        fd = -1;
+    }
+    if ((fd >= 0) && (((sgMapStopFd = eventfd(0, EFD_CLOEXEC)) < 0) ||
+            pthread_create(&sgMapThread, NULL, sgMapFaultThread, (void *)(intptr_t)fd))) {
+        if (sgMapStopFd >= 0) {
+            close(sgMapStopFd);
+        }
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        logMessage( LOG_INFO_LEVEL, "sgMapStart: userfaultfd unavailable [%s], views are read in when mapped",
+                strerror(errno) );
+    }
+    sgMapFaultFd = (fd >= 0) ? fd : -2;
+    pthread_mutex_unlock(&sgDriverMapLock);
+    return( (fd >= 0) ? 0 : -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgMapDrop
+// Description  : Refresh the pages of views covering bytes just written.
+//                Pages filled on fault are dropped to be filled again when
+//                next touched, pages read in up front are read again. (file
+//                lock held)
+//
+// Inputs       : file - the file written
+//                pos - the file position of the bytes
+//                len - the number of bytes
+// Outputs      : none
+
+void sgMapDrop( File_t *file, size_t pos, size_t len ) {
+
+    mapview_t *view;
+    size_t start, end;
+
+    //a page filled before the write may still be on its way in, it is dropped once it is in
+    pthread_mutex_lock(&sgDriverMapLock);
+    while (sgMapFilling != 0) {
+        pthread_cond_wait(&sgMapFillCond, &sgDriverMapLock);
+    }
+    for (view = sgMapViews; view != NULL; view = view->next) {
+        if ((view->file_h != file->file_h) || (pos + len <= view->pos) || (pos >= view->pos + view->length)) {
+            continue;
+        }
+        start = (pos > view->pos) ? ((pos - view->pos) & ~(sgMapPageSize - 1)) : 0;
+        end = (pos + len - view->pos < view->length) ? (pos + len - view->pos) : view->length;
+        end = (end + sgMapPageSize - 1) & ~(sgMapPageSize - 1);
+        if (view->lazy) {
+            madvise(view->base + start, end - start, MADV_DONTNEED);
+        } else if (mprotect(view->base + start, end - start, PROT_READ | PROT_WRITE) ||
+                sgMapFill(file, view->pos + start, view->base + start, end - start) ||
+                mprotect(view->base + start, end - start, PROT_READ)) {
+            logMessage( LOG_ERROR_LEVEL, "sgMapDrop: unable to refresh a view of file [%d]", file->file_h );
+        }
+        SG_STAT_ADD(map_refreshes, (end - start) / sgMapPageSize);
+    }
+    pthread_mutex_unlock(&sgDriverMapLock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgMapFaultThread
+// Description  : Fill the pages of views as they are touched.  A fault on a
+//                file whose lock is held is put aside and tried again every
+//                millisecond, while the other faults go on.
+//
+// Inputs       : arg - the userfaultfd
+// Outputs      : NULL
+
+void *sgMapFaultThread( void *arg ) {
+
+    int fd = (int)(intptr_t)arg;
+    struct pollfd fds[2];
+    struct uffd_msg msg;
+    mapfault_t *busy = NULL, fault;
+    int nbusy = 0, maxbusy = 0, i;
+    char *page;
+
+    page = aligned_alloc(sgMapPageSize, sgMapPageSize);
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = sgMapStopFd;
+    fds[1].events = POLLIN;
+    while (page != NULL) {
+        if (poll(fds, 2, (nbusy > 0) ? 1 : -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+
+        //faults whose file was busy are tried again, the thread holding it may have let go
+        for (i = 0; i < nbusy; ) {
+            if (sgMapFaultRetry(fd, &busy[i], page) > 0) {
+                i++;
+            } else {
+                busy[i] = busy[--nbusy];
+            }
+        }
+        if (!fds[0].revents || (read(fd, &msg, sizeof(msg)) != sizeof(msg)) ||
+                (msg.event != UFFD_EVENT_PAGEFAULT)) {
+            continue;
+        }
+        fault.addr = msg.arg.pagefault.address;
+        fault.ptid = msg.arg.pagefault.feat.ptid;
+        if (sgMapFaultRetry(fd, &fault, page) > 0) {
+            if (nbusy == maxbusy) {
+                maxbusy = (maxbusy > 0) ? maxbusy * 2 : 16;
+                busy = realloc(busy, maxbusy * sizeof(mapfault_t));
+            }
+            busy[nbusy++] = fault;
+        }
+    }
+    free(busy);
+    free(page);
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgMapFaultRetry
+// Description  : Fill a touched page of a view.  A page that cannot be read
+//                raises SIGBUS in the thread touching it, as for a file
+//                mapping.
+//
+// Inputs       : fd - the userfaultfd
+//                fault - the page fault
+//                page - a page sized buffer
+// Outputs      : 0 if the fault is done with, 1 if the file is busy (try again)
+
+int sgMapFaultRetry( int fd, mapfault_t *fault, char *page ) {
+
+    int ret = sgMapFault(fd, fault->addr, page);
+
+    if (ret < 0) {
+        logMessage( LOG_ERROR_LEVEL, "sgMapFaultThread: unable to fill page [%lx] of a view", fault->addr );
+        if (fault->ptid != 0) {
+            syscall(SYS_tgkill, getpid(), fault->ptid, SIGBUS);
+        } else {
+            kill(getpid(), SIGBUS);
+        }
+        return( 0 );
+    }
+    return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgMapFault
+// Description  : Fill a touched page of a view, from the cache (or the SG
+//                system).  The fault thread never waits for a file lock: the
+//                thread holding it may be touching a view itself, so a busy
+//                file has the fault tried again later.  The page is read under
+//                the file lock and copied in after it is let go, a write
+//                refreshing the page waits for the copy (sgMapFilling).
+//
+// Inputs       : fd - the userfaultfd
+//                addr - the address touched
+//                page - a page sized buffer
+// Outputs      : 0 if successful, 1 if the file is busy, -1 if the page could
+//                not be read
+
+int sgMapFault( int fd, uint64_t addr, char *page ) {
+
+    struct uffdio_copy copy;
+    struct uffdio_range range;
+    mapview_t *view;
+    File_t *aFile = NULL;
+    size_t pos = 0;
+
+    addr &= ~((uint64_t)sgMapPageSize - 1);
+    pthread_mutex_lock(&sgDriverMapLock);
+    for (view = sgMapViews; view != NULL; view = view->next) {
+        if ((addr >= (uintptr_t)view->base) && (addr < (uintptr_t)view->base + view->length)) {
+            aFile = sgFindFile(view->file_h);
+            pos = view->pos + (addr - (uintptr_t)view->base);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sgDriverMapLock);
+
+    //a view unmapped while it was touched has nothing left to fill
+    range.start = addr;
+    range.len = sgMapPageSize;
+    if (aFile == NULL) {
+        ioctl(fd, UFFDIO_WAKE, &range);
+        return( 0 );
+    }
+    if (pthread_mutex_trylock(&aFile->lock)) {
+        return( 1 );
+    }
+    if (sgMapFill(aFile, pos, page, sgMapPageSize)) {
+        pthread_mutex_unlock(&aFile->lock);
+        return( -1 );
+    }
+    pthread_mutex_lock(&sgDriverMapLock);
+    sgMapFilling = addr;
+    pthread_mutex_unlock(&sgDriverMapLock);
+    pthread_mutex_unlock(&aFile->lock);
+
+    copy.dst = addr;
+    copy.src = (uintptr_t)page;
+    copy.len = sgMapPageSize;
+    copy.mode = 0;
+    copy.copy = 0;
+    if (ioctl(fd, UFFDIO_COPY, &copy) == 0) {
+        SG_STAT_ADD(map_faults, 1);
+    } else {
+        //filled by an earlier fault on the page, or the view was unmapped
+        ioctl(fd, UFFDIO_WAKE, &range);
+    }
+    pthread_mutex_lock(&sgDriverMapLock);
+    sgMapFilling = 0;
+    pthread_cond_broadcast(&sgMapFillCond);
+    pthread_mutex_unlock(&sgDriverMapLock);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLoadFileBlock
+// Description  : Get the contents of a single logical block of a file,
+//                unpacking it if it is stored in a packed block
+//
+// Inputs       : file - the file to read from
+//                index - the logical block index in the file
+//                data - the buffer to place the data (SG_BLOCK_SIZE)
+//                refetch - skip the cache and obtain the block from the system
+//                cached - set to 1 if the block came from the cache
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLoadFileBlock( File_t *file, int index, char *data, int refetch, int *cached ) {
+
+    block_t *aBlock = &file->data[index];
+    char pack[SG_BLOCK_SIZE];
+    char *buf = (aBlock->pack_slot == SG_NOT_PACKED) ? data : pack;
+
+    if (refetch) {
+        *cached = 0;
+        if (sgDriverFetchBlock(aBlock->rem_id, aBlock->blk_id, buf)) {
+            return( -1 );
+        }
+    }
+    else if (sgDriverObtainBlock(aBlock->rem_id, aBlock->blk_id, buf, cached)) {
+        return( -1 );
+    }
+    if (aBlock->pack_slot == SG_NOT_PACKED) {
+        return( 0 );
+    }
+
+    //decompress our slot out of the packed block
+    memset(data, 0x0, SG_BLOCK_SIZE);
+    if (sgPackRead(pack, aBlock->pack_slot, data) < 0) {
+        logMessage( LOG_ERROR_LEVEL, "sgLoadFileBlock: failed unpacking block [%d] of file [%d]", index, file->file_h );
         return( -1 );
     }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgWriteFileBlock
+// Description  : Write the contents of a logical block of a file, creating the
+//                block if it is the next block of the file
+//
+// Inputs       : file - the file to write to
+//                index - the logical block index in the file
+//                data - the new block contents (SG_BLOCK_SIZE)
+//                len - the number of bytes of the block in the file
+// Outputs      : 0 if successful, -1 if failure
+
+int sgWriteFileBlock( File_t *file, int index, char *data, size_t len ) {
+
+    block_t *aBlock = &file->data[index];
+    char pack[SG_BLOCK_SIZE], zdata[SG_BLOCK_SIZE];
+    SG_Node_ID target;
+
+    //the checksum covers the whole logical block, it is verified when the block is read back
+    if (sgChecksumEnabled) {
+        aBlock->crc = sgCrc32c(0, data, SG_BLOCK_SIZE);
+    }
+
+    //if we are creating a block, pack it if it compresses well, otherwise create a block for it
+    if (index == file->num_blocks) {
+        aBlock->block_number = index;
+        aBlock->pack_slot = SG_NOT_PACKED;
+        aBlock->tail = 0;
+        aBlock->replicas = 0;
+        if (sgInlineEnabled && (len <= SG_TAIL_MAX_BYTES) && (sgTailAddBlock(file, index, data, len) == 0)) {
+            file->num_blocks++;
+            return( 0 );
+        }
+        if (sgCompressionEnabled && (sgCompress(data, len, zdata, len / SG_PACK_MIN_RATIO) >= 0) &&
+                (sgPackFileBlock(file, index, data, len) == 0)) {
+            file->num_blocks++;
+            return( 0 );
+        }
+
+        //a block of a write over several blocks is created with the others of its node as the write ends
+        target = sgPlacementChoose(file->file_h, index);
+        if (sgWriteBatch && (sgReplicas <= 1) && (target != SG_NODE_UNKNOWN)) {
+            if (sgDriverDeferCreate(file, index, data, target)) {
+                return( -1 );
+            }
+        } else if (sgDriverCreateBlock(data, target, &aBlock->rem_id, &aBlock->blk_id) ||
+                sgReplicateFileBlock(file, index, data)) {
+            return( -1 );
+        }
+        file->num_blocks++;
+        return( 0 );
+    }
+
+    //update a regular block (and its copies) in place
+    if (aBlock->pack_slot == SG_NOT_PACKED) {
+        if (sgDriverUpdateBlock(aBlock->rem_id, aBlock->blk_id, data)) {
+            return( -1 );
+        }
+        return( sgReplicaUpdate(aBlock, data) );
+    }
+
+    //a file tail is shared with other files' tails
+    if (aBlock->tail) {
+        return( sgTailUpdateBlock(file, index, data, len) );
+    }
+
+    //update a packed block, recompressing the slot into the pack if it still fits
+    if (sgDriverObtainBlock(aBlock->rem_id, aBlock->blk_id, pack, NULL)) {
+        return( -1 );
+    }
+    if (sgPackWrite(pack, aBlock->pack_slot, data, len) == 0) {
+        return( sgDriverUpdateBlock(aBlock->rem_id, aBlock->blk_id, pack) );
+    }
+
+    //the block no longer fits, spill it to a block of its own and free its slot
+    logMessage( LOG_INFO_LEVEL, "sgWriteFileBlock: spilling block [%d] of file [%d] from pack [%lu]", index, file->file_h, aBlock->blk_id );
+    sgPackFree(pack, aBlock->pack_slot);
+    if (sgDriverUpdateBlock(aBlock->rem_id, aBlock->blk_id, pack)) {
+        return( -1 );
+    }
+    aBlock->pack_slot = SG_NOT_PACKED;
+    if (sgDriverCreateBlock(data, sgPlacementChoose(file->file_h, index), &aBlock->rem_id, &aBlock->blk_id)) {
+        return( -1 );
+    }
+    return( sgReplicateFileBlock(file, index, data) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPatchFileBlock
+// Description  : Write some bytes of a block of its own (and its copies) with
+//                patches of just those bytes.  A cached block is changed in
+//                the cache once the patch is posted; a block that is not is
+//                never obtained, its checksum is brought up to date from the
+//                old bytes the patch returns (the CRC of the change is XORed in).
+//
+// Inputs       : file - the file to write to
+//                index - the logical block index in the file
+//                off - the offset of the bytes in the block
+//                data - the new bytes
+//                len - the number of bytes (at most SG_PATCH_MAX_BYTES)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgPatchFileBlock( File_t *file, int index, int off, char *data, size_t len ) {
+
+    block_t *aBlock = &file->data[index];
+    char block[SG_BLOCK_SIZE];
+    SG_Node_ID rem = aBlock->rem_id;
+    SG_Block_ID blk = aBlock->blk_id;
+    patch_t patch;
+    uint32_t zcrc;
+    int ret;
+
+    //the patch holds the fetch slot of an uncached block, so no fetch in flight caches it unpatched
+    patch.off = off;
+    patch.len = len;
+    memcpy(patch.bytes, data, len);
+    if (beginSGDataFetch(rem, blk, block, 1) != SG_FETCH_LEAD) {
+        ret = sgDriverPostBlockOp(SG_PATCH_BLOCK, &rem, &blk, (char *)&patch);
+        if (ret == 0) {
+            memcpy(block + off, data, len);
+            if (sgChecksumEnabled) {
+                aBlock->crc = sgCrc32c(0, block, SG_BLOCK_SIZE);
+            }
+            putSGDataBlock(aBlock->rem_id, aBlock->blk_id, block);
+        }
+    } else {
+        ret = sgDriverPostBlockOp(SG_PATCH_BLOCK, &rem, &blk, (char *)&patch);
+        endSGDataFetch(aBlock->rem_id, aBlock->blk_id, block, -1);
+        SG_STAT_ADD(patch_misses, 1);
+        if ((ret == 0) && sgChecksumEnabled) {
+            memset(block, 0x0, SG_BLOCK_SIZE);
+            zcrc = sgCrc32c(0, block, SG_BLOCK_SIZE);
+            for (size_t i = 0; i < len; i++) {
+                block[off + i] = patch.bytes[i] ^ data[i];
+            }
+            aBlock->crc ^= sgCrc32c(0, block, SG_BLOCK_SIZE) ^ zcrc;
+        }
+    }
+    if (ret) {
+        return( -1 );
+    }
+    SG_STAT_ADD(patches, 1);
+    SG_STAT_ADD(patch_bytes, len);
+
+    //the copies get the same patch
+    for (int i = 0; i < aBlock->replicas; i++) {
+        rem = aBlock->rep_rem[i];
+        blk = aBlock->rep_blk[i];
+        memcpy(patch.bytes, data, len);
+        if (sgDriverPostBlockOp(SG_PATCH_BLOCK, &rem, &blk, (char *)&patch)) {
+            return( -1 );
+        }
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPackFileBlock
+// Description  : Place a new logical block in a packed block, adding it to the
+//                pack of the previous block of the file when there is room
+//
+// Inputs       : file - the file being written
+//                index - the logical block index in the file
+//                data - the block contents
+//                len - the number of bytes of the block in the file
+// Outputs      : 0 if successful, -1 if failure
+
+int sgPackFileBlock( File_t *file, int index, char *data, size_t len ) {
+
+    block_t *aBlock = &file->data[index], *prev;
+    char pack[SG_BLOCK_SIZE];
+    int slot;
+
+    //try the pack holding the previous block of the file first
+    if (index > 0) {
+        prev = &file->data[index - 1];
+        if ((prev->pack_slot != SG_NOT_PACKED) && !prev->tail) {
+            if (sgDriverObtainBlock(prev->rem_id, prev->blk_id, pack, NULL)) {
+                return( -1 );
+            }
+            slot = sgPackSlots(pack);
+            if (sgPackWrite(pack, slot, data, len) == 0) {
+                if (sgDriverUpdateBlock(prev->rem_id, prev->blk_id, pack)) {
+                    return( -1 );
+                }
+                aBlock->rem_id = prev->rem_id;
+                aBlock->blk_id = prev->blk_id;
+                aBlock->pack_slot = slot;
+                return( 0 );
+            }
+        }
+    }
+
+    //start a new pack with this block in the first slot
+    memset(pack, 0x0, SG_BLOCK_SIZE);
+    if (sgPackWrite(pack, 0, data, len)) {
+        return( -1 );
+    }
+    if (sgDriverCreateBlock(pack, sgPlacementChoose(file->file_h, index), &aBlock->rem_id, &aBlock->blk_id)) {
+        return( -1 );
+    }
+    aBlock->pack_slot = 0;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSpillInline
+// Description  : Move the inline data of a small file that outgrew its metadata
+//                into the file's first block
+//
+// Inputs       : file - the file
+// Outputs      : 0 if successful, -1 if failure
+
+int sgSpillInline( File_t *file ) {
+
+    char data[SG_BLOCK_SIZE];
+
+    memset(data, 0x0, SG_BLOCK_SIZE);
+    memcpy(data, file->inline_data, file->file_size);
+    SG_STAT_ADD(inline_spills, 1);
+    if (sgAppendBuffer(file, data)) {
+        return( 0 );
+    }
+    return( sgWriteFileBlock(file, 0, data, file->file_size) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgAppendBuffer
+// Description  : Keep the contents of a new, not yet full last block of a file
+//                in its append buffer instead of creating the block.  Only
+//                SG_APPEND_MAX_BUFFERS files hold a buffer at once, others
+//                write through.
+//
+// Inputs       : file - the file being written
+//                data - the block contents (SG_BLOCK_SIZE)
+// Outputs      : 1 if the block was buffered, 0 if it must be written
+
+int sgAppendBuffer( File_t *file, char *data ) {
+
+    if (!sgAppendBuffering) {
+        return( 0 );
+    }
+    if (file->append_buf == NULL) {
+        if (__atomic_add_fetch(&sgAppendBuffers, 1, __ATOMIC_RELAXED) > SG_APPEND_MAX_BUFFERS) {
+            __atomic_sub_fetch(&sgAppendBuffers, 1, __ATOMIC_RELAXED);
+            return( 0 );
+        }
+        file->append_buf = malloc(SG_BLOCK_SIZE);
+    }
+    memcpy(file->append_buf, data, SG_BLOCK_SIZE);
+    return( 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgAppendFlush
+// Description  : Create the buffered last block of a file, if it has one
+//
+// Inputs       : file - the file
+// Outputs      : 0 if successful, -1 if failure
+
+int sgAppendFlush( File_t *file ) {
+
+    size_t blen;
+
+    if (file->append_buf == NULL) {
+        return( 0 );
+    }
+    blen = file->file_size - ((size_t)file->num_blocks * SG_BLOCK_SIZE);
+    if (sgWriteFileBlock(file, file->num_blocks, file->append_buf, blen)) {
+        return( -1 );
+    }
+    SG_STAT_ADD(append_flushes, 1);
+    sgAppendRelease(file);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgAppendRelease
+// Description  : Free the append buffer of a file once its block is created
+//
+// Inputs       : file - the file
+// Outputs      : none
+
+void sgAppendRelease( File_t *file ) {
+
+    if (file->append_buf != NULL) {
+        free(file->append_buf);
+        file->append_buf = NULL;
+        __atomic_sub_fetch(&sgAppendBuffers, 1, __ATOMIC_RELAXED);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgTailAddBlock
+// Description  : Place a new, short last block of a file in the shared pack of
+//                file tails, starting a new shared pack when it is full
+//
+// Inputs       : file - the file being written
+//                index - the logical block index in the file
+//                data - the block contents
+//                len - the number of bytes of the block in the file
+// Outputs      : 0 if successful, -1 if failure
+
+int sgTailAddBlock( File_t *file, int index, char *data, size_t len ) {
+
+    block_t *aBlock = &file->data[index];
+    char pack[SG_BLOCK_SIZE];
+    int slot;
+
+    pthread_mutex_lock(&sgDriverTailLock);
+    if (sgTailPackValid) {
+        if (sgDriverObtainBlock(sgTailPackNode, sgTailPackBlock, pack, NULL)) {
+            pthread_mutex_unlock(&sgDriverTailLock);
+            return( -1 );
+        }
+        slot = sgPackFreeSlot(pack);
+        if ((slot >= 0) && (sgPackWrite(pack, slot, data, len) == 0)) {
+            if (sgDriverUpdateBlock(sgTailPackNode, sgTailPackBlock, pack)) {
+                pthread_mutex_unlock(&sgDriverTailLock);
+                return( -1 );
+            }
+            aBlock->rem_id = sgTailPackNode;
+            aBlock->blk_id = sgTailPackBlock;
+            aBlock->pack_slot = slot;
+            aBlock->tail = 1;
+            SG_STAT_ADD(tail_blocks, 1);
+            pthread_mutex_unlock(&sgDriverTailLock);
+            return( 0 );
+        }
+    }
+
+    //the shared pack is full, start the next one with this tail
+    memset(pack, 0x0, SG_BLOCK_SIZE);
+    if (sgPackWrite(pack, 0, data, len) ||
+            sgDriverCreateBlock(pack, sgPlacementChoose(file->file_h, index), &aBlock->rem_id, &aBlock->blk_id)) {
+        pthread_mutex_unlock(&sgDriverTailLock);
+        return( -1 );
+    }
+    sgTailPackNode = aBlock->rem_id;
+    sgTailPackBlock = aBlock->blk_id;
+    sgTailPackValid = 1;
+    aBlock->pack_slot = 0;
+    aBlock->tail = 1;
+    SG_STAT_ADD(tail_packs, 1);
+    SG_STAT_ADD(tail_blocks, 1);
+    pthread_mutex_unlock(&sgDriverTailLock);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgTailUpdateBlock
+// Description  : Rewrite a file tail in its shared pack, spilling it to a
+//                block of its own once it outgrows the tail size or the pack
+//
+// Inputs       : file - the file being written
+//                index - the logical block index in the file
+//                data - the new block contents
+//                len - the number of bytes of the block in the file
+// Outputs      : 0 if successful, -1 if failure
+
+int sgTailUpdateBlock( File_t *file, int index, char *data, size_t len ) {
+
+    block_t *aBlock = &file->data[index];
+    char pack[SG_BLOCK_SIZE];
+
+    pthread_mutex_lock(&sgDriverTailLock);
+    if (sgDriverObtainBlock(aBlock->rem_id, aBlock->blk_id, pack, NULL)) {
+        pthread_mutex_unlock(&sgDriverTailLock);
+        return( -1 );
+    }
+    if ((len <= SG_TAIL_MAX_BYTES) && (sgPackWrite(pack, aBlock->pack_slot, data, len) == 0)) {
+        pthread_mutex_unlock(&sgDriverTailLock);
+        return( sgDriverUpdateBlock(aBlock->rem_id, aBlock->blk_id, pack) );
+    }
+
+    //release the slot for another tail, then give the block its own
+    sgPackFree(pack, aBlock->pack_slot);
+    if (sgDriverUpdateBlock(aBlock->rem_id, aBlock->blk_id, pack)) {
+        pthread_mutex_unlock(&sgDriverTailLock);
+        return( -1 );
+    }
+    pthread_mutex_unlock(&sgDriverTailLock);
+    logMessage( LOG_INFO_LEVEL, "sgTailUpdateBlock: spilling tail block [%d] of file [%d] from pack [%lu]", index, file->file_h, aBlock->blk_id );
+    SG_STAT_ADD(tail_spills, 1);
+    aBlock->pack_slot = SG_NOT_PACKED;
+    aBlock->tail = 0;
+    if (sgDriverCreateBlock(data, sgPlacementChoose(file->file_h, index), &aBlock->rem_id, &aBlock->blk_id)) {
+        return( -1 );
+    }
+    return( sgReplicateFileBlock(file, index, data) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgReplicateFileBlock
+// Description  : Create the extra copies of a block of its own, each on a
+//                node not holding a copy yet.  Until the placement layer
+//                knows enough nodes the service picks (the SG service always
+//                does), and a copy landing on a node that already has one is
+//                deleted and tried again.
+//
+// Inputs       : file - the file being written
+//                index - the logical block index in the file
+//                data - the block contents
+// Outputs      : 0 if successful, -1 if failure
+
+int sgReplicateFileBlock( File_t *file, int index, char *data ) {
+
+    block_t *aBlock = &file->data[index];
+    SG_Node_ID nodes[SG_MAX_REPLICAS], rem;
+    SG_Block_ID blk;
+    int copies = 1, tries = 0;
+
+    aBlock->replicas = 0;
+    nodes[0] = aBlock->rem_id;
+    for (int i = 1; i < sgReplicas; i++) {
+        rem = sgPlacementChooseReplica(file->file_h, index, nodes, copies);
+        blk = SG_BLOCK_UNKNOWN;
+        if (sgDriverPostBlockOp(SG_CREATE_BLOCK, &rem, &blk, data)) {
+            return( -1 );
+        }
+        for (int c = 0; c < copies; c++) {
+            if (nodes[c] == rem) {
+                sgDriverPostBlockOp(SG_DELETE_BLOCK, &rem, &blk, NULL);
+                rem = SG_NODE_UNKNOWN;
+                break;
+            }
+        }
+        if (rem == SG_NODE_UNKNOWN) {
+            if (++tries < SG_REPLICA_TRIES) {
+                i--;
+            } else {
+                SG_STAT_ADD(replica_misses, 1);
+                tries = 0;
+            }
+            continue;
+        }
+        tries = 0;
+        aBlock->rep_rem[aBlock->replicas] = rem;
+        aBlock->rep_blk[aBlock->replicas] = blk;
+        aBlock->replicas++;
+        nodes[copies++] = rem;
+        SG_STAT_ADD(replica_blocks, 1);
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgReplicaUpdate
+// Description  : Push an update to the extra copies of a block (the cache
+//                only holds the first copy)
+//
+// Inputs       : aBlock - the file block
+//                data - the new block contents (SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgReplicaUpdate( block_t *aBlock, char *data ) {
+
+    SG_Node_ID rem;
+    SG_Block_ID blk;
+
+    for (int i = 0; i < aBlock->replicas; i++) {
+        rem = aBlock->rep_rem[i];
+        blk = aBlock->rep_blk[i];
+        if (sgDriverPostBlockOp(SG_UPDATE_BLOCK, &rem, &blk, data)) {
+            return( -1 );
+        }
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverObtainBlock
+// Description  : Get a block from the cache, or from the SG system (placing it
+//                in the cache) if it is not cached.  Concurrent misses on the
+//                block share one fetch.
+//
+// Inputs       : rem_id - the remote node of the block
+//                blk_id - the block identifier
+//                data - the buffer to place the data (SG_BLOCK_SIZE)
+//                cached - set to 1 if the block came from the cache (or NULL)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverObtainBlock( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data, int *cached ) {
+
+    SG_Fetch_Status ret;
+
+    //try to retreive the block in the cache, or from a fetch of it in flight (read ahead of it is now urgent)
+    if (sgPrefetchBlocks > 0) {
+        sgSchedPromote(rem_id, blk_id);
+    }
+    ret = beginSGDataFetch(rem_id, blk_id, data, 1);
+    if (cached != NULL) {
+        *cached = (ret == SG_FETCH_CACHED);
+    }
+    if (ret != SG_FETCH_LEAD) {
+        return( 0 );
+    }
+
+    //if nobody has the block, obtain the block regularly from the SG system
+    return( sgDriverLeadFetch(rem_id, blk_id, NULL, data) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverLeadFetch
+// Description  : Obtain a block from the SG system for a fetch this caller
+//                leads, then cache it and hand it to the callers waiting on it
+//
+// Inputs       : rem_id - the remote node of the block
+//                blk_id - the block identifier
+//                aBlock - the file block, for its copies (or NULL)
+//                data - the buffer to place the data (SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverLeadFetch( SG_Node_ID rem_id, SG_Block_ID blk_id, block_t *aBlock, char *data ) {
+
+    int ret;
+
+    ret = sgDriverObtainCopy(rem_id, blk_id, aBlock, data);
+    endSGDataFetch(rem_id, blk_id, data, ret);
+    return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverObtainCopy
+// Description  : Obtain a block from the SG system, from whichever of its
+//                copies answers first if it has any
+//
+// Inputs       : rem_id - the remote node of the block
+//                blk_id - the block identifier
+//                aBlock - the file block, for its copies (or NULL)
+//                data - the buffer to place the data (SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverObtainCopy( SG_Node_ID rem_id, SG_Block_ID blk_id, block_t *aBlock, char *data ) {
+
+    if ((__atomic_load_n(&sgPendingCount, __ATOMIC_ACQUIRE) > 0) && (sgDriverPendingLookup(rem_id, blk_id, data) == 0)) {
+        return( 0 );
+    }
+    if ((aBlock != NULL) && (aBlock->replicas > 0)) {
+        return( sgDriverHedgedObtain(aBlock, data) );
+    }
+    return( sgDriverPostBlockOp(SG_OBTAIN_BLOCK, &rem_id, &blk_id, data) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverHedgedObtain
+// Description  : Obtain a block that has copies on other nodes.  The first
+//                copy is asked, and if it has not answered by the hedge
+//                deadline (a high percentile of recent obtain latency) the
+//                next copy is asked too, the first answer wins.  A copy that
+//                fails is followed by the next one at once.  Requests that
+//                lose the race finish on their own threads.
+//
+// Inputs       : aBlock - the file block
+//                data - the buffer to place the data (SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverHedgedObtain( block_t *aBlock, char *data ) {
+
+    hedge_t *hedge;
+    pthread_condattr_t attr;
+    pthread_attr_t tattr;
+    pthread_t tid;
+    struct timespec when;
+    uint64_t deadline;
+    int expired = 0, ret, last;
+
+    SG_STAT_ADD(hedge_reads, 1);
+    hedge = calloc(1, sizeof(hedge_t));
+    hedge->rem_id[0] = aBlock->rem_id;
+    hedge->blk_id[0] = aBlock->blk_id;
+    for (int i = 0; i < aBlock->replicas; i++) {
+        hedge->rem_id[i + 1] = aBlock->rep_rem[i];
+        hedge->blk_id[i + 1] = aBlock->rep_blk[i];
+    }
+    hedge->copies = aBlock->replicas + 1;
+    hedge->refs = 1;
+    pthread_mutex_init(&hedge->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&hedge->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_attr_init(&tattr);
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
+
+    //a service taking one post at a time cannot overlap requests, so there it only fails over
+    pthread_mutex_lock(&sgDriverPacketLock);
+    deadline = sgServiceConcurrent ? sgHedgeDeadline : 0;
+    pthread_mutex_unlock(&sgDriverPacketLock);
+
+    pthread_mutex_lock(&hedge->lock);
+    while (!hedge->done && (hedge->failed < hedge->copies)) {
+
+        //start the next copy at first, once every request so far failed, or at the deadline
+        if ((hedge->issued < hedge->copies) &&
+                ((hedge->issued == 0) || (hedge->failed == hedge->issued) || expired)) {
+            if (hedge->issued > 0) {
+                SG_STAT_ADD(hedges, (hedge->failed < hedge->issued) ? 1 : 0);
+                SG_STAT_ADD(failovers, (hedge->failed == hedge->issued) ? 1 : 0);
+            }
+            hedge->issued++;
+            hedge->refs++;
+            pthread_mutex_lock(&sgDriverHedgeLock);
+            sgHedgeThreads++;
+            pthread_mutex_unlock(&sgDriverHedgeLock);
+            if (pthread_create(&tid, &tattr, sgDriverHedgeThread, hedge)) {
+                pthread_mutex_unlock(&hedge->lock);
+                sgDriverHedgeThread(hedge);
+                pthread_mutex_lock(&hedge->lock);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &when);
+            when.tv_sec += (when.tv_nsec + deadline) / 1000000000;
+            when.tv_nsec = (when.tv_nsec + deadline) % 1000000000;
+            expired = 0;
+            continue;
+        }
+
+        //wait for an answer, or the deadline if there is a copy left to ask
+        if ((hedge->issued < hedge->copies) && (deadline > 0)) {
+            expired = (pthread_cond_timedwait(&hedge->cond, &hedge->lock, &when) == ETIMEDOUT);
+        } else {
+            pthread_cond_wait(&hedge->cond, &hedge->lock);
+        }
+    }
+
+    //take the answer, the last one out frees the hedge
+    ret = hedge->done ? 0 : -1;
+    if (hedge->done) {
+        memcpy(data, hedge->data, SG_BLOCK_SIZE);
+        SG_STAT_ADD(hedge_wins, (hedge->winner > 0) ? 1 : 0);
+    }
+    last = (--hedge->refs == 0);
+    pthread_mutex_unlock(&hedge->lock);
+    pthread_attr_destroy(&tattr);
+    if (last) {
+        pthread_mutex_destroy(&hedge->lock);
+        pthread_cond_destroy(&hedge->cond);
+        free(hedge);
+    }
+    if (ret) {
+        logMessage( LOG_ERROR_LEVEL, "sgDriverHedgedObtain: no copy of block [%lu] could be obtained", aBlock->blk_id );
+    }
+    return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverHedgeThread
+// Description  : Obtain the next copy of a hedged read, handing the block to
+//                the reader if it is the first answer
+//
+// Inputs       : arg - the hedged read (hedge_t)
+// Outputs      : NULL
+
+void *sgDriverHedgeThread( void *arg ) {
+
+    hedge_t *hedge = arg;
+    char block[SG_BLOCK_SIZE];
+    SG_Node_ID rem;
+    SG_Block_ID blk;
+    int copy, ret, last;
+
+    pthread_mutex_lock(&hedge->lock);
+    copy = hedge->next++;
+    rem = hedge->rem_id[copy];
+    blk = hedge->blk_id[copy];
+    pthread_mutex_unlock(&hedge->lock);
+
+    ret = sgDriverPostBlockOp(SG_OBTAIN_BLOCK, &rem, &blk, block);
+
+    pthread_mutex_lock(&hedge->lock);
+    if (ret) {
+        hedge->failed++;
+    } else if (!hedge->done) {
+        memcpy(hedge->data, block, SG_BLOCK_SIZE);
+        hedge->done = 1;
+        hedge->winner = copy;
+    }
+    pthread_cond_signal(&hedge->cond);
+    last = (--hedge->refs == 0);
+    pthread_mutex_unlock(&hedge->lock);
+    if (last) {
+        pthread_mutex_destroy(&hedge->lock);
+        pthread_cond_destroy(&hedge->cond);
+        free(hedge);
+    }
+
+    pthread_mutex_lock(&sgDriverHedgeLock);
+    sgHedgeThreads--;
+    pthread_cond_broadcast(&sgDriverHedgeCond);
+    pthread_mutex_unlock(&sgDriverHedgeLock);
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverHedgeRecord
+// Description  : Sample the latency of an obtain, recomputing the hedge
+//                deadline every so often (packet lock held)
+//
+// Inputs       : nsec - the latency of the obtain
+// Outputs      : none
+
+void sgDriverHedgeRecord( uint64_t nsec ) {
+
+    uint64_t sorted[SG_HEDGE_SAMPLES], key;
+    int num, j;
+
+    sgHedgeSamples[sgHedgeCount++ % SG_HEDGE_SAMPLES] = nsec;
+    if ((sgHedgeCount % SG_HEDGE_INTERVAL) != 0) {
+        return;
+    }
+
+    //the deadline is the percentile of the samples we have (insertion sorted, few of them)
+    num = (sgHedgeCount < SG_HEDGE_SAMPLES) ? (int)sgHedgeCount : SG_HEDGE_SAMPLES;
+    for (int i = 0; i < num; i++) {
+        key = sgHedgeSamples[i];
+        for (j = i; (j > 0) && (sorted[j - 1] > key); j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = key;
+    }
+    sgHedgeDeadline = sorted[(num * SG_HEDGE_PERCENTILE) / 100];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFetchBlock
+// Description  : Obtain a block from the SG system and place it in the cache
+//
+// Inputs       : rem_id - the remote node of the block
+//                blk_id - the block identifier
+//                data - the buffer to place the data (SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverFetchBlock( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data ) {
+
+    if (((__atomic_load_n(&sgPendingCount, __ATOMIC_ACQUIRE) == 0) || sgDriverPendingLookup(rem_id, blk_id, data)) &&
+            sgDriverPostBlockOp(SG_OBTAIN_BLOCK, &rem_id, &blk_id, data)) {
+        return( -1 );
+    }
+
+    //place the block in cache since we did not find it earlier
+    putSGDataBlock(rem_id, blk_id, data);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverObtainBlocks
+// Description  : Get several blocks, from the cache where possible.  When the
+//                service takes concurrent requests the missing blocks are
+//                grouped by node and each group is fetched by its own thread.
+//                A node's blocks go in compound packets if the service takes
+//                them, one round trip for up to SG_COMPOUND_MAX_OPS blocks.
+//                Blocks another caller is already fetching are waited for
+//                after our own fetches, so that two callers never wait on
+//                each other.
+//
+// Inputs       : fetches - the blocks to get (data and cached are filled in)
+//                num - the number of blocks
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverObtainBlocks( fetch_t *fetches, int num ) {
+
+    SG_Node_ID nodes[SG_MAX_FANOUT_BLOCKS];
+    int order[SG_MAX_FANOUT_BLOCKS];
+    pthread_t threads[SG_MAX_FANOUT];
+    fanout_t work[SG_MAX_FANOUT];
+    SG_Fetch_Status ret;
+    int misses = 0, num_nodes = 0, num_threads, n, status = 0;
+
+    //look each block up in the cache, collecting the nodes of the misses we lead
+    for (int i = 0; i < num; i++) {
+        fetches[i].status = 0;
+        ret = beginSGDataFetch(fetches[i].rem_id, fetches[i].blk_id, fetches[i].data, 0);
+        fetches[i].cached = (ret == SG_FETCH_CACHED);
+        fetches[i].lead = (ret == SG_FETCH_LEAD);
+        if (!fetches[i].lead) {
+            continue;
+        }
+        misses++;
+        for (n = 0; (n < num_nodes) && (nodes[n] != fetches[i].rem_id); n++);
+        if (n == num_nodes) {
+            nodes[num_nodes++] = fetches[i].rem_id;
+        }
+    }
+
+    if (misses == 0) {
+        return( sgDriverJoinFetches(fetches, num) );
+    }
+
+    //a single node (or a service that takes one post at a time) is fetched in order, node by node
+    //in ascending block IDs
+    sgDriverSortFetches(fetches, num, order);
+    if (!sgServiceConcurrent || (num_nodes == 1)) {
+        for (n = 0; n < num_nodes; n++) {
+            sgDriverFetchNode(fetches, order, num, nodes[n]);
+        }
+        num_threads = 0;
+    } else {
+        //otherwise fan out, each thread fetching the blocks of every num_threads'th node
+        num_threads = (num_nodes < SG_MAX_FANOUT) ? num_nodes : SG_MAX_FANOUT;
+        SG_STAT_ADD(fanout_rounds, 1);
+        SG_STAT_ADD(fanout_blocks, misses);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        work[t].fetches = fetches;
+        work[t].num_fetches = num;
+        work[t].nodes = nodes;
+        work[t].num_nodes = num_nodes;
+        work[t].order = order;
+        work[t].thread = t;
+        work[t].num_threads = num_threads;
+        if (pthread_create(&threads[t], NULL, sgDriverFanoutThread, &work[t])) {
+            sgDriverFanoutThread(&work[t]);
+            threads[t] = 0;
+        }
+    }
+    for (int t = 0; t < num_threads; t++) {
+        if (threads[t] != 0) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+
+    //place the fetched blocks in the cache, releasing everyone waiting on them
+    for (int i = 0; i < num; i++) {
+        if (fetches[i].lead) {
+            endSGDataFetch(fetches[i].rem_id, fetches[i].blk_id, fetches[i].data, fetches[i].status);
+            status |= fetches[i].status;
+        }
+    }
+    return( status ? -1 : sgDriverJoinFetches(fetches, num) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverJoinFetches
+// Description  : Wait for the blocks other callers were fetching, fetching any
+//                whose fetch failed ourselves
+//
+// Inputs       : fetches - the blocks to get
+//                num - the number of blocks
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverJoinFetches( fetch_t *fetches, int num ) {
+
+    SG_Fetch_Status ret;
+
+    for (int i = 0; i < num; i++) {
+        if (fetches[i].cached || fetches[i].lead) {
+            continue;
+        }
+        if (sgPrefetchBlocks > 0) {
+            sgSchedPromote(fetches[i].rem_id, fetches[i].blk_id);
+        }
+        ret = beginSGDataFetch(fetches[i].rem_id, fetches[i].blk_id, fetches[i].data, 1);
+        fetches[i].cached = (ret == SG_FETCH_CACHED);
+        if ((ret == SG_FETCH_LEAD) &&
+                sgDriverLeadFetch(fetches[i].rem_id, fetches[i].blk_id, fetches[i].block, fetches[i].data)) {
+            return( -1 );
+        }
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFanoutThread
+// Description  : Fetch the missing blocks of the nodes assigned to a thread,
+//                each node's in ascending block IDs
+//
+// Inputs       : arg - the thread's work (fanout_t)
+// Outputs      : NULL
+
+void *sgDriverFanoutThread( void *arg ) {
+
+    fanout_t *work = arg;
+
+    for (int n = work->thread; n < work->num_nodes; n += work->num_threads) {
+        sgDriverFetchNode(work->fetches, work->order, work->num_fetches, work->nodes[n]);
+    }
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFetchNode
+// Description  : Fetch the missing blocks of a node we lead in ascending
+//                block IDs, up to SG_COMPOUND_MAX_OPS of them to a compound
+//                packet if the service takes them.  Blocks with copies are
+//                obtained (hedged) one at a time.
+//
+// Inputs       : fetches - the blocks to get (status is filled in)
+//                order - the fetch indexes in order (sgDriverSortFetches)
+//                num - the number of blocks
+//                node - the node
+// Outputs      : 0 if successful, -1 if any fetch failed
+
+int sgDriverFetchNode( fetch_t *fetches, int *order, int num, SG_Node_ID node ) {
+
+    fetch_t *batch[SG_COMPOUND_MAX_OPS], *fetch;
+    int count = 0, status = 0;
+
+    for (int i = 0; i < num; i++) {
+        fetch = &fetches[order[i]];
+        if (!fetch->lead || (fetch->rem_id != node)) {
+            continue;
+        }
+        if ((__atomic_load_n(&sgPendingCount, __ATOMIC_ACQUIRE) > 0) &&
+                (sgDriverPendingLookup(fetch->rem_id, fetch->blk_id, fetch->data) == 0)) {
+            fetch->status = 0;
+        } else if (!(sgServiceFeatures & SG_FEATURE_COMPOUND) || ((fetch->block != NULL) && (fetch->block->replicas > 0))) {
+            fetch->status = sgDriverObtainCopy(fetch->rem_id, fetch->blk_id, fetch->block, fetch->data);
+        } else {
+            batch[count++] = fetch;
+            if (count == SG_COMPOUND_MAX_OPS) {
+                status |= sgDriverFetchCompound(node, batch, count);
+                count = 0;
+            }
+        }
+        status |= fetch->status;
+    }
+    if (count > 0) {
+        status |= sgDriverFetchCompound(node, batch, count);
+    }
+    return( status ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFetchCompound
+// Description  : Obtain blocks of a node in one compound packet (a single
+//                block is obtained on its own)
+//
+// Inputs       : node - the node
+//                batch - the fetches (status is filled in)
+//                num - the number of fetches
+// Outputs      : 0 if successful, -1 if any fetch failed
+
+int sgDriverFetchCompound( SG_Node_ID node, fetch_t **batch, int num ) {
+
+    compound_t *cmp;
+    SG_Node_ID rem = node;
+    SG_Block_ID blk = batch[0]->blk_id;
+    int ret, status = 0;
+
+    if (num == 1) {
+        return( batch[0]->status = sgDriverPostBlockOp(SG_OBTAIN_BLOCK, &rem, &blk, batch[0]->data) );
+    }
+    if ((cmp = malloc(sizeof(compound_t))) == NULL) {
+        logMessage( LOG_ERROR_LEVEL, "sgDriverFetchCompound: out of memory" );
+        for (int i = 0; i < num; i++) {
+            batch[i]->status = -1;
+        }
+        return( -1 );
+    }
+    cmp->num = num;
+    for (int i = 0; i < num; i++) {
+        cmp->ops[i].blk_id = batch[i]->blk_id;
+        cmp->ops[i].op = SG_OBTAIN_BLOCK;
+        cmp->ops[i].data = batch[i]->data;
+    }
+    ret = sgDriverScheduleBlockOp(SG_SCHED_READ, SG_SCHED_NO_TENANT, SG_COMPOUND_OPS, &rem, &blk, (char *)cmp);
+    if (ret == 0) {
+        SG_STAT_ADD(compounds, 1);
+        SG_STAT_ADD(compound_ops, num);
+    }
+    for (int i = 0; i < num; i++) {
+        batch[i]->status = ret ? -1 : cmp->ops[i].status;
+        status |= batch[i]->status;
+    }
+    free(cmp);
+    return( status ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPrefetchFileBlocks
+// Description  : Queue the blocks following a sequential read to be read
+//                ahead, up to sgPrefetchBlocks past it (file lock held)
+//
+// Inputs       : file - the file read
+//                first - the first logical block of the read
+//                count - the number of blocks read
+// Outputs      : none
+
+void sgPrefetchFileBlocks( File_t *file, int first, int count ) {
+
+    SG_Node_ID rem = SG_NODE_UNKNOWN;
+    SG_Block_ID blk = SG_BLOCK_UNKNOWN;
+    block_t *aBlock;
+    prefetch_t *job;
+    int start = first + count, end = first + count + sgPrefetchBlocks;
+
+    if (end > file->num_blocks) {
+        end = file->num_blocks;
+    }
+    if (start < file->prefetched) {
+        start = file->prefetched;
+    }
+    if (start >= end) {
+        return;
+    }
+
+    pthread_mutex_lock(&sgDriverPrefetchLock);
+    for (int i = start; i < end; i++) {
+        //blocks packed together are read ahead once
+        aBlock = &file->data[i];
+        if ((aBlock->rem_id == rem) && (aBlock->blk_id == blk)) {
+            continue;
+        }
+        rem = aBlock->rem_id;
+        blk = aBlock->blk_id;
+        if (sgPrefetchCount == SG_PREFETCH_MAX_QUEUED) {
+            SG_STAT_ADD(prefetch_dropped, 1);
+            continue;
+        }
+        job = &sgPrefetchQueue[(sgPrefetchHead + sgPrefetchCount) % SG_PREFETCH_MAX_QUEUED];
+        job->file_h = file->file_h;
+        job->rem_id = rem;
+        job->blk_id = blk;
+        sgPrefetchCount++;
+        SG_STAT_ADD(prefetch_queued, 1);
+    }
+    file->prefetched = end;
+    pthread_cond_broadcast(&sgDriverPrefetchCond);
+    pthread_mutex_unlock(&sgDriverPrefetchLock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPrefetchCancel
+// Description  : Drop the read ahead of a file, both the blocks still queued
+//                and the obtains waiting for the scheduler (file lock held)
+//
+// Inputs       : file - the file
+// Outputs      : none
+
+void sgPrefetchCancel( File_t *file ) {
+
+    prefetch_t job;
+    int n = 0;
+
+    pthread_mutex_lock(&sgDriverPrefetchLock);
+    for (int i = 0; i < sgPrefetchCount; i++) {
+        job = sgPrefetchQueue[(sgPrefetchHead + i) % SG_PREFETCH_MAX_QUEUED];
+        if (job.file_h == file->file_h) {
+            SG_STAT_ADD(prefetch_cancelled, 1);
+            continue;
+        }
+        sgPrefetchQueue[(sgPrefetchHead + n) % SG_PREFETCH_MAX_QUEUED] = job;
+        n++;
+    }
+    sgPrefetchCount = n;
+    pthread_mutex_unlock(&sgDriverPrefetchLock);
+    sgSchedCancel(file->file_h);
+    file->prefetched = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverPrefetchThread
+// Description  : Obtain the blocks queued to be read ahead into the cache,
+//                scheduled below the reads and writes callers wait for
+//
+// Inputs       : arg - unused
+// Outputs      : NULL
+
+void *sgDriverPrefetchThread( void *arg ) {
+
+    char block[SG_BLOCK_SIZE];
+    prefetch_t job;
+    SG_Node_ID rem;
+    SG_Block_ID blk;
+    int ret;
+
+    pthread_mutex_lock(&sgDriverPrefetchLock);
+    while (1) {
+        while ((sgPrefetchCount == 0) && !sgPrefetchStop) {
+            pthread_cond_wait(&sgDriverPrefetchCond, &sgDriverPrefetchLock);
+        }
+        if (sgPrefetchStop) {
+            break;
+        }
+        job = sgPrefetchQueue[sgPrefetchHead];
+        sgPrefetchHead = (sgPrefetchHead + 1) % SG_PREFETCH_MAX_QUEUED;
+        sgPrefetchCount--;
+        pthread_mutex_unlock(&sgDriverPrefetchLock);
+
+        //a block in the cache or already being fetched needs no read ahead
+        sgSchedThrottle(job.file_h, 1);
+        if (beginSGDataFetch(job.rem_id, job.blk_id, block, 0) == SG_FETCH_LEAD) {
+            rem = job.rem_id;
+            blk = job.blk_id;
+            ret = ((__atomic_load_n(&sgPendingCount, __ATOMIC_ACQUIRE) > 0) &&
+                    (sgDriverPendingLookup(rem, blk, block) == 0)) ? 0 :
+                    sgDriverScheduleBlockOp(SG_SCHED_PREFETCH, job.file_h, SG_OBTAIN_BLOCK, &rem, &blk, block);
+            endSGDataFetch(job.rem_id, job.blk_id, block, ret);
+            if (ret == 0) {
+                SG_STAT_ADD(prefetch_obtained, 1);
+            }
+        }
+        pthread_mutex_lock(&sgDriverPrefetchLock);
+    }
+    pthread_mutex_unlock(&sgDriverPrefetchLock);
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverCreateBlock
+// Description  : Create a new block in the SG system and cache it
+//
+// Inputs       : data - the block contents (SG_BLOCK_SIZE)
+//                target - the node to create the block on (or SG_NODE_UNKNOWN)
+//                rem_id - the remote node of the new block (returned)
+//                blk_id - the identifier of the new block (returned)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverCreateBlock( char *data, SG_Node_ID target, SG_Node_ID *rem_id, SG_Block_ID *blk_id ) {
+
+    *rem_id = target;
+    *blk_id = SG_BLOCK_UNKNOWN;
+    if (sgDriverPostBlockOp(SG_CREATE_BLOCK, rem_id, blk_id, data)) {
+        return( -1 );
+    }
+    putSGDataBlock(*rem_id, *blk_id, data);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverDeferCreate
+// Description  : Hold the create of a new block back until the write ends.
+//                The block has its node but no block ID until then (file
+//                lock held).
+//
+// Inputs       : file - the file being written
+//                index - the logical block index in the file
+//                data - the block contents (SG_BLOCK_SIZE)
+//                target - the node placement chose for the block
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverDeferCreate( File_t *file, int index, char *data, SG_Node_ID target ) {
+
+    pcreate_t *crt;
+
+    if ((crt = malloc(sizeof(pcreate_t))) == NULL) {
+        logMessage( LOG_ERROR_LEVEL, "sgDriverDeferCreate: out of memory" );
+        return( -1 );
+    }
+    crt->index = index;
+    crt->target = target;
+    memcpy(crt->data, data, SG_BLOCK_SIZE);
+    crt->next = sgWriteCreates;
+    sgWriteCreates = crt;
+    file->data[index].rem_id = target;
+    file->data[index].blk_id = SG_BLOCK_UNKNOWN;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFlushCreates
+// Description  : Create the blocks held back by this thread's write, up to
+//                SG_COMPOUND_MAX_OPS of a node in a compound packet.  A block
+//                the packet did not create is created on its own; if that
+//                fails too the file ends before it (file lock held).
+//
+// Inputs       : file - the file written
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverFlushCreates( File_t *file ) {
+
+    pcreate_t **prev, *crt, *batch[SG_COMPOUND_MAX_OPS];
+    compound_t *cmp = NULL;
+    block_t *aBlock;
+    SG_Node_ID rem;
+    SG_Block_ID blk;
+    int num, ret, created, first = file->num_blocks;
+
+    if ((sgWriteCreates != NULL) && (sgWriteCreates->next != NULL) && ((cmp = malloc(sizeof(compound_t))) == NULL)) {
+        logMessage( LOG_ERROR_LEVEL, "sgDriverFlushCreates: out of memory, creating blocks one at a time" );
+    }
+    while (sgWriteCreates != NULL) {
+        //take the creates of the node of the first one
+        rem = sgWriteCreates->target;
+        num = 0;
+        for (prev = &sgWriteCreates; (*prev != NULL) && (num < SG_COMPOUND_MAX_OPS); ) {
+            crt = *prev;
+            if (crt->target == rem) {
+                *prev = crt->next;
+                batch[num++] = crt;
+            } else {
+                prev = &crt->next;
+            }
+        }
+
+        ret = -1;
+        if ((num > 1) && (cmp != NULL)) {
+            for (int i = 0; i < num; i++) {
+                cmp->ops[i].blk_id = SG_BLOCK_UNKNOWN;
+                cmp->ops[i].op = SG_CREATE_BLOCK;
+                cmp->ops[i].data = batch[i]->data;
+            }
+            cmp->num = num;
+            blk = SG_BLOCK_UNKNOWN;
+            ret = sgDriverScheduleBlockOp(SG_SCHED_WRITE, SG_SCHED_NO_TENANT, SG_COMPOUND_OPS, &rem, &blk, (char *)cmp);
+            if (ret == 0) {
+                SG_STAT_ADD(compounds, 1);
+                SG_STAT_ADD(compound_ops, num);
+            }
+        }
+        created = 0;
+        for (int i = 0; i < num; i++) {
+            aBlock = &file->data[batch[i]->index];
+            if ((ret == 0) && (cmp->ops[i].status == 0)) {
+                aBlock->rem_id = rem;
+                aBlock->blk_id = cmp->ops[i].blk_id;
+                putSGDataBlock(aBlock->rem_id, aBlock->blk_id, batch[i]->data);
+                created++;
+            } else if (sgDriverCreateBlock(batch[i]->data, batch[i]->target, &aBlock->rem_id, &aBlock->blk_id)) {
+                aBlock->blk_id = SG_BLOCK_UNKNOWN;
+                if (batch[i]->index < first) {
+                    first = batch[i]->index;
+                }
+            }
+            free(batch[i]);
+        }
+        if (created > 0) {
+            sgPlacementAddBlocks(rem, created);
+        }
+    }
+    free(cmp);
+
+    //the file ends before a block that could not be created (the append buffer followed the last block)
+    if (first < file->num_blocks) {
+        logMessage( LOG_ERROR_LEVEL, "sgDriverFlushCreates: unable to create block [%d] of file [%d]", first, file->file_h );
+        file->num_blocks = first;
+        sgAppendRelease(file);
+        if (file->file_size > ((size_t)first << SG_BLOCK_SHIFT)) {
+            file->file_size = (size_t)first << SG_BLOCK_SHIFT;
+        }
+        return( -1 );
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverUpdateBlock
+// Description  : Push an update through the cache and the SG system (held
+//                back to be merged if sgPendingUpdates is set, or until the
+//                end of a write over several blocks)
+//
+// Inputs       : rem_id - the remote node of the block
+//                blk_id - the block identifier
+//                data - the new block contents (SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverUpdateBlock( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data ) {
+
+    putSGDataBlock(rem_id, blk_id, data);
+    if ((sgPendingUpdates > 0) || sgWriteBatch) {
+        return( sgDriverDeferUpdate(rem_id, blk_id, data) );
+    }
+    return( sgDriverPostBlockOp(SG_UPDATE_BLOCK, &rem_id, &blk_id, data) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverDeferUpdate
+// Description  : Hold an update back in its node's pending list, replacing
+//                an update of the same block still waiting there.  Once
+//                sgPendingUpdates updates are waiting they are all posted.
+//
+// Inputs       : rem_id - the remote node of the block
+//                blk_id - the block identifier
+//                data - the new block contents (SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverDeferUpdate( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data ) {
+
+    pnode_t **pnode, *pn;
+    pending_t **prev, *upd;
+    int flush;
+
+    pthread_mutex_lock(&sgDriverPendingLock);
+    for (pnode = &sgPendingNodes; (*pnode != NULL) && ((*pnode)->node_id < rem_id); pnode = &(*pnode)->next);
+    if ((*pnode == NULL) || ((*pnode)->node_id != rem_id)) {
+        pn = calloc(1, sizeof(pnode_t));
+        pn->node_id = rem_id;
+        pn->next = *pnode;
+        *pnode = pn;
+    }
+    pn = *pnode;
+
+    //a newer update of a block supersedes the one waiting
+    for (prev = &pn->updates; (*prev != NULL) && ((*prev)->blk_id < blk_id); prev = &(*prev)->next);
+    if ((*prev != NULL) && ((*prev)->blk_id == blk_id)) {
+        upd = *prev;
+        upd->gen++;
+        SG_STAT_ADD(updates_merged, 1);
+    } else {
+        upd = malloc(sizeof(pending_t));
+        upd->blk_id = blk_id;
+        upd->gen = 0;
+        upd->next = *prev;
+        *prev = upd;
+        pn->count++;
+        __atomic_add_fetch(&sgPendingCount, 1, __ATOMIC_RELEASE);
+    }
+    memcpy(upd->data, data, SG_BLOCK_SIZE);
+    SG_STAT_ADD(updates_deferred, 1);
+    flush = (sgPendingUpdates > 0) && (sgPendingCount >= sgPendingUpdates);
+    pthread_mutex_unlock(&sgDriverPendingLock);
+
+    return( flush ? sgDriverFlushUpdates() : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFlushUpdates
+// Description  : Post the held back updates in bursts, one per node.  When
+//                the service takes concurrent posts the bursts of up to
+//                SG_MAX_FANOUT nodes are posted in parallel.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure (failed updates stay held back)
+
+int sgDriverFlushUpdates( void ) {
+
+    pthread_t threads[SG_MAX_FANOUT];
+    pnode_t *nodes[SG_MAX_FANOUT], *pn = NULL;
+    int width = sgServiceConcurrent ? SG_MAX_FANOUT : 1;
+    int num, status = 0;
+
+    pthread_mutex_lock(&sgDriverFlushLock);
+    do {
+        //take the next nodes with updates waiting (nodes are only freed at shutdown)
+        pthread_mutex_lock(&sgDriverPendingLock);
+        pn = (pn == NULL) ? sgPendingNodes : pn->next;
+        for (num = 0; pn != NULL; pn = pn->next) {
+            if (pn->count > 0) {
+                nodes[num++] = pn;
+            }
+            if (num == width) {
+                break;
+            }
+        }
+        pthread_mutex_unlock(&sgDriverPendingLock);
+
+        for (int t = 0; t < num; t++) {
+            if ((num == 1) || pthread_create(&threads[t], NULL, sgDriverFlushThread, nodes[t])) {
+                status |= sgDriverFlushNode(nodes[t]);
+                threads[t] = 0;
+            }
+        }
+        for (int t = 0; t < num; t++) {
+            if (threads[t] != 0) {
+                pthread_join(threads[t], NULL);
+                status |= nodes[t]->status;
+            }
+        }
+    } while (pn != NULL);
+    pthread_mutex_unlock(&sgDriverFlushLock);
+    return( status ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFlushThread
+// Description  : Post the held back updates of one node on a thread of its own
+//
+// Inputs       : arg - the node (pnode_t)
+// Outputs      : NULL
+
+void *sgDriverFlushThread( void *arg ) {
+
+    pnode_t *pn = arg;
+
+    pn->status = sgDriverFlushNode(pn);
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFlushNode
+// Description  : Post the held back updates of a node in ascending block IDs,
+//                up to SG_COMPOUND_MAX_OPS of them to a compound packet if the
+//                service takes them.  An update stays visible to readers
+//                until it is posted, one replaced while it was posted waits
+//                for the next flush.
+//
+// Inputs       : pn - the node
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverFlushNode( pnode_t *pn ) {
+
+    pending_t **prev, *upd, *batch[SG_COMPOUND_MAX_OPS];
+    unsigned long gens[SG_COMPOUND_MAX_OPS];
+    int results[SG_COMPOUND_MAX_OPS];
+    compound_t *cmp = NULL;
+    char *data;
+    SG_Node_ID rem;
+    SG_Block_ID blk, last;
+    int width = (sgServiceFeatures & SG_FEATURE_COMPOUND) ? SG_COMPOUND_MAX_OPS : 1;
+    int num, ret, status = 0;
+
+    data = malloc((size_t)width * SG_BLOCK_SIZE);
+    if ((width > 1) && (data != NULL) && ((cmp = malloc(sizeof(compound_t))) == NULL)) {
+        free(data);
+        data = NULL;
+    }
+    if (data == NULL) {
+        logMessage( LOG_ERROR_LEVEL, "sgDriverFlushNode: out of memory" );
+        return( -1 );
+    }
+
+    SG_STAT_ADD(update_bursts, 1);
+    pthread_mutex_lock(&sgDriverPendingLock);
+    upd = pn->updates;
+    while (upd != NULL) {
+        for (num = 0; (upd != NULL) && (num < width); upd = upd->next, num++) {
+            batch[num] = upd;
+            gens[num] = upd->gen;
+            memcpy(data + num * SG_BLOCK_SIZE, upd->data, SG_BLOCK_SIZE);
+            if (cmp != NULL) {
+                cmp->ops[num].blk_id = upd->blk_id;
+                cmp->ops[num].op = SG_UPDATE_BLOCK;
+                cmp->ops[num].data = data + num * SG_BLOCK_SIZE;
+            }
+        }
+        rem = pn->node_id;
+        blk = batch[0]->blk_id;
+        last = batch[num - 1]->blk_id;
+        pthread_mutex_unlock(&sgDriverPendingLock);
+        if (num == 1) {
+            results[0] = sgDriverPostBlockOp(SG_UPDATE_BLOCK, &rem, &blk, data);
+        } else {
+            cmp->num = num;
+            ret = sgDriverScheduleBlockOp(SG_SCHED_WRITE, SG_SCHED_NO_TENANT, SG_COMPOUND_OPS, &rem, &blk, (char *)cmp);
+            if (ret == 0) {
+                SG_STAT_ADD(compounds, 1);
+                SG_STAT_ADD(compound_ops, num);
+            }
+            for (int i = 0; i < num; i++) {
+                results[i] = ret ? -1 : cmp->ops[i].status;
+            }
+        }
+        pthread_mutex_lock(&sgDriverPendingLock);
+
+        //updates are only removed under the flush lock, so the entries are still in the list
+        for (int i = 0; i < num; i++) {
+            if (results[i]) {
+                status = -1;
+                continue;
+            }
+            SG_STAT_ADD(update_posts, 1);
+            if (batch[i]->gen == gens[i]) {
+                for (prev = &pn->updates; *prev != batch[i]; prev = &(*prev)->next);
+                *prev = batch[i]->next;
+                free(batch[i]);
+                pn->count--;
+                __atomic_sub_fetch(&sgPendingCount, 1, __ATOMIC_RELEASE);
+            }
+        }
+
+        //updates added while posting may sit before the cursor, they are picked up next time
+        for (upd = pn->updates; (upd != NULL) && (upd->blk_id <= last); upd = upd->next);
+    }
+    pthread_mutex_unlock(&sgDriverPendingLock);
+    free(cmp);
+    free(data);
+    return( status );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverPendingLookup
+// Description  : Get the contents of a block from an update held back for it
+//
+// Inputs       : rem_id - the remote node of the block
+//                blk_id - the block identifier
+//                data - the buffer to place the data (SG_BLOCK_SIZE)
+// Outputs      : 0 if an update was held back, -1 if not
+
+int sgDriverPendingLookup( SG_Node_ID rem_id, SG_Block_ID blk_id, char *data ) {
+
+    pnode_t *pn;
+    pending_t *upd = NULL;
+
+    pthread_mutex_lock(&sgDriverPendingLock);
+    for (pn = sgPendingNodes; (pn != NULL) && (pn->node_id != rem_id); pn = pn->next);
+    if (pn != NULL) {
+        for (upd = pn->updates; (upd != NULL) && (upd->blk_id != blk_id); upd = upd->next);
+    }
+    if (upd != NULL) {
+        memcpy(data, upd->data, SG_BLOCK_SIZE);
+    }
+    pthread_mutex_unlock(&sgDriverPendingLock);
+    return( (upd != NULL) ? 0 : -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverSortFetches
+// Description  : Order fetches by node, then block ID, so each node is sent
+//                its requests in one run of ascending blocks
+//
+// Inputs       : fetches - the blocks to get
+//                num - the number of blocks
+//                order - the fetch indexes in order (returned)
+// Outputs      : none
+
+void sgDriverSortFetches( fetch_t *fetches, int num, int *order ) {
+
+    fetch_t *a, *b;
+    int j;
+
+    for (int i = 0; i < num; i++) {
+        a = &fetches[i];
+        for (j = i; j > 0; j--) {
+            b = &fetches[order[j - 1]];
+            if ((b->rem_id < a->rem_id) || ((b->rem_id == a->rem_id) && (b->blk_id <= a->blk_id))) {
+                break;
+            }
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverPostBlockOp
+// Description  : Send a block operation a caller is waiting for to the SG
+//                system, scheduled as a read, a write or (deletes) background
+//                work
+//
+// Inputs       : op - the block operation
+//                rem_id - the remote node (updated from the reply)
+//                blk_id - the block identifier (updated from the reply)
+//                data - the block data sent (create/update) or received (obtain)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverPostBlockOp( SG_System_OP op, SG_Node_ID *rem_id, SG_Block_ID *blk_id, char *data ) {
+
+    SG_Sched_Class cls = (op == SG_OBTAIN_BLOCK) ? SG_SCHED_READ :
+            (op == SG_DELETE_BLOCK) ? SG_SCHED_BACKGROUND : SG_SCHED_WRITE;
+
+    return( sgDriverScheduleBlockOp(cls, SG_SCHED_NO_TENANT, op, rem_id, blk_id, data) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverScheduleBlockOp
+// Description  : Send a block operation to the SG system once the scheduler
+//                gives it a dispatch slot.  A service that takes one post at
+//                a time gets them one at a time, so that it sees the sequence
+//                numbers in order.
+//
+// Inputs       : cls - the traffic class of the operation
+//                tenant - the file the operation is for (SG_SCHED_NO_TENANT if none)
+//                op - the block operation
+//                rem_id - the remote node (updated from the reply)
+//                blk_id - the block identifier (updated from the reply)
+//                data - the block data sent (create/update) or received (obtain)
+// Outputs      : 0 if successful, -1 if failure (or cancelled)
+
+int sgDriverScheduleBlockOp( SG_Sched_Class cls, int tenant, SG_System_OP op, SG_Node_ID *rem_id,
+        SG_Block_ID *blk_id, char *data ) {
+
+    int ret;
+
+    if (sgSchedBegin(cls, tenant, *rem_id, *blk_id)) {
+        return( -1 );
+    }
+    if (sgServiceConcurrent) {
+        ret = sgDriverExchangeBlockOp(op, rem_id, blk_id, data);
+    } else {
+        pthread_mutex_lock(&sgDriverServiceLock);
+        ret = sgDriverExchangeBlockOp(op, rem_id, blk_id, data);
+        pthread_mutex_unlock(&sgDriverServiceLock);
+    }
+    sgSchedEnd(cls);
+    return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverExchangeBlockOp
+// Description  : Build the packet for a block operation, send it to the SG
+//                system and unpack the reply
+//
+// Inputs       : op - the block operation
+//                rem_id - the remote node (updated from the reply)
+//                blk_id - the block identifier (updated from the reply)
+//                data - block data to send (create/update) or receive (obtain),
+//                       the patch_t of a patch (the old bytes are returned) or
+//                       the compound_t of a compound packet (its results are returned)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgDriverExchangeBlockOp( SG_System_OP op, SG_Node_ID *rem_id, SG_Block_ID *blk_id, char *data ) {
+
+    char initPacket[SG_DATA_PACKET_SIZE], recvPacket[SG_DATA_PACKET_SIZE];
+    size_t pktlen, rpktlen;
+    SG_Node_ID loc, rem;
+    SG_Block_ID blkid;
+    SG_SeqNum sloc, srem;
+    SG_System_OP rop;
+    SG_Packet_Status ret;
+    struct timespec start, end;
+    uint64_t tstart;
+    SG_Node_ID target = *rem_id;
+    SG_SeqNum rseq, sseq;
+    int post;
+    char *sdata = ((op == SG_CREATE_BLOCK) || (op == SG_UPDATE_BLOCK)) ? data : NULL;
+    char *rdata = (op == SG_OBTAIN_BLOCK) ? data : NULL;
+    patch_t *patch = (op == SG_PATCH_BLOCK) ? (patch_t *)data : NULL;
+    compound_t *cmp = (op == SG_COMPOUND_OPS) ? (compound_t *)data : NULL;
+    char *spkt = (cmp != NULL) ? cmp->packet : initPacket;
+    char *rpkt = (cmp != NULL) ? cmp->reply : recvPacket;
+
+    // Setup the packet, sequence numbers are handed out under the packet lock
+    pthread_mutex_lock(&sgDriverPacketLock);
+    rseq = (op == SG_CREATE_BLOCK) ? SG_SEQNO_UNKNOWN : sgDriverSeqIssue(target);
+    sseq = sgDriverSendIssue();
+    pktlen = SG_DATA_PACKET_SIZE;
+    if ( (ret = serialize_sg_packet(sgLocalNodeId, // Local ID
+                                    *rem_id,   // Remote ID
+                                    *blk_id,  // Block ID
+                                    op,  // Operation
+                                    sseq,    // Sender sequence number
+                                    rseq,  // Receiver sequence number
+                                    sdata, spkt, &pktlen)) != SG_PACKT_OK ) {
+        sgDriverSeqComplete(target, rseq);
+        sgDriverSendComplete(sseq);
+        pthread_mutex_unlock(&sgDriverPacketLock);
+        logMessage( LOG_ERROR_LEVEL, "sgDriverExchangeBlockOp: failed serialization of packet [%d].", ret );
+        return( -1 );
+    }
+    pthread_mutex_unlock(&sgDriverPacketLock);
+    if (patch != NULL) {
+        sgDriverPackPatch(spkt, &pktlen, patch);
+    } else if (cmp != NULL) {
+        pktlen = sgDriverPackCompound(spkt, cmp);
+    }
+    SG_STAT_ADD(sent_bytes, pktlen);
+
+    // Send the packet, timing the request for the placement layer
+    sgPlacementStart(*rem_id);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tstart = SG_TRACE_START();
+    rpktlen = (cmp != NULL) ? sizeof(cmp->reply) : SG_DATA_PACKET_SIZE;
+    post = sgDriverServicePost(spkt, &pktlen, rpkt, &rpktlen);
+    SG_TRACE_SPAN(SG_TEV_SERVICE_POST, tstart, op);
+    if ( post ) {
+        pthread_mutex_lock(&sgDriverPacketLock);
+        sgDriverSeqComplete(target, rseq);
+        sgDriverSendComplete(sseq);
+        pthread_mutex_unlock(&sgDriverPacketLock);
+        logMessage( LOG_ERROR_LEVEL, "sgDriverExchangeBlockOp: failed packet post" );
+        return( -1 );
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // Unpack the recieived data, the request has left both windows
+    pthread_mutex_lock(&sgDriverPacketLock);
+    sgDriverSeqComplete(target, rseq);
+    sgDriverSendComplete(sseq);
+    if ((op == SG_OBTAIN_BLOCK) && (sgReplicas > 1)) {
+        sgDriverHedgeRecord((uint64_t)(end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec));
+    }
+    if ( (ret = deserialize_sg_packet(&loc, &rem, &blkid, &rop, &sloc, 
+                                    &srem, rdata, rpkt, rpktlen)) != SG_PACKT_OK ) {
+        pthread_mutex_unlock(&sgDriverPacketLock);
+        logMessage( LOG_ERROR_LEVEL, "sgDriverExchangeBlockOp: failed deserialization of packet [%d]", ret );
+        return( -1 );
+    }
+    if ((patch != NULL) && sgDriverUnpackPatch(rpkt, rpktlen, patch)) {
+        pthread_mutex_unlock(&sgDriverPacketLock);
+        logMessage( LOG_ERROR_LEVEL, "sgDriverExchangeBlockOp: bad patch reply for block [%lu]", *blk_id );
+        return( -1 );
+    }
+    if ((cmp != NULL) && sgDriverUnpackCompound(rpkt, rpktlen, cmp)) {
+        pthread_mutex_unlock(&sgDriverPacketLock);
+        logMessage( LOG_ERROR_LEVEL, "sgDriverExchangeBlockOp: bad compound reply from node [%lu]", *rem_id );
+        return( -1 );
+    }
+
+    // the first node we talk to becomes the head of the node/rseq mapping
+    if (node_head->node_id == 0) {
+        node_head->node_id = rem;
+        node_head->rseq = srem;
+        node_head->next = NULL;
+    }
+    pthread_mutex_unlock(&sgDriverPacketLock);
+    sgPlacementRecord(rem, op, (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec));
+
+    *rem_id = rem;
+    *blk_id = blkid;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverPackPatch
+// Description  : Make a serialized packet without data a patch packet, the
+//                byte range taking the place of the block
+//
+// Inputs       : packet - the packet (SG_PATCH_PACKET_SIZE of the patch)
+//                plen - the packet length (updated)
+//                patch - the patch
+// Outputs      : none
+
+void sgDriverPackPatch( char *packet, size_t *plen, patch_t *patch ) {
+
+    uint32_t magic = SG_MAGIC_VALUE;
+    uint8_t data_indicator = SG_PATCH_DATA;
+    size_t off = SG_BASE_PACKET_SIZE - sizeof(magic) - sizeof(data_indicator);
+
+    memcpy(packet + off, &data_indicator, sizeof(data_indicator));
+    off += sizeof(data_indicator);
+    memcpy(packet + off, &patch->off, sizeof(patch->off));
+    off += sizeof(patch->off);
+    memcpy(packet + off, &patch->len, sizeof(patch->len));
+    off += sizeof(patch->len);
+    memcpy(packet + off, patch->bytes, patch->len);
+    off += patch->len;
+    memcpy(packet + off, &magic, sizeof(magic));
+    *plen = off + sizeof(magic);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverUnpackPatch
+// Description  : Get the bytes a patch replaced from its reply
+//
+// Inputs       : packet - the reply packet
+//                plen - the reply length
+//                patch - the patch posted (its bytes are replaced)
+// Outputs      : 0 if successful, -1 if the reply is not for the patch
+
+int sgDriverUnpackPatch( char *packet, size_t plen, patch_t *patch ) {
+
+    uint8_t data_indicator;
+    uint32_t poff, plength, magic;
+    size_t off = SG_BASE_PACKET_SIZE - sizeof(magic) - sizeof(data_indicator);
+
+    if (plen < SG_PATCH_PACKET_SIZE(patch->len)) {
+        return( -1 );
+    }
+    memcpy(&data_indicator, packet + off, sizeof(data_indicator));
+    off += sizeof(data_indicator);
+    memcpy(&poff, packet + off, sizeof(poff));
+    off += sizeof(poff);
+    memcpy(&plength, packet + off, sizeof(plength));
+    off += sizeof(plength);
+    if ((data_indicator != SG_PATCH_DATA) || (poff != patch->off) || (plength != patch->len)) {
+        return( -1 );
+    }
+    memcpy(patch->bytes, packet + off, patch->len);
+    memcpy(&magic, packet + off + patch->len, sizeof(magic));
+    return( (magic == SG_MAGIC_VALUE) ? 0 : -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverPackCompound
+// Description  : Make a serialized packet without data a compound packet, the
+//                vector of block operations taking the place of the block
+//
+// Inputs       : packet - the packet (SG_COMPOUND_PACKET_SIZE of the operations)
+//                cmp - the block operations
+// Outputs      : the packet length
+
+size_t sgDriverPackCompound( char *packet, compound_t *cmp ) {
+
+    uint32_t count = cmp->num, magic = SG_MAGIC_VALUE;
+    uint8_t data_indicator = SG_COMPOUND_DATA;
+    size_t off = SG_BASE_PACKET_SIZE - sizeof(magic) - sizeof(data_indicator);
+    blockop_t *bop;
+
+    memcpy(packet + off, &data_indicator, sizeof(data_indicator));
+    off += sizeof(data_indicator);
+    memcpy(packet + off, &count, sizeof(count));
+    off += sizeof(count);
+    for (int i = 0; i < cmp->num; i++) {
+        bop = &cmp->ops[i];
+        data_indicator = ((bop->op == SG_CREATE_BLOCK) || (bop->op == SG_UPDATE_BLOCK));
+        memcpy(packet + off, &bop->blk_id, sizeof(bop->blk_id));
+        off += sizeof(bop->blk_id);
+        packet[off++] = (uint8_t)bop->op;
+        packet[off++] = 0;
+        packet[off++] = data_indicator;
+        if (data_indicator) {
+            memcpy(packet + off, bop->data, SG_BLOCK_SIZE);
+            off += SG_BLOCK_SIZE;
+        }
+    }
+    memcpy(packet + off, &magic, sizeof(magic));
+    return( off + sizeof(magic) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverUnpackCompound
+// Description  : Get the status of each block operation of a compound packet
+//                from its reply, with the blocks obtained and created
+//
+// Inputs       : packet - the reply packet
+//                plen - the reply length
+//                cmp - the block operations posted (results filled in)
+// Outputs      : 0 if successful, -1 if the reply is not for the operations
+
+int sgDriverUnpackCompound( char *packet, size_t plen, compound_t *cmp ) {
+
+    uint8_t data_indicator;
+    uint32_t count, magic;
+    size_t off = SG_BASE_PACKET_SIZE - sizeof(magic) - sizeof(data_indicator);
+    blockop_t *bop;
+
+    if (plen < SG_COMPOUND_PACKET_SIZE(0) + cmp->num * SG_COMPOUND_OP_SIZE) {
+        return( -1 );
+    }
+    memcpy(&data_indicator, packet + off, sizeof(data_indicator));
+    off += sizeof(data_indicator);
+    memcpy(&count, packet + off, sizeof(count));
+    off += sizeof(count);
+    if ((data_indicator != SG_COMPOUND_DATA) || (count != (uint32_t)cmp->num)) {
+        return( -1 );
+    }
+    for (int i = 0; i < cmp->num; i++) {
+        bop = &cmp->ops[i];
+        if ((off + SG_COMPOUND_OP_SIZE + sizeof(magic) > plen) || ((uint8_t)packet[off + sizeof(SG_Block_ID)] != bop->op)) {
+            return( -1 );
+        }
+        memcpy(&bop->blk_id, packet + off, sizeof(bop->blk_id));
+        off += sizeof(bop->blk_id) + 1;
+        bop->status = packet[off++] ? -1 : 0;
+        data_indicator = packet[off++];
+        if (data_indicator) {
+            if ((off + SG_BLOCK_SIZE + sizeof(magic) > plen) || (bop->op != SG_OBTAIN_BLOCK)) {
+                return( -1 );
+            }
+            memcpy(bop->data, packet + off, SG_BLOCK_SIZE);
+            off += SG_BLOCK_SIZE;
+        } else if ((bop->op == SG_OBTAIN_BLOCK) && (bop->status == 0)) {
+            return( -1 );
+        }
+    }
+    memcpy(&magic, packet + off, sizeof(magic));
+    return( (magic == SG_MAGIC_VALUE) ? 0 : -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverNextSeqno
+// Description  : Take the next sender sequence number, wrapping around the
+//                reserved values (packet lock held once the driver runs
+//                concurrently)
+//
+// Inputs       : none
+// Outputs      : the sequence number to send
+
+SG_SeqNum sgDriverNextSeqno( void ) {
+
+    SG_SeqNum seq = sgLocalSeqno;
+
+    sgLocalSeqno = SG_SEQNO_NEXT(seq);
+    if (sgLocalSeqno < seq) {
+        SG_STAT_ADD(seq_wraps, 1);
+    }
+    return( seq );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverFindNodeMap
+// Description  : Find the sequence state of a node (packet lock held)
+//
+// Inputs       : rem_id - the node
+// Outputs      : the node mapping, NULL if the node is not known yet
+
+map_t *sgDriverFindNodeMap( SG_Node_ID rem_id ) {
+
+    map_t *crt;
+
+    if (rem_id == SG_NODE_UNKNOWN) {
+        return( NULL );
+    }
+    for (crt = node_head; crt != NULL; crt = crt->next) {
+        if (crt->node_id == rem_id) {
+            return( crt );
+        }
+    }
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverSeqIssue
+// Description  : Take the next receiver sequence number of a node and mark it
+//                in flight.  At most SG_DRIVER_SEQ_WINDOW numbers past the
+//                oldest one still in flight are handed out, later callers
+//                wait for it to complete (packet lock held).
+//
+// Inputs       : rem_id - the node the request goes to
+// Outputs      : the sequence number, SG_SEQNO_UNKNOWN if the node is not
+//                known yet (serialize_sg_packet picks one)
+
+SG_SeqNum sgDriverSeqIssue( SG_Node_ID rem_id ) {
+
+    map_t *node = sgDriverFindNodeMap(rem_id);
+    SG_SeqNum seq;
+
+    if (node == NULL) {
+        return( SG_SEQNO_UNKNOWN );
+    }
+    while (sgDriverWindowFull(&node->win, SG_SEQNO_NEXT(node->rseq))) {
+        SG_STAT_ADD(seq_waits, 1);
+        pthread_cond_wait(&sgDriverSeqCond, &sgDriverPacketLock);
+    }
+    seq = SG_SEQNO_NEXT(node->rseq);
+    node->rseq = seq;
+    sgDriverWindowAdd(&node->win, seq);
+    return( seq );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverSeqComplete
+// Description  : Retire a receiver sequence number once its request is done
+//                (in any order), sliding the node's window past the oldest
+//                requests that have all completed (packet lock held)
+//
+// Inputs       : rem_id - the node the request went to
+//                rseq - the sequence number from sgDriverSeqIssue
+// Outputs      : none
+
+void sgDriverSeqComplete( SG_Node_ID rem_id, SG_SeqNum rseq ) {
+
+    map_t *node = sgDriverFindNodeMap(rem_id);
+
+    if ((node == NULL) || (rseq == SG_SEQNO_UNKNOWN)) {
+        return;
+    }
+    sgDriverWindowRemove(&node->win, rseq);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverSendIssue
+// Description  : Take the next sender sequence number and mark it in flight.
+//                The service only accepts numbers up to SG_LOCAL_SEQ_WINDOW
+//                past the next one it expects, so a request delayed after
+//                taking its number holds the others back (packet lock held).
+//
+// Inputs       : none
+// Outputs      : the sequence number to send
+
+SG_SeqNum sgDriverSendIssue( void ) {
+
+    SG_SeqNum seq;
+
+    while (sgDriverWindowFull(&sgLocalSeqWindow, sgLocalSeqno)) {
+        SG_STAT_ADD(seq_waits, 1);
+        pthread_cond_wait(&sgDriverSeqCond, &sgDriverPacketLock);
+    }
+    seq = sgDriverNextSeqno();
+    sgDriverWindowAdd(&sgLocalSeqWindow, seq);
+    return( seq );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverSendComplete
+// Description  : Retire a sender sequence number once its request is done
+//                (packet lock held)
+//
+// Inputs       : sseq - the sequence number from sgDriverSendIssue
+// Outputs      : none
+
+void sgDriverSendComplete( SG_SeqNum sseq ) {
+
+    sgDriverWindowRemove(&sgLocalSeqWindow, sseq);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverWindowFull
+// Description  : Check if a sequence number is SG_DRIVER_SEQ_WINDOW or more
+//                past the oldest one still in flight, the caller waits on
+//                sgDriverSeqCond and checks again (packet lock held)
+//
+// Inputs       : win - the window
+//                next - the sequence number about to be handed out
+// Outputs      : 1 if the number must wait, 0 if it fits the window
+
+int sgDriverWindowFull( seqwin_t *win, SG_SeqNum next ) {
+
+    return( (win->inflight > 0) && (SG_SEQNO_DIFF(next, win->base) >= SG_DRIVER_SEQ_WINDOW) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverWindowAdd
+// Description  : Mark a sequence number in flight, once it fits the window
+//                (packet lock held)
+//
+// Inputs       : win - the window
+//                seq - the sequence number handed out
+// Outputs      : none
+
+void sgDriverWindowAdd( seqwin_t *win, SG_SeqNum seq ) {
+
+    int bit;
+
+    if (win->inflight++ == 0) {
+        win->base = seq;
+    }
+    bit = (win->basepos + SG_SEQNO_DIFF(seq, win->base)) % SG_DRIVER_SEQ_WINDOW;
+    win->window[bit / 64] |= ((uint64_t)1 << (bit % 64));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgDriverWindowRemove
+// Description  : Retire a sequence number (in any order), sliding the window
+//                past the oldest requests that have all completed and waking
+//                the callers waiting for room (packet lock held)
+//
+// Inputs       : win - the window
+//                seq - the sequence number from sgDriverWindowAdd
+// Outputs      : none
+
+void sgDriverWindowRemove( seqwin_t *win, SG_SeqNum seq ) {
+
+    int dist, bit;
+
+    if (win->inflight == 0) {
+        return;
+    }
+    dist = SG_SEQNO_DIFF(seq, win->base);
+    if ((dist < 0) || (dist >= SG_DRIVER_SEQ_WINDOW)) {
+        return;
+    }
+    bit = (win->basepos + dist) % SG_DRIVER_SEQ_WINDOW;
+    if (!(win->window[bit / 64] & ((uint64_t)1 << (bit % 64)))) {
+        return;
+    }
+    win->window[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+    win->inflight--;
+
+    // the base moves up to the oldest request still in flight
+    while ((win->inflight > 0) &&
+            !(win->window[win->basepos / 64] & ((uint64_t)1 << (win->basepos % 64)))) {
+        win->base = SG_SEQNO_NEXT(win->base);
+        win->basepos = (win->basepos + 1) % SG_DRIVER_SEQ_WINDOW;
+    }
+    pthread_cond_broadcast(&sgDriverSeqCond);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgInitEndpoint
+// Description  : Initialize the endpoint
+//
+// Inputs       : none
+// Outputs      : 0 if successfull, -1 if failure
+
+int sgInitEndpoint( void ) {
+
+    // Local variables
+    char initPacket[SG_BASE_PACKET_SIZE], recvPacket[SG_BASE_PACKET_SIZE];
+    size_t pktlen, rpktlen;
+    SG_Node_ID loc, rem;
+    SG_Block_ID blkid;
+    SG_SeqNum sloc, srem;
+    SG_System_OP op;
+    SG_Packet_Status ret;
+    
+    // initializing the file linked list, nodeid/rseq linked list, and cache
+    headd = (File_t *) malloc(sizeof(File_t));
+    headd->file_h = 0;
+    headd->next = NULL;
+    node_head = (map_t *) calloc(1, sizeof(map_t));
+    global_flag = 1;
+    node_head->next = NULL;
+    initSGCache(SG_MAX_CACHE_ELEMENTS, sgCacheOrganization);
+    if ((sgCacheSharedName != NULL) && initSGCacheShared(sgCacheSharedName, SG_SHMCACHE_DEFAULT_LINES)) {
+        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: unable to attach the shared cache [%s]", sgCacheSharedName );
+        return( -1 );
+    }
+    if (sgCacheMaxBytes > 0) {
+        setSGCacheBudget(sgCacheMinBytes, sgCacheMaxBytes);
+    }
+    initSGPlacement(sgPlacementPolicy);
+    if (sgCompressionEnabled) {
+        initSGCacheTier(SG_MAX_CACHE_TIER_BYTES);
+    }
+    if ((sgCacheDiskPath != NULL) && initSGCacheDisk(sgCacheDiskPath, sgCacheDiskBytes)) {
+        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: unable to create the disk tier [%s]", sgCacheDiskPath );
+        return( -1 );
+    }
+    if ((sgTracePath != NULL) && initSGTrace(sgTracePath)) {
+        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: unable to start tracing to [%s]", sgTracePath );
+        return( -1 );
+    }
+    if ((sgCapturePath != NULL) && initSGCapture(sgCapturePath, sgCaptureHashes)) {
+        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: unable to capture calls to [%s]", sgCapturePath );
+        return( -1 );
+    }
+    initSGSched(sgServiceConcurrent ? SG_SCHED_DEFAULT_DEPTH : 1, sgSchedFileRate);
+    for (int t = 0; (sgPrefetchBlocks > 0) && (t < SG_PREFETCH_WORKERS); t++) {
+        if (pthread_create(&sgPrefetchThreads[sgPrefetchWorkers], NULL, sgDriverPrefetchThread, NULL) == 0) {
+            sgPrefetchWorkers++;
+        }
+    }
+
+    // Local and do some initial setup
+    logMessage( LOG_INFO_LEVEL, "Initializing local endpoint ..." );
+    sgLocalSeqno = SG_INITIAL_SEQNO;
+    memset(&sgLocalSeqWindow, 0, sizeof(sgLocalSeqWindow));
+
+    // Setup the packet
+    pktlen = SG_BASE_PACKET_SIZE;
+    if ( (ret = serialize_sg_packet( SG_NODE_UNKNOWN, // Local ID
+                                    SG_NODE_UNKNOWN,   // Remote ID
+                                    SG_BLOCK_UNKNOWN,  // Block ID
+                                    SG_INIT_ENDPOINT,  // Operation
+                                    sgDriverNextSeqno(), // Sender sequence number
+                                    SG_SEQNO_UNKNOWN,  // Receiver sequence number
+                                    NULL, initPacket, &pktlen)) != SG_PACKT_OK ) {
+        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: failed serialization of packet [%d].", ret );
+        return( -1 );
+    }
+
+    // Send the packet
+    rpktlen = SG_BASE_PACKET_SIZE;
+    if ( sgDriverServicePost(initPacket, &pktlen, recvPacket, &rpktlen) ) {
+        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: failed packet post" );
+        return( -1 );
+    }
+
+    // Unpack the recieived data
+    if ( (ret = deserialize_sg_packet(&loc, &rem, &blkid, &op, &sloc, 
+                                    &srem, NULL, recvPacket, rpktlen)) != SG_PACKT_OK ) {
+        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: failed deserialization of packet [%d]", ret );
+        return( -1 );
+    }
+
+    // Sanity check the return value
+    if ( loc == SG_NODE_UNKNOWN ) {
+        logMessage( LOG_ERROR_LEVEL, "sgInitEndpoint: bad local ID returned [%ul]", loc );
+        return( -1 );
+    }
+
+    // A service that speaks extensions lists them in the block ID of its reply
+    // (only the enabled ones are used)
+    sgServiceFeatures = ((blkid & ~SG_FEATURE_MASK) == SG_FEATURE_TAG) ? (uint32_t)(blkid & SG_FEATURE_MASK) : 0;
+    sgServiceFeatures &= (sgPatchEnabled ? SG_FEATURE_PATCH : 0) | (sgCompoundEnabled ? SG_FEATURE_COMPOUND : 0);
+    if (sgServiceFeatures & SG_FEATURE_PATCH) {
+        logMessage( LOG_INFO_LEVEL, "sgInitEndpoint: service takes byte range patches, small writes are patched" );
+    }
+    if (sgServiceFeatures & SG_FEATURE_COMPOUND) {
+        logMessage( LOG_INFO_LEVEL, "sgInitEndpoint: service takes compound packets, block operations are sent per node" );
+    }
 
     // Set the local node ID, log and return successfully
     sgLocalNodeId = loc;
@@ -13,13 +13,81 @@
 
 // Includes
 #include <sg_defs.h>
+#include <sg_placement.h>
+#include <sg_cache.h>
 
 // Defines 
+#define SG_MAX_REPLICAS 4  // Most copies kept of a block (sgReplicas)
 
 // Type definitions
+typedef int (*SgServicePostFunc)( char *packet, size_t *len, char *rpacket, size_t *rlen );
 
 // Global interface definitions
 
+extern int sgCompressionEnabled;
+    // Compress and pack file blocks, keep evicted blocks compressed in cache
+
+extern int sgInlineEnabled;
+    // Keep small files inline in their metadata, pack file tails into shared blocks
+
+extern int sgAppendBuffering;
+    // Buffer a file's new last block in memory until it is full (or closed)
+
+extern int sgChecksumEnabled;
+    // Verify block checksums when blocks are obtained from the SG system
+
+extern int sgChecksumCacheHits;
+    // Also verify block checksums on cache hits
+
+extern SgServicePostFunc sgDriverServicePost;
+    // The service the driver posts packets to (sgServicePost by default)
+
+extern int sgServiceConcurrent;
+    // The service accepts posts from several threads at once
+
+extern SG_Placement_Policy sgPlacementPolicy;
+    // The policy choosing the node new blocks are created on
+
+extern SG_Cache_Organization sgCacheOrganization;
+    // The organization of the block cache (array of lines or set associative)
+
+extern size_t sgCacheMinBytes, sgCacheMaxBytes;
+    // Size the block cache adaptively between these budgets (max 0 if fixed)
+
+extern int sgReplicas;
+    // Keep this many copies of each block on distinct nodes, hedging reads over them
+
+extern char *sgCacheSharedName;
+    // Share the block cache with other processes through this segment (NULL if private)
+
+extern char *sgCacheDiskPath;
+extern size_t sgCacheDiskBytes;
+    // Keep blocks evicted from memory in this local (SSD) file, up to the bytes given (NULL for none)
+
+extern int sgPrefetchBlocks;
+    // Read this many blocks ahead of a file read sequentially (0 for none)
+
+extern uint32_t sgSchedFileRate;
+    // Limit each file to this many block operations per second (0 unlimited)
+
+extern int sgPendingUpdates;
+    // Hold back up to this many updates, merging them and posting them per node (0 for none)
+
+extern int sgPatchEnabled;
+    // Send small writes into a block as patches of their bytes, if the service takes them
+
+extern int sgCompoundEnabled;
+    // Send the block operations of a node together in compound packets, if the service takes them
+
+extern char *sgTracePath;
+    // Trace driver, cache, packet and service events to this file as Chrome trace JSON (NULL for none)
+
+extern char *sgCapturePath;
+    // Capture every open/read/write/seek/close call to this log for replay by sg_sim (NULL for none)
+
+extern int sgCaptureHashes;
+    // Record a CRC32C of the data of captured reads and writes
+
 // Type definitions
 
 // File system interface definitions
@@ -39,6 +107,12 @@ int sgseek( SgFHandle fh, size_t off );
 int sgclose( SgFHandle fh );
     // Close the file
 
+const char *sgmap( SgFHandle fh, size_t off, size_t len );
+    // Map a range of the file read only, its pages filled as they are touched
+
+int sgunmap( const char *view );
+    // Release a mapped view
+
 int sgshutdown( void );
     // Shut down the filesystem
 
@@ -0,0 +1,752 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_local_service.c
+//  Description    : This file contains the local stand-in for the
+//                   ScatterGather service.  Blocks live in per-node hash
+//                   tables in memory; each node has its own lock so requests
+//                   to different nodes are served concurrently.  Sequence
+//                   numbers are accepted within a window so that packets
+//                   posted from several threads may arrive out of order.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_local_service.h>
+
+// Defines
+//struct for a stored block
+typedef struct lblock {
+    struct lblock *next;
+    SG_Block_ID blk_id;
+    SGDataBlock data;
+} lblock_t;
+//struct for a window of accepted sequence numbers
+typedef struct lseqwin {
+    SG_SeqNum expected;  // the next sequence number expected
+    int pos;             // the bit of expected in seen
+    uint64_t seen[SG_LOCAL_SEQ_WINDOW / 64]; // bit (pos + distance from expected) set if seq, ahead of expected, was received
+} lseqwin_t;
+//struct for a storage node
+typedef struct lnode {
+    SG_Node_ID node_id;
+    lseqwin_t rseq;
+    pthread_mutex_t lock;
+    lblock_t *blocks[SG_LOCAL_BLOCK_BUCKETS];
+    int num_blocks;
+    unsigned long ops;
+    unsigned long stalls;
+    unsigned int seed;
+} lnode_t;
+//struct for the service state
+typedef struct lservice {
+    int initialized;
+    int num_nodes;
+    uint32_t latency;
+    int slow_nodes;      // the first slow_nodes nodes stall now and then
+    uint32_t stall;      // the length of a stall (usec)
+    int stall_percent;   // the percentage of requests a slow node stalls on
+    uint32_t features;   // the extensions advertised at init (SG_FEATURE_*)
+    SG_Node_ID loc_id;
+    lseqwin_t lseq;
+    unsigned int seed;
+    pthread_mutex_t lock;
+    lnode_t nodes[SG_LOCAL_MAX_NODES];
+} lservice_t;
+
+// Functional Prototypes
+int sgLocalUnpackPacket( char *packet, size_t plen, SG_Node_ID *loc, SG_Node_ID *rem,
+        SG_Block_ID *blk, SG_System_OP *op, SG_SeqNum *sseq, SG_SeqNum *rseq, char *data,
+        uint32_t *poff, uint32_t *plength );
+int sgLocalPackPacket( SG_Node_ID loc, SG_Node_ID rem, SG_Block_ID blk, SG_System_OP op,
+        SG_SeqNum sseq, SG_SeqNum rseq, char *data, uint32_t poff, uint32_t plength,
+        char *packet, size_t *plen );
+int sgLocalSeqAccept( lseqwin_t *win, SG_SeqNum seq );
+uint64_t sgLocalRandomID( void );
+int sgLocalInitialize( SG_SeqNum sseq );
+void sgLocalShutdown( void );
+lnode_t *sgLocalFindNode( SG_Node_ID nde );
+lblock_t *sgLocalFindBlock( lnode_t *node, SG_Block_ID blk, lblock_t ***prev );
+int sgLocalNodeOp( lnode_t *node, SG_System_OP op, SG_Block_ID *blk, SG_SeqNum *rseq, char *data,
+        uint32_t poff, uint32_t plength );
+int sgLocalNodeAdmit( lnode_t *node, SG_System_OP op, SG_SeqNum *rseq );
+int sgLocalBlockOp( lnode_t *node, SG_System_OP op, SG_Block_ID *blk, char *data, uint32_t poff, uint32_t plength );
+int sgLocalCompoundOps( lnode_t *node, char *packet, size_t plen, char *rpacket, size_t *rlen );
+
+//
+// Global Data
+lservice_t sgLocal = { .num_nodes = SG_LOCAL_DEFAULT_NODES, .features = SG_FEATURE_PATCH | SG_FEATURE_COMPOUND,
+        .lock = PTHREAD_MUTEX_INITIALIZER };
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalServiceConfigure
+// Description  : Set the number of nodes and the per-request latency of the
+//                local service (takes effect at the next endpoint init)
+//
+// Inputs       : nodes - the number of storage nodes
+//                latency - the time each node takes per request (usec)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLocalServiceConfigure( int nodes, uint32_t latency ) {
+
+    if ((nodes < 1) || (nodes > SG_LOCAL_MAX_NODES)) {
+        logMessage( LOG_ERROR_LEVEL, "sgLocalServiceConfigure: bad node count [%d]", nodes );
+        return( -1 );
+    }
+    pthread_mutex_lock(&sgLocal.lock);
+    sgLocal.num_nodes = nodes;
+    sgLocal.latency = latency;
+    pthread_mutex_unlock(&sgLocal.lock);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalServiceSlowNodes
+// Description  : Make some nodes of the local service slow: the first nodes
+//                stall on a percentage of their requests, so that tail
+//                latency (and what hedged reads do for it) can be measured
+//
+// Inputs       : nodes - the number of slow nodes
+//                stall - the length of a stall (usec)
+//                percent - the percentage of requests a slow node stalls on
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLocalServiceSlowNodes( int nodes, uint32_t stall, int percent ) {
+
+    if ((nodes < 0) || (nodes > SG_LOCAL_MAX_NODES) || (percent < 0) || (percent > 100)) {
+        logMessage( LOG_ERROR_LEVEL, "sgLocalServiceSlowNodes: bad slow nodes [%d, %d%%]", nodes, percent );
+        return( -1 );
+    }
+    pthread_mutex_lock(&sgLocal.lock);
+    sgLocal.slow_nodes = nodes;
+    sgLocal.stall = stall;
+    sgLocal.stall_percent = percent;
+    pthread_mutex_unlock(&sgLocal.lock);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalServiceFeatures
+// Description  : Set the protocol extensions the local service advertises at
+//                the next endpoint init (a transport that cannot carry some
+//                of the packets leaves them out)
+//
+// Inputs       : features - the extensions (SG_FEATURE_*)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLocalServiceFeatures( uint32_t features ) {
+
+    if (features & ~(uint32_t)(SG_FEATURE_PATCH | SG_FEATURE_COMPOUND)) {
+        logMessage( LOG_ERROR_LEVEL, "sgLocalServiceFeatures: unknown features [0x%x]", features );
+        return( -1 );
+    }
+    pthread_mutex_lock(&sgLocal.lock);
+    sgLocal.features = features;
+    pthread_mutex_unlock(&sgLocal.lock);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalServicePost
+// Description  : Post a packet to the local ScatterGather service
+//
+// Inputs       : packet - the request packet
+//                len - the length of the request packet
+//                rpacket - the buffer for the reply packet
+//                rlen - the size of the reply buffer (set to the reply length)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLocalServicePost( char *packet, size_t *len, char *rpacket, size_t *rlen ) {
+
+    SG_Node_ID loc, rem;
+    SG_Block_ID blk;
+    SG_System_OP op;
+    SG_SeqNum sseq, rseq;
+    SGDataBlock data;
+    uint32_t poff = 0, plength = 0, features;
+    size_t rcap = *rlen;
+    lnode_t *node = NULL;
+    int ret;
+
+    // Unpack the request
+    if (sgLocalUnpackPacket(packet, *len, &loc, &rem, &blk, &op, &sseq, &rseq, data, &poff, &plength)) {
+        logMessage( LOG_ERROR_LEVEL, "sgLocalServicePost: failed deserialization of packet" );
+        return( -1 );
+    }
+
+    // Endpoint operations and sequence checks are done under the service lock
+    pthread_mutex_lock(&sgLocal.lock);
+    if (op == SG_INIT_ENDPOINT) {
+        ret = sgLocalInitialize(sseq);
+        loc = sgLocal.loc_id;
+        features = sgLocal.features;
+        pthread_mutex_unlock(&sgLocal.lock);
+        if (ret) {
+            return( -1 );
+        }
+        // the block ID of the reply tells the driver which extensions we speak
+        return( sgLocalPackPacket(loc, SG_NODE_UNKNOWN, SG_FEATURE_TAG | features, op, sseq,
+                (SG_SeqNum)(sseq + 1), NULL, 0, 0, rpacket, rlen) );
+    }
+    if (!sgLocal.initialized) {
+        pthread_mutex_unlock(&sgLocal.lock);
+        logMessage( LOG_ERROR_LEVEL, "sgLocalServicePost: service not initialized" );
+        return( -1 );
+    }
+    if (sgLocalSeqAccept(&sgLocal.lseq, sseq)) {
+        pthread_mutex_unlock(&sgLocal.lock);
+        logMessage( LOG_ERROR_LEVEL, "sgLocalServicePost: out of sequence request, loc seq=%u, expected=%u",
+                sseq, sgLocal.lseq.expected );
+        return( -1 );
+    }
+    if (op == SG_STOP_ENDPOINT) {
+        sgLocalShutdown();
+        pthread_mutex_unlock(&sgLocal.lock);
+        return( sgLocalPackPacket(loc, SG_NODE_UNKNOWN, SG_BLOCK_UNKNOWN, op, sseq,
+                (SG_SeqNum)(sseq + 1), NULL, 0, 0, rpacket, rlen) );
+    }
+
+    // Find the node, creates go to the requested node or a random one
+    node = sgLocalFindNode(rem);
+    if ((node == NULL) && (op == SG_CREATE_BLOCK)) {
+        node = &sgLocal.nodes[rand_r(&sgLocal.seed) % sgLocal.num_nodes];
+        rseq = SG_SEQNO_UNKNOWN;
+    }
+    pthread_mutex_unlock(&sgLocal.lock);
+    if (node == NULL) {
+        logMessage( LOG_ERROR_LEVEL, "sgLocalServicePost: could not find node from ID [%lu]", rem );
+        return( -1 );
+    }
+
+    // A compound packet is admitted once, then its operations run in order, each with its own status
+    if (op == SG_COMPOUND_OPS) {
+        if (sgLocalPackPacket(loc, node->node_id, blk, op, sseq, rseq, NULL, 0, 0, rpacket, rlen)) {
+            return( -1 );
+        }
+        *rlen = rcap;
+        pthread_mutex_lock(&node->lock);
+        ret = sgLocalNodeAdmit(node, op, &rseq) || sgLocalCompoundOps(node, packet, *len, rpacket, rlen);
+        pthread_mutex_unlock(&node->lock);
+        return( ret ? -1 : 0 );
+    }
+
+    // Perform the block operation on the node
+    pthread_mutex_lock(&node->lock);
+    ret = sgLocalNodeOp(node, op, &blk, &rseq, data, poff, plength);
+    pthread_mutex_unlock(&node->lock);
+    if (ret) {
+        return( -1 );
+    }
+
+    // Send back the reply, with the block for obtains and the replaced bytes for patches
+    return( sgLocalPackPacket(loc, node->node_id, blk, op, sseq, rseq,
+            ((op == SG_OBTAIN_BLOCK) || (op == SG_PATCH_BLOCK)) ? data : NULL, poff, plength, rpacket, rlen) );
+}
+
+//
+// Service support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalNodeOp
+// Description  : Perform a block operation on a node (node lock held)
+//
+// Inputs       : node - the node
+//                op - the block operation
+//                blk - the block ID (set for create)
+//                rseq - the receiver sequence number (set for create)
+//                data - the block data (in for create/update, out for obtain),
+//                       for a patch the new bytes in and the old bytes out
+//                poff, plength - the byte range of a patch
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLocalNodeOp( lnode_t *node, SG_System_OP op, SG_Block_ID *blk, SG_SeqNum *rseq, char *data,
+        uint32_t poff, uint32_t plength ) {
+
+    if (sgLocalNodeAdmit(node, op, rseq)) {
+        return( -1 );
+    }
+    return( sgLocalBlockOp(node, op, blk, data, poff, plength) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalNodeAdmit
+// Description  : Accept a request's sequence number on a node and take the
+//                time the node serves a request in (node lock held)
+//
+// Inputs       : node - the node
+//                op - the operation of the request
+//                rseq - the receiver sequence number (set for create)
+// Outputs      : 0 if successful, -1 if out of sequence
+
+int sgLocalNodeAdmit( lnode_t *node, SG_System_OP op, SG_SeqNum *rseq ) {
+
+    // creates on a node we picked don't use a sequence number (the sender could have
+    // requests to it in flight), they report the last one seen so the sender can sync
+    if ((op == SG_CREATE_BLOCK) && (*rseq == SG_SEQNO_UNKNOWN)) {
+        *rseq = SG_SEQNO_PREV(node->rseq.expected);
+    } else if (sgLocalSeqAccept(&node->rseq, *rseq)) {
+        logMessage( LOG_ERROR_LEVEL, "sgLocalNodeAdmit: out of sequence request, rem seq=%u, expected=%u",
+                *rseq, node->rseq.expected );
+        return( -1 );
+    }
+
+    // simulate the time the node takes to serve the request
+    if (sgLocal.latency > 0) {
+        usleep(sgLocal.latency);
+    }
+    if (((node - sgLocal.nodes) < sgLocal.slow_nodes) && ((int)(rand_r(&node->seed) % 100) < sgLocal.stall_percent)) {
+        usleep(sgLocal.stall);
+        node->stalls++;
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalBlockOp
+// Description  : Perform a block operation on a node (node lock held)
+//
+// Inputs       : node - the node
+//                op - the block operation
+//                blk - the block ID (set for create)
+//                data - the block data (in for create/update, out for obtain),
+//                       for a patch the new bytes in and the old bytes out
+//                poff, plength - the byte range of a patch
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLocalBlockOp( lnode_t *node, SG_System_OP op, SG_Block_ID *blk, char *data, uint32_t poff, uint32_t plength ) {
+
+    lblock_t *block, **prev;
+    uint64_t bucket;
+    char old[SG_BLOCK_SIZE];
+
+    node->ops++;
+    switch (op) {
+
+        case SG_CREATE_BLOCK: // Add a new block with a fresh identifier
+            block = malloc(sizeof(lblock_t));
+            do {
+                block->blk_id = sgLocalRandomID();
+            } while (sgLocalFindBlock(node, block->blk_id, &prev) != NULL);
+            memcpy(block->data, data, SG_BLOCK_SIZE);
+            bucket = block->blk_id % SG_LOCAL_BLOCK_BUCKETS;
+            block->next = node->blocks[bucket];
+            node->blocks[bucket] = block;
+            node->num_blocks++;
+            *blk = block->blk_id;
+            logMessage( SGServiceLevel, "sgLocalNodeOp: created block [%lu] on node [%lu]", *blk, node->node_id );
+            return( 0 );
+
+        case SG_UPDATE_BLOCK: // Replace the block contents
+        case SG_OBTAIN_BLOCK: // Return the block contents
+        case SG_DELETE_BLOCK: // Remove the block
+        case SG_PATCH_BLOCK:  // Replace a byte range, returning the bytes it held
+            if ((block = sgLocalFindBlock(node, *blk, &prev)) == NULL) {
+                logMessage( LOG_ERROR_LEVEL, "sgLocalNodeOp: could not find block [%lu] on node [%lu]", *blk, node->node_id );
+                return( -1 );
+            }
+            if (op == SG_UPDATE_BLOCK) {
+                memcpy(block->data, data, SG_BLOCK_SIZE);
+            } else if (op == SG_PATCH_BLOCK) {
+                memcpy(old, block->data + poff, plength);
+                memcpy(block->data + poff, data, plength);
+                memcpy(data, old, plength);
+            } else if (op == SG_OBTAIN_BLOCK) {
+                memcpy(data, block->data, SG_BLOCK_SIZE);
+            } else {
+                *prev = block->next;
+                free(block);
+                node->num_blocks--;
+            }
+            return( 0 );
+
+        default: // Not a block operation
+            logMessage( LOG_ERROR_LEVEL, "sgLocalBlockOp: bad operation [%d]", op );
+            return( -1 );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalCompoundOps
+// Description  : Perform the operations of a compound packet on a node in
+//                order, adding each one's status (and the block of an obtain)
+//                to the reply.  An operation that fails does not stop the
+//                ones after it.  (node lock held)
+//
+// Inputs       : node - the node
+//                packet - the request packet
+//                plen - the request length
+//                rpacket - the reply, its header already packed
+//                rlen - the size of the reply buffer (set to the reply length)
+// Outputs      : 0 if successful, -1 if the packet is malformed or the reply won't fit
+
+int sgLocalCompoundOps( lnode_t *node, char *packet, size_t plen, char *rpacket, size_t *rlen ) {
+
+    size_t off = SG_BASE_PACKET_SIZE - sizeof(uint32_t), roff = off;
+    uint32_t count, magic = SG_MAGIC_VALUE;
+    SG_Block_ID blk;
+    uint8_t op, status, data_indicator;
+    SGDataBlock data;
+
+    memcpy(&count, packet + off, sizeof(count));
+    off += sizeof(count);
+    if ((count == 0) || (count > SG_COMPOUND_MAX_OPS) || (*rlen < SG_COMPOUND_PACKET_SIZE(0))) {
+        return( -1 );
+    }
+    memcpy(rpacket + roff, &count, sizeof(count));
+    roff += sizeof(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (off + SG_COMPOUND_OP_SIZE + sizeof(magic) > plen) {
+            return( -1 );
+        }
+        memcpy(&blk, packet + off, sizeof(blk));
+        off += sizeof(blk);
+        op = packet[off++];
+        off++;
+        data_indicator = packet[off++];
+        if (data_indicator) {
+            if (off + SG_BLOCK_SIZE + sizeof(magic) > plen) {
+                return( -1 );
+            }
+            memcpy(data, packet + off, SG_BLOCK_SIZE);
+            off += SG_BLOCK_SIZE;
+        }
+
+        // only the plain block operations can be in a compound packet
+        status = 1;
+        if ((((op == SG_CREATE_BLOCK) || (op == SG_UPDATE_BLOCK)) && data_indicator) ||
+                (((op == SG_OBTAIN_BLOCK) || (op == SG_DELETE_BLOCK)) && !data_indicator)) {
+            status = (sgLocalBlockOp(node, op, &blk, data, 0, 0) != 0);
+        }
+        data_indicator = ((op == SG_OBTAIN_BLOCK) && (status == 0));
+        if (roff + SG_COMPOUND_OP_SIZE + (data_indicator ? SG_BLOCK_SIZE : 0) + sizeof(magic) > *rlen) {
+            return( -1 );
+        }
+        memcpy(rpacket + roff, &blk, sizeof(blk));
+        roff += sizeof(blk);
+        rpacket[roff++] = op;
+        rpacket[roff++] = status;
+        rpacket[roff++] = data_indicator;
+        if (data_indicator) {
+            memcpy(rpacket + roff, data, SG_BLOCK_SIZE);
+            roff += SG_BLOCK_SIZE;
+        }
+    }
+    rpacket[SG_BASE_PACKET_SIZE - sizeof(magic) - sizeof(data_indicator)] = SG_COMPOUND_DATA;
+    memcpy(rpacket + roff, &magic, sizeof(magic));
+    *rlen = roff + sizeof(magic);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalInitialize
+// Description  : Initialize (or re-initialize) the service and its nodes
+//                (service lock held)
+//
+// Inputs       : sseq - the sequence number of the init packet
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLocalInitialize( SG_SeqNum sseq ) {
+
+    if (sgLocal.initialized) {
+        sgLocalShutdown();
+    }
+    sgLocal.seed = (unsigned int)time(NULL) ^ (unsigned int)getpid();
+    sgLocal.loc_id = sgLocalRandomID();
+    sgLocal.lseq.expected = sseq;
+    sgLocal.lseq.pos = 0;
+    memset(sgLocal.lseq.seen, 0x0, sizeof(sgLocal.lseq.seen));
+    sgLocalSeqAccept(&sgLocal.lseq, sseq);
+
+    // create the nodes, each starts its sequence numbers at the initial value
+    for (int i = 0; i < sgLocal.num_nodes; i++) {
+        memset(&sgLocal.nodes[i], 0x0, sizeof(lnode_t));
+        sgLocal.nodes[i].node_id = sgLocalRandomID();
+        sgLocal.nodes[i].seed = sgLocal.seed + i;
+        sgLocal.nodes[i].rseq.expected = SG_INITIAL_SEQNO;
+        pthread_mutex_init(&sgLocal.nodes[i].lock, NULL);
+    }
+    sgLocal.initialized = 1;
+    logMessage( SGServiceLevel, "sgLocalInitialize: local service started with %d nodes", sgLocal.num_nodes );
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalShutdown
+// Description  : Free all of the nodes and blocks (service lock held)
+//
+// Inputs       : none
+// Outputs      : none
+
+void sgLocalShutdown( void ) {
+
+    lblock_t *block;
+
+    for (int i = 0; i < sgLocal.num_nodes; i++) {
+        logMessage( SGServiceLevel, "sgLocalShutdown: Cleaning up node [%lu], [%d] blocks, [%lu] ops, [%lu] stalls.",
+                sgLocal.nodes[i].node_id, sgLocal.nodes[i].num_blocks, sgLocal.nodes[i].ops, sgLocal.nodes[i].stalls );
+        for (int j = 0; j < SG_LOCAL_BLOCK_BUCKETS; j++) {
+            while ((block = sgLocal.nodes[i].blocks[j]) != NULL) {
+                sgLocal.nodes[i].blocks[j] = block->next;
+                free(block);
+            }
+        }
+        pthread_mutex_destroy(&sgLocal.nodes[i].lock);
+    }
+    sgLocal.initialized = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalSeqAccept
+// Description  : Accept a sequence number if it is within the window ahead of
+//                the expected value and has not been seen yet.  Numbers wrap
+//                around the reserved values, so window bits are kept relative
+//                to the expected value.
+//
+// Inputs       : win - the sequence window
+//                seq - the sequence number received
+// Outputs      : 0 if accepted, -1 if out of sequence
+
+int sgLocalSeqAccept( lseqwin_t *win, SG_SeqNum seq ) {
+
+    int dist, bit;
+
+    if ((seq == 0) || (seq == SG_SEQNO_UNKNOWN)) {
+        return( -1 );
+    }
+    dist = SG_SEQNO_DIFF(seq, win->expected);
+    bit = (win->pos + dist) % SG_LOCAL_SEQ_WINDOW;
+    if ((dist < 0) || (dist >= SG_LOCAL_SEQ_WINDOW) || (win->seen[bit / 64] & ((uint64_t)1 << (bit % 64)))) {
+        return( -1 );
+    }
+
+    // mark it seen, then slide the window past everything received in order
+    win->seen[bit / 64] |= ((uint64_t)1 << (bit % 64));
+    while (win->seen[win->pos / 64] & ((uint64_t)1 << (win->pos % 64))) {
+        win->seen[win->pos / 64] &= ~((uint64_t)1 << (win->pos % 64));
+        win->expected = SG_SEQNO_NEXT(win->expected);
+        win->pos = (win->pos + 1) % SG_LOCAL_SEQ_WINDOW;
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalFindNode
+// Description  : Find a node from its identifier
+//
+// Inputs       : nde - the node ID
+// Outputs      : pointer to the node or NULL if not found
+
+lnode_t *sgLocalFindNode( SG_Node_ID nde ) {
+
+    for (int i = 0; i < sgLocal.num_nodes; i++) {
+        if (sgLocal.nodes[i].node_id == nde) {
+            return( &sgLocal.nodes[i] );
+        }
+    }
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalFindBlock
+// Description  : Find a block in a node's block table
+//
+// Inputs       : node - the node
+//                blk - the block ID
+//                prev - set to the link pointing at the block (for removal)
+// Outputs      : pointer to the block or NULL if not found
+
+lblock_t *sgLocalFindBlock( lnode_t *node, SG_Block_ID blk, lblock_t ***prev ) {
+
+    *prev = &node->blocks[blk % SG_LOCAL_BLOCK_BUCKETS];
+    while (**prev != NULL) {
+        if ((**prev)->blk_id == blk) {
+            return( **prev );
+        }
+        *prev = &(**prev)->next;
+    }
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalRandomID
+// Description  : Generate a random node/block identifier (never 0 or unknown)
+//
+// Inputs       : none
+// Outputs      : the identifier
+
+uint64_t sgLocalRandomID( void ) {
+
+    uint64_t id;
+
+    do {
+        id = ((uint64_t)rand_r(&sgLocal.seed) << 33) ^ ((uint64_t)rand_r(&sgLocal.seed) << 12) ^
+             (uint64_t)rand_r(&sgLocal.seed);
+    } while ((id == 0) || (id == SG_NODE_UNKNOWN) || (id == SG_BLOCK_UNKNOWN));
+    return( id );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalUnpackPacket
+// Description  : Unpack a ScatterGather packet (same layout as the driver)
+//
+// Inputs       : packet - the packet
+//                plen - the packet length
+//                loc, rem, blk, op, sseq, rseq - the packet fields (returned)
+//                data - buffer for the block data (SG_BLOCK_SIZE), or the bytes of a patch
+//                poff, plength - the byte range of a patch (returned)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLocalUnpackPacket( char *packet, size_t plen, SG_Node_ID *loc, SG_Node_ID *rem,
+        SG_Block_ID *blk, SG_System_OP *op, SG_SeqNum *sseq, SG_SeqNum *rseq, char *data,
+        uint32_t *poff, uint32_t *plength ) {
+
+    uint32_t magic, emagic;
+    uint8_t data_indicator;
+    size_t off = 0;
+
+    if (plen < SG_BASE_PACKET_SIZE) {
+        return( -1 );
+    }
+    memcpy(&magic, packet + off, sizeof(magic));
+    off += sizeof(magic);
+    memcpy(loc, packet + off, sizeof(*loc));
+    off += sizeof(*loc);
+    memcpy(rem, packet + off, sizeof(*rem));
+    off += sizeof(*rem);
+    memcpy(blk, packet + off, sizeof(*blk));
+    off += sizeof(*blk);
+    memcpy(op, packet + off, sizeof(*op));
+    off += sizeof(*op);
+    memcpy(sseq, packet + off, sizeof(*sseq));
+    off += sizeof(*sseq);
+    memcpy(rseq, packet + off, sizeof(*rseq));
+    off += sizeof(*rseq);
+    memcpy(&data_indicator, packet + off, sizeof(data_indicator));
+    off += sizeof(data_indicator);
+    if (data_indicator == SG_PATCH_DATA) {
+        if (plen < SG_PATCH_PACKET_SIZE(0)) {
+            return( -1 );
+        }
+        memcpy(poff, packet + off, sizeof(*poff));
+        off += sizeof(*poff);
+        memcpy(plength, packet + off, sizeof(*plength));
+        off += sizeof(*plength);
+        if ((*plength == 0) || (*plength > SG_BLOCK_SIZE) || (*poff > SG_BLOCK_SIZE - *plength) ||
+                (plen < SG_PATCH_PACKET_SIZE(*plength))) {
+            return( -1 );
+        }
+        memcpy(data, packet + off, *plength);
+        off += *plength;
+    } else if (data_indicator == SG_COMPOUND_DATA) {
+        // the operations are left in the packet, the end magic closes the packet
+        if (plen < SG_COMPOUND_PACKET_SIZE(0)) {
+            return( -1 );
+        }
+        off = plen - sizeof(emagic);
+    } else if (data_indicator) {
+        if (plen < SG_DATA_PACKET_SIZE) {
+            return( -1 );
+        }
+        memcpy(data, packet + off, SG_BLOCK_SIZE);
+        off += SG_BLOCK_SIZE;
+    }
+    memcpy(&emagic, packet + off, sizeof(emagic));
+
+    // sanity check the packet framing and fields
+    if ((magic != SG_MAGIC_VALUE) || (emagic != SG_MAGIC_VALUE) || (*op >= SG_MAXVAL_OP) || (*sseq == 0)) {
+        return( -1 );
+    }
+    if (((*op == SG_CREATE_BLOCK) || (*op == SG_UPDATE_BLOCK)) && (data_indicator != 1)) {
+        return( -1 );
+    }
+    if (((*op == SG_PATCH_BLOCK) != (data_indicator == SG_PATCH_DATA)) ||
+            ((*op == SG_COMPOUND_OPS) != (data_indicator == SG_COMPOUND_DATA))) {
+        return( -1 );
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgLocalPackPacket
+// Description  : Build a ScatterGather reply packet
+//
+// Inputs       : loc, rem, blk, op, sseq, rseq - the packet fields
+//                data - the block data, the bytes of a patch or NULL
+//                poff, plength - the byte range of a patch (plength 0 if not a patch)
+//                packet - the buffer for the packet
+//                plen - the size of the buffer (set to the packet length)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgLocalPackPacket( SG_Node_ID loc, SG_Node_ID rem, SG_Block_ID blk, SG_System_OP op,
+        SG_SeqNum sseq, SG_SeqNum rseq, char *data, uint32_t poff, uint32_t plength,
+        char *packet, size_t *plen ) {
+
+    uint32_t magic = SG_MAGIC_VALUE;
+    uint8_t data_indicator = (data == NULL) ? 0 : (plength > 0) ? SG_PATCH_DATA : 1;
+    size_t off = 0;
+
+    if (*plen < ((data_indicator == SG_PATCH_DATA) ? SG_PATCH_PACKET_SIZE(plength) :
+            data ? SG_DATA_PACKET_SIZE : SG_BASE_PACKET_SIZE)) {
+        return( -1 );
+    }
+    memcpy(packet + off, &magic, sizeof(magic));
+    off += sizeof(magic);
+    memcpy(packet + off, &loc, sizeof(loc));
+    off += sizeof(loc);
+    memcpy(packet + off, &rem, sizeof(rem));
+    off += sizeof(rem);
+    memcpy(packet + off, &blk, sizeof(blk));
+    off += sizeof(blk);
+    memcpy(packet + off, &op, sizeof(op));
+    off += sizeof(op);
+    memcpy(packet + off, &sseq, sizeof(sseq));
+    off += sizeof(sseq);
+    memcpy(packet + off, &rseq, sizeof(rseq));
+    off += sizeof(rseq);
+    memcpy(packet + off, &data_indicator, sizeof(data_indicator));
+    off += sizeof(data_indicator);
+    if (data_indicator == SG_PATCH_DATA) {
+        memcpy(packet + off, &poff, sizeof(poff));
+        off += sizeof(poff);
+        memcpy(packet + off, &plength, sizeof(plength));
+        off += sizeof(plength);
+        memcpy(packet + off, data, plength);
+        off += plength;
+    } else if (data != NULL) {
+        memcpy(packet + off, data, SG_BLOCK_SIZE);
+        off += SG_BLOCK_SIZE;
+    }
+    memcpy(packet + off, &magic, sizeof(magic));
+    off += sizeof(magic);
+    *plen = off;
+    return( 0 );
+}
@@ -0,0 +1,44 @@
+#ifndef SG_LOCAL_SERVICE_INCLUDED
+#define SG_LOCAL_SERVICE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_local_service.h
+//  Description    : This is the declaration of the interface to the local
+//                   stand-in for the ScatterGather service.  It speaks the
+//                   same packet protocol as sgServicePost, but keeps its
+//                   blocks in memory, honors the node requested on create
+//                   and can serve requests for different nodes concurrently.
+//                   It also takes byte range patches (SG_PATCH_BLOCK) and
+//                   compound packets of several block operations on a node
+//                   (SG_COMPOUND_OPS), which it advertises in its reply to
+//                   SG_INIT_ENDPOINT.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <sg_defs.h>
+
+// Defines
+#define SG_LOCAL_MAX_NODES 64        // Maximum number of storage nodes
+#define SG_LOCAL_DEFAULT_NODES 8     // Default number of storage nodes
+#define SG_LOCAL_SEQ_WINDOW 1024     // Sequence numbers accepted ahead of expected (multiple of 64)
+#define SG_LOCAL_BLOCK_BUCKETS 1024  // Hash buckets per node block table
+
+// Global interface definitions
+
+int sgLocalServicePost( char *packet, size_t *len, char *rpacket, size_t *rlen );
+    // Post a packet to the local ScatterGather service
+
+int sgLocalServiceConfigure( int nodes, uint32_t latency );
+    // Set the number of nodes and per-request latency (usec), before init
+
+int sgLocalServiceSlowNodes( int nodes, uint32_t stall, int percent );
+    // Make the first nodes stall (usec) on a percentage of their requests
+
+int sgLocalServiceFeatures( uint32_t features );
+    // Set the protocol extensions advertised at init (SG_FEATURE_*)
+
+#endif
@@ -0,0 +1,768 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_mrc.c
+//  Description    : This is the miss ratio curve analyzer for ScatterGather
+//                   workloads.  It replays a workload (text or binary) through
+//                   the driver's mapping of file offsets to blocks, computes
+//                   the reuse (stack) distance of every block access and from
+//                   them the miss ratio of an LRU cache of any size.  Huge
+//                   traces can be sampled by block (SHARDS) instead.  It also
+//                   simulates several replacement policies side by side at
+//                   chosen cache sizes and reports the sequential/random mix
+//                   and operation size distribution of the workload.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmpsc311_log.h>
+#include <cmpsc311_workload.h>
+
+// Project Includes
+#include <sg_defs.h>
+#include <sg_cache.h>
+#include <sg_workload.h>
+
+// Defines
+#define SG_MRC_ARGUMENTS "hvr:s:"
+#define USAGE \
+	"USAGE: sg_mrc [-h] [-v] [-r <rate>] [-s <sizes>] <workload>\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"    -v - verbose output\n" \
+	"    -r - sample blocks at this rate (0 < rate <= 1, SHARDS), default 1\n" \
+	"    -s - comma separated cache sizes (blocks) to simulate policies at\n" \
+	"\n" \
+	"    workload - the workload file (text, or binary from sg_wlconvert)\n" \
+	"\n" \
+
+#define SG_MRC_MAX_SIZES 16
+#define SG_MRC_SIZE_BUCKETS 16      // Operation size histogram (powers of 2)
+#define SG_MRC_SAMPLE_MODULUS (1 << 24)
+#define SG_MRC_NOT_CACHED ((size_t)-1)
+
+// Type definitions
+typedef enum {
+	SG_MRC_LRU    = 0, // Least recently used (the driver's policy)
+	SG_MRC_FIFO   = 1, // First in, first out
+	SG_MRC_CLOCK  = 2, // Second chance
+	SG_MRC_RANDOM = 3, // Random eviction
+	SG_MRC_OPT    = 4, // Belady's optimal (offline)
+	SG_MRC_MAXVAL = 5
+} SG_Mrc_Policy;
+
+/* Hash table of 64 bit keys to 64 bit values */
+typedef struct {
+	uint64_t *keys;
+	uint64_t *vals;
+	uint8_t  *used;
+	size_t    capacity;
+	size_t    count;
+} mrctable_t;
+
+/* Access statistics of one kind of operation */
+typedef struct {
+	uint64_t ops;
+	uint64_t bytes;
+	uint64_t sequential;
+	uint64_t min, max;
+	uint64_t sizes[SG_MRC_SIZE_BUCKETS];
+} mrcopstats_t;
+
+/* The cache being simulated */
+typedef struct {
+	SG_Mrc_Policy policy;
+	size_t     size;
+	size_t     used;
+	uint64_t  *keys;     // the block in each slot
+	uint64_t  *next;     // the next use of the block in each slot (OPT)
+	uint8_t   *ref;      // reference bits (CLOCK)
+	size_t    *newer;    // recency list (LRU)
+	size_t    *older;
+	size_t     head, tail, hand;
+	mrctable_t index;    // block to slot
+	uint64_t   hits;
+} mrccache_t;
+
+//
+// Global Data
+const char *sg_mrc_policy_strings[SG_MRC_MAXVAL] = { "LRU", "FIFO", "CLOCK", "RANDOM", "OPT" };
+
+//
+// Functional Prototypes
+
+int mrcReadWorkload( char *wload, uint64_t **accesses, size_t *num, mrcopstats_t *stats );
+int mrcAddOperation( workload_operations_type op, const char *objname, size_t pos, size_t size,
+		mrcopstats_t *stats, mrctable_t *objects, uint64_t **accesses, size_t *num, size_t *max );
+int mrcStackDistances( uint64_t *accesses, size_t num, double rate, uint64_t **histogram,
+		size_t *distinct, uint64_t *cold, uint64_t *sampled );
+double mrcMissRatio( uint64_t *histogram, size_t distinct, uint64_t cold, uint64_t total, double size );
+uint64_t mrcSimulate( uint64_t *accesses, uint64_t *next, size_t num, SG_Mrc_Policy policy, size_t size );
+void mrcReport( const char *name, mrcopstats_t *stats );
+uint64_t mrcHash( uint64_t key );
+uint64_t mrcHashString( const char *str );
+int mrcTableInit( mrctable_t *table, size_t capacity );
+uint64_t *mrcTableFind( mrctable_t *table, uint64_t key );
+uint64_t *mrcTableInsert( mrctable_t *table, uint64_t key, uint64_t val );
+int mrcTableDelete( mrctable_t *table, uint64_t key );
+void mrcTableFree( mrctable_t *table );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the miss ratio curve analyzer
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	size_t sizes[SG_MRC_MAX_SIZES] = { 32, 64, SG_MAX_CACHE_ELEMENTS, 256, 512 };
+	int ch, verbose = 0, num_sizes = 5;
+	mrcopstats_t stats[WLT_MAX_WORKLOAD_OP_TYPE];
+	uint64_t *accesses, *next, *histogram, cold, sampled, hits;
+	size_t num, distinct;
+	mrctable_t last;
+	double rate = 1.0;
+	char *tok;
+
+	// Process the command line parameters
+	while ((ch = getopt(argc, argv, SG_MRC_ARGUMENTS)) != -1) {
+
+		switch (ch) {
+		case 'h': // Help, print usage
+			fprintf( stderr, USAGE );
+			return( -1 );
+
+		case 'v': // Verbose Flag
+			verbose = 1;
+			break;
+
+		case 'r': // Sampling rate
+			rate = atof( optarg );
+			if ( (rate <= 0) || (rate > 1) ) {
+				fprintf( stderr, "Bad sampling rate (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 's': // Cache sizes
+			num_sizes = 0;
+			for ( tok = strtok(optarg, ","); tok != NULL; tok = strtok(NULL, ",") ) {
+				if ( (num_sizes == SG_MRC_MAX_SIZES) || (atol(tok) < 1) ) {
+					fprintf( stderr, "Bad cache sizes, aborting.\n" );
+					return( -1 );
+				}
+				sizes[num_sizes++] = atol( tok );
+			}
+			break;
+
+		default:  // Default (unknown)
+			fprintf( stderr, "Unknown command line option (%c), aborting.\n", ch );
+			return( -1 );
+		}
+	}
+
+	// Setup the log, check the workload
+	initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+	if ( verbose ) {
+		enableLogLevels( LOG_INFO_LEVEL );
+	}
+	if ( argv[optind] == NULL ) {
+		fprintf( stderr, "Missing command line parameters, use -h to see usage, aborting.\n" );
+		return( -1 );
+	}
+
+	// Read the workload into its block accesses
+	if ( mrcReadWorkload(argv[optind], &accesses, &num, stats) ) {
+		return( -1 );
+	}
+	printf( "Workload %s: %lu block accesses (%d byte blocks)\n", argv[optind], num, SG_BLOCK_SIZE );
+	mrcReport( "reads", &stats[WL_READ] );
+	mrcReport( "writes", &stats[WL_WRITE] );
+	if ( num == 0 ) {
+		free( accesses );
+		return( 0 );
+	}
+
+	// The miss ratio curve of an LRU cache, from the stack distances
+	if ( mrcStackDistances(accesses, num, rate, &histogram, &distinct, &cold, &sampled) ) {
+		free( accesses );
+		return( -1 );
+	}
+	printf( "\nMiss ratio curve (LRU, %s, %lu of %lu accesses sampled, ~%.0f distinct blocks)\n",
+		(rate < 1) ? "SHARDS" : "exact", sampled, num, distinct / rate );
+	printf( "  %10s  %10s\n", "blocks", "miss ratio" );
+	for ( double size = 1; ; size *= 2 ) {
+		printf( "  %10.0f  %10.4f\n", size, mrcMissRatio(histogram, distinct, cold, sampled, size * rate) );
+		if ( size >= distinct / rate ) {
+			break;
+		}
+	}
+	for ( int i=0; i<num_sizes; i++ ) {
+		printf( "  %10lu  %10.4f  (requested)\n", sizes[i], mrcMissRatio(histogram, distinct, cold, sampled, sizes[i] * rate) );
+	}
+
+	// The next use of each access, for the optimal policy
+	next = malloc( num * sizeof(uint64_t) );
+	mrcTableInit( &last, 1024 );
+	for ( size_t i=num; i-- > 0; ) {
+		uint64_t *when = mrcTableFind( &last, accesses[i] );
+		next[i] = (when != NULL) ? *when : UINT64_MAX;
+		mrcTableInsert( &last, accesses[i], i );
+	}
+	mrcTableFree( &last );
+
+	// Simulate the policies side by side
+	printf( "\nPolicy miss ratios\n  %10s", "blocks" );
+	for ( int p=0; p<SG_MRC_MAXVAL; p++ ) {
+		printf( "  %8s", sg_mrc_policy_strings[p] );
+	}
+	printf( "\n" );
+	for ( int i=0; i<num_sizes; i++ ) {
+		printf( "  %10lu", sizes[i] );
+		for ( int p=0; p<SG_MRC_MAXVAL; p++ ) {
+			hits = mrcSimulate( accesses, next, num, p, sizes[i] );
+			printf( "  %8.4f", 1.0 - (double)hits / num );
+		}
+		printf( "\n" );
+	}
+
+	free( histogram );
+	free( next );
+	free( accesses );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcReadWorkload
+// Description  : Read a workload into the sequence of block accesses it makes
+//
+// Inputs       : wload - the workload filename
+//                accesses - the block accesses (allocated, returned)
+//                num - the number of accesses (returned)
+//                stats - the per operation statistics (returned)
+// Outputs      : 0 if successful, -1 if failure
+
+int mrcReadWorkload( char *wload, uint64_t **accesses, size_t *num, mrcopstats_t *stats ) {
+
+	workload_state state;
+	workload_operation operation;
+	sg_workload_t binary;
+	const sg_workload_op_t *record;
+	mrctable_t objects;
+	size_t max = 0;
+	int ret = 0;
+
+	*accesses = NULL;
+	*num = 0;
+	memset( stats, 0x0, sizeof(mrcopstats_t) * WLT_MAX_WORKLOAD_OP_TYPE );
+	mrcTableInit( &objects, 1024 );
+
+	// Binary workloads are iterated in place, text ones are parsed
+	if ( sgWorkloadIsBinary(wload) ) {
+		if ( sgWorkloadOpen(&binary, wload) ) {
+			mrcTableFree( &objects );
+			return( -1 );
+		}
+		while ( ((record = sgWorkloadNext(&binary)) != NULL) && (record->op != WL_EOF) ) {
+			mrcAddOperation( record->op, sgWorkloadObject(&binary, record), record->pos, record->size,
+				stats, &objects, accesses, num, &max );
+		}
+		if ( record == NULL ) {
+			logMessage( LOG_ERROR_LEVEL, "sg_mrc: binary workload [%s] ended without EOF", wload );
+			ret = -1;
+		}
+		sgWorkloadClose( &binary );
+	} else {
+		if ( openCmpsc311Workload(&state, wload) ) {
+			logMessage( LOG_ERROR_LEVEL, "sg_mrc: failed opening workload [%s]", wload );
+			mrcTableFree( &objects );
+			return( -1 );
+		}
+		do {
+			if ( readCmpsc311Workload(&state, &operation) ) {
+				logMessage( LOG_ERROR_LEVEL, "sg_mrc: failed reading workload at line %d", state.lineno );
+				ret = -1;
+				break;
+			}
+			if ( operation.op != WL_EOF ) {
+				mrcAddOperation( operation.op, operation.objname, operation.pos, operation.size,
+					stats, &objects, accesses, num, &max );
+			}
+		} while ( operation.op != WL_EOF );
+		closeCmpsc311Workload( &state );
+	}
+
+	mrcTableFree( &objects );
+	if ( ret ) {
+		free( *accesses );
+		*accesses = NULL;
+	}
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcAddOperation
+// Description  : Add the block accesses and statistics of an operation
+//
+// Inputs       : op, objname, pos, size - the operation
+//                stats - the per operation statistics
+//                objects - the end of the last access to each object
+//                accesses, num, max - the block access array (grown as needed)
+// Outputs      : 0 if successful, -1 if failure
+
+int mrcAddOperation( workload_operations_type op, const char *objname, size_t pos, size_t size,
+		mrcopstats_t *stats, mrctable_t *objects, uint64_t **accesses, size_t *num, size_t *max ) {
+
+	uint64_t object = mrcHashString( objname ), *end;
+	int bucket = 0;
+
+	// the object's blocks are named by the object and block index, as the driver lays them out
+	if ( (op != WL_READ) && (op != WL_WRITE) ) {
+		if ( op == WL_OPEN ) {
+			mrcTableInsert( objects, object, 0 );
+		}
+		return( 0 );
+	}
+	stats[op].ops ++;
+	stats[op].bytes += size;
+	if ( (stats[op].ops == 1) || (size < stats[op].min) ) {
+		stats[op].min = size;
+	}
+	if ( size > stats[op].max ) {
+		stats[op].max = size;
+	}
+	while ( (bucket < SG_MRC_SIZE_BUCKETS-1) && ((size >> bucket) > 1) ) {
+		bucket ++;
+	}
+	stats[op].sizes[bucket] ++;
+
+	// an operation continuing where the last one on the object ended is sequential
+	end = mrcTableFind( objects, object );
+	if ( (end != NULL) && (*end == pos) ) {
+		stats[op].sequential ++;
+	}
+	mrcTableInsert( objects, object, pos + size );
+
+	for ( size_t blk = pos / SG_BLOCK_SIZE; (size > 0) && (blk <= (pos + size - 1) / SG_BLOCK_SIZE); blk++ ) {
+		if ( *num == *max ) {
+			*max = (*max == 0) ? 4096 : *max * 2;
+			*accesses = realloc( *accesses, *max * sizeof(uint64_t) );
+		}
+		(*accesses)[(*num)++] = mrcHash( object ^ mrcHash(blk) );
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcStackDistances
+// Description  : Compute the LRU stack distance histogram of the accesses.  The
+//                distance of an access is the number of distinct blocks used
+//                since the last access to its block, counted with a Fenwick
+//                tree holding a mark at the latest access of every block.  At
+//                rates below 1 only the blocks whose hash falls under the rate
+//                are tracked (SHARDS), scale distances by 1/rate to read it.
+//
+// Inputs       : accesses, num - the block accesses
+//                rate - the sampling rate
+//                histogram - the distance histogram (allocated, returned)
+//                distinct - the number of distinct sampled blocks (returned)
+//                cold - the number of first accesses (returned)
+//                sampled - the number of sampled accesses (returned)
+// Outputs      : 0 if successful, -1 if failure
+
+int mrcStackDistances( uint64_t *accesses, size_t num, double rate, uint64_t **histogram,
+		size_t *distinct, uint64_t *cold, uint64_t *sampled ) {
+
+	uint64_t threshold = (uint64_t)(rate * SG_MRC_SAMPLE_MODULUS), *prev, d;
+	mrctable_t last;
+	uint32_t *tree;
+	size_t t = 0;
+
+	tree = calloc( num + 1, sizeof(uint32_t) );
+	*histogram = calloc( num + 1, sizeof(uint64_t) );
+	*distinct = 0;
+	*cold = 0;
+	*sampled = 0;
+	mrcTableInit( &last, 1024 );
+
+	for ( size_t i=0; i<num; i++ ) {
+		if ( (accesses[i] % SG_MRC_SAMPLE_MODULUS) >= threshold ) {
+			continue;
+		}
+		t ++;
+		(*sampled) ++;
+		if ( (prev = mrcTableFind(&last, accesses[i])) == NULL ) {
+			(*cold) ++;
+			(*distinct) ++;
+		} else {
+			// marks after the previous access are the distinct blocks used since
+			d = 0;
+			for ( size_t x = t - 1; x > 0; x -= x & -x ) {
+				d += tree[x];
+			}
+			for ( size_t x = *prev; x > 0; x -= x & -x ) {
+				d -= tree[x];
+			}
+			(*histogram)[d] ++;
+			for ( size_t x = *prev; x <= num; x += x & -x ) {
+				tree[x] --;
+			}
+		}
+		for ( size_t x = t; x <= num; x += x & -x ) {
+			tree[x] ++;
+		}
+		mrcTableInsert( &last, accesses[i], t );
+	}
+
+	mrcTableFree( &last );
+	free( tree );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcMissRatio
+// Description  : The miss ratio of an LRU cache from the distance histogram
+//
+// Inputs       : histogram, distinct, cold, total - the distance histogram
+//                size - the cache size (in sampled blocks)
+// Outputs      : the miss ratio
+
+double mrcMissRatio( uint64_t *histogram, size_t distinct, uint64_t cold, uint64_t total, double size ) {
+
+	uint64_t misses = cold;
+
+	// an access hits if fewer distinct blocks than the cache holds were used since
+	for ( size_t d = (size_t)size; d < distinct; d++ ) {
+		misses += histogram[d];
+	}
+	return( (total > 0) ? (double)misses / total : 0.0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcSimulate
+// Description  : Simulate a cache with a replacement policy over the accesses
+//
+// Inputs       : accesses, next, num - the block accesses and their next uses
+//                policy - the replacement policy
+//                size - the cache size (blocks)
+// Outputs      : the number of hits
+
+uint64_t mrcSimulate( uint64_t *accesses, uint64_t *next, size_t num, SG_Mrc_Policy policy, size_t size ) {
+
+	mrccache_t cache;
+	uint64_t *slotp;
+	size_t slot;
+	unsigned int seed = 311;
+
+	memset( &cache, 0x0, sizeof(cache) );
+	cache.policy = policy;
+	cache.size = size;
+	cache.keys = calloc( size, sizeof(uint64_t) );
+	cache.next = calloc( size, sizeof(uint64_t) );
+	cache.ref = calloc( size, sizeof(uint8_t) );
+	cache.newer = calloc( size, sizeof(size_t) );
+	cache.older = calloc( size, sizeof(size_t) );
+	cache.head = cache.tail = SG_MRC_NOT_CACHED;
+	mrcTableInit( &cache.index, size * 2 );
+
+	for ( size_t i=0; i<num; i++ ) {
+
+		// a hit updates the policy state of the slot
+		if ( (slotp = mrcTableFind(&cache.index, accesses[i])) != NULL ) {
+			slot = *slotp;
+			cache.hits ++;
+			cache.ref[slot] = 1;
+			cache.next[slot] = next[i];
+			if ( (policy == SG_MRC_LRU) && (cache.head != slot) ) {
+				if ( cache.tail == slot ) {
+					cache.tail = cache.newer[slot];
+				} else {
+					cache.newer[cache.older[slot]] = cache.newer[slot];
+				}
+				cache.older[cache.newer[slot]] = cache.older[slot];
+				cache.older[slot] = cache.head;
+				cache.newer[cache.head] = slot;
+				cache.head = slot;
+			}
+			continue;
+		}
+
+		// a miss fills a free slot or evicts the policy's victim
+		if ( cache.used < size ) {
+			slot = cache.used ++;
+		} else {
+			switch ( policy ) {
+			case SG_MRC_LRU:
+				slot = cache.tail;
+				if ( cache.head == slot ) {
+					cache.head = cache.tail = SG_MRC_NOT_CACHED;
+				} else {
+					cache.tail = cache.newer[slot];
+				}
+				break;
+			case SG_MRC_FIFO:
+				slot = cache.hand;
+				cache.hand = (cache.hand + 1) % size;
+				break;
+			case SG_MRC_CLOCK:
+				while ( cache.ref[cache.hand] ) {
+					cache.ref[cache.hand] = 0;
+					cache.hand = (cache.hand + 1) % size;
+				}
+				slot = cache.hand;
+				cache.hand = (cache.hand + 1) % size;
+				break;
+			case SG_MRC_RANDOM:
+				slot = rand_r( &seed ) % size;
+				break;
+			default: // OPT, evict the block used furthest in the future
+				slot = 0;
+				for ( size_t s=1; s<size; s++ ) {
+					if ( cache.next[s] > cache.next[slot] ) {
+						slot = s;
+					}
+				}
+				break;
+			}
+			mrcTableDelete( &cache.index, cache.keys[slot] );
+		}
+		cache.keys[slot] = accesses[i];
+		cache.next[slot] = next[i];
+		cache.ref[slot] = 0;
+		mrcTableInsert( &cache.index, accesses[i], slot );
+		if ( policy == SG_MRC_LRU ) {
+			cache.older[slot] = cache.head;
+			if ( cache.head != SG_MRC_NOT_CACHED ) {
+				cache.newer[cache.head] = slot;
+			} else {
+				cache.tail = slot;
+			}
+			cache.head = slot;
+		}
+	}
+
+	mrcTableFree( &cache.index );
+	free( cache.keys );
+	free( cache.next );
+	free( cache.ref );
+	free( cache.newer );
+	free( cache.older );
+	return( cache.hits );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcReport
+// Description  : Print the statistics of one kind of operation
+//
+// Inputs       : name - the kind of operation
+//                stats - its statistics
+// Outputs      : none
+
+void mrcReport( const char *name, mrcopstats_t *stats ) {
+
+	if ( stats->ops == 0 ) {
+		printf( "  %-6s: none\n", name );
+		return;
+	}
+	printf( "  %-6s: %lu ops, %lu bytes, sizes %lu-%lu (mean %lu), %.1f%% sequential, %.1f%% random\n",
+		name, stats->ops, stats->bytes, stats->min, stats->max, stats->bytes / stats->ops,
+		100.0 * stats->sequential / stats->ops, 100.0 * (stats->ops - stats->sequential) / stats->ops );
+	for ( int b=0; b<SG_MRC_SIZE_BUCKETS; b++ ) {
+		if ( stats->sizes[b] > 0 ) {
+			printf( "            <= %6lu bytes: %lu ops (%.1f%%)\n", (uint64_t)2 << b, stats->sizes[b],
+				100.0 * stats->sizes[b] / stats->ops );
+		}
+	}
+}
+
+//
+// Hash table support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcHash
+// Description  : Mix a 64 bit key into a well distributed hash (splitmix64)
+//
+// Inputs       : key - the key
+// Outputs      : the hash
+
+uint64_t mrcHash( uint64_t key ) {
+
+	key += 0x9e3779b97f4a7c15ULL;
+	key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+	return( key ^ (key >> 31) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcHashString
+// Description  : Hash a string (FNV-1a)
+//
+// Inputs       : str - the string
+// Outputs      : the hash
+
+uint64_t mrcHashString( const char *str ) {
+
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for ( ; *str; str++ ) {
+		hash = (hash ^ (unsigned char)*str) * 0x100000001b3ULL;
+	}
+	return( hash );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcTableInit
+// Description  : Create an (open addressing) hash table
+//
+// Inputs       : table - the table
+//                capacity - the initial capacity
+// Outputs      : 0 if successful, -1 if failure
+
+int mrcTableInit( mrctable_t *table, size_t capacity ) {
+
+	table->capacity = 16;
+	while ( table->capacity < capacity ) {
+		table->capacity *= 2;
+	}
+	table->keys = malloc( table->capacity * sizeof(uint64_t) );
+	table->vals = malloc( table->capacity * sizeof(uint64_t) );
+	table->used = calloc( table->capacity, sizeof(uint8_t) );
+	table->count = 0;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcTableFind
+// Description  : Find the value of a key
+//
+// Inputs       : table - the table
+//                key - the key
+// Outputs      : pointer to the value or NULL if not found
+
+uint64_t *mrcTableFind( mrctable_t *table, uint64_t key ) {
+
+	size_t i = mrcHash( key ) & (table->capacity - 1);
+
+	while ( table->used[i] ) {
+		if ( table->keys[i] == key ) {
+			return( &table->vals[i] );
+		}
+		i = (i + 1) & (table->capacity - 1);
+	}
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcTableInsert
+// Description  : Insert or replace the value of a key, growing the table when
+//                it is half full
+//
+// Inputs       : table - the table
+//                key - the key
+//                val - the value
+// Outputs      : pointer to the value
+
+uint64_t *mrcTableInsert( mrctable_t *table, uint64_t key, uint64_t val ) {
+
+	mrctable_t bigger;
+	uint64_t *found;
+	size_t i;
+
+	if ( (found = mrcTableFind(table, key)) != NULL ) {
+		*found = val;
+		return( found );
+	}
+	if ( (table->count + 1) * 2 > table->capacity ) {
+		mrcTableInit( &bigger, table->capacity * 2 );
+		for ( i=0; i<table->capacity; i++ ) {
+			if ( table->used[i] ) {
+				mrcTableInsert( &bigger, table->keys[i], table->vals[i] );
+			}
+		}
+		mrcTableFree( table );
+		*table = bigger;
+	}
+	i = mrcHash( key ) & (table->capacity - 1);
+	while ( table->used[i] ) {
+		i = (i + 1) & (table->capacity - 1);
+	}
+	table->used[i] = 1;
+	table->keys[i] = key;
+	table->vals[i] = val;
+	table->count ++;
+	return( &table->vals[i] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcTableDelete
+// Description  : Remove a key, moving back the entries that probed past it
+//
+// Inputs       : table - the table
+//                key - the key
+// Outputs      : 0 if removed, -1 if not found
+
+int mrcTableDelete( mrctable_t *table, uint64_t key ) {
+
+	size_t mask = table->capacity - 1, i, j, home;
+
+	for ( i = mrcHash(key) & mask; table->used[i] && (table->keys[i] != key); i = (i + 1) & mask );
+	if ( !table->used[i] ) {
+		return( -1 );
+	}
+	table->used[i] = 0;
+	table->count --;
+
+	// re-place the rest of the cluster so lookups don't stop at the hole
+	for ( j = (i + 1) & mask; table->used[j]; j = (j + 1) & mask ) {
+		home = mrcHash( table->keys[j] ) & mask;
+		if ( ((j > i) && ((home <= i) || (home > j))) || ((j < i) && ((home <= i) && (home > j))) ) {
+			table->keys[i] = table->keys[j];
+			table->vals[i] = table->vals[j];
+			table->used[i] = 1;
+			table->used[j] = 0;
+			i = j;
+		}
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mrcTableFree
+// Description  : Free a hash table
+//
+// Inputs       : table - the table
+// Outputs      : none
+
+void mrcTableFree( mrctable_t *table ) {
+
+	free( table->keys );
+	free( table->vals );
+	free( table->used );
+	memset( table, 0x0, sizeof(mrctable_t) );
+}
@@ -0,0 +1,402 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_placement.c
+//  Description    : This file contains the block placement layer of the scatter
+//                   gather driver.  Nodes are learned from the replies of the
+//                   service, and for each one the layer tracks the requests in
+//                   flight, a moving average of the request latency and the
+//                   number of blocks placed on it.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_placement.h>
+
+// Defines
+//struct for the load information of a node
+typedef struct pnode {
+    SG_Node_ID node_id;
+    int inflight;
+    long blocks;
+    unsigned long requests;
+    uint64_t latency;  // moving average latency (nsec)
+} pnode_t;
+//struct for a point on the consistent hash ring
+typedef struct ringpt {
+    uint64_t hash;
+    int node;
+} ringpt_t;
+//struct for the placement state
+typedef struct placement {
+    SG_Placement_Policy policy;
+    unsigned long choices;
+    int num_nodes;
+    pnode_t nodes[SG_PLACE_MAX_NODES];
+    int ring_size;
+    ringpt_t ring[SG_PLACE_MAX_NODES * SG_PLACE_VNODES];
+    pthread_mutex_t lock;
+} placement_t;
+
+// Functional Prototypes
+pnode_t *sgPlacementFindNode( SG_Node_ID nde, int add );
+int sgPlacementExcluded( SG_Node_ID nde, SG_Node_ID *exclude, int num );
+uint64_t sgPlacementHash( uint64_t key );
+int sgPlacementRingCompare( const void *a, const void *b );
+
+//
+// Global Data
+placement_t sgPlacement = { .policy = SG_PLACE_SERVICE, .lock = PTHREAD_MUTEX_INITIALIZER };
+const char *sg_placement_strings[SG_PLACE_MAXVAL] = { "service", "round-robin", "least-loaded", "hash" };
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : initSGPlacement
+// Description  : Initialize the placement layer with a policy
+//
+// Inputs       : policy - the placement policy
+// Outputs      : 0 if successful, -1 if failure
+
+int initSGPlacement( SG_Placement_Policy policy ) {
+
+    if ((policy < 0) || (policy >= SG_PLACE_MAXVAL)) {
+        logMessage(LOG_ERROR_LEVEL, "initSGPlacement: bad placement policy [%d]", policy);
+        return( -1 );
+    }
+    pthread_mutex_lock(&sgPlacement.lock);
+    sgPlacement.policy = policy;
+    sgPlacement.choices = 0;
+    sgPlacement.num_nodes = 0;
+    sgPlacement.ring_size = 0;
+    pthread_mutex_unlock(&sgPlacement.lock);
+    logMessage(LOG_INFO_LEVEL, "initSGPlacement: using %s placement", sg_placement_strings[policy]);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : closeSGPlacement
+// Description  : Close the placement layer, log the per-node statistics
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int closeSGPlacement( void ) {
+
+    pthread_mutex_lock(&sgPlacement.lock);
+    for (int i = 0; i < sgPlacement.num_nodes; i++) {
+        logMessage(LOG_INFO_LEVEL, "Node [%lu]: %ld blocks, %lu requests, %lu ns average latency.",
+                sgPlacement.nodes[i].node_id, sgPlacement.nodes[i].blocks,
+                sgPlacement.nodes[i].requests, sgPlacement.nodes[i].latency);
+    }
+    sgPlacement.num_nodes = 0;
+    sgPlacement.ring_size = 0;
+    pthread_mutex_unlock(&sgPlacement.lock);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPlacementChoose
+// Description  : Choose the node for a new block of a file.  Nodes are only
+//                known once the service has placed a block on them, so
+//                every so often the service is left to pick the node.
+//
+// Inputs       : fh - the file handle
+//                index - the logical block index in the file
+// Outputs      : the node ID, SG_NODE_UNKNOWN to let the service choose
+
+SG_Node_ID sgPlacementChoose( SgFHandle fh, int index ) {
+
+    SG_Node_ID nde = SG_NODE_UNKNOWN;
+    uint64_t hash, score, best = 0;
+    int lo, hi, mid;
+
+    pthread_mutex_lock(&sgPlacement.lock);
+    if ((sgPlacement.num_nodes == 0) || ((sgPlacement.choices++ % SG_PLACE_PROBE_INTERVAL) == 0)) {
+        pthread_mutex_unlock(&sgPlacement.lock);
+        return( SG_NODE_UNKNOWN );
+    }
+
+    switch (sgPlacement.policy) {
+
+        case SG_PLACE_ROUND_ROBIN: // Consecutive blocks of a file go to consecutive nodes
+            nde = sgPlacement.nodes[((unsigned)fh + (unsigned)index) % sgPlacement.num_nodes].node_id;
+            break;
+
+        case SG_PLACE_LEAST_LOADED: // Weigh requests in flight and blocks held by latency
+            for (int i = 0; i < sgPlacement.num_nodes; i++) {
+                score = (uint64_t)(sgPlacement.nodes[i].inflight + 1) *
+                        (uint64_t)(sgPlacement.nodes[i].blocks + 1) *
+                        ((sgPlacement.nodes[i].latency / 1000) + 1);
+                if ((i == 0) || (score < best)) {
+                    best = score;
+                    nde = sgPlacement.nodes[i].node_id;
+                }
+            }
+            break;
+
+        case SG_PLACE_HASH: // First ring point at or after the hash of the block
+            hash = sgPlacementHash(((uint64_t)(uint32_t)fh << 32) | (uint32_t)index);
+            lo = 0;
+            hi = sgPlacement.ring_size;
+            while (lo < hi) {
+                mid = (lo + hi) / 2;
+                if (sgPlacement.ring[mid].hash < hash) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            nde = sgPlacement.nodes[sgPlacement.ring[lo % sgPlacement.ring_size].node].node_id;
+            break;
+
+        default: // The service picks
+            break;
+    }
+
+    pthread_mutex_unlock(&sgPlacement.lock);
+    return( nde );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPlacementChooseReplica
+// Description  : Choose the node for another copy of a block.  With hash
+//                placement it is the next distinct node along the ring,
+//                otherwise the least loaded node not holding a copy yet.
+//
+// Inputs       : fh - the file handle
+//                index - the logical block index in the file
+//                exclude - the nodes already holding a copy
+//                num - the number of nodes in exclude
+// Outputs      : the node ID, SG_NODE_UNKNOWN if every known node has a copy
+
+SG_Node_ID sgPlacementChooseReplica( SgFHandle fh, int index, SG_Node_ID *exclude, int num ) {
+
+    SG_Node_ID nde = SG_NODE_UNKNOWN;
+    uint64_t hash, score, best = 0;
+    int lo, hi, mid;
+
+    pthread_mutex_lock(&sgPlacement.lock);
+    if ((sgPlacement.policy == SG_PLACE_HASH) && (sgPlacement.ring_size > 0)) {
+        hash = sgPlacementHash(((uint64_t)(uint32_t)fh << 32) | (uint32_t)index);
+        lo = 0;
+        hi = sgPlacement.ring_size;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (sgPlacement.ring[mid].hash < hash) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (int i = 0; i < sgPlacement.ring_size; i++) {
+            nde = sgPlacement.nodes[sgPlacement.ring[(lo + i) % sgPlacement.ring_size].node].node_id;
+            if (!sgPlacementExcluded(nde, exclude, num)) {
+                pthread_mutex_unlock(&sgPlacement.lock);
+                return( nde );
+            }
+        }
+        pthread_mutex_unlock(&sgPlacement.lock);
+        return( SG_NODE_UNKNOWN );
+    }
+
+    for (int i = 0; i < sgPlacement.num_nodes; i++) {
+        if (sgPlacementExcluded(sgPlacement.nodes[i].node_id, exclude, num)) {
+            continue;
+        }
+        score = (uint64_t)(sgPlacement.nodes[i].inflight + 1) *
+                (uint64_t)(sgPlacement.nodes[i].blocks + 1) *
+                ((sgPlacement.nodes[i].latency / 1000) + 1);
+        if ((nde == SG_NODE_UNKNOWN) || (score < best)) {
+            best = score;
+            nde = sgPlacement.nodes[i].node_id;
+        }
+    }
+    pthread_mutex_unlock(&sgPlacement.lock);
+    return( nde );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPlacementStart
+// Description  : Note that a request to a node has been sent
+//
+// Inputs       : nde - the node ID
+// Outputs      : none
+
+void sgPlacementStart( SG_Node_ID nde ) {
+
+    pnode_t *node;
+
+    pthread_mutex_lock(&sgPlacement.lock);
+    if ((node = sgPlacementFindNode(nde, 0)) != NULL) {
+        node->inflight++;
+    }
+    pthread_mutex_unlock(&sgPlacement.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPlacementRecord
+// Description  : Record the completion of a request to a node, learning about
+//                the node if we have not seen it before
+//
+// Inputs       : nde - the node ID (from the reply)
+//                op - the operation performed
+//                nsec - the latency of the request
+// Outputs      : none
+
+void sgPlacementRecord( SG_Node_ID nde, SG_System_OP op, uint64_t nsec ) {
+
+    pnode_t *node;
+
+    pthread_mutex_lock(&sgPlacement.lock);
+    if ((node = sgPlacementFindNode(nde, 1)) == NULL) {
+        pthread_mutex_unlock(&sgPlacement.lock);
+        return;
+    }
+
+    // update the in flight count, request count and latency average
+    if (node->inflight > 0) {
+        node->inflight--;
+    }
+    node->requests++;
+    if (node->latency == 0) {
+        node->latency = nsec;
+    } else {
+        node->latency = node->latency - (node->latency / SG_PLACE_LATENCY_WEIGHT) + (nsec / SG_PLACE_LATENCY_WEIGHT);
+    }
+    if (op == SG_CREATE_BLOCK) {
+        node->blocks++;
+    } else if ((op == SG_DELETE_BLOCK) && (node->blocks > 0)) {
+        node->blocks--;
+    }
+    pthread_mutex_unlock(&sgPlacement.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPlacementAddBlocks
+// Description  : Count the blocks a compound packet created on a node (the
+//                packet itself is recorded as one request)
+//
+// Inputs       : nde - the node ID
+//                num - the number of blocks created
+// Outputs      : none
+
+void sgPlacementAddBlocks( SG_Node_ID nde, int num ) {
+
+    pnode_t *node;
+
+    pthread_mutex_lock(&sgPlacement.lock);
+    if ((node = sgPlacementFindNode(nde, 0)) != NULL) {
+        node->blocks += num;
+    }
+    pthread_mutex_unlock(&sgPlacement.lock);
+}
+
+//
+// Placement support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPlacementFindNode
+// Description  : Find the load information of a node (placement lock held)
+//
+// Inputs       : nde - the node ID
+//                add - add the node (and its ring points) if not found
+// Outputs      : pointer to the node or NULL if not found
+
+pnode_t *sgPlacementFindNode( SG_Node_ID nde, int add ) {
+
+    pnode_t *node;
+
+    if ((nde == 0) || (nde == SG_NODE_UNKNOWN)) {
+        return( NULL );
+    }
+    for (int i = 0; i < sgPlacement.num_nodes; i++) {
+        if (sgPlacement.nodes[i].node_id == nde) {
+            return( &sgPlacement.nodes[i] );
+        }
+    }
+    if (!add || (sgPlacement.num_nodes == SG_PLACE_MAX_NODES)) {
+        return( NULL );
+    }
+
+    // add the node, and its points on the hash ring
+    node = &sgPlacement.nodes[sgPlacement.num_nodes];
+    memset(node, 0x0, sizeof(pnode_t));
+    node->node_id = nde;
+    for (int v = 0; v < SG_PLACE_VNODES; v++) {
+        sgPlacement.ring[sgPlacement.ring_size].hash = sgPlacementHash(nde ^ ((uint64_t)v * 0x9e3779b97f4a7c15ULL));
+        sgPlacement.ring[sgPlacement.ring_size].node = sgPlacement.num_nodes;
+        sgPlacement.ring_size++;
+    }
+    qsort(sgPlacement.ring, sgPlacement.ring_size, sizeof(ringpt_t), sgPlacementRingCompare);
+    sgPlacement.num_nodes++;
+    logMessage(LOG_INFO_LEVEL, "sgPlacement: learned node [%lu] (%d nodes)", nde, sgPlacement.num_nodes);
+    return( node );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPlacementExcluded
+// Description  : Check if a node is one of a list of nodes
+//
+// Inputs       : nde - the node ID
+//                exclude - the list of nodes
+//                num - the number of nodes in the list
+// Outputs      : 1 if the node is in the list, 0 if not
+
+int sgPlacementExcluded( SG_Node_ID nde, SG_Node_ID *exclude, int num ) {
+
+    for (int i = 0; i < num; i++) {
+        if (exclude[i] == nde) {
+            return( 1 );
+        }
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPlacementHash
+// Description  : Mix a 64 bit key into a well distributed hash (splitmix64)
+//
+// Inputs       : key - the key
+// Outputs      : the hash
+
+uint64_t sgPlacementHash( uint64_t key ) {
+
+    key += 0x9e3779b97f4a7c15ULL;
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return( key ^ (key >> 31) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgPlacementRingCompare
+// Description  : Order ring points by hash (qsort callback)
+//
+// Inputs       : a, b - the ring points
+// Outputs      : <0, 0, >0 as a is before, equal or after b
+
+int sgPlacementRingCompare( const void *a, const void *b ) {
+
+    const ringpt_t *x = a, *y = b;
+
+    return( (x->hash < y->hash) ? -1 : ((x->hash > y->hash) ? 1 : 0) );
+}
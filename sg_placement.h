@@ -0,0 +1,59 @@
+#ifndef SG_PLACEMENT_INCLUDED
+#define SG_PLACEMENT_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_placement.h
+//  Description    : This is the declaration of the block placement layer of
+//                   the scatter gather driver.  It tracks the load and latency
+//                   of each storage node and picks the node new blocks are
+//                   created on.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <sg_defs.h>
+
+//
+// Defines
+#define SG_PLACE_MAX_NODES 256     // Maximum number of nodes tracked
+#define SG_PLACE_VNODES 32         // Points per node on the consistent hash ring
+#define SG_PLACE_LATENCY_WEIGHT 8  // EWMA weight (1/n) of a new latency sample
+#define SG_PLACE_PROBE_INTERVAL 16 // Every n'th create lets the service pick (finds nodes)
+
+// Type definitions
+typedef enum {
+    SG_PLACE_SERVICE      = 0,  // Let the service pick the node
+    SG_PLACE_ROUND_ROBIN  = 1,  // Stripe each file's blocks over the nodes
+    SG_PLACE_LEAST_LOADED = 2,  // Node with the least load (in flight, latency, blocks)
+    SG_PLACE_HASH         = 3,  // Consistent hashing of (file, block)
+    SG_PLACE_MAXVAL       = 4   // Maximum value of the policy
+} SG_Placement_Policy;
+
+//
+// Placement functions
+
+int initSGPlacement( SG_Placement_Policy policy );
+    // Initialize the placement layer with a policy
+
+int closeSGPlacement( void );
+    // Close the placement layer, log the per-node statistics
+
+SG_Node_ID sgPlacementChoose( SgFHandle fh, int index );
+    // Choose the node for a new block (SG_NODE_UNKNOWN lets the service pick)
+
+SG_Node_ID sgPlacementChooseReplica( SgFHandle fh, int index, SG_Node_ID *exclude, int num );
+    // Choose a node for another copy of a block, not one of exclude (SG_NODE_UNKNOWN if none)
+
+void sgPlacementStart( SG_Node_ID nde );
+    // Note that a request to a node has been sent
+
+void sgPlacementRecord( SG_Node_ID nde, SG_System_OP op, uint64_t nsec );
+    // Record the completion of a request to a node and its latency
+
+void sgPlacementAddBlocks( SG_Node_ID nde, int num );
+    // Count blocks created on a node by a compound packet
+
+#endif
@@ -0,0 +1,466 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_sched.c
+//  Description    : This file contains the I/O scheduler of the scatter gather
+//                   driver.  A request waiting for a dispatch slot parks a
+//                   ticket on its class queue.  Each ticket is stamped with a
+//                   virtual finish time (start + 1/weight of its class) and a
+//                   freed slot goes to the earliest finish time among the
+//                   class queues that are under their cap.  Demand reads get
+//                   the largest share, background work the smallest.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_sched.h>
+#include <sg_trace.h>
+
+// Defines
+#define SG_SCHED_SCALE 1000000     // Virtual time of one request at weight 1
+#define SG_SCHED_BURST_SEC 1       // Seconds of rate a file may burst
+
+//struct for a request waiting for a dispatch slot
+typedef struct ticket {
+    struct ticket *next;
+    SG_Sched_Class cls;
+    int tenant;
+    SG_Node_ID nde;
+    SG_Block_ID blk;
+    uint64_t finish;    // virtual finish time
+    int state;          // SG_TICKET_WAITING, _GO or _CANCELLED
+    pthread_cond_t cond;
+} ticket_t;
+//struct for a traffic class
+typedef struct sclass {
+    ticket_t *head;     // FIFO of waiting tickets (finish times ascend)
+    ticket_t *tail;
+    int weight;
+    int cap;            // most requests of the class in flight
+    int inflight;
+    uint64_t last_finish;
+    unsigned long dispatched;
+    unsigned long queued;
+    unsigned long cancelled;
+    unsigned long promoted;
+    uint64_t wait_nsec;
+} sclass_t;
+//struct for a file rate limit (token bucket, in millionths of an op)
+typedef struct bucket {
+    int64_t tokens;
+    struct timespec last;
+} bucket_t;
+//struct for the scheduler state
+typedef struct sched {
+    int depth;
+    int inflight;
+    uint32_t rate;
+    uint64_t vtime;
+    sclass_t classes[SG_SCHED_MAXVAL];
+    bucket_t buckets[SG_SCHED_TENANTS];
+    unsigned long throttled;
+    pthread_mutex_t lock;
+} sched_t;
+
+enum { SG_TICKET_WAITING = 0, SG_TICKET_GO = 1, SG_TICKET_CANCELLED = 2 };
+
+// Functional Prototypes
+void sgSchedStamp( ticket_t *ticket );
+void sgSchedQueue( ticket_t *ticket );
+void sgSchedUnlink( ticket_t *ticket );
+void sgSchedDispatch( void );
+
+//
+// Global Data
+sched_t sgSched = { .depth = 1, .lock = PTHREAD_MUTEX_INITIALIZER };
+const int sg_sched_weights[SG_SCHED_MAXVAL] = { 8, 4, 2, 1 };
+const char *sg_sched_strings[SG_SCHED_MAXVAL] = { "read", "write", "prefetch", "background" };
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : initSGSched
+// Description  : Initialize the scheduler.  Prefetch and background work
+//                may use at most a quarter of the dispatch slots.
+//
+// Inputs       : depth - the number of packets in flight to the service
+//                rate - the block operations per second of each file (0 unlimited)
+// Outputs      : 0 if successful, -1 if failure
+
+int initSGSched( int depth, uint32_t rate ) {
+
+    if (depth < 1) {
+        logMessage(LOG_ERROR_LEVEL, "initSGSched: bad dispatch depth [%d]", depth);
+        return( -1 );
+    }
+    pthread_mutex_lock(&sgSched.lock);
+    sgSched.depth = depth;
+    sgSched.inflight = 0;
+    sgSched.rate = rate;
+    sgSched.vtime = 0;
+    sgSched.throttled = 0;
+    memset(sgSched.classes, 0x0, sizeof(sgSched.classes));
+    memset(sgSched.buckets, 0x0, sizeof(sgSched.buckets));
+    for (int c = 0; c < SG_SCHED_MAXVAL; c++) {
+        sgSched.classes[c].weight = sg_sched_weights[c];
+        sgSched.classes[c].cap = depth;
+    }
+    sgSched.classes[SG_SCHED_PREFETCH].cap = (depth >= 4) ? depth / 4 : 1;
+    sgSched.classes[SG_SCHED_BACKGROUND].cap = (depth >= 4) ? depth / 4 : 1;
+    pthread_mutex_unlock(&sgSched.lock);
+    logMessage(LOG_INFO_LEVEL, "initSGSched: %d packets in flight, %u block ops/sec per file", depth, rate);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : closeSGSched
+// Description  : Close the scheduler, log the per-class statistics
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int closeSGSched( void ) {
+
+    sclass_t *sc;
+
+    pthread_mutex_lock(&sgSched.lock);
+    for (int c = 0; c < SG_SCHED_MAXVAL; c++) {
+        sc = &sgSched.classes[c];
+        if (sc->dispatched + sc->cancelled == 0) {
+            continue;
+        }
+        logMessage(LOG_INFO_LEVEL, "Scheduler %s: %lu dispatched, %lu queued (%lu ns mean wait), %lu cancelled, %lu promoted.",
+                sg_sched_strings[c], sc->dispatched, sc->queued, sc->queued ? sc->wait_nsec / sc->queued : 0,
+                sc->cancelled, sc->promoted);
+    }
+    if (sgSched.rate > 0) {
+        logMessage(LOG_INFO_LEVEL, "Scheduler rate limit: %lu waits at %u block ops/sec per file.", sgSched.throttled, sgSched.rate);
+    }
+    pthread_mutex_unlock(&sgSched.lock);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSchedBegin
+// Description  : Wait for a dispatch slot.  A request goes straight out if a
+//                slot is free and nothing is queued ahead of it, otherwise
+//                it waits on its class queue until it is dispatched.
+//
+// Inputs       : cls - the traffic class of the request
+//                tenant - the file the request is for (SG_SCHED_NO_TENANT if none)
+//                nde - the node of the block
+//                blk - the block ID
+// Outputs      : 0 when the request may be posted, -1 if it was cancelled
+
+int sgSchedBegin( SG_Sched_Class cls, int tenant, SG_Node_ID nde, SG_Block_ID blk ) {
+
+    ticket_t ticket;
+    sclass_t *sc = &sgSched.classes[cls];
+    struct timespec start, end;
+    uint64_t tstart;
+    int queued = 0;
+
+    memset(&ticket, 0x0, sizeof(ticket));
+    ticket.cls = cls;
+    ticket.tenant = tenant;
+    ticket.nde = nde;
+    ticket.blk = blk;
+
+    pthread_mutex_lock(&sgSched.lock);
+    sgSchedStamp(&ticket);
+
+    // the fast path, nothing waiting
+    if ((sgSched.inflight < sgSched.depth) && (sc->inflight < sc->cap)) {
+        queued = 0;
+        for (int c = 0; (c < SG_SCHED_MAXVAL) && !queued; c++) {
+            queued = (sgSched.classes[c].head != NULL);
+        }
+        if (!queued) {
+            sgSched.vtime = ticket.finish;
+            sgSched.inflight++;
+            sc->inflight++;
+            sc->dispatched++;
+            pthread_mutex_unlock(&sgSched.lock);
+            return( 0 );
+        }
+    }
+
+    // wait on the class queue for a slot
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tstart = SG_TRACE_START();
+    pthread_cond_init(&ticket.cond, NULL);
+    sgSchedQueue(&ticket);
+    sgSchedDispatch();
+    while (ticket.state == SG_TICKET_WAITING) {
+        pthread_cond_wait(&ticket.cond, &sgSched.lock);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    SG_TRACE_SPAN(SG_TEV_SCHED_WAIT, tstart, cls);
+
+    // a promoted request was dispatched as a read, but is released in the class it began in
+    if (ticket.cls != cls) {
+        sgSched.classes[ticket.cls].inflight--;
+        sgSched.classes[cls].inflight++;
+    }
+    sc = &sgSched.classes[ticket.cls];
+    sc->queued++;
+    sc->wait_nsec += (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec);
+    pthread_mutex_unlock(&sgSched.lock);
+    pthread_cond_destroy(&ticket.cond);
+    return( (ticket.state == SG_TICKET_GO) ? 0 : -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSchedEnd
+// Description  : Release the dispatch slot of a request, handing it to the
+//                next request due
+//
+// Inputs       : cls - the traffic class the request was dispatched in
+// Outputs      : none
+
+void sgSchedEnd( SG_Sched_Class cls ) {
+
+    pthread_mutex_lock(&sgSched.lock);
+    sgSched.inflight--;
+    sgSched.classes[cls].inflight--;
+    sgSchedDispatch();
+    pthread_mutex_unlock(&sgSched.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSchedPromote
+// Description  : Move a queued prefetch of a block to the demand read queue,
+//                a caller is about to wait for the block it fetches
+//
+// Inputs       : nde - the node of the block
+//                blk - the block ID
+// Outputs      : 1 if a prefetch was promoted, 0 if not
+
+int sgSchedPromote( SG_Node_ID nde, SG_Block_ID blk ) {
+
+    ticket_t *ticket;
+
+    pthread_mutex_lock(&sgSched.lock);
+    for (ticket = sgSched.classes[SG_SCHED_PREFETCH].head; ticket != NULL; ticket = ticket->next) {
+        if ((ticket->nde == nde) && (ticket->blk == blk)) {
+            break;
+        }
+    }
+    if (ticket == NULL) {
+        pthread_mutex_unlock(&sgSched.lock);
+        return( 0 );
+    }
+    sgSchedUnlink(ticket);
+    sgSched.classes[SG_SCHED_PREFETCH].promoted++;
+    ticket->cls = SG_SCHED_READ;
+    sgSchedStamp(ticket);
+    sgSchedQueue(ticket);
+    sgSchedDispatch();
+    pthread_mutex_unlock(&sgSched.lock);
+    return( 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSchedCancel
+// Description  : Cancel the queued prefetches of a file (it was closed or
+//                stopped reading sequentially)
+//
+// Inputs       : tenant - the file
+// Outputs      : the number of prefetches cancelled
+
+int sgSchedCancel( int tenant ) {
+
+    sclass_t *sc = &sgSched.classes[SG_SCHED_PREFETCH];
+    ticket_t *ticket, *next;
+    int num = 0;
+
+    pthread_mutex_lock(&sgSched.lock);
+    for (ticket = sc->head; ticket != NULL; ticket = next) {
+        next = ticket->next;
+        if (ticket->tenant != tenant) {
+            continue;
+        }
+        sgSchedUnlink(ticket);
+        ticket->state = SG_TICKET_CANCELLED;
+        sc->cancelled++;
+        pthread_cond_signal(&ticket->cond);
+        num++;
+    }
+    pthread_mutex_unlock(&sgSched.lock);
+    return( num );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSchedThrottle
+// Description  : Charge block operations to a file's token bucket, sleeping
+//                off any debt so the file stays under the rate limit
+//
+// Inputs       : tenant - the file
+//                ops - the number of block operations
+// Outputs      : none
+
+void sgSchedThrottle( int tenant, int ops ) {
+
+    bucket_t *bucket;
+    struct timespec now;
+    int64_t elapsed, burst, wait = 0;
+
+    if ((sgSched.rate == 0) || (tenant < 0)) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    burst = (int64_t)sgSched.rate * 1000000 * SG_SCHED_BURST_SEC;
+
+    // refill the bucket for the time since it was last charged (a new bucket is full)
+    pthread_mutex_lock(&sgSched.lock);
+    bucket = &sgSched.buckets[tenant % SG_SCHED_TENANTS];
+    if ((bucket->last.tv_sec == 0) && (bucket->last.tv_nsec == 0)) {
+        bucket->tokens = burst;
+    } else {
+        elapsed = (int64_t)(now.tv_sec - bucket->last.tv_sec) * 1000000 + (now.tv_nsec - bucket->last.tv_nsec) / 1000;
+        bucket->tokens += elapsed * sgSched.rate;
+        if (bucket->tokens > burst) {
+            bucket->tokens = burst;
+        }
+    }
+    bucket->last = now;
+    bucket->tokens -= (int64_t)ops * 1000000;
+    if (bucket->tokens < 0) {
+        wait = -bucket->tokens / sgSched.rate;
+        sgSched.throttled++;
+    }
+    pthread_mutex_unlock(&sgSched.lock);
+
+    if (wait > 0) {
+        usleep(wait);
+    }
+}
+
+//
+// Scheduler support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSchedStamp
+// Description  : Give a ticket its virtual finish time in its class
+//                (scheduler lock held)
+//
+// Inputs       : ticket - the ticket
+// Outputs      : none
+
+void sgSchedStamp( ticket_t *ticket ) {
+
+    sclass_t *sc = &sgSched.classes[ticket->cls];
+    uint64_t start = (sc->last_finish > sgSched.vtime) ? sc->last_finish : sgSched.vtime;
+
+    ticket->finish = start + (SG_SCHED_SCALE / sc->weight);
+    sc->last_finish = ticket->finish;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSchedQueue
+// Description  : Add a ticket to the tail of its class queue (scheduler lock
+//                held)
+//
+// Inputs       : ticket - the ticket
+// Outputs      : none
+
+void sgSchedQueue( ticket_t *ticket ) {
+
+    sclass_t *sc = &sgSched.classes[ticket->cls];
+
+    ticket->next = NULL;
+    if (sc->tail == NULL) {
+        sc->head = ticket;
+    } else {
+        sc->tail->next = ticket;
+    }
+    sc->tail = ticket;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSchedUnlink
+// Description  : Remove a ticket from its class queue (scheduler lock held)
+//
+// Inputs       : ticket - the ticket
+// Outputs      : none
+
+void sgSchedUnlink( ticket_t *ticket ) {
+
+    sclass_t *sc = &sgSched.classes[ticket->cls];
+    ticket_t **prev = &sc->head, *last = NULL;
+
+    while ((*prev != NULL) && (*prev != ticket)) {
+        last = *prev;
+        prev = &(*prev)->next;
+    }
+    if (*prev == NULL) {
+        return;
+    }
+    *prev = ticket->next;
+    if (sc->tail == ticket) {
+        sc->tail = last;
+    }
+    ticket->next = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSchedDispatch
+// Description  : Hand free dispatch slots to the queued tickets with the
+//                earliest virtual finish times, skipping classes at their
+//                cap (scheduler lock held)
+//
+// Inputs       : none
+// Outputs      : none
+
+void sgSchedDispatch( void ) {
+
+    ticket_t *ticket;
+    sclass_t *sc;
+    int best;
+
+    while (sgSched.inflight < sgSched.depth) {
+        best = -1;
+        for (int c = 0; c < SG_SCHED_MAXVAL; c++) {
+            sc = &sgSched.classes[c];
+            if ((sc->head != NULL) && (sc->inflight < sc->cap) &&
+                    ((best < 0) || (sc->head->finish < sgSched.classes[best].head->finish))) {
+                best = c;
+            }
+        }
+        if (best < 0) {
+            return;
+        }
+        sc = &sgSched.classes[best];
+        ticket = sc->head;
+        sgSchedUnlink(ticket);
+        if (ticket->finish > sgSched.vtime) {
+            sgSched.vtime = ticket->finish;
+        }
+        ticket->state = SG_TICKET_GO;
+        sgSched.inflight++;
+        sc->inflight++;
+        sc->dispatched++;
+        pthread_cond_signal(&ticket->cond);
+    }
+}
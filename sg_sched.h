@@ -0,0 +1,61 @@
+#ifndef SG_SCHED_INCLUDED
+#define SG_SCHED_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_sched.h
+//  Description    : This is the declaration of the I/O scheduler of the
+//                   scatter gather driver.  Every packet posted to the SG
+//                   service takes one of a limited number of dispatch slots.
+//                   Requests waiting for a slot are queued by traffic class
+//                   and dispatched by weighted fair queueing, prefetch and
+//                   background work are capped, queued prefetches can be
+//                   cancelled, and each file can be rate limited.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <sg_defs.h>
+
+//
+// Defines
+#define SG_SCHED_DEFAULT_DEPTH 16   // Packets in flight to a concurrent service
+#define SG_SCHED_TENANTS 256        // Rate limit buckets (files hash to one)
+#define SG_SCHED_NO_TENANT -1       // Requests not charged to a file
+
+// Type definitions
+typedef enum {
+    SG_SCHED_READ       = 0,  // Blocks a caller is reading
+    SG_SCHED_WRITE      = 1,  // Blocks a caller is writing
+    SG_SCHED_PREFETCH   = 2,  // Blocks read ahead of the caller
+    SG_SCHED_BACKGROUND = 3,  // Writeback and deletes
+    SG_SCHED_MAXVAL     = 4   // Maximum value of the class
+} SG_Sched_Class;
+
+//
+// Scheduler functions
+
+int initSGSched( int depth, uint32_t rate );
+    // Initialize the scheduler with the packets in flight and per-file ops/sec (0 unlimited)
+
+int closeSGSched( void );
+    // Close the scheduler, log the per-class statistics
+
+int sgSchedBegin( SG_Sched_Class cls, int tenant, SG_Node_ID nde, SG_Block_ID blk );
+    // Wait for a dispatch slot, -1 if the request was cancelled while queued
+
+void sgSchedEnd( SG_Sched_Class cls );
+    // Release the dispatch slot of a request
+
+int sgSchedPromote( SG_Node_ID nde, SG_Block_ID blk );
+    // Make a queued prefetch of a block a demand read (a caller now waits on it)
+
+int sgSchedCancel( int tenant );
+    // Cancel the queued prefetches of a file, returns the number cancelled
+
+void sgSchedThrottle( int tenant, int ops );
+    // Charge ops to a file's rate limit, waiting if it is over
+
+#endif
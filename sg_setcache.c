@@ -0,0 +1,406 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_setcache.c
+//  Description    : This file contains the set associative index of the block
+//                   cache.  A set's tags are probed with an AVX2 or SSE2
+//                   compare on x86 (NEON on ARMv8) when available, and with a
+//                   scalar loop otherwise.  The index does no locking or
+//                   statistics, the block cache does both around it.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Project Includes
+#include <sg_setcache.h>
+
+// Functional Prototypes
+typedef uint32_t (*sg_probe_func_t)( const uint32_t *set, uint32_t tag );
+uint32_t sgSetCacheProbeScalar( const uint32_t *set, uint32_t tag );
+uint32_t sgSetCacheProbeSse2( const uint32_t *set, uint32_t tag );
+uint32_t sgSetCacheProbeAvx2( const uint32_t *set, uint32_t tag );
+uint32_t sgSetCacheProbeNeon( const uint32_t *set, uint32_t tag );
+uint64_t sgSetCacheHash( SG_Node_ID nde, SG_Block_ID blk );
+uint32_t sgSetCacheVictim( sgsetcache_t *sc, uint32_t set );
+int sgSetCacheAlloc( sgsetcache_t *sc, uint32_t lines );
+void sgSetCacheInit( void );
+
+//
+// Global Data
+sg_probe_func_t sgSetProbeFunc = NULL;  // The set probe selected at first use
+const char *sgSetProbeName = "scalar";  // Its name
+pthread_once_t sgSetCacheOnce = PTHREAD_ONCE_INIT;  // Guards the probe selection
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheCreate
+// Description  : Create a set associative index holding at least lines blocks
+//
+// Inputs       : lines - the number of blocks to hold
+//                evict - called with each block evicted (or NULL)
+// Outputs      : the index or NULL if failure
+
+sgsetcache_t *sgSetCacheCreate( uint32_t lines, sg_setcache_evict_t evict ) {
+
+    sgsetcache_t *sc;
+
+    pthread_once(&sgSetCacheOnce, sgSetCacheInit);
+    if ((sc = calloc(1, sizeof(sgsetcache_t))) == NULL) {
+        return( NULL );
+    }
+    sc->evict = evict;
+    if (sgSetCacheAlloc(sc, lines)) {
+        free(sc);
+        return( NULL );
+    }
+    return( sc );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheLookup
+// Description  : Find the payload of a block, setting its reference bit
+//
+// Inputs       : sc - the index
+//                nde - node ID to find
+//                blk - block ID to find
+//                victim - set to 1 if the block was its set's next victim (or
+//                         NULL)
+// Outputs      : pointer to the payload or NULL if not cached
+
+char *sgSetCacheLookup( sgsetcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, int *victim ) {
+
+    uint64_t hash = sgSetCacheHash(nde, blk);
+    uint32_t set = (uint32_t)(((hash >> 32) * sc->num_sets) >> 32);
+    uint32_t tag = ((uint32_t)hash != 0) ? (uint32_t)hash : 1;
+    uint32_t match, way, line;
+
+    // every way whose fingerprint matches is checked against the full key
+    match = sgSetProbeFunc(&sc->tags[set * SG_SETCACHE_WAYS], tag);
+    while (match) {
+        way = __builtin_ctz(match);
+        line = (set * SG_SETCACHE_WAYS) + way;
+        if ((sc->nodes[line] == nde) && (sc->blocks[line] == blk)) {
+            if (victim != NULL) {
+                *victim = (sgSetCacheVictim(sc, set) == way);
+            }
+            sc->refs[set] |= (1 << way);
+            return( sc->arena + ((size_t)line * SG_BLOCK_SIZE) );
+        }
+        match &= match - 1;
+    }
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheInsert
+// Description  : Get the payload of a block, taking an empty way of its set or
+//                evicting the CLOCK victim of the set if it is not cached (the
+//                hand clears the reference bits it sweeps past)
+//
+// Inputs       : sc - the index
+//                nde - node ID of the block
+//                blk - block ID of the block
+// Outputs      : pointer to the payload (to be filled in if new)
+
+char *sgSetCacheInsert( sgsetcache_t *sc, SG_Node_ID nde, SG_Block_ID blk ) {
+
+    uint64_t hash = sgSetCacheHash(nde, blk);
+    uint32_t set = (uint32_t)(((hash >> 32) * sc->num_sets) >> 32);
+    uint32_t tag = ((uint32_t)hash != 0) ? (uint32_t)hash : 1;
+    uint32_t empty, way, line;
+    char *payload;
+
+    if ((payload = sgSetCacheLookup(sc, nde, blk, NULL)) != NULL) {
+        return( payload );
+    }
+
+    // an empty way has a zero tag, otherwise evict the victim and move the hand past it
+    empty = sgSetProbeFunc(&sc->tags[set * SG_SETCACHE_WAYS], 0);
+    if (empty) {
+        way = __builtin_ctz(empty);
+    } else {
+        way = sgSetCacheVictim(sc, set);
+        if (sc->refs[set] == (uint8_t)((1 << SG_SETCACHE_WAYS) - 1)) {
+            sc->refs[set] = 0;
+        }
+        for (uint32_t i = sc->hands[set]; i != way; i = (i + 1) % SG_SETCACHE_WAYS) {
+            sc->refs[set] &= ~(1 << i);
+        }
+        sc->hands[set] = (way + 1) % SG_SETCACHE_WAYS;
+        line = (set * SG_SETCACHE_WAYS) + way;
+        if (sc->evict != NULL) {
+            sc->evict(sc->nodes[line], sc->blocks[line], sc->arena + ((size_t)line * SG_BLOCK_SIZE));
+        }
+        sc->items--;
+    }
+
+    line = (set * SG_SETCACHE_WAYS) + way;
+    sc->tags[line] = tag;
+    sc->nodes[line] = nde;
+    sc->blocks[line] = blk;
+    sc->refs[set] &= ~(1 << way);
+    sc->items++;
+    return( sc->arena + ((size_t)line * SG_BLOCK_SIZE) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheResize
+// Description  : Rebuild the index for a new number of lines, moving the blocks
+//                over and evicting the ones that no longer fit.  The old
+//                payload arena is freed (returned to the OS).
+//
+// Inputs       : sc - the index
+//                lines - the new number of lines
+// Outputs      : 0 if successful, -1 if failure
+
+int sgSetCacheResize( sgsetcache_t *sc, uint32_t lines ) {
+
+    sgsetcache_t old = *sc;
+    uint32_t line;
+    char *payload;
+
+    if (sgSetCacheAlloc(sc, lines)) {
+        *sc = old;
+        return( -1 );
+    }
+    for (line = 0; line < old.num_sets * SG_SETCACHE_WAYS; line++) {
+        if (old.tags[line] == 0) {
+            continue;
+        }
+        payload = sgSetCacheInsert(sc, old.nodes[line], old.blocks[line]);
+        memcpy(payload, old.arena + ((size_t)line * SG_BLOCK_SIZE), SG_BLOCK_SIZE);
+        if (old.refs[line / SG_SETCACHE_WAYS] & (1 << (line % SG_SETCACHE_WAYS))) {
+            sgSetCacheLookup(sc, old.nodes[line], old.blocks[line], NULL);
+        }
+    }
+    sgSetCacheFree(&old);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheFree
+// Description  : Free the index arrays and payloads (not the index itself)
+//
+// Inputs       : sc - the index
+// Outputs      : none
+
+void sgSetCacheFree( sgsetcache_t *sc ) {
+
+    free(sc->tags);
+    free(sc->nodes);
+    free(sc->blocks);
+    free(sc->refs);
+    free(sc->hands);
+    free(sc->arena);
+    sc->tags = NULL;
+    sc->arena = NULL;
+    sc->num_sets = 0;
+    sc->items = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheImplementation
+// Description  : Return the name of the set probe in use
+//
+// Inputs       : none
+// Outputs      : the probe name
+
+const char *sgSetCacheImplementation( void ) {
+
+    pthread_once(&sgSetCacheOnce, sgSetCacheInit);
+    return( sgSetProbeName );
+}
+
+//
+// Support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheInit
+// Description  : Select the widest set probe the processor supports
+//
+// Inputs       : none
+// Outputs      : none
+
+void sgSetCacheInit( void ) {
+
+    sgSetProbeFunc = sgSetCacheProbeScalar;
+    sgSetProbeName = "scalar";
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        sgSetProbeFunc = sgSetCacheProbeAvx2;
+        sgSetProbeName = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        sgSetProbeFunc = sgSetCacheProbeSse2;
+        sgSetProbeName = "sse2";
+    }
+#elif defined(__aarch64__)
+    sgSetProbeFunc = sgSetCacheProbeNeon;
+    sgSetProbeName = "neon";
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheAlloc
+// Description  : Allocate the arrays of an index for a number of lines, the
+//                sets being rounded up to whole sets
+//
+// Inputs       : sc - the index
+//                lines - the number of lines
+// Outputs      : 0 if successful, -1 if failure
+
+int sgSetCacheAlloc( sgsetcache_t *sc, uint32_t lines ) {
+
+    uint32_t num_sets = (lines + SG_SETCACHE_WAYS - 1) / SG_SETCACHE_WAYS;
+    size_t ways = (size_t)((num_sets > 0) ? num_sets : 1) * SG_SETCACHE_WAYS;
+
+    sc->num_sets = ways / SG_SETCACHE_WAYS;
+    sc->items = 0;
+    sc->tags = aligned_alloc(SG_SETCACHE_WAYS * sizeof(uint32_t), ways * sizeof(uint32_t));
+    sc->nodes = malloc(ways * sizeof(SG_Node_ID));
+    sc->blocks = malloc(ways * sizeof(SG_Block_ID));
+    sc->refs = calloc(sc->num_sets, sizeof(uint8_t));
+    sc->hands = calloc(sc->num_sets, sizeof(uint8_t));
+    sc->arena = aligned_alloc(SG_SETCACHE_ARENA_ALIGN,
+            ((ways * SG_BLOCK_SIZE) + SG_SETCACHE_ARENA_ALIGN - 1) & ~((size_t)SG_SETCACHE_ARENA_ALIGN - 1));
+    if ((sc->tags == NULL) || (sc->nodes == NULL) || (sc->blocks == NULL) ||
+            (sc->refs == NULL) || (sc->hands == NULL) || (sc->arena == NULL)) {
+        sgSetCacheFree(sc);
+        return( -1 );
+    }
+    memset(sc->tags, 0x0, ways * sizeof(uint32_t));
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheHash
+// Description  : Hash a block key, the high half picks the set and the low
+//                half is the tag fingerprint
+//
+// Inputs       : nde - node ID of the block
+//                blk - block ID of the block
+// Outputs      : the hash
+
+uint64_t sgSetCacheHash( SG_Node_ID nde, SG_Block_ID blk ) {
+
+    uint64_t hash = (nde * 0x9e3779b97f4a7c15ULL) ^ blk;
+
+    hash = (hash ^ (hash >> 33)) * 0xff51afd7ed558ccdULL;
+    hash = (hash ^ (hash >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return( hash ^ (hash >> 33) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSetCacheVictim
+// Description  : Find the way CLOCK would evict next from a full set: the
+//                first way from the hand whose reference bit is clear (the
+//                hand itself if every way was referenced)
+//
+// Inputs       : sc - the index
+//                set - the set
+// Outputs      : the way, SG_SETCACHE_WAYS if the set has an empty way
+
+uint32_t sgSetCacheVictim( sgsetcache_t *sc, uint32_t set ) {
+
+    uint32_t way;
+
+    if (sgSetProbeFunc(&sc->tags[set * SG_SETCACHE_WAYS], 0)) {
+        return( SG_SETCACHE_WAYS );
+    }
+    for (uint32_t i = 0; i < SG_SETCACHE_WAYS; i++) {
+        way = (sc->hands[set] + i) % SG_SETCACHE_WAYS;
+        if (!(sc->refs[set] & (1 << way))) {
+            return( way );
+        }
+    }
+    return( sc->hands[set] );
+}
+
+//
+// Set probe functions, each returns a bit mask of the ways whose tag matches
+
+uint32_t sgSetCacheProbeScalar( const uint32_t *set, uint32_t tag ) {
+
+    uint32_t match = 0;
+
+    for (int way = 0; way < SG_SETCACHE_WAYS; way++) {
+        match |= (uint32_t)(set[way] == tag) << way;
+    }
+    return( match );
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+uint32_t sgSetCacheProbeSse2( const uint32_t *set, uint32_t tag ) {
+
+    __m128i key = _mm_set1_epi32((int)tag);
+    __m128i lo = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *)set), key);
+    __m128i hi = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *)(set + 4)), key);
+
+    return( (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(lo)) |
+            ((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4) );
+}
+
+__attribute__((target("avx2")))
+uint32_t sgSetCacheProbeAvx2( const uint32_t *set, uint32_t tag ) {
+
+    __m256i match = _mm256_cmpeq_epi32(_mm256_load_si256((const __m256i *)set), _mm256_set1_epi32((int)tag));
+
+    return( (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(match)) );
+}
+
+#else
+
+uint32_t sgSetCacheProbeSse2( const uint32_t *set, uint32_t tag ) {
+    return( sgSetCacheProbeScalar(set, tag) );
+}
+
+uint32_t sgSetCacheProbeAvx2( const uint32_t *set, uint32_t tag ) {
+    return( sgSetCacheProbeScalar(set, tag) );
+}
+
+#endif
+
+#if defined(__aarch64__)
+
+uint32_t sgSetCacheProbeNeon( const uint32_t *set, uint32_t tag ) {
+
+    const uint32_t weights[4] = { 1, 2, 4, 8 };
+    uint32x4_t key = vdupq_n_u32(tag), bits = vld1q_u32(weights);
+    uint32x4_t lo = vandq_u32(vceqq_u32(vld1q_u32(set), key), bits);
+    uint32x4_t hi = vandq_u32(vceqq_u32(vld1q_u32(set + 4), key), bits);
+
+    return( vaddvq_u32(lo) | (vaddvq_u32(hi) << 4) );
+}
+
+#else
+
+uint32_t sgSetCacheProbeNeon( const uint32_t *set, uint32_t tag ) {
+    return( sgSetCacheProbeScalar(set, tag) );
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SG_SETCACHE_INCLUDED
+#define SG_SETCACHE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_setcache.h
+//  Description    : This is the declaration of the set associative index of
+//                   the block cache.  Blocks hash to a set of SG_SETCACHE_WAYS
+//                   ways.  The 32 bit tag fingerprints of a set are packed
+//                   together so the whole set is probed with one SIMD compare,
+//                   replacement within a set is CLOCK (one reference bit per
+//                   way) and the block payloads live in a separate aligned
+//                   arena.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <sg_defs.h>
+
+//
+// Defines
+#define SG_SETCACHE_WAYS 8          // Ways per set (eight 32 bit tags, one AVX2 compare, at most 8)
+#define SG_SETCACHE_ARENA_ALIGN 4096 // Alignment of the payload arena
+
+// Type definitions
+typedef void (*sg_setcache_evict_t)( SG_Node_ID nde, SG_Block_ID blk, char *block );
+
+typedef struct {
+    uint32_t     num_sets;   // Number of sets
+    uint32_t     items;      // Number of blocks held
+    uint32_t    *tags;       // Tag fingerprints, a set's ways together (0 if empty)
+    SG_Node_ID  *nodes;      // Node of the block in each way
+    SG_Block_ID *blocks;     // Block ID of the block in each way
+    uint8_t     *refs;       // CLOCK reference bits of each set (bit per way)
+    uint8_t     *hands;      // CLOCK hand of each set
+    char        *arena;      // Block payloads (SG_BLOCK_SIZE per way)
+    sg_setcache_evict_t evict; // Called with each block evicted
+} sgsetcache_t;
+
+//
+// Set associative cache functions
+
+sgsetcache_t *sgSetCacheCreate( uint32_t lines, sg_setcache_evict_t evict );
+    // Create a set associative index holding at least lines blocks
+
+char *sgSetCacheLookup( sgsetcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, int *victim );
+    // Find the payload of a block (NULL if not cached)
+
+char *sgSetCacheInsert( sgsetcache_t *sc, SG_Node_ID nde, SG_Block_ID blk );
+    // Get the payload of a block, making room for it if not cached
+
+int sgSetCacheResize( sgsetcache_t *sc, uint32_t lines );
+    // Rebuild the index for a new number of lines, evicting what doesn't fit
+
+void sgSetCacheFree( sgsetcache_t *sc );
+    // Free the index and its payloads
+
+const char *sgSetCacheImplementation( void );
+    // Return the name of the set probe in use (avx2, sse2, neon or scalar)
+
+#endif
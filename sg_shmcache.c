@@ -0,0 +1,418 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_shmcache.c
+//  Description    : This file contains the block cache shared by processes
+//                   through a shared memory segment.  Lookups never lock: a
+//                   reader notes the seqlock count of the set, copies the
+//                   block and checks the count did not move.  Inserts lock
+//                   the set with the PID of the process, so a set left locked
+//                   (and maybe half written) by a process that died is taken
+//                   back and emptied by the next writer.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_shmcache.h>
+
+// Defines
+#define SG_SHMCACHE_ARENA_ALIGN 4096 // Alignment of the payload arena in the segment
+#define SG_SHMCACHE_OPEN_WAIT 2000   // Milliseconds to wait for another process to set a segment up
+
+// Functional Prototypes
+size_t sgShmCacheSize( uint32_t num_sets );
+int sgShmCacheMap( sgshmcache_t *sc, int fd, uint32_t num_sets );
+int sgShmCacheSetup( sgshmcache_t *sc, int fd, uint32_t lines );
+sgshmset_t *sgShmCacheSet( sgshmcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, uint32_t *index );
+void sgShmCacheLockSet( sgshmcache_t *sc, sgshmset_t *set );
+int sgShmCacheOwnerDead( uint32_t pid );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheOpen
+// Description  : Attach to the shared cache segment name, creating it with
+//                room for lines blocks if no process has yet.  A segment whose
+//                creator died before setting it up is set up again.
+//
+// Inputs       : name - the segment name
+//                lines - the number of blocks to hold (new segments only)
+// Outputs      : the shared cache, NULL if failure
+
+sgshmcache_t *sgShmCacheOpen( const char *name, uint32_t lines ) {
+
+    char path[256];
+    sgshmcache_t *sc;
+    sgshmcachehdr_t *hdr;
+    uint32_t owner;
+    struct stat st;
+    int fd, created = 0;
+
+    if ((name == NULL) || (name[0] == '\0') || (strchr(name + 1, '/') != NULL) ||
+            (snprintf(path, sizeof(path), "%s%s", (name[0] == '/') ? "" : "/", name) >= (int)sizeof(path))) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmCacheOpen: bad segment name [%s]", name ? name : "" );
+        return( NULL );
+    }
+    fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd >= 0) {
+        created = 1;
+    } else if ((errno != EEXIST) || ((fd = shm_open(path, O_RDWR, 0)) < 0)) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmCacheOpen: shm_open %s failed [%s]", path, strerror(errno) );
+        return( NULL );
+    }
+    sc = calloc(1, sizeof(sgshmcache_t));
+
+    // the creator sizes and sets up the segment, everyone else waits for the magic number
+    if (created) {
+        if (sgShmCacheSetup(sc, fd, lines)) {
+            shm_unlink(path);
+            close(fd);
+            free(sc);
+            return( NULL );
+        }
+        close(fd);
+        logMessage( LOG_INFO_LEVEL, "Created shared cache %s (%u blocks).", path, sgShmCacheLines(sc) );
+        return( sc );
+    }
+    for (int waited = 0; ; waited++) {
+        if ((fstat(fd, &st) == 0) && (st.st_size >= (off_t)sizeof(sgshmcachehdr_t))) {
+            hdr = mmap(NULL, sizeof(sgshmcachehdr_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (hdr == MAP_FAILED) {
+                break;
+            }
+            if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == SG_SHMCACHE_MAGIC) {
+                if ((hdr->block_size != SG_BLOCK_SIZE) || sgShmCacheMap(sc, fd, hdr->num_sets)) {
+                    logMessage( LOG_ERROR_LEVEL, "sgShmCacheOpen: %s is not a cache of %d byte blocks",
+                            path, SG_BLOCK_SIZE );
+                    munmap(hdr, sizeof(sgshmcachehdr_t));
+                    break;
+                }
+                munmap(hdr, sizeof(sgshmcachehdr_t));
+                close(fd);
+                logMessage( LOG_INFO_LEVEL, "Attached to shared cache %s (%u blocks).", path, sgShmCacheLines(sc) );
+                return( sc );
+            }
+
+            // the creator died before finishing, take the setup over
+            owner = __atomic_load_n(&hdr->owner, __ATOMIC_ACQUIRE);
+            if ((waited >= SG_SHMCACHE_OPEN_WAIT) && sgShmCacheOwnerDead(owner) &&
+                    __atomic_compare_exchange_n(&hdr->owner, &owner, (uint32_t)getpid(), 0,
+                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                munmap(hdr, sizeof(sgshmcachehdr_t));
+                if (sgShmCacheSetup(sc, fd, lines) == 0) {
+                    close(fd);
+                    logMessage( LOG_INFO_LEVEL, "Recovered shared cache %s from a crashed creator.", path );
+                    return( sc );
+                }
+                break;
+            }
+            munmap(hdr, sizeof(sgshmcachehdr_t));
+        }
+        if (waited >= 2 * SG_SHMCACHE_OPEN_WAIT) {
+            logMessage( LOG_ERROR_LEVEL, "sgShmCacheOpen: timed out waiting for %s to be set up", path );
+            break;
+        }
+        usleep(1000);
+    }
+    close(fd);
+    free(sc);
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheGet
+// Description  : Copy a block out of the shared cache without locking, the
+//                copy is retried if a writer changed the set meanwhile
+//
+// Inputs       : sc - the shared cache
+//                nde - node ID to find
+//                blk - block ID to find
+//                block - the buffer for the block (SG_BLOCK_SIZE)
+// Outputs      : 0 if found, -1 if not
+
+int sgShmCacheGet( sgshmcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, char *block ) {
+
+    uint32_t index, before, after;
+    sgshmset_t *set = sgShmCacheSet(sc, nde, blk, &index);
+    int way;
+
+    for (int tries = 0; tries < SG_SHMCACHE_READ_RETRIES; tries++) {
+        before = __atomic_load_n(&set->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        way = -1;
+        for (int i = 0; i < SG_SHMCACHE_WAYS; i++) {
+            if (set->ways[i].valid && (set->ways[i].rem_id == nde) && (set->ways[i].blk_id == blk)) {
+                way = i;
+                break;
+            }
+        }
+        if (way >= 0) {
+            memcpy(block, sc->arena + (((size_t)index * SG_SHMCACHE_WAYS + way) * SG_BLOCK_SIZE), SG_BLOCK_SIZE);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&set->seq, __ATOMIC_RELAXED);
+        if (before == after) {
+            if (way < 0) {
+                return( -1 );
+            }
+            __atomic_fetch_or(&set->refs, 1u << way, __ATOMIC_RELAXED);
+            return( 0 );
+        }
+    }
+    return( -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCachePut
+// Description  : Insert or replace a block in the shared cache, evicting by
+//                CLOCK within its set
+//
+// Inputs       : sc - the shared cache
+//                nde - node ID of the block
+//                blk - block ID of the block
+//                block - the block (SG_BLOCK_SIZE)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgShmCachePut( sgshmcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, char *block ) {
+
+    uint32_t index, seq, refs;
+    sgshmset_t *set = sgShmCacheSet(sc, nde, blk, &index);
+    int way = -1;
+
+    sgShmCacheLockSet(sc, set);
+    seq = set->seq;
+    __atomic_store_n(&set->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    // the block's own way, else an empty one, else the first unreferenced from the hand
+    for (int i = 0; (i < SG_SHMCACHE_WAYS) && (way < 0); i++) {
+        if (set->ways[i].valid && (set->ways[i].rem_id == nde) && (set->ways[i].blk_id == blk)) {
+            way = i;
+        }
+    }
+    for (int i = 0; (i < SG_SHMCACHE_WAYS) && (way < 0); i++) {
+        if (!set->ways[i].valid) {
+            way = i;
+        }
+    }
+    while (way < 0) {
+        refs = __atomic_load_n(&set->refs, __ATOMIC_RELAXED);
+        if (refs & (1u << set->hand)) {
+            __atomic_fetch_and(&set->refs, ~(1u << set->hand), __ATOMIC_RELAXED);
+        } else {
+            way = set->hand;
+        }
+        set->hand = (set->hand + 1) % SG_SHMCACHE_WAYS;
+    }
+    set->ways[way].rem_id = nde;
+    set->ways[way].blk_id = blk;
+    set->ways[way].valid = 1;
+    memcpy(sc->arena + (((size_t)index * SG_SHMCACHE_WAYS + way) * SG_BLOCK_SIZE), block, SG_BLOCK_SIZE);
+    __atomic_fetch_or(&set->refs, 1u << way, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&set->seq, seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&set->lock, 0, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&sc->hdr->inserts, 1, __ATOMIC_RELAXED);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheLines
+// Description  : Get the number of blocks the shared cache holds
+//
+// Inputs       : sc - the shared cache
+// Outputs      : the number of blocks
+
+uint32_t sgShmCacheLines( sgshmcache_t *sc ) {
+
+    return( sc->hdr->num_sets * SG_SHMCACHE_WAYS );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheClose
+// Description  : Detach from the shared cache, the segment (and the blocks in
+//                it) stays for the other processes and later runs
+//
+// Inputs       : sc - the shared cache
+// Outputs      : none
+
+void sgShmCacheClose( sgshmcache_t *sc ) {
+
+    logMessage( LOG_INFO_LEVEL, "Detaching shared cache: %lu inserts by all processes, %lu locks recovered.",
+            sc->hdr->inserts, sc->hdr->recoveries );
+    munmap(sc->hdr, sc->size);
+    free(sc);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheSize
+// Description  : Get the size of a segment with num_sets sets
+//
+// Inputs       : num_sets - the number of sets
+// Outputs      : the segment size in bytes
+
+size_t sgShmCacheSize( uint32_t num_sets ) {
+
+    size_t sets = sizeof(sgshmcachehdr_t) + ((size_t)num_sets * sizeof(sgshmset_t));
+
+    sets = (sets + SG_SHMCACHE_ARENA_ALIGN - 1) & ~((size_t)SG_SHMCACHE_ARENA_ALIGN - 1);
+    return( sets + ((size_t)num_sets * SG_SHMCACHE_WAYS * SG_BLOCK_SIZE) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheMap
+// Description  : Map a segment of num_sets sets and find its parts
+//
+// Inputs       : sc - the shared cache
+//                fd - the segment file descriptor
+//                num_sets - the number of sets
+// Outputs      : 0 if successful, -1 if failure
+
+int sgShmCacheMap( sgshmcache_t *sc, int fd, uint32_t num_sets ) {
+
+    struct stat st;
+    char *base;
+
+    sc->size = sgShmCacheSize(num_sets);
+    if ((num_sets == 0) || (fstat(fd, &st) < 0) || ((size_t)st.st_size != sc->size)) {
+        return( -1 );
+    }
+    base = mmap(NULL, sc->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmCacheMap: mmap failed [%s]", strerror(errno) );
+        return( -1 );
+    }
+    sc->hdr = (sgshmcachehdr_t *)base;
+    sc->sets = (sgshmset_t *)(base + sizeof(sgshmcachehdr_t));
+    sc->arena = base + (sc->size - ((size_t)num_sets * SG_SHMCACHE_WAYS * SG_BLOCK_SIZE));
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheSetup
+// Description  : Size, map and clear a segment this process owns, publishing
+//                it to the others last
+//
+// Inputs       : sc - the shared cache
+//                fd - the segment file descriptor
+//                lines - the number of blocks to hold
+// Outputs      : 0 if successful, -1 if failure
+
+int sgShmCacheSetup( sgshmcache_t *sc, int fd, uint32_t lines ) {
+
+    uint32_t num_sets = 1;
+
+    while (num_sets * SG_SHMCACHE_WAYS < lines) {
+        num_sets <<= 1;
+    }
+    if ((ftruncate(fd, sgShmCacheSize(num_sets)) < 0) || sgShmCacheMap(sc, fd, num_sets)) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmCacheSetup: unable to size the segment [%s]", strerror(errno) );
+        return( -1 );
+    }
+    __atomic_store_n(&sc->hdr->owner, (uint32_t)getpid(), __ATOMIC_RELEASE);
+    memset(sc->sets, 0x0, (size_t)num_sets * sizeof(sgshmset_t));
+    sc->hdr->block_size = SG_BLOCK_SIZE;
+    sc->hdr->num_sets = num_sets;
+    sc->hdr->inserts = 0;
+    sc->hdr->recoveries = 0;
+    __atomic_store_n(&sc->hdr->magic, SG_SHMCACHE_MAGIC, __ATOMIC_RELEASE);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheSet
+// Description  : Find the set a block hashes to
+//
+// Inputs       : sc - the shared cache
+//                nde - node ID of the block
+//                blk - block ID of the block
+//                index - set to the index of the set
+// Outputs      : the set
+
+sgshmset_t *sgShmCacheSet( sgshmcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, uint32_t *index ) {
+
+    uint64_t hash = (nde * 0x9e3779b97f4a7c15ULL) ^ (blk * 0xc2b2ae3d27d4eb4fULL);
+
+    hash ^= hash >> 29;
+    *index = (uint32_t)hash & (sc->hdr->num_sets - 1);
+    return( &sc->sets[*index] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheLockSet
+// Description  : Lock a set for an insert.  A lock held by a process that no
+//                longer exists is taken over; if that process died in the
+//                middle of a change the set is emptied.
+//
+// Inputs       : sc - the shared cache
+//                set - the set
+// Outputs      : none
+
+void sgShmCacheLockSet( sgshmcache_t *sc, sgshmset_t *set ) {
+
+    uint32_t pid = (uint32_t)getpid(), owner, seq;
+
+    for (int spins = 1; ; spins++) {
+        owner = 0;
+        if (__atomic_compare_exchange_n(&set->lock, &owner, pid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        if (spins % SG_SHMCACHE_LOCK_SPINS) {
+            continue;
+        }
+        if ((owner != 0) && sgShmCacheOwnerDead(owner) &&
+                __atomic_compare_exchange_n(&set->lock, &owner, pid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            seq = __atomic_load_n(&set->seq, __ATOMIC_RELAXED);
+            if (seq & 1) {
+                memset(set->ways, 0x0, sizeof(set->ways));
+                __atomic_store_n(&set->refs, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&set->seq, seq + 1, __ATOMIC_RELEASE);
+            }
+            __atomic_fetch_add(&sc->hdr->recoveries, 1, __ATOMIC_RELAXED);
+            logMessage( LOG_INFO_LEVEL, "sgShmCacheLockSet: recovered a set lock from process %u", owner );
+            return;
+        }
+        sched_yield();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmCacheOwnerDead
+// Description  : Check whether the process owning a lock has exited
+//
+// Inputs       : pid - the owner (0 if none)
+// Outputs      : 1 if the owner no longer exists, 0 otherwise
+
+int sgShmCacheOwnerDead( uint32_t pid ) {
+
+    return( (pid == 0) || ((kill((pid_t)pid, 0) < 0) && (errno == ESRCH)) );
+}
@@ -0,0 +1,79 @@
+#ifndef SG_SHMCACHE_INCLUDED
+#define SG_SHMCACHE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_shmcache.h
+//  Description    : This is the declaration of the block cache shared by all
+//                   processes on a host through a POSIX shared memory segment
+//                   (/dev/shm).  Blocks hash to a set of SG_SHMCACHE_WAYS
+//                   ways.  Each set has a seqlock: readers copy a block
+//                   without locking and retry if a writer got in, writers
+//                   take the set lock, which names the owning process so a
+//                   lock left behind by a crashed process is recovered.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <sg_defs.h>
+
+//
+// Defines
+#define SG_SHMCACHE_MAGIC 0x53474343     // Segment magic number ("SGCC")
+#define SG_SHMCACHE_WAYS 8               // Ways per set
+#define SG_SHMCACHE_DEFAULT_LINES 4096   // Blocks held when the segment is created
+#define SG_SHMCACHE_READ_RETRIES 64      // Torn reads of a set before calling it a miss
+#define SG_SHMCACHE_LOCK_SPINS 1024      // Spins on a set lock before checking its owner
+
+// Type definitions
+typedef struct {
+    SG_Node_ID  rem_id;   // Node of the block in the way
+    SG_Block_ID blk_id;   // Block ID of the block in the way
+    uint32_t    valid;    // The way holds a block
+} sgshmway_t;
+
+typedef struct {
+    uint32_t   lock;      // PID of the process updating the set, 0 if none
+    uint32_t   seq;       // Seqlock count, odd while the set is being changed
+    uint32_t   refs;      // CLOCK reference bits (bit per way)
+    uint32_t   hand;      // CLOCK hand
+    sgshmway_t ways[SG_SHMCACHE_WAYS];
+} __attribute__((aligned(64))) sgshmset_t;
+
+typedef struct {
+    uint32_t magic;       // SG_SHMCACHE_MAGIC once the segment is set up
+    uint32_t block_size;  // SG_BLOCK_SIZE of the processes sharing it
+    uint32_t num_sets;    // Number of sets (power of 2)
+    uint32_t owner;       // PID of the process setting the segment up
+    uint64_t inserts;     // Blocks inserted by all processes
+    uint64_t recoveries;  // Set locks taken back from crashed processes
+} __attribute__((aligned(64))) sgshmcachehdr_t;
+
+typedef struct {
+    sgshmcachehdr_t *hdr;   // The segment header
+    sgshmset_t      *sets;  // The sets (after the header)
+    char            *arena; // The block payloads (after the sets)
+    size_t           size;  // The size of the mapping
+} sgshmcache_t;
+
+//
+// Shared cache functions
+
+sgshmcache_t *sgShmCacheOpen( const char *name, uint32_t lines );
+    // Attach to (creating if needed) the shared cache segment name
+
+int sgShmCacheGet( sgshmcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, char *block );
+    // Copy a block out of the shared cache, 0 if found, -1 if not
+
+int sgShmCachePut( sgshmcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, char *block );
+    // Insert or replace a block in the shared cache
+
+uint32_t sgShmCacheLines( sgshmcache_t *sc );
+    // Get the number of blocks the shared cache holds
+
+void sgShmCacheClose( sgshmcache_t *sc );
+    // Detach from the shared cache (the segment stays for other processes)
+
+#endif
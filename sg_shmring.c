@@ -0,0 +1,441 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_shmring.c
+//  Description    : This file contains the shared memory ring transport to
+//                   the out-of-process ScatterGather service.  Each ring has
+//                   exactly one producer and one consumer, so head and tail
+//                   are plain counters published with release/acquire
+//                   ordering.  A consumer that finds its ring empty polls
+//                   SG_SHM_SPIN_LIMIT times, then (unless busy polling)
+//                   sleeps on the head counter with a shared futex.  On a
+//                   single CPU spinning only delays the peer, so pollers
+//                   yield the CPU instead.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_shmring.h>
+
+// Defines
+#if defined(__x86_64__) || defined(__i386__)
+#define SG_SHM_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define SG_SHM_RELAX() __asm__ __volatile__( "yield" ::: "memory" )
+#else
+#define SG_SHM_RELAX() __asm__ __volatile__( "" ::: "memory" )
+#endif
+
+// Functional Prototypes
+int sgShmSegmentName( const char *name, char *path, size_t plen );
+void sgShmFutexWait( uint32_t *addr, uint32_t val, long usec );
+void sgShmFutexWake( uint32_t *addr );
+void sgShmSpinInit( void );
+
+//
+// Global Data
+sgshmsegment_t *sgShmSegment = NULL; // The segment of the attached service
+int sgShmNextChannel = 0; // The channel the next client thread uses
+pthread_mutex_t sgShmChannelLock[SG_SHM_CHANNELS]; // One poster per channel at a time
+__thread int sgShmChannel = -1; // The channel of this thread
+int sgShmSpinLimit; // Polls of an empty ring before sleeping (0 on one CPU)
+pthread_once_t sgShmSpinOnce = PTHREAD_ONCE_INIT; // Sets the spin limit once
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmRingPush
+// Description  : Add a packet to a ring and wake its consumer if it sleeps
+//
+// Inputs       : ring - the ring (this side is its only producer)
+//                packet - the packet (may be NULL if len is 0)
+//                len - the length of the packet
+// Outputs      : 0 if successful, -1 if failure
+
+int sgShmRingPush( sgshmring_t *ring, const char *packet, size_t len ) {
+
+    uint32_t head;
+    sgshmslot_t *slot;
+
+    if (len > SG_DATA_PACKET_SIZE) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmRingPush: packet too large [%zu]", len );
+        return( -1 );
+    }
+
+    //wait for a free slot, the peer drains the ring without sleeping on us
+    head = ring->head;
+    while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= SG_SHM_RING_SLOTS) {
+        sched_yield();
+    }
+    slot = &ring->slots[head & (SG_SHM_RING_SLOTS - 1)];
+    slot->len = len;
+    if (len > 0) {
+        memcpy(slot->packet, packet, len);
+    }
+
+    //publish the slot, then check for a sleeping consumer (pairs with the fence in pop)
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->sleeping, __ATOMIC_RELAXED)) {
+        sgShmFutexWake(&ring->head);
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmRingPop
+// Description  : Take the next packet off a ring.  An empty ring is polled,
+//                then slept on (for at most SG_SHM_WAIT_USEC) unless busy
+//                polling.
+//
+// Inputs       : ring - the ring (this side is its only consumer)
+//                packet - the buffer for the packet (SG_DATA_PACKET_SIZE)
+//                len - set to the length of the packet
+//                busy - poll only, never sleep
+// Outputs      : 0 if a packet was taken, 1 if the ring stayed empty
+
+int sgShmRingPop( sgshmring_t *ring, char *packet, size_t *len, int busy ) {
+
+    uint32_t tail = ring->tail, head;
+    sgshmslot_t *slot;
+
+    pthread_once(&sgShmSpinOnce, sgShmSpinInit);
+    for (int spin = 0; ; spin++) {
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head != tail) {
+            break;
+        }
+        if (spin < sgShmSpinLimit) {
+            SG_SHM_RELAX();
+            continue;
+        }
+        if (busy) {
+            if (sgShmSpinLimit == 0) {
+                sched_yield();
+            }
+            return( 1 );
+        }
+
+        //announce the sleep before the last look at head (pairs with the fence in push)
+        __atomic_store_n(&ring->sleeping, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            sgShmFutexWait(&ring->head, head, SG_SHM_WAIT_USEC);
+            head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        }
+        __atomic_store_n(&ring->sleeping, 0, __ATOMIC_RELAXED);
+        if (head == tail) {
+            return( 1 );
+        }
+        break;
+    }
+
+    slot = &ring->slots[tail & (SG_SHM_RING_SLOTS - 1)];
+    *len = slot->len;
+    if (*len > 0) {
+        memcpy(packet, slot->packet, *len);
+    }
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmSegmentCreate
+// Description  : Create the shared segment of a service, resetting all of
+//                its rings
+//
+// Inputs       : name - the segment name
+//                busy - clients and service poll rather than sleep
+// Outputs      : the mapped segment, NULL if failure
+
+sgshmsegment_t *sgShmSegmentCreate( const char *name, int busy ) {
+
+    char path[256];
+    sgshmsegment_t *seg;
+    int fd;
+
+    if (sgShmSegmentName(name, path, sizeof(path))) {
+        return( NULL );
+    }
+    fd = shm_open(path, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmSegmentCreate: shm_open %s failed [%s]", path, strerror(errno) );
+        return( NULL );
+    }
+    if (ftruncate(fd, sizeof(sgshmsegment_t)) < 0) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmSegmentCreate: ftruncate %s failed [%s]", path, strerror(errno) );
+        close(fd);
+        return( NULL );
+    }
+    seg = mmap(NULL, sizeof(sgshmsegment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmSegmentCreate: mmap %s failed [%s]", path, strerror(errno) );
+        return( NULL );
+    }
+
+    //the magic number goes in last, clients check it before using the rings
+    memset(seg, 0x0, sizeof(sgshmsegment_t));
+    seg->block_size = SG_BLOCK_SIZE;
+    seg->busy_poll = busy;
+    seg->running = 1;
+    __atomic_store_n(&seg->magic, SG_SHM_MAGIC, __ATOMIC_RELEASE);
+    return( seg );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmSegmentOpen
+// Description  : Map the shared segment of a running service
+//
+// Inputs       : name - the segment name
+// Outputs      : the mapped segment, NULL if failure
+
+sgshmsegment_t *sgShmSegmentOpen( const char *name ) {
+
+    char path[256];
+    sgshmsegment_t *seg;
+    struct stat st;
+    int fd;
+
+    if (sgShmSegmentName(name, path, sizeof(path))) {
+        return( NULL );
+    }
+    fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmSegmentOpen: no service at %s [%s]", path, strerror(errno) );
+        return( NULL );
+    }
+    if ((fstat(fd, &st) < 0) || (st.st_size != sizeof(sgshmsegment_t))) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmSegmentOpen: segment %s has the wrong size", path );
+        close(fd);
+        return( NULL );
+    }
+    seg = mmap(NULL, sizeof(sgshmsegment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmSegmentOpen: mmap %s failed [%s]", path, strerror(errno) );
+        return( NULL );
+    }
+    if ((__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != SG_SHM_MAGIC) || (seg->block_size != SG_BLOCK_SIZE)) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmSegmentOpen: segment %s is not a service with %d byte blocks",
+                path, SG_BLOCK_SIZE );
+        munmap(seg, sizeof(sgshmsegment_t));
+        return( NULL );
+    }
+    return( seg );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmSegmentClose
+// Description  : Unmap a shared segment, removing its name if asked
+//
+// Inputs       : seg - the segment
+//                name - the segment name
+//                remove - remove the name (the service is going away)
+// Outputs      : none
+
+void sgShmSegmentClose( sgshmsegment_t *seg, const char *name, int remove ) {
+
+    char path[256];
+
+    munmap(seg, sizeof(sgshmsegment_t));
+    if (remove && (sgShmSegmentName(name, path, sizeof(path)) == 0)) {
+        shm_unlink(path);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmServiceConnect
+// Description  : Attach this process to the out-of-process service, only
+//                one client process may be attached at a time (the rings
+//                have a single producer)
+//
+// Inputs       : name - the segment name the service was started with
+// Outputs      : 0 if successful, -1 if failure
+
+int sgShmServiceConnect( const char *name ) {
+
+    uint32_t expected = 0;
+
+    sgShmSegment = sgShmSegmentOpen(name);
+    if (sgShmSegment == NULL) {
+        return( -1 );
+    }
+    if (!__atomic_load_n(&sgShmSegment->running, __ATOMIC_ACQUIRE) ||
+            !__atomic_compare_exchange_n(&sgShmSegment->attached, &expected, 1, 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmServiceConnect: service %s is stopped or has a client", name );
+        sgShmSegmentClose(sgShmSegment, name, 0);
+        sgShmSegment = NULL;
+        return( -1 );
+    }
+    //drop any reply left behind by a client that died mid request
+    for (int i = 0; i < SG_SHM_CHANNELS; i++) {
+        pthread_mutex_init(&sgShmChannelLock[i], NULL);
+        sgShmSegment->chan[i].response.tail = __atomic_load_n(&sgShmSegment->chan[i].response.head, __ATOMIC_ACQUIRE);
+    }
+    logMessage( LOG_INFO_LEVEL, "Attached to service %s (%d channels, %s).", name, SG_SHM_CHANNELS,
+            sgShmSegment->busy_poll ? "busy polling" : "futex wakeups" );
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmServicePost
+// Description  : Post a packet to the out-of-process service and wait for
+//                the reply.  Each thread sticks to one channel; threads
+//                sharing a channel take turns.
+//
+// Inputs       : packet - the request packet
+//                len - the length of the request packet
+//                rpacket - the buffer for the reply packet
+//                rlen - the size of the reply buffer (set to the reply length)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgShmServicePost( char *packet, size_t *len, char *rpacket, size_t *rlen ) {
+
+    sgshmchannel_t *chan;
+    char reply[SG_DATA_PACKET_SIZE];
+    size_t plen;
+    int ret;
+
+    if (sgShmSegment == NULL) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmServicePost: not attached to a service" );
+        return( -1 );
+    }
+    if (sgShmChannel < 0) {
+        sgShmChannel = __atomic_fetch_add(&sgShmNextChannel, 1, __ATOMIC_RELAXED) % SG_SHM_CHANNELS;
+    }
+    chan = &sgShmSegment->chan[sgShmChannel];
+
+    //the request goes out and its reply comes back on the same channel
+    pthread_mutex_lock(&sgShmChannelLock[sgShmChannel]);
+    if (sgShmRingPush(&chan->request, packet, *len)) {
+        pthread_mutex_unlock(&sgShmChannelLock[sgShmChannel]);
+        return( -1 );
+    }
+    while ((ret = sgShmRingPop(&chan->response, reply, &plen, sgShmSegment->busy_poll)) == 1) {
+        if (!__atomic_load_n(&sgShmSegment->running, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sgShmChannelLock[sgShmChannel]);
+
+    if (ret) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmServicePost: service stopped" );
+        return( -1 );
+    }
+    if ((plen == 0) || (plen > *rlen)) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmServicePost: request failed [reply %zu bytes]", plen );
+        return( -1 );
+    }
+    memcpy(rpacket, reply, plen);
+    *rlen = plen;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmServiceDisconnect
+// Description  : Detach this process from the out-of-process service
+//
+// Inputs       : none
+// Outputs      : none
+
+void sgShmServiceDisconnect( void ) {
+
+    if (sgShmSegment != NULL) {
+        __atomic_store_n(&sgShmSegment->attached, 0, __ATOMIC_RELEASE);
+        sgShmSegmentClose(sgShmSegment, NULL, 0);
+        sgShmSegment = NULL;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmSegmentName
+// Description  : Turn a segment name into a shm_open path ("/name")
+//
+// Inputs       : name - the segment name
+//                path - the buffer for the path
+//                plen - the size of the buffer
+// Outputs      : 0 if successful, -1 if failure
+
+int sgShmSegmentName( const char *name, char *path, size_t plen ) {
+
+    if ((name == NULL) || (name[0] == '\0') || (strchr(name + 1, '/') != NULL) ||
+            (snprintf(path, plen, "%s%s", (name[0] == '/') ? "" : "/", name) >= (int)plen)) {
+        logMessage( LOG_ERROR_LEVEL, "sgShmSegmentName: bad segment name [%s]", name ? name : "" );
+        return( -1 );
+    }
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmSpinInit
+// Description  : Set how long an empty ring is polled, not at all when the
+//                peer can only run once this side gives up the CPU
+//
+// Inputs       : none
+// Outputs      : none
+
+void sgShmSpinInit( void ) {
+
+    sgShmSpinLimit = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? SG_SHM_SPIN_LIMIT : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmFutexWait
+// Description  : Sleep while a shared word holds a value (or until woken or
+//                the timeout passes)
+//
+// Inputs       : addr - the futex word (in the shared segment)
+//                val - the value to sleep on
+//                usec - the longest time to sleep
+// Outputs      : none
+
+void sgShmFutexWait( uint32_t *addr, uint32_t val, long usec ) {
+
+    struct timespec ts = { .tv_sec = usec / 1000000, .tv_nsec = (usec % 1000000) * 1000 };
+
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmFutexWake
+// Description  : Wake the process sleeping on a shared word
+//
+// Inputs       : addr - the futex word (in the shared segment)
+// Outputs      : none
+
+void sgShmFutexWake( uint32_t *addr ) {
+
+    syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
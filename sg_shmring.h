@@ -0,0 +1,87 @@
+#ifndef SG_SHMRING_INCLUDED
+#define SG_SHMRING_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_shmring.h
+//  Description    : This is the declaration of the shared memory transport to
+//                   an out-of-process ScatterGather service (sg_shmsvc).  A
+//                   POSIX shared memory segment holds SG_SHM_CHANNELS pairs of
+//                   lock-free single producer/single consumer packet rings
+//                   (request and response).  A consumer polls its ring, then
+//                   sleeps on a futex, or polls forever in busy-poll mode.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <sg_defs.h>
+
+//
+// Defines
+#define SG_SHM_MAGIC 0x53475348      // Segment magic number ("SGSH")
+#define SG_SHM_CHANNELS 16           // Request/response ring pairs (one server thread each)
+#define SG_SHM_RING_SLOTS 8          // Packets per ring (power of 2)
+#define SG_SHM_SPIN_LIMIT 4096       // Polls of an empty ring before sleeping (or returning)
+#define SG_SHM_WAIT_USEC 100000      // Longest sleep on an empty ring
+#define SG_SHM_CACHE_LINE 64         // Ring indices live on their own cache lines
+
+// Type definitions
+typedef struct {
+    uint32_t len;                        // Length of the packet (0 if the request failed)
+    char     packet[SG_DATA_PACKET_SIZE]; // The packet
+} sgshmslot_t;
+
+typedef struct {
+    uint32_t head __attribute__((aligned(SG_SHM_CACHE_LINE))); // Next slot to fill (producer, futex word)
+    uint32_t sleeping;                                        // The consumer sleeps on head
+    uint32_t tail __attribute__((aligned(SG_SHM_CACHE_LINE))); // Next slot to drain (consumer)
+    sgshmslot_t slots[SG_SHM_RING_SLOTS] __attribute__((aligned(SG_SHM_CACHE_LINE)));
+} sgshmring_t;
+
+typedef struct {
+    sgshmring_t request;   // Client to service
+    sgshmring_t response;  // Service to client
+} sgshmchannel_t;
+
+typedef struct {
+    uint32_t magic;        // SG_SHM_MAGIC once the service has set up the segment
+    uint32_t block_size;   // SG_BLOCK_SIZE the service was built with
+    uint32_t busy_poll;    // Both sides poll rather than sleep
+    uint32_t running;      // The service loop is running
+    uint32_t attached;     // A client process is attached
+    sgshmchannel_t chan[SG_SHM_CHANNELS] __attribute__((aligned(SG_SHM_CACHE_LINE)));
+} sgshmsegment_t;
+
+//
+// Ring and segment functions
+
+int sgShmRingPush( sgshmring_t *ring, const char *packet, size_t len );
+    // Add a packet to a ring, waking its consumer
+
+int sgShmRingPop( sgshmring_t *ring, char *packet, size_t *len, int busy );
+    // Take a packet off a ring, 1 if it stayed empty (poll again)
+
+sgshmsegment_t *sgShmSegmentCreate( const char *name, int busy );
+    // Create (or reset) the shared segment of a service
+
+sgshmsegment_t *sgShmSegmentOpen( const char *name );
+    // Map the shared segment of a running service
+
+void sgShmSegmentClose( sgshmsegment_t *seg, const char *name, int remove );
+    // Unmap a segment (and remove its name)
+
+//
+// Client functions
+
+int sgShmServiceConnect( const char *name );
+    // Attach to the out-of-process service at segment name
+
+int sgShmServicePost( char *packet, size_t *len, char *rpacket, size_t *rlen );
+    // Post a packet to the out-of-process service
+
+void sgShmServiceDisconnect( void );
+    // Detach from the out-of-process service
+
+#endif
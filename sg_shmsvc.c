@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_shmsvc.c
+//  Description    : This is the out-of-process ScatterGather service.  It
+//                   serves the local (in-memory) service over the shared
+//                   memory rings of sg_shmring, one thread per channel,
+//                   until it is interrupted.  Clients attach with sg_sim -r.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_defs.h>
+#include <sg_local_service.h>
+#include <sg_shmring.h>
+
+// Defines
+#define SG_SHMSVC_ARGUMENTS "hvbn:d:z:l:"
+#define USAGE \
+	"USAGE: sg_shmsvc [-h] [-v] [-b] [-n <nodes>] [-d <usec>] [-z <nodes>,<usec>,<pct>]\n" \
+	"                 [-l <logfile>] <segment>\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"    -v - verbose output\n" \
+	"    -b - busy poll the rings (service and clients never sleep)\n" \
+	"    -n - number of nodes of the service\n" \
+	"    -d - per-request delay (usec) of the service\n" \
+	"    -z - the first <nodes> nodes stall <usec> on <pct> percent of their requests\n" \
+	"    -l - write log messages to the filename <logfile>\n" \
+	"and\n" \
+	"    segment - is the name of the shared memory segment clients attach\n" \
+	"              to (sg_sim -r <segment>).\n" \
+	"\n" \
+
+// Functional Prototypes
+void *sgShmServeChannel( void *arg );
+void sgShmServiceStop( int sig );
+
+//
+// Global Data
+unsigned long SGServiceLevel; // Service log level
+volatile sig_atomic_t sgShmServiceStopped = 0; // Set by SIGINT/SIGTERM
+sgshmsegment_t *sgShmServiceSegment; // The segment being served
+unsigned long sgShmServiceRequests[SG_SHM_CHANNELS]; // Requests served per channel
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the out-of-process service
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	int ch, verbose = 0, log_initialized = 0, busy = 0;
+	int nodes = SG_LOCAL_DEFAULT_NODES, delay = 0;
+	int slow_nodes = 0, slow_percent = 0;
+	unsigned int slow_stall = 0;
+	pthread_t threads[SG_SHM_CHANNELS];
+	unsigned long total = 0;
+	struct sigaction sa;
+
+	// Process the command line parameters
+	while ((ch = getopt(argc, argv, SG_SHMSVC_ARGUMENTS)) != -1) {
+
+		switch (ch) {
+		case 'h': // Help, print usage
+			fprintf( stderr, USAGE );
+			return( -1 );
+
+		case 'v': // Verbose Flag
+			verbose = 1;
+			break;
+
+		case 'b': // Busy poll Flag
+			busy = 1;
+			break;
+
+		case 'n': // Service nodes
+			nodes = atoi( optarg );
+			break;
+
+		case 'd': // Service delay
+			delay = atoi( optarg );
+			break;
+
+		case 'z': // Slow nodes
+			if ( sscanf(optarg, "%d,%u,%d", &slow_nodes, &slow_stall, &slow_percent) != 3 ) {
+				fprintf( stderr, "Bad slow nodes (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'l': // Set the log filename
+			initializeLogWithFilename( optarg );
+			log_initialized = 1;
+			break;
+
+		default:  // Default (unknown)
+			fprintf( stderr, "Unknown command line option (%c), aborting.\n", ch );
+			return( -1 );
+		}
+	}
+
+	// Setup the log, check the segment name
+	if ( ! log_initialized ) {
+		initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+	}
+	SGServiceLevel = registerLogLevel("SG_SERVICE", 0); // Service log level
+	if ( verbose ) {
+		enableLogLevels( LOG_INFO_LEVEL );
+		enableLogLevels( SGServiceLevel );
+	}
+	if ( argv[optind] == NULL ) {
+		fprintf( stderr, "Missing command line parameters, use -h to see usage, aborting.\n" );
+		return( -1 );
+	}
+	if ( sgLocalServiceConfigure(nodes, delay) || sgLocalServiceSlowNodes(slow_nodes, slow_stall, slow_percent) ) {
+		return( -1 );
+	}
+
+	// A ring slot holds one block's packet, too small for compound packets
+	sgLocalServiceFeatures( SG_FEATURE_PATCH );
+
+	// Stop cleanly when interrupted
+	sa.sa_handler = sgShmServiceStop;
+	sigemptyset( &sa.sa_mask );
+	sa.sa_flags = 0;
+	sigaction( SIGINT, &sa, NULL );
+	sigaction( SIGTERM, &sa, NULL );
+
+	// Create the segment, serve each channel from its own thread
+	sgShmServiceSegment = sgShmSegmentCreate( argv[optind], busy );
+	if ( sgShmServiceSegment == NULL ) {
+		return( -1 );
+	}
+	logMessage( LOG_INFO_LEVEL, "Serving %d nodes at %s (%d channels, %d byte blocks, %s).", nodes,
+			argv[optind], SG_SHM_CHANNELS, SG_BLOCK_SIZE, busy ? "busy polling" : "futex wakeups" );
+	for ( long i = 0; i < SG_SHM_CHANNELS; i++ ) {
+		if ( pthread_create(&threads[i], NULL, sgShmServeChannel, (void *)i) ) {
+			logMessage( LOG_ERROR_LEVEL, "Unable to start service thread, aborting." );
+			sgShmServiceStopped = 1;
+			sgShmServiceSegment->running = 0;
+			return( -1 );
+		}
+	}
+	for ( int i = 0; i < SG_SHM_CHANNELS; i++ ) {
+		pthread_join( threads[i], NULL );
+		total += sgShmServiceRequests[i];
+	}
+
+	// Tell any client the service is gone, remove the segment
+	__atomic_store_n( &sgShmServiceSegment->running, 0, __ATOMIC_RELEASE );
+	sgShmSegmentClose( sgShmServiceSegment, argv[optind], 1 );
+	logMessage( LOG_INFO_LEVEL, "Service stopped after %lu requests.", total );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmServeChannel
+// Description  : The service loop of a channel, takes requests off the
+//                request ring, posts them to the local service and puts the
+//                replies on the response ring (an empty reply if it failed)
+//
+// Inputs       : arg - the channel number
+// Outputs      : NULL
+
+void *sgShmServeChannel( void *arg ) {
+
+	long channel = (long)arg;
+	sgshmchannel_t *chan = &sgShmServiceSegment->chan[channel];
+	char packet[SG_DATA_PACKET_SIZE], rpacket[SG_DATA_PACKET_SIZE];
+	size_t len, rlen;
+
+	while ( ! sgShmServiceStopped ) {
+		if ( sgShmRingPop(&chan->request, packet, &len, sgShmServiceSegment->busy_poll) ) {
+			continue;
+		}
+		rlen = sizeof(rpacket);
+		if ( sgLocalServicePost(packet, &len, rpacket, &rlen) ) {
+			rlen = 0;
+		}
+		sgShmRingPush( &chan->response, rpacket, rlen );
+		sgShmServiceRequests[channel]++;
+	}
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgShmServiceStop
+// Description  : The signal handler stopping the service loops
+//
+// Inputs       : sig - the signal
+// Outputs      : none
+
+void sgShmServiceStop( int sig ) {
+
+	sgShmServiceStopped = 1;
+}
@@ -13,6 +13,9 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
 #include <cmpsc311_log.h>
 #include <cmpsc311_assocarr.h>
 #include <cmpsc311_workload.h>
@@ -20,33 +23,102 @@
 // Project Includes 
 #include <sg_defs.h>
 #include <sg_driver.h>
+#include <sg_local_service.h>
+#include <sg_shmring.h>
+#include <sg_capture.h>
+#include <sg_workload.h>
 
 // Defines
-#define SG_ARGUMENTS "hvul:"
+#define SG_ARGUMENTS "hvuckiwsaqyPMr:m:p:n:d:z:x:f:e:g:j:o:t:b:D:l:"
 #define USAGE \
-	"USAGE: sg_sim [-h] [-v] [-l <logfile>] <workload>\n" \
+	"USAGE: sg_sim [-h] [-v] [-c] [-k] [-i] [-w] [-s] [-a] [-r <segment>] [-m <segment>]\n" \
+	"              [-p <policy>] [-n <nodes>] [-d <usec>] [-z <nodes>,<usec>,<pct>]\n" \
+	"              [-x <copies>] [-f <blocks>] [-e <ops>] [-g <updates>]\n" \
+	"              [-j <tracefile>] [-o <capture>] [-q] [-y] [-P] [-M] [-t <threads>]\n" \
+	"              [-b <min>,<max>] [-D <file>,<MB>] [-l <logfile>]\n" \
+	"              <workload> [<workload> ...]\n" \
 	"\n" \
 	"where:\n" \
 	"    -h - help mode (display this message)\n" \
 	"    -v - verbose output\n" \
 	"    -u - perform the unit tests\n" \
+	"    -c - compress file blocks (packing and compressed cache tier)\n" \
+	"    -k - verify block checksums on cache hits as well\n" \
+	"    -i - keep small files inline, pack file tails into shared blocks\n" \
+	"    -w - buffer appends until a block is full (or the file is closed)\n" \
+	"    -s - use the local (in-process, concurrent) service\n" \
+	"    -a - use the set associative block cache\n" \
+	"    -r - use the out-of-process service (sg_shmsvc) at <segment>\n" \
+	"    -m - share the block cache with other processes through <segment>\n" \
+	"    -p - block placement policy (0 service, 1 round-robin,\n" \
+	"         2 least-loaded, 3 hash)\n" \
+	"    -n - number of nodes of the local service\n" \
+	"    -d - per-request delay (usec) of the local service\n" \
+	"    -z - the first <nodes> nodes of the local service stall <usec> on\n" \
+	"         <pct> percent of their requests\n" \
+	"    -x - keep <copies> copies of each block, hedging reads over them\n" \
+	"    -f - read <blocks> blocks ahead of files read sequentially\n" \
+	"    -e - limit each file to <ops> block operations per second\n" \
+	"    -g - hold back up to <updates> block updates, merging repeated\n" \
+	"         updates of a block and posting them node by node\n" \
+	"    -j - trace driver, cache, packet and service events to <tracefile>\n" \
+	"         (Chrome trace JSON, load in chrome://tracing or Perfetto)\n" \
+	"    -o - capture every open/read/write/seek/close to the log <capture>\n" \
+	"    -q - leave the data hashes out of the capture log\n" \
+	"    -y - replay capture logs as fast as possible, not at their timing\n" \
+	"    -P - speak only the base protocol (no patches or compound packets)\n" \
+	"    -M - check reads through mapped views of the files (sgmap), not sgread\n" \
+	"    -t - number of client threads, one workload is split between them\n" \
+	"         by object name, several workloads run one per thread\n" \
+	"    -b - size the block cache adaptively between <min> and <max> KB\n" \
+	"    -D - keep up to <MB> of blocks evicted from memory in the local\n" \
+	"         (SSD) file <file>\n" \
 	"    -l - write log messages to the filename <logfile>\n" \
 	"and\n" \
-	"    workload - is the name of the workload file.  Not that this\n" \
-	"               file is not needed when running the unit tests.\n" \
+	"    workload - is the name of the workload file (text, or binary from\n" \
+	"               sg_wlconvert).  Not that this file is not needed when\n" \
+	"               running the unit tests.  Several workloads are replayed\n" \
+	"               concurrently against the same driver.  A capture log\n" \
+	"               (-o) is replayed call for call at its timing, with\n" \
+	"               generated data in place of the data written.\n" \
 	"\n" \
 
+#define SG_SIM_MAX_CLIENTS 64
+#define SG_SIM_LAT_BUCKETS 48 // Latency histogram buckets (powers of 2 nsec)
+#define SG_SIM_MAX_HANDLES (1 << 24) // Largest file handle a capture log may hold
+
+// Type definitions
+typedef struct {
+	char       *wload;        // The workload replayed
+	int         client;       // The client number
+	int         partitions;   // Objects are split over this many clients (1 = all)
+	int         result;       // The result of the replay
+	unsigned long opens, reads, writes, seeks, closes;
+	uint64_t    bytes;        // Bytes read and written
+	uint64_t    latency;      // Total read/write latency (nsec)
+	uint64_t    histogram[SG_SIM_LAT_BUCKETS]; // Read/write latency histogram
+	uint64_t    rhistogram[SG_SIM_LAT_BUCKETS]; // Read latency histogram
+} simclient_t;
+
 //
 // Global Data
 int verbose;
 unsigned long SGServiceLevel; // Service log level
 unsigned long SGDriverLevel; // Controller log level
 unsigned long SGSimulatorLevel; // Simulation log level
+pthread_mutex_t simWorkloadLock = PTHREAD_MUTEX_INITIALIZER; // The text workload reader is not reentrant
+int simReplayFast = 0; // Replay capture logs without waiting for their timing
+int simMapReads = 0; // Read through mapped views of the files (sgmap) in place of sgread
 
 //
 // Functional Prototypes
 
-int simulateScatterGather( char *wload ); // ScatterGather simulation
+int simulateScatterGather( simclient_t *client ); // ScatterGather simulation
+int simulateCaptureReplay( simclient_t *client ); // Replay a capture log
+int simulateScatterGatherClients( char **wloads, int num, int threads ); // Concurrent simulation
+void *simulateClientThread( void *arg ); // Run one simulation client
+void simulateRecordLatency( simclient_t *client, struct timespec *start, size_t size, int read ); // Op latency
+uint64_t simulatePercentile( uint64_t *histogram, uint64_t count, int permille ); // Latency percentile
 int sg_unit_test( void ); // The program unit tests
 extern int packetUnitTest( void ); // External function (packet processing)
 
@@ -66,6 +138,10 @@ int main( int argc, char *argv[] ) {
 
 	// Local variables
 	int ch, verbose = 0, log_initialized = 0, unit_tests = 0;
+	int local_nodes = SG_LOCAL_DEFAULT_NODES, local_delay = 0, threads = 1;
+	int slow_nodes = 0, slow_percent = 0;
+	unsigned int slow_stall = 0;
+	char *segment = NULL;
 	
 	// Process the command line parameters
 	while ((ch = getopt(argc, argv, SG_ARGUMENTS)) != -1) {
@@ -83,6 +159,143 @@ int main( int argc, char *argv[] ) {
 			unit_tests = 1;
 			break;
 
+		case 'c': // Compression Flag
+			sgCompressionEnabled = 1;
+			break;
+
+		case 'k': // Checksum cache hits Flag
+			sgChecksumCacheHits = 1;
+			break;
+
+		case 'i': // Inline small files Flag
+			sgInlineEnabled = 1;
+			break;
+
+		case 'w': // Append buffering Flag
+			sgAppendBuffering = 1;
+			break;
+
+		case 's': // Local service Flag
+			sgDriverServicePost = sgLocalServicePost;
+			sgServiceConcurrent = 1;
+			break;
+
+		case 'a': // Set associative cache Flag
+			sgCacheOrganization = SG_CACHE_SET_ASSOC;
+			break;
+
+		case 'r': // Out-of-process service segment
+			segment = optarg;
+			break;
+
+		case 'm': // Shared cache segment
+			sgCacheSharedName = optarg;
+			break;
+
+		case 'p': // Placement policy
+			sgPlacementPolicy = atoi( optarg );
+			if ( (sgPlacementPolicy < 0) || (sgPlacementPolicy >= SG_PLACE_MAXVAL) ) {
+				fprintf( stderr, "Bad placement policy (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'n': // Local service nodes
+			local_nodes = atoi( optarg );
+			break;
+
+		case 'd': // Local service delay
+			local_delay = atoi( optarg );
+			break;
+
+		case 'z': // Slow local service nodes
+			if ( (sscanf(optarg, "%d,%u,%d", &slow_nodes, &slow_stall, &slow_percent) != 3) ||
+					(slow_nodes < 0) || (slow_percent < 0) || (slow_percent > 100) ) {
+				fprintf( stderr, "Bad slow nodes (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'x': // Block copies
+			sgReplicas = atoi( optarg );
+			if ( (sgReplicas < 1) || (sgReplicas > SG_MAX_REPLICAS) ) {
+				fprintf( stderr, "Bad number of copies (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'f': // Read ahead blocks
+			sgPrefetchBlocks = atoi( optarg );
+			if ( sgPrefetchBlocks < 0 ) {
+				fprintf( stderr, "Bad number of read ahead blocks (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'e': // Per-file rate limit
+			sgSchedFileRate = (uint32_t)atoi( optarg );
+			break;
+
+		case 'g': // Held back updates
+			sgPendingUpdates = atoi( optarg );
+			if ( sgPendingUpdates < 0 ) {
+				fprintf( stderr, "Bad number of held back updates (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'j': // Trace file
+			sgTracePath = optarg;
+			break;
+
+		case 'o': // Capture log
+			sgCapturePath = optarg;
+			break;
+
+		case 'q': // Capture without data hashes
+			sgCaptureHashes = 0;
+			break;
+
+		case 'P': // Only the base protocol
+			sgPatchEnabled = 0;
+			sgCompoundEnabled = 0;
+			break;
+
+		case 'M': // Read through mapped views
+			simMapReads = 1;
+			break;
+
+		case 'y': // Replay captures as fast as possible
+			simReplayFast = 1;
+			break;
+
+		case 't': // Client threads
+			threads = atoi( optarg );
+			if ( (threads < 1) || (threads > SG_SIM_MAX_CLIENTS) ) {
+				fprintf( stderr, "Bad number of threads (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'b': // Adaptive cache budget
+			if ( (sscanf(optarg, "%lu,%lu", &sgCacheMinBytes, &sgCacheMaxBytes) != 2) ||
+					(sgCacheMinBytes == 0) || (sgCacheMaxBytes < sgCacheMinBytes) ) {
+				fprintf( stderr, "Bad cache budget (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			sgCacheMinBytes *= 1024;
+			sgCacheMaxBytes *= 1024;
+			break;
+
+		case 'D': // Disk tier of the cache
+			if ( (sscanf(optarg, "%m[^,],%lu", &sgCacheDiskPath, &sgCacheDiskBytes) != 2) ||
+					(sgCacheDiskBytes == 0) ) {
+				fprintf( stderr, "Bad disk tier (%s), aborting.\n", optarg );
+				return( -1 );
+			}
+			sgCacheDiskBytes *= 1024 * 1024;
+			break;
+
 		case 'l': // Set the log filename
 			initializeLogWithFilename( optarg );
 			log_initialized = 1;
@@ -105,6 +318,17 @@ int main( int argc, char *argv[] ) {
 		enableLogLevels( LOG_INFO_LEVEL );
 		enableLogLevels(SGServiceLevel | SGDriverLevel | SGSimulatorLevel);
 	}
+	if ( sgLocalServiceConfigure(local_nodes, local_delay) ||
+			sgLocalServiceSlowNodes(slow_nodes, slow_stall, slow_percent) ) {
+		return( -1 );
+	}
+	if ( segment != NULL ) {
+		if ( sgShmServiceConnect(segment) ) {
+			return( -1 );
+		}
+		sgDriverServicePost = sgShmServicePost;
+		sgServiceConcurrent = 1;
+	}
 
 	// If exgtracting file from data
 	if (unit_tests) {
@@ -127,7 +351,7 @@ int main( int argc, char *argv[] ) {
 		}
 
 		// Run the simulation
-		if ( simulateScatterGather(argv[optind]) == 0 ) {
+		if ( simulateScatterGatherClients(&argv[optind], argc - optind, threads) == 0 ) {
 			logMessage( LOG_INFO_LEVEL, "ScatterGather.com simulation completed successfully!!!\n\n" );
 		} else {
 			logMessage( LOG_INFO_LEVEL, "ScatterGather.com simulation failed.\n\n" );
@@ -135,19 +359,193 @@ int main( int argc, char *argv[] ) {
 	}
 
 	// Return successfully
+	sgShmServiceDisconnect();
 	return( 0 );
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulateScatterGatherClients
+// Description  : Replay workloads concurrently against the driver.  With one
+//                workload each thread replays the objects whose names hash
+//                to it, with several workloads each runs on its own thread.
+//
+// Inputs       : wloads - the workload filenames
+//                num - the number of workloads
+//                threads - the number of client threads
+// Outputs      : 0 if successful test, -1 if failure
+
+int simulateScatterGatherClients( char **wloads, int num, int threads ) {
+
+	simclient_t *clients;
+	pthread_t tids[SG_SIM_MAX_CLIENTS];
+	struct timespec start, end;
+	uint64_t histogram[SG_SIM_LAT_BUCKETS] = { 0 }, rhistogram[SG_SIM_LAT_BUCKETS] = { 0 };
+	uint64_t latency = 0, bytes = 0, count = 0;
+	unsigned long opens = 0, reads = 0, writes = 0, seeks = 0, closes = 0;
+	double elapsed;
+	int ret = 0;
+
+	/* Several workloads get a thread each, one workload is partitioned */
+	if ( num > 1 ) {
+		threads = num;
+	}
+	if ( threads > SG_SIM_MAX_CLIENTS ) {
+		logMessage( LOG_ERROR_LEVEL, "CMPSC311 SG : too many clients [%d]", threads );
+		return( -1 );
+	}
+	clients = calloc( threads, sizeof(simclient_t) );
+	for ( int i=0; i<threads; i++ ) {
+		clients[i].wload = wloads[(num > 1) ? i : 0];
+		clients[i].client = i;
+		clients[i].partitions = (num > 1) ? 1 : threads;
+	}
+
+	/* Run the clients, the first on this thread */
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	for ( int i=1; i<threads; i++ ) {
+		if ( pthread_create(&tids[i], NULL, simulateClientThread, &clients[i]) ) {
+			logMessage( LOG_ERROR_LEVEL, "CMPSC311 SG : failed starting client %d", i );
+			simulateClientThread( &clients[i] );
+			tids[i] = 0;
+		}
+	}
+	simulateClientThread( &clients[0] );
+	for ( int i=1; i<threads; i++ ) {
+		if ( tids[i] != 0 ) {
+			pthread_join( tids[i], NULL );
+		}
+	}
+	clock_gettime( CLOCK_MONOTONIC, &end );
+
+	/* All of the clients are done, shut the driver down */
+	if ( sgshutdown() ) {
+		logMessage( LOG_ERROR_LEVEL, "SG shutdown failed" );
+		ret = -1;
+	}
+
+	/* Aggregate and report the client results */
+	for ( int i=0; i<threads; i++ ) {
+		if ( clients[i].result ) {
+			logMessage( LOG_ERROR_LEVEL, "CMPSC311 SG : client %d [%s] failed", i, clients[i].wload );
+			ret = -1;
+		}
+		if ( threads > 1 ) {
+			logMessage( LOG_INFO_LEVEL, "Client %d: %lu opens, %lu reads (verified), %lu writes, %lu seeks, %lu closes",
+				i, clients[i].opens, clients[i].reads, clients[i].writes, clients[i].seeks, clients[i].closes );
+		}
+		opens += clients[i].opens;
+		reads += clients[i].reads;
+		writes += clients[i].writes;
+		seeks += clients[i].seeks;
+		closes += clients[i].closes;
+		bytes += clients[i].bytes;
+		latency += clients[i].latency;
+		for ( int b=0; b<SG_SIM_LAT_BUCKETS; b++ ) {
+			histogram[b] += clients[i].histogram[b];
+			rhistogram[b] += clients[i].rhistogram[b];
+		}
+	}
+	count = reads + writes;
+	elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	logMessage( LOG_INFO_LEVEL, "Replay: %d clients, %lu opens, %lu reads, %lu writes, %lu seeks, %lu closes in %.3f sec",
+		threads, opens, reads, writes, seeks, closes, elapsed );
+	if ( (count > 0) && (elapsed > 0) ) {
+		logMessage( LOG_INFO_LEVEL, "Throughput: %.0f ops/sec, %.2f MB/sec; latency mean %lu ns, p50 <%lu ns, p95 <%lu ns, p99 <%lu ns, p999 <%lu ns",
+			count / elapsed, bytes / elapsed / (1024.0 * 1024.0), latency / count,
+			simulatePercentile(histogram, count, 500), simulatePercentile(histogram, count, 950),
+			simulatePercentile(histogram, count, 990), simulatePercentile(histogram, count, 999) );
+	}
+	if ( reads > 0 ) {
+		logMessage( LOG_INFO_LEVEL, "Read latency: p50 <%lu ns, p95 <%lu ns, p99 <%lu ns, p999 <%lu ns",
+			simulatePercentile(rhistogram, reads, 500), simulatePercentile(rhistogram, reads, 950),
+			simulatePercentile(rhistogram, reads, 990), simulatePercentile(rhistogram, reads, 999) );
+	}
+	free( clients );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulateClientThread
+// Description  : Run one simulation client (thread start routine)
+//
+// Inputs       : arg - the client (simclient_t)
+// Outputs      : NULL
+
+void *simulateClientThread( void *arg ) {
+
+	simclient_t *client = arg;
+
+	client->result = simulateScatterGather( client );
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulateRecordLatency
+// Description  : Record the latency of a read or write
+//
+// Inputs       : client - the client
+//                start - the time the operation started
+//                size - the bytes read or written
+//                read - 1 if the operation was a read
+// Outputs      : none
+
+void simulateRecordLatency( simclient_t *client, struct timespec *start, size_t size, int read ) {
+
+	struct timespec end;
+	uint64_t nsec;
+	int bucket = 0;
+
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	nsec = (uint64_t)(end.tv_sec - start->tv_sec) * 1000000000 + (end.tv_nsec - start->tv_nsec);
+	while ( (bucket < SG_SIM_LAT_BUCKETS-1) && ((nsec >> bucket) > 1) ) {
+		bucket ++;
+	}
+	client->histogram[bucket] ++;
+	if ( read ) {
+		client->rhistogram[bucket] ++;
+	}
+	client->latency += nsec;
+	client->bytes += size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulatePercentile
+// Description  : Find the latency bucket holding a percentile
+//
+// Inputs       : histogram - the latency histogram
+//                count - the number of samples
+//                permille - the percentile (in tenths of a percent)
+// Outputs      : the upper bound of the bucket (nsec)
+
+uint64_t simulatePercentile( uint64_t *histogram, uint64_t count, int permille ) {
+
+	uint64_t seen = 0;
+	int bucket;
+
+	for ( bucket=0; bucket<SG_SIM_LAT_BUCKETS-1; bucket++ ) {
+		seen += histogram[bucket];
+		if ( seen * 1000 >= count * permille ) {
+			break;
+		}
+	}
+	return( (uint64_t)2 << bucket );
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Function     : simulateScatterGather
 // Description  : The main control loop for the processing of the SG
 //                simulation (which calls the student code).
 //
-// Inputs       : wload - this is the workload filename
+// Inputs       : client - the client, with the workload filename and the
+//                         partition of its objects to replay
 // Outputs      : 0 if successful test, -1 if failure
 
-int simulateScatterGather( char *wload ) {
+int simulateScatterGather( simclient_t *client ) {
 
 	/* Local types */
 	typedef struct {
@@ -159,10 +557,17 @@ int simulateScatterGather( char *wload ) {
     /* Local variables */
     workload_state state;
     workload_operation operation;
+	sg_workload_t binary;
+	const sg_workload_op_t *record;
+	const char *objname, *data, *view;
+	workload_operations_type op;
+	size_t pos, size;
+	int is_binary, ret;
 	SgFHandle fh;
 	AssocArray fhTable;
-	char buf[10240];
-	int opens, reads, writes, seeks, closes;
+	char buf[10240], *wload = client->wload;
+	struct timespec start;
+	unsigned long hash;
 	fsysdata *fdata;
 
 	/* Initalize the local data and simulation */
@@ -171,143 +576,209 @@ int simulateScatterGather( char *wload ) {
 		return( -1 );
 	}
 
-	/* Open the workload for processing */
-	if ( openCmpsc311Workload(&state, wload) ) {
+	/* Capture logs are replayed call for call */
+	if ( sgCaptureIsLog(wload) ) {
+		return( simulateCaptureReplay(client) );
+	}
+
+	/* Open the workload for processing, binary workloads are mapped */
+	is_binary = sgWorkloadIsBinary( wload );
+	pthread_mutex_lock( &simWorkloadLock );
+	ret = is_binary ? sgWorkloadOpen(&binary, wload) : openCmpsc311Workload(&state, wload);
+	pthread_mutex_unlock( &simWorkloadLock );
+	if ( ret ) {
 		logMessage( LOG_ERROR_LEVEL, "CMPSC311 SG workload: failed opening workload [%s]", wload );
 		return( -1 );        
 	}
 
 	/* Loop until we are done with the workload */
-	logMessage( SGSimulatorLevel, "CMPSC311 SG : executing workload [%s]", state.filename );
+	logMessage( SGSimulatorLevel, "CMPSC311 SG : executing workload [%s]", wload );
 	do {
 
 		/* Get the next operation to process */
-		if ( readCmpsc311Workload(&state, &operation) ) {
-			logMessage( LOG_ERROR_LEVEL, "CMPSC311 workload unit test failed at line %d, get op", state.lineno );
-			return( -1 );
+		if ( is_binary ) {
+			if ( (record = sgWorkloadNext(&binary)) == NULL ) {
+				logMessage( LOG_ERROR_LEVEL, "CMPSC311 binary workload ended at op %lu without EOF", binary.next );
+				return( -1 );
+			}
+			objname = sgWorkloadObject( &binary, record );
+			data = sgWorkloadData( &binary, record );
+			op = record->op;
+			pos = record->pos;
+			size = record->size;
+		} else {
+			pthread_mutex_lock( &simWorkloadLock );
+			ret = readCmpsc311Workload( &state, &operation );
+			pthread_mutex_unlock( &simWorkloadLock );
+			if ( ret ) {
+				logMessage( LOG_ERROR_LEVEL, "CMPSC311 workload unit test failed at line %d, get op", state.lineno );
+				return( -1 );
+			}
+			objname = operation.objname;
+			data = operation.data;
+			op = operation.op;
+			pos = operation.pos;
+			size = operation.size;
+		}
+
+		/* Skip objects that belong to other clients */
+		if ( (client->partitions > 1) && (op != WL_EOF) ) {
+			hash = 5381;
+			for ( const char *c = objname; *c; c++ ) {
+				hash = (hash * 33) ^ (unsigned char)*c;
+			}
+			if ( (int)(hash % client->partitions) != client->client ) {
+				continue;
+			}
 		}
 
 		/* Verbose log the operation */
-		if ( (operation.op == WL_READ) || (operation.op == WL_WRITE) ) {
-			logMessage( SGSimulatorLevel, "CMPSCS311 workload op: %s %s off=%d, sz=%d [%.10s <more data follows>]", operation.objname,
-				workload_operations_strings[operation.op], operation.pos, operation.size, operation.data );
+		if ( (op == WL_READ) || (op == WL_WRITE) ) {
+			logMessage( SGSimulatorLevel, "CMPSCS311 workload op: %s %s off=%d, sz=%d [%.10s <more data follows>]", objname,
+				workload_operations_strings[op], pos, size, data );
 		} else {
-			logMessage( SGSimulatorLevel, "CMPSCS311 workload op: %s %s", operation.objname, 
-				workload_operations_strings[operation.op] );
+			logMessage( SGSimulatorLevel, "CMPSCS311 workload op: %s %s", objname, 
+				workload_operations_strings[op] );
 		}
 
 		/* Switch on the operation type */
-		switch ( operation.op ) {
+		switch ( op ) {
 
 			case WL_OPEN: /* Open the file for reading/writing, check error */
 
 				/* Open the file for reading */
-				if ( (fh = sgopen(operation.objname)) == -1 ) {
-					logMessage( LOG_ERROR_LEVEL, "SG error opening file [%s], aborting", operation.objname );
+				if ( (fh = sgopen(objname)) == -1 ) {
+					logMessage( LOG_ERROR_LEVEL, "SG error opening file [%s], aborting", objname );
 					return( -1 );
 				}
 
 				/* Setup the structure */
 				fdata = malloc( sizeof(fsysdata) );
-				fdata->filename = strdup( operation.objname );
+				fdata->filename = strdup( objname );
 				fdata->fhandle = fh;
 				fdata->pos = 0;
 
 				/* Insert the file into the table */
 				insert_assoc( &fhTable, fdata->filename, fdata );
 				logMessage( SGSimulatorLevel, "SG Open file [%s]", fdata->filename );
-				opens ++;
+				client->opens ++;
 				break;
 
 			case WL_READ: /* Read a block of data from the file */
 
 				/* Find the file for processing */
-				if ( (fdata = find_assoc(&fhTable, operation.objname)) == NULL ) {
+				if ( (fdata = find_assoc(&fhTable, (char *)objname)) == NULL ) {
 					logMessage( LOG_ERROR_LEVEL, "SG error reading unknown file [%s], aborting", 
-						operation.objname );
+						objname );
 					return( -1 );
 				}
 
+				/* A mapped view is read in place, it leaves the file position alone */
+				if ( simMapReads ) {
+					clock_gettime( CLOCK_MONOTONIC, &start );
+					if ( (view = sgmap(fdata->fhandle, pos, size)) == NULL ) {
+						logMessage( LOG_ERROR_LEVEL, "SG error map failed [%s, pos=%d, size=%d], aborting", 
+							objname, pos, size );
+						return( -1 );
+					}
+					ret = strncmp( view, data, size );
+					simulateRecordLatency( client, &start, size, 1 );
+					sgunmap( view );
+					if ( ret != 0 ) {
+						logMessage( LOG_ERROR_LEVEL, "SG mapped data compare failed [%s, pos=%d, size=%d], aborting", 
+							objname, pos, size );
+						return( -1 );
+					}
+					logMessage( SGSimulatorLevel, "Correctly mapped [%s], %d bytes at position %d", 
+						fdata->filename, size, pos );
+					client->reads ++;
+					break;
+				}
+
 				/* If the position within the file is not a read location, seek */
-				if ( fdata->pos != operation.pos ) {
-					if ( sgseek(fdata->fhandle, operation.pos) != operation.pos ) {
+				if ( fdata->pos != pos ) {
+					if ( sgseek(fdata->fhandle, pos) != pos ) {
 						logMessage( LOG_ERROR_LEVEL, "SG error seek failed [%s, pos=%d], aborting", 
-							operation.objname, operation.pos );
+							objname, pos );
 						return( -1 );
 					}
-					fdata->pos = operation.pos;
-					seeks ++;
+					fdata->pos = pos;
+					client->seeks ++;
 				}
 
 				/* Now do the read from the file */
-				if ( sgread(fdata->fhandle, buf, operation.size) != operation.size ) {
+				clock_gettime( CLOCK_MONOTONIC, &start );
+				if ( sgread(fdata->fhandle, buf, size) != size ) {
 					logMessage( LOG_ERROR_LEVEL, "SG error read failed [%s, pos=%d, size=%d], aborting", 
-						operation.objname, operation.pos, operation.size );
+						objname, pos, size );
 					return( -1 );
 				}
+				simulateRecordLatency( client, &start, size, 1 );
 
 				/* Compare the data read with that in the workload data */
-				if ( strncmp(buf, operation.data, operation.size) != 0 ) {
+				if ( strncmp(buf, data, size) != 0 ) {
 					logMessage( LOG_ERROR_LEVEL, "SG read data compare failed, aborting" );
 					logMessage( LOG_ERROR_LEVEL, "Read data     : [%s]", buf );
-					logMessage( LOG_ERROR_LEVEL, "Expected data : [%s]", operation.data );
+					logMessage( LOG_ERROR_LEVEL, "Expected data : [%.*s]", (int)size, data );
 					return( -1 );
 				}
 
 				/* Now increment the file position, log the data */
-				fdata->pos += operation.size;
+				fdata->pos += size;
 				logMessage( SGSimulatorLevel, "Correctly read from [%s], %d bytes at position %d", 
-					fdata->filename, operation.size, operation.pos );
-				reads ++;
+					fdata->filename, size, pos );
+				client->reads ++;
 				break;
 
 			case WL_WRITE: /* Write a block of data to the file */
 
 				/* Find the file for processing */
-				if ( (fdata = find_assoc(&fhTable, operation.objname)) == NULL ) {
+				if ( (fdata = find_assoc(&fhTable, (char *)objname)) == NULL ) {
 					logMessage( LOG_ERROR_LEVEL, "SG error writing unknown file [%s], aborting", 
-						operation.objname );
+						objname );
 					return( -1 );
 				}
 
 				/* If the position within the file is not a read location, seek */
-				if ( fdata->pos != operation.pos ) {
-					if ( sgseek(fdata->fhandle, operation.pos) != operation.pos ) {
+				if ( fdata->pos != pos ) {
+					if ( sgseek(fdata->fhandle, pos) != pos ) {
 						logMessage( LOG_ERROR_LEVEL, "SG error seek failed [%s, pos=%d], aborting", 
-							operation.objname, operation.pos );
+							objname, pos );
 						return( -1 );
 					}
-					fdata->pos = operation.pos;
-					seeks ++;
+					fdata->pos = pos;
+					client->seeks ++;
 				}
 
 				/* Now do the write to the file */
-				if ( sgwrite(fdata->fhandle, operation.data, operation.size) != operation.size ) {
+				clock_gettime( CLOCK_MONOTONIC, &start );
+				if ( sgwrite(fdata->fhandle, (char *)data, size) != size ) {
 					logMessage( LOG_ERROR_LEVEL, "SG error write failed [%s, pos=%d, size=%d], aborting", 
-						operation.objname, operation.pos, operation.size );
+						objname, pos, size );
 					return( -1 );
 				}
+				simulateRecordLatency( client, &start, size, 0 );
 
 				/* Now increment the file position, log the data */
-				fdata->pos += operation.size;
+				fdata->pos += size;
 				logMessage( SGSimulatorLevel, "Wrote data to file [%s], %d bytes at position %d", 
-					fdata->filename, operation.size, operation.pos );
-				writes ++;
+					fdata->filename, size, pos );
+				client->writes ++;
 				break;
 
 			case WL_CLOSE:
 
 				/* Find the file for processing */
-				if ( (fdata = find_assoc(&fhTable, operation.objname)) == NULL ) {
+				if ( (fdata = find_assoc(&fhTable, (char *)objname)) == NULL ) {
 					logMessage( LOG_ERROR_LEVEL, "SG error closing unknown file [%s], aborting", 
-						operation.objname );
+						objname );
 					return( -1 );
 				}
 
 				/* Now close the file */
 				if ( sgclose(fdata->fhandle) != 0 ) {
 					logMessage( LOG_ERROR_LEVEL, "SG error close failed [%s, pos=%d, size=%d], aborting", 
-						operation.objname, operation.pos, operation.size );
+						objname, pos, size );
 					return( -1 );
 				}
 
@@ -316,30 +787,184 @@ int simulateScatterGather( char *wload ) {
 				delete_assoc( &fhTable, fdata->filename );
 				free( fdata->filename );
 				free( fdata );
-				closes ++;
+				client->closes ++;
 				break;
 
-			case WL_EOF: // End of the workload file
-				if ( sgshutdown() ) {
-					logMessage( LOG_ERROR_LEVEL, "SG shutdown failed" );
-					return( -1 );
-				}
+			case WL_EOF: // End of the workload file (the driver is shut down once all clients finish)
 				logMessage( SGSimulatorLevel, "End of the workload file (processed)" );
 				break;
 
 			default: /* Unknown oepration type, bailout */
-				logMessage( LOG_ERROR_LEVEL, "Scatter/gather bad operation type [%d]", operation.op );
+				logMessage( LOG_ERROR_LEVEL, "Scatter/gather bad operation type [%d]", op );
 				return( -1 );
 
 		}
 
-	} while ( operation.op < WL_EOF );
+	} while ( op < WL_EOF );
 	
 	/* Log, close workload and delete the local file, return successfully  */
-	closeCmpsc311Workload( &state );
+	if ( is_binary ) {
+		sgWorkloadClose( &binary );
+	} else {
+		pthread_mutex_lock( &simWorkloadLock );
+		closeCmpsc311Workload( &state );
+		pthread_mutex_unlock( &simWorkloadLock );
+	}
 	return( 0 );
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulateCaptureReplay
+// Description  : Replay a capture log against the driver, issuing the calls
+//                it recorded in order and (unless -y) at the times they were
+//                made.  The log holds at most a hash of the data, so writes
+//                are given data generated from it (equal hashes give equal
+//                data) and reads are not verified.  Calls whose result
+//                differs from the one captured are counted, not failed.
+//
+// Inputs       : client - the client, with the log filename and the
+//                         partition of its file handles to replay
+// Outputs      : 0 if successful test, -1 if failure
+
+int simulateCaptureReplay( simclient_t *client ) {
+
+	sg_capture_t cap;
+	const sg_capture_rec_t *rec;
+	const char *path;
+	SgFHandle *handles = NULL, fh;
+	uint32_t num_handles = 0, key;
+	char *buf = NULL;
+	size_t buflen = 0;
+	struct timespec base, start, due;
+	uint64_t now, target, lag = 0, seed;
+	unsigned long calls = 0, differed = 0, late = 0;
+	int ret;
+
+	pthread_mutex_lock( &simWorkloadLock );
+	ret = sgCaptureOpen( &cap, client->wload );
+	pthread_mutex_unlock( &simWorkloadLock );
+	if ( ret ) {
+		logMessage( LOG_ERROR_LEVEL, "CMPSC311 SG capture: failed opening capture log [%s]", client->wload );
+		return( -1 );
+	}
+	logMessage( SGSimulatorLevel, "CMPSC311 SG : replaying capture log [%s]", client->wload );
+
+	clock_gettime( CLOCK_MONOTONIC, &base );
+	while ( (rec = sgCaptureNext(&cap, &path)) != NULL ) {
+
+		/* Skip handles that belong to other clients (failed opens are the first client's) */
+		key = rec->fh;
+		if ( (rec->op == SG_CAPTURE_OPEN) && (rec->result == -1) ) {
+			key = 0;
+		}
+		if ( (client->partitions > 1) && ((int)(key % client->partitions) != client->client) ) {
+			continue;
+		}
+
+		/* Map the captured handle to the one it was opened as here */
+		if ( key >= SG_SIM_MAX_HANDLES ) {
+			logMessage( LOG_ERROR_LEVEL, "CMPSC311 SG capture: bad file handle %u in record %lu", key, cap.count );
+			ret = -1;
+			break;
+		}
+		if ( key >= num_handles ) {
+			handles = realloc( handles, (key + 64) * sizeof(SgFHandle) );
+			for ( uint32_t i=num_handles; i<key+64; i++ ) {
+				handles[i] = -1;
+			}
+			num_handles = key + 64;
+		}
+		fh = handles[key];
+
+		/* Wait until the call is due */
+		if ( ! simReplayFast ) {
+			target = (uint64_t)base.tv_sec * 1000000000 + base.tv_nsec + rec->time;
+			clock_gettime( CLOCK_MONOTONIC, &start );
+			now = (uint64_t)start.tv_sec * 1000000000 + start.tv_nsec;
+			if ( now < target ) {
+				due.tv_sec = target / 1000000000;
+				due.tv_nsec = target % 1000000000;
+				clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL );
+			} else if ( now - target > 1000000 ) {
+				late ++;
+				if ( now - target > lag ) {
+					lag = now - target;
+				}
+			}
+		}
+		if ( (rec->op == SG_CAPTURE_READ) || (rec->op == SG_CAPTURE_WRITE) ) {
+			if ( rec->size > buflen ) {
+				buflen = rec->size;
+				buf = realloc( buf, buflen );
+			}
+		}
+
+		/* Issue the call */
+		clock_gettime( CLOCK_MONOTONIC, &start );
+		switch ( rec->op ) {
+
+			case SG_CAPTURE_OPEN:
+				ret = sgopen( path );
+				if ( rec->result != -1 ) {
+					handles[key] = ret;
+				}
+				differed += ((ret == -1) != (rec->result == -1));
+				client->opens ++;
+				break;
+
+			case SG_CAPTURE_READ:
+				ret = sgread( fh, buf, rec->size );
+				simulateRecordLatency( client, &start, (ret > 0) ? ret : 0, 1 );
+				differed += (ret != rec->result);
+				client->reads ++;
+				break;
+
+			case SG_CAPTURE_WRITE:
+				seed = rec->hash ? rec->hash : ((uint64_t)rec->fh << 32) ^ rec->off ^ rec->size;
+				for ( uint32_t i=0; i<rec->size; i++ ) {
+					seed ^= seed << 13;
+					seed ^= seed >> 7;
+					seed ^= seed << 17;
+					buf[i] = 'a' + (seed % 26);
+				}
+				ret = sgwrite( fh, buf, rec->size );
+				simulateRecordLatency( client, &start, (ret > 0) ? ret : 0, 0 );
+				differed += (ret != rec->result);
+				client->writes ++;
+				break;
+
+			case SG_CAPTURE_SEEK:
+				ret = sgseek( fh, rec->off );
+				differed += (ret != rec->result);
+				client->seeks ++;
+				break;
+
+			case SG_CAPTURE_CLOSE:
+				ret = sgclose( fh );
+				differed += (ret != rec->result);
+				handles[key] = -1;
+				client->closes ++;
+				break;
+		}
+		calls ++;
+		ret = 0;
+	}
+	if ( cap.next != cap.length ) {
+		ret = -1;
+	}
+
+	/* Log, close the log, return */
+	logMessage( LOG_INFO_LEVEL, "Capture replay [%s]: %lu calls, %lu results differed from the capture, %lu behind its timing (max %lu usec).",
+		client->wload, calls, differed, late, lag / 1000 );
+	pthread_mutex_lock( &simWorkloadLock );
+	sgCaptureClose( &cap );
+	pthread_mutex_unlock( &simWorkloadLock );
+	free( handles );
+	free( buf );
+	return( ret );
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Function     : sg_unit_test
@@ -0,0 +1,450 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_ssdcache.c
+//  Description    : This file contains the local disk (SSD) tier of the block
+//                   cache.  The tier is exclusive of the memory cache: a block
+//                   read back is removed (it goes back into memory), a block
+//                   replaced in memory drops its copy here.  Segments are only
+//                   ever written whole, so the file sees large sequential
+//                   writes and small random reads.  The caller serializes
+//                   access (the cache lock).
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_ssdcache.h>
+#include <sg_crc.h>
+
+// Defines
+#define SG_SSDCACHE_EMPTY UINT32_MAX // Slot of an empty index entry
+
+// Functional Prototypes
+sgssdentry_t *sgSsdCacheFind( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk );
+void sgSsdCacheAdd( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, uint32_t slot, uint32_t crc );
+void sgSsdCacheDelete( sgssdcache_t *sc, sgssdentry_t *entry );
+int sgSsdCacheSeal( sgssdcache_t *sc );
+void sgSsdCacheNextSegment( sgssdcache_t *sc );
+void sgSsdCacheDropSegment( sgssdcache_t *sc, uint32_t seg );
+int sgSsdCacheCleanSegment( sgssdcache_t *sc, uint32_t seg );
+off_t sgSsdCacheOffset( sgssdcache_t *sc, uint32_t slot );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheOpen
+// Description  : Create the disk tier in a file (truncated, the tier does not
+//                outlive the process)
+//
+// Inputs       : path - the tier filename (on the local SSD)
+//                bytes - the most bytes of blocks to hold
+// Outputs      : the disk tier, NULL if failure
+
+sgssdcache_t *sgSsdCacheOpen( const char *path, size_t bytes ) {
+
+    sgssdcache_t *sc;
+    uint64_t slots;
+    uint32_t size = 1;
+
+    sc = calloc(1, sizeof(sgssdcache_t));
+    sc->seg_blocks = SG_SSDCACHE_SEGMENT_BYTES / SG_BLOCK_SIZE;
+    sc->num_segs = bytes / ((size_t)sc->seg_blocks * SG_BLOCK_SIZE);
+    if (sc->num_segs < SG_SSDCACHE_MIN_SEGMENTS) {
+        sc->num_segs = SG_SSDCACHE_MIN_SEGMENTS;
+    }
+    slots = (uint64_t)sc->num_segs * sc->seg_blocks;
+    if ((sc->seg_blocks == 0) || (slots >= SG_SSDCACHE_EMPTY / 2)) {
+        logMessage(LOG_ERROR_LEVEL, "sgSsdCacheOpen: bad disk tier size [%lu bytes]", bytes);
+        free(sc);
+        return( NULL );
+    }
+    if (((sc->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600)) == -1) ||
+        (ftruncate(sc->fd, (off_t)slots * SG_BLOCK_SIZE) != 0)) {
+        logMessage(LOG_ERROR_LEVEL, "sgSsdCacheOpen: unable to create disk tier [%s]", path);
+        if (sc->fd != -1) {
+            close(sc->fd);
+            unlink(path);
+        }
+        free(sc);
+        return( NULL );
+    }
+
+    // the index is kept at most 3/4 full
+    while (size < slots + slots / 3 + 1) {
+        size <<= 1;
+    }
+    sc->index = malloc(size * sizeof(sgssdentry_t));
+    for (uint32_t i = 0; i < size; i++) {
+        sc->index[i].slot = SG_SSDCACHE_EMPTY;
+    }
+    sc->index_mask = size - 1;
+    sc->segs = calloc(sc->num_segs, sizeof(sgssdseg_t));
+    sc->slots = calloc(slots, sizeof(sgssdentry_t));
+    sc->wbuf = malloc((size_t)sc->seg_blocks * SG_BLOCK_SIZE);
+    sc->path = strdup(path);
+    sc->active = 0;
+    sc->fill = 0;
+    sc->seq = 1;
+    sc->segs[0].seq = sc->seq;
+    logMessage(LOG_INFO_LEVEL, "sgSsdCacheOpen: disk tier [%s], %u segments of %u blocks (%lu bytes)",
+            path, sc->num_segs, sc->seg_blocks, (unsigned long)slots * SG_BLOCK_SIZE);
+    return( sc );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheInsert
+// Description  : Add an evicted block to the tier, replacing any older copy.
+//                The block goes into the segment being filled, which is
+//                written out once it is full.
+//
+// Inputs       : sc - the disk tier
+//                nde - node ID of the block
+//                blk - block ID of the block
+//                block - the block data
+// Outputs      : 0 if successful, -1 if failure
+
+int sgSsdCacheInsert( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, char *block ) {
+
+    sgssdentry_t *entry;
+    uint32_t slot;
+
+    if ((entry = sgSsdCacheFind(sc, nde, blk)) != NULL) {
+        sgSsdCacheDelete(sc, entry);
+    }
+    if (sc->fill == sc->seg_blocks) {
+        sgSsdCacheSeal(sc);
+        sgSsdCacheNextSegment(sc);
+    }
+    slot = sc->active * sc->seg_blocks + sc->fill;
+    memcpy(&sc->wbuf[(size_t)sc->fill * SG_BLOCK_SIZE], block, SG_BLOCK_SIZE);
+    sc->slots[slot].rem_id = nde;
+    sc->slots[slot].blk_id = blk;
+    sgSsdCacheAdd(sc, nde, blk, slot, sgCrc32c(0, block, SG_BLOCK_SIZE));
+    sc->fill++;
+    sc->inserts++;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheGet
+// Description  : Read a block out of the tier, removing it (it goes back into
+//                the memory cache).  A block failing its checksum is a miss.
+//
+// Inputs       : sc - the disk tier
+//                nde - node ID of the block
+//                blk - block ID of the block
+//                block - buffer to read the block into
+// Outputs      : 0 if found, -1 if not found
+
+int sgSsdCacheGet( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, char *block ) {
+
+    sgssdentry_t *entry;
+    uint32_t seg;
+
+    sc->lookups++;
+    if ((entry = sgSsdCacheFind(sc, nde, blk)) == NULL) {
+        return( -1 );
+    }
+    seg = entry->slot / sc->seg_blocks;
+    if (seg == sc->active) {
+        memcpy(block, &sc->wbuf[(size_t)(entry->slot % sc->seg_blocks) * SG_BLOCK_SIZE], SG_BLOCK_SIZE);
+    } else if (pread(sc->fd, block, SG_BLOCK_SIZE, sgSsdCacheOffset(sc, entry->slot)) != SG_BLOCK_SIZE) {
+        logMessage(LOG_ERROR_LEVEL, "sgSsdCacheGet: failed reading block [%lu] from the disk tier", blk);
+        sc->errors++;
+        sgSsdCacheDelete(sc, entry);
+        return( -1 );
+    }
+    if (sgCrc32c(0, block, SG_BLOCK_SIZE) != entry->crc) {
+        logMessage(LOG_ERROR_LEVEL, "sgSsdCacheGet: block [%lu] failed its checksum in the disk tier", blk);
+        sc->errors++;
+        sgSsdCacheDelete(sc, entry);
+        return( -1 );
+    }
+    sgSsdCacheDelete(sc, entry);
+    sc->hits++;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheRemove
+// Description  : Drop a block from the tier
+//
+// Inputs       : sc - the disk tier
+//                nde - node ID of the block
+//                blk - block ID of the block
+// Outputs      : 0 if it was there, -1 if not
+
+int sgSsdCacheRemove( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk ) {
+
+    sgssdentry_t *entry;
+
+    if ((entry = sgSsdCacheFind(sc, nde, blk)) == NULL) {
+        return( -1 );
+    }
+    sgSsdCacheDelete(sc, entry);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheClose
+// Description  : Log the tier statistics, remove its file and free it
+//
+// Inputs       : sc - the disk tier
+// Outputs      : none
+
+void sgSsdCacheClose( sgssdcache_t *sc ) {
+
+    logMessage(LOG_INFO_LEVEL, "Closing disk tier: %u items, %lu inserted, %lu hits of %lu lookups, %lu segments written, "
+            "%lu cleaned (%lu blocks copied), %lu dropped, %lu errors.\n", sc->items, sc->inserts, sc->hits, sc->lookups,
+            sc->segments_written, sc->cleans, sc->copied, sc->dropped, sc->errors);
+    close(sc->fd);
+    unlink(sc->path);
+    free(sc->path);
+    free(sc->index);
+    free(sc->segs);
+    free(sc->slots);
+    free(sc->wbuf);
+    free(sc);
+}
+
+//
+// Disk tier support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheFind
+// Description  : Find a block in the index
+//
+// Inputs       : sc - the disk tier
+//                nde - node ID of the block
+//                blk - block ID of the block
+// Outputs      : the index entry, NULL if not found
+
+sgssdentry_t *sgSsdCacheFind( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk ) {
+
+    uint64_t hash = (nde * 0x9e3779b97f4a7c15ULL) ^ (blk * 0xc2b2ae3d27d4eb4fULL);
+    uint32_t i;
+
+    hash ^= hash >> 29;
+    for (i = (uint32_t)hash & sc->index_mask; sc->index[i].slot != SG_SSDCACHE_EMPTY; i = (i + 1) & sc->index_mask) {
+        if ((sc->index[i].rem_id == nde) && (sc->index[i].blk_id == blk)) {
+            return( &sc->index[i] );
+        }
+    }
+    return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheAdd
+// Description  : Add a block to the index (it must not be there)
+//
+// Inputs       : sc - the disk tier
+//                nde - node ID of the block
+//                blk - block ID of the block
+//                slot - the slot holding it
+//                crc - its checksum
+// Outputs      : none
+
+void sgSsdCacheAdd( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, uint32_t slot, uint32_t crc ) {
+
+    uint64_t hash = (nde * 0x9e3779b97f4a7c15ULL) ^ (blk * 0xc2b2ae3d27d4eb4fULL);
+    uint32_t i;
+
+    hash ^= hash >> 29;
+    for (i = (uint32_t)hash & sc->index_mask; sc->index[i].slot != SG_SSDCACHE_EMPTY; i = (i + 1) & sc->index_mask);
+    sc->index[i].rem_id = nde;
+    sc->index[i].blk_id = blk;
+    sc->index[i].slot = slot;
+    sc->index[i].crc = crc;
+    sc->segs[slot / sc->seg_blocks].live++;
+    sc->items++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheDelete
+// Description  : Remove an entry from the index, shifting the entries probed
+//                past it back so that no tombstones are needed
+//
+// Inputs       : sc - the disk tier
+//                entry - the entry
+// Outputs      : none
+
+void sgSsdCacheDelete( sgssdcache_t *sc, sgssdentry_t *entry ) {
+
+    uint32_t hole = entry - sc->index, i = hole, home;
+    uint64_t hash;
+
+    sc->segs[entry->slot / sc->seg_blocks].live--;
+    sc->items--;
+    for (;;) {
+        i = (i + 1) & sc->index_mask;
+        if (sc->index[i].slot == SG_SSDCACHE_EMPTY) {
+            break;
+        }
+        hash = (sc->index[i].rem_id * 0x9e3779b97f4a7c15ULL) ^ (sc->index[i].blk_id * 0xc2b2ae3d27d4eb4fULL);
+        hash ^= hash >> 29;
+        home = (uint32_t)hash & sc->index_mask;
+        // the entry can fill the hole if its home is not between the hole and it
+        if (((i - home) & sc->index_mask) >= ((i - hole) & sc->index_mask)) {
+            sc->index[hole] = sc->index[i];
+            hole = i;
+        }
+    }
+    sc->index[hole].slot = SG_SSDCACHE_EMPTY;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheSeal
+// Description  : Write the segment being filled out to the file.  If the
+//                write fails its blocks are dropped.
+//
+// Inputs       : sc - the disk tier
+// Outputs      : 0 if successful, -1 if failure
+
+int sgSsdCacheSeal( sgssdcache_t *sc ) {
+
+    size_t len = (size_t)sc->fill * SG_BLOCK_SIZE;
+    off_t off = sgSsdCacheOffset(sc, sc->active * sc->seg_blocks);
+
+    if (pwrite(sc->fd, sc->wbuf, len, off) != (ssize_t)len) {
+        logMessage(LOG_ERROR_LEVEL, "sgSsdCacheSeal: failed writing segment %u of the disk tier", sc->active);
+        sc->errors++;
+        sgSsdCacheDropSegment(sc, sc->active);
+        return( -1 );
+    }
+    // the blocks are read back rarely, keep them out of the page cache
+    posix_fadvise(sc->fd, off, len, POSIX_FADV_DONTNEED);
+    sc->segments_written++;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheNextSegment
+// Description  : Pick the next segment to fill: an empty one if any, else
+//                the one with the fewest live blocks, which is cleaned (its
+//                live blocks start the new segment).  If even that one is
+//                mostly live the oldest segment is dropped instead.
+//
+// Inputs       : sc - the disk tier
+// Outputs      : none
+
+void sgSsdCacheNextSegment( sgssdcache_t *sc ) {
+
+    uint32_t victim = sc->active, oldest = sc->active;
+
+    for (uint32_t s = 0; s < sc->num_segs; s++) {
+        if (s == sc->active) {
+            continue;
+        }
+        if ((victim == sc->active) || (sc->segs[s].live < sc->segs[victim].live) ||
+            ((sc->segs[s].live == sc->segs[victim].live) && (sc->segs[s].seq < sc->segs[victim].seq))) {
+            victim = s;
+        }
+        if ((oldest == sc->active) || (sc->segs[s].seq < sc->segs[oldest].seq)) {
+            oldest = s;
+        }
+    }
+    sc->active = victim;
+    sc->fill = 0;
+    if ((sc->segs[victim].live * 100 > sc->seg_blocks * SG_SSDCACHE_CLEAN_LIVE) ||
+        ((sc->segs[victim].live > 0) && sgSsdCacheCleanSegment(sc, victim))) {
+        sc->active = oldest;
+        sgSsdCacheDropSegment(sc, oldest);
+    }
+    sc->segs[sc->active].seq = ++sc->seq;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheDropSegment
+// Description  : Drop the blocks still live in a segment from the index
+//
+// Inputs       : sc - the disk tier
+//                seg - the segment
+// Outputs      : none
+
+void sgSsdCacheDropSegment( sgssdcache_t *sc, uint32_t seg ) {
+
+    sgssdentry_t *entry;
+    uint32_t slot = seg * sc->seg_blocks;
+
+    for (uint32_t s = slot; (sc->segs[seg].live > 0) && (s < slot + sc->seg_blocks); s++) {
+        entry = sgSsdCacheFind(sc, sc->slots[s].rem_id, sc->slots[s].blk_id);
+        if ((entry != NULL) && (entry->slot == s)) {
+            sgSsdCacheDelete(sc, entry);
+            sc->dropped++;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheCleanSegment
+// Description  : Read a segment into the segment buffer and compact its live
+//                blocks to the front, making it the segment being filled
+//
+// Inputs       : sc - the disk tier
+//                seg - the segment (sc->active)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgSsdCacheCleanSegment( sgssdcache_t *sc, uint32_t seg ) {
+
+    size_t len = (size_t)sc->seg_blocks * SG_BLOCK_SIZE;
+    uint32_t base = seg * sc->seg_blocks, to = 0;
+    sgssdentry_t *entry;
+
+    if (pread(sc->fd, sc->wbuf, len, sgSsdCacheOffset(sc, base)) != (ssize_t)len) {
+        logMessage(LOG_ERROR_LEVEL, "sgSsdCacheCleanSegment: failed reading segment %u of the disk tier", seg);
+        sc->errors++;
+        return( -1 );
+    }
+    for (uint32_t from = 0; from < sc->seg_blocks; from++) {
+        entry = sgSsdCacheFind(sc, sc->slots[base + from].rem_id, sc->slots[base + from].blk_id);
+        if ((entry == NULL) || (entry->slot != base + from)) {
+            continue;
+        }
+        if (to != from) {
+            memcpy(&sc->wbuf[(size_t)to * SG_BLOCK_SIZE], &sc->wbuf[(size_t)from * SG_BLOCK_SIZE], SG_BLOCK_SIZE);
+            sc->slots[base + to] = sc->slots[base + from];
+            entry->slot = base + to;
+        }
+        to++;
+    }
+    sc->fill = to;
+    sc->cleans++;
+    sc->copied += to;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgSsdCacheOffset
+// Description  : Get the file offset of a slot
+//
+// Inputs       : sc - the disk tier
+//                slot - the slot
+// Outputs      : the offset
+
+off_t sgSsdCacheOffset( sgssdcache_t *sc, uint32_t slot ) {
+
+    return( (off_t)slot * SG_BLOCK_SIZE );
+}
@@ -0,0 +1,78 @@
+#ifndef SG_SSDCACHE_INCLUDED
+#define SG_SSDCACHE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_ssdcache.h
+//  Description    : This is the declaration of the local disk (SSD) tier of
+//                   the block cache.  Blocks evicted from memory are gathered
+//                   into a segment buffer and written to a local file one
+//                   large sequential segment at a time.  An index in memory
+//                   (about 60 bytes a block) maps each block to its slot and
+//                   CRC32C, hits are read back with pread.  Space is taken
+//                   back log structured style: the segment with the fewest
+//                   live blocks is read in, its live blocks are compacted to
+//                   the front of the segment buffer, and it is refilled.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <sg_defs.h>
+
+//
+// Defines
+#define SG_SSDCACHE_SEGMENT_BYTES (1 << 20)   // Bytes written per segment
+#define SG_SSDCACHE_MIN_SEGMENTS 4            // Smallest tier (segments)
+#define SG_SSDCACHE_CLEAN_LIVE 75             // Segments more live than this (percent) are dropped, not cleaned
+
+// Type definitions
+typedef struct {
+    SG_Node_ID  rem_id;   // Node of the block
+    SG_Block_ID blk_id;   // Block ID of the block
+    uint32_t    slot;     // Slot of the block in the file (segment * blocks per segment + index)
+    uint32_t    crc;      // CRC32C of the block as written
+} sgssdentry_t;
+
+typedef struct {
+    uint32_t live;        // Slots of the segment whose block is still indexed
+    uint64_t seq;         // When the segment was last filled (higher is newer)
+} sgssdseg_t;
+
+typedef struct {
+    int           fd;           // The tier file
+    char         *path;         // The tier filename
+    uint32_t      seg_blocks;   // Blocks per segment
+    uint32_t      num_segs;     // Segments in the file
+    sgssdseg_t   *segs;         // The segments
+    sgssdentry_t *slots;        // The block each slot was written with (for cleaning)
+    sgssdentry_t *index;        // The index (open addressing, power of 2)
+    uint32_t      index_mask;
+    uint32_t      items;        // Blocks indexed
+    char         *wbuf;         // The segment being filled
+    uint32_t      active;       // The segment being filled
+    uint32_t      fill;         // Slots of the active segment used
+    uint64_t      seq;          // Segments filled so far
+    unsigned long inserts, hits, lookups, segments_written, cleans, copied, dropped, errors;
+} sgssdcache_t;
+
+//
+// Disk tier functions
+
+sgssdcache_t *sgSsdCacheOpen( const char *path, size_t bytes );
+    // Create the disk tier in the file path, holding up to bytes of blocks
+
+int sgSsdCacheInsert( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, char *block );
+    // Add an evicted block to the tier (replacing any older copy)
+
+int sgSsdCacheGet( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk, char *block );
+    // Read a block out of the tier and remove it, 0 if found, -1 if not
+
+int sgSsdCacheRemove( sgssdcache_t *sc, SG_Node_ID nde, SG_Block_ID blk );
+    // Drop a block from the tier (it was replaced by a newer version)
+
+void sgSsdCacheClose( sgssdcache_t *sc );
+    // Log the tier statistics, remove the file and free the tier
+
+#endif
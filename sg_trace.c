@@ -0,0 +1,281 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_trace.c
+//  Description    : This file contains the event tracing of the scatter
+//                   gather driver.  A thread's first event takes it a buffer,
+//                   either one left by a thread that has exited or a new one
+//                   pushed on the list of buffers (compare and swap), and
+//                   from then on only that thread writes it.  The buffers are
+//                   never freed, so the events of short lived threads (fan
+//                   out, hedged reads) survive them and closing the trace
+//                   cannot pull a buffer from under a thread.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_trace.h>
+
+//struct for a recorded event
+typedef struct tevent {
+    uint64_t start;     // nsec since tracing started
+    uint64_t dur;       // nsec, 0 for an instant
+    uint64_t arg;
+    uint32_t tid;       // the thread that recorded it
+    uint32_t ev;
+} tevent_t;
+//struct for the buffer of a thread
+typedef struct tbuffer {
+    struct tbuffer *next;
+    uint32_t count;     // events recorded (written by the owning thread only)
+    uint32_t dropped;   // events that did not fit
+    int free;           // the owning thread has exited, the buffer can be taken
+    tevent_t events[SG_TRACE_BUFFER_EVENTS];
+} tbuffer_t;
+
+// Functional Prototypes
+tbuffer_t *sgTraceBuffer( void );
+void sgTraceThreadExit( void *arg );
+void sgTraceKeyInit( void );
+
+//
+// Global Data
+volatile int sgTraceEnabled = 0;
+char *sgTraceFile = NULL;   // where the events are written
+uint64_t sgTraceBase = 0;   // the time tracing started
+tbuffer_t *sgTraceBuffers = NULL;  // every buffer handed out
+pthread_key_t sgTraceKey;   // the calling thread's buffer
+pthread_once_t sgTraceOnce = PTHREAD_ONCE_INIT;
+const char *sg_trace_names[SG_TEV_MAXVAL] = {
+    "sgopen", "sgread", "sgwrite", "sgseek", "sgclose",
+    "cache get", "cache put", "cache evict", "fetch wait",
+    "serialize", "deserialize", "service post", "sched wait" };
+const char *sg_trace_categories[SG_TEV_MAXVAL] = {
+    "driver", "driver", "driver", "driver", "driver",
+    "cache", "cache", "cache", "cache",
+    "packet", "packet", "service", "sched" };
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : initSGTrace
+// Description  : Start tracing
+//
+// Inputs       : path - the file the events are written to on close
+// Outputs      : 0 if successful, -1 if failure
+
+int initSGTrace( const char *path ) {
+
+    if ((path == NULL) || (sgTraceEnabled)) {
+        logMessage(LOG_ERROR_LEVEL, "initSGTrace: bad trace file or tracing already started");
+        return( -1 );
+    }
+    pthread_once(&sgTraceOnce, sgTraceKeyInit);
+    sgTraceFile = strdup(path);
+    sgTraceBase = 0;
+    sgTraceBase = sgTraceNow();
+    sgTraceEnabled = 1;
+    logMessage(LOG_INFO_LEVEL, "initSGTrace: tracing to [%s]", path);
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : closeSGTrace
+// Description  : Stop tracing and write the recorded events as Chrome
+//                trace-event JSON (the threads that recorded them must be
+//                done, or at least no longer tracing)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int closeSGTrace( void ) {
+
+    tbuffer_t *buf;
+    tevent_t *tev;
+    unsigned long events = 0, dropped = 0;
+    uint32_t count;
+    FILE *out;
+    int first = 1, pid = getpid();
+
+    if (!sgTraceEnabled) {
+        return( -1 );
+    }
+    sgTraceEnabled = 0;
+    if ((out = fopen(sgTraceFile, "w")) == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "closeSGTrace: unable to open trace file [%s]", sgTraceFile);
+        return( -1 );
+    }
+
+    // one complete ("X") or instant ("i") event per record, times in usec
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (buf = __atomic_load_n(&sgTraceBuffers, __ATOMIC_ACQUIRE); buf != NULL; buf = buf->next) {
+        count = __atomic_load_n(&buf->count, __ATOMIC_ACQUIRE);
+        for (uint32_t e = 0; e < count; e++) {
+            tev = &buf->events[e];
+            fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%lu.%03lu,", first ? "" : ",\n",
+                    sg_trace_names[tev->ev], sg_trace_categories[tev->ev], (tev->ev == SG_TEV_CACHE_EVICT) ? "i" : "X",
+                    tev->start / 1000, tev->start % 1000);
+            if (tev->ev == SG_TEV_CACHE_EVICT) {
+                fprintf(out, "\"s\":\"t\",");
+            } else {
+                fprintf(out, "\"dur\":%lu.%03lu,", tev->dur / 1000, tev->dur % 1000);
+            }
+            fprintf(out, "\"pid\":%d,\"tid\":%u,\"args\":{\"arg\":%lu}}", pid, tev->tid, tev->arg);
+            first = 0;
+        }
+        events += count;
+        dropped += buf->dropped;
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    logMessage(LOG_INFO_LEVEL, "Trace: %lu events written to [%s], %lu dropped (buffers full).", events, sgTraceFile, dropped);
+
+    // the buffers are emptied, not freed (threads may still hold them)
+    for (buf = sgTraceBuffers; buf != NULL; buf = buf->next) {
+        __atomic_store_n(&buf->count, 0, __ATOMIC_RELEASE);
+        buf->dropped = 0;
+    }
+    free(sgTraceFile);
+    sgTraceFile = NULL;
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgTraceNow
+// Description  : Get the time trace events are stamped with
+//
+// Inputs       : none
+// Outputs      : nsec since tracing started
+
+uint64_t sgTraceNow( void ) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return( (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec - sgTraceBase );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgTraceRecord
+// Description  : Record an event in the calling thread's buffer
+//
+// Inputs       : ev - the event
+//                start - when it started (sgTraceNow)
+//                dur - how long it took (nsec, 0 for an instant)
+//                arg - the argument recorded with it
+// Outputs      : none
+
+void sgTraceRecord( SG_Trace_Event ev, uint64_t start, uint64_t dur, uint64_t arg ) {
+
+    tbuffer_t *buf;
+    tevent_t *tev;
+
+    if (!sgTraceEnabled || ((buf = sgTraceBuffer()) == NULL)) {
+        return;
+    }
+    if (buf->count == SG_TRACE_BUFFER_EVENTS) {
+        buf->dropped++;
+        return;
+    }
+    tev = &buf->events[buf->count];
+    tev->start = start;
+    tev->dur = dur;
+    tev->arg = arg;
+    tev->tid = (uint32_t)syscall(SYS_gettid);
+    tev->ev = ev;
+    __atomic_store_n(&buf->count, buf->count + 1, __ATOMIC_RELEASE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgTraceScopeEnd
+// Description  : Record the span of a scope as it is left (SG_TRACE_SCOPE)
+//
+// Inputs       : scope - the scope
+// Outputs      : none
+
+void sgTraceScopeEnd( sgtracescope_t *scope ) {
+
+    SG_TRACE_SPAN(scope->ev, scope->start, scope->arg);
+}
+
+//
+// Trace support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgTraceBuffer
+// Description  : Get the calling thread's buffer, taking one left by an
+//                exited thread or adding a new one
+//
+// Inputs       : none
+// Outputs      : the buffer, NULL if out of memory
+
+tbuffer_t *sgTraceBuffer( void ) {
+
+    tbuffer_t *buf = pthread_getspecific(sgTraceKey);
+    int expected;
+
+    if (buf != NULL) {
+        return( buf );
+    }
+    for (buf = __atomic_load_n(&sgTraceBuffers, __ATOMIC_ACQUIRE); buf != NULL; buf = buf->next) {
+        expected = 1;
+        if (__atomic_compare_exchange_n(&buf->free, &expected, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (buf == NULL) {
+        if ((buf = calloc(1, sizeof(tbuffer_t))) == NULL) {
+            return( NULL );
+        }
+        buf->next = __atomic_load_n(&sgTraceBuffers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&sgTraceBuffers, &buf->next, buf, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    pthread_setspecific(sgTraceKey, buf);
+    return( buf );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgTraceThreadExit
+// Description  : Give the buffer of an exiting thread back for another
+//
+// Inputs       : arg - the buffer
+// Outputs      : none
+
+void sgTraceThreadExit( void *arg ) {
+
+    tbuffer_t *buf = arg;
+
+    __atomic_store_n(&buf->free, 1, __ATOMIC_RELEASE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgTraceKeyInit
+// Description  : Create the key holding each thread's buffer
+//
+// Inputs       : none
+// Outputs      : none
+
+void sgTraceKeyInit( void ) {
+
+    pthread_key_create(&sgTraceKey, sgTraceThreadExit);
+}
@@ -0,0 +1,113 @@
+#ifndef SG_TRACE_INCLUDED
+#define SG_TRACE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_trace.h
+//  Description    : This is the declaration of the event tracing of the
+//                   scatter gather driver.  Trace points time driver calls,
+//                   cache operations, packet encoding, service posts and
+//                   waits.  Each thread records into a buffer of its own
+//                   without locking, and the buffers are written out as
+//                   Chrome trace-event JSON (chrome://tracing, Perfetto) when
+//                   tracing is closed.  Built with SG_TRACE_USDT every trace
+//                   point is also a USDT probe (provider sg) that perf or
+//                   bpftrace can attach to whether tracing is on or not.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <stdint.h>
+#ifdef SG_TRACE_USDT
+#include <sys/sdt.h>
+#endif
+
+//
+// Defines
+#define SG_TRACE_BUFFER_EVENTS 65536  // Events a thread's buffer holds (later ones are dropped)
+
+// Type definitions
+typedef enum {
+    SG_TEV_OPEN         = 0,   // sgopen
+    SG_TEV_READ         = 1,   // sgread
+    SG_TEV_WRITE        = 2,   // sgwrite
+    SG_TEV_SEEK         = 3,   // sgseek
+    SG_TEV_CLOSE        = 4,   // sgclose
+    SG_TEV_CACHE_GET    = 5,   // getSGDataBlock
+    SG_TEV_CACHE_PUT    = 6,   // putSGDataBlock
+    SG_TEV_CACHE_EVICT  = 7,   // a block leaves the cache (instant)
+    SG_TEV_FETCH_WAIT   = 8,   // waiting for a fetch in flight
+    SG_TEV_SERIALIZE    = 9,   // serialize_sg_packet
+    SG_TEV_DESERIALIZE  = 10,  // deserialize_sg_packet
+    SG_TEV_SERVICE_POST = 11,  // a packet posted to the service
+    SG_TEV_SCHED_WAIT   = 12,  // waiting for a dispatch slot
+    SG_TEV_MAXVAL       = 13   // Maximum value of the event
+} SG_Trace_Event;
+
+typedef struct {
+    uint64_t start;   // when the span started (nsec, 0 if tracing was off)
+    uint64_t arg;     // the argument recorded with the span
+    SG_Trace_Event ev;
+} sgtracescope_t;
+
+//
+// Global interface definitions
+
+extern volatile int sgTraceEnabled;
+    // Trace points record events
+
+//
+// Trace point macros
+
+#ifdef SG_TRACE_USDT
+#define SG_TRACE_PROBE(ev, dur, arg) DTRACE_PROBE3(sg, event, (int)(ev), (uint64_t)(dur), (uint64_t)(arg))
+#else
+#define SG_TRACE_PROBE(ev, dur, arg)
+#endif
+
+#define SG_TRACE_START() (__builtin_expect(sgTraceEnabled, 0) ? sgTraceNow() : 0)
+    // Take the start time of a span (0 if tracing is off)
+
+#define SG_TRACE_SPAN(ev, start, arg) do { \
+        uint64_t sg_trace_now = (start) ? sgTraceNow() : 0; \
+        SG_TRACE_PROBE(ev, sg_trace_now - (start), arg); \
+        if (start) { \
+            sgTraceRecord((ev), (start), sg_trace_now - (start), (uint64_t)(arg)); \
+        } \
+    } while (0)
+    // Record a span from its start time to now
+
+#define SG_TRACE_SCOPE(ev, arg) \
+    sgtracescope_t sg_trace_scope __attribute__((cleanup(sgTraceScopeEnd))) = \
+            { SG_TRACE_START(), (uint64_t)(arg), (ev) }
+    // Record a span from here to the end of the enclosing block (any return)
+
+#define SG_TRACE_INSTANT(ev, arg) do { \
+        SG_TRACE_PROBE(ev, 0, arg); \
+        if (__builtin_expect(sgTraceEnabled, 0)) { \
+            sgTraceRecord((ev), sgTraceNow(), 0, (uint64_t)(arg)); \
+        } \
+    } while (0)
+    // Record an event without a duration
+
+//
+// Trace functions
+
+int initSGTrace( const char *path );
+    // Start tracing, the events are written to path when it is closed
+
+int closeSGTrace( void );
+    // Stop tracing and write the events out as Chrome trace-event JSON
+
+uint64_t sgTraceNow( void );
+    // Get the time (nsec) trace events are stamped with
+
+void sgTraceRecord( SG_Trace_Event ev, uint64_t start, uint64_t dur, uint64_t arg );
+    // Record an event in the calling thread's buffer
+
+void sgTraceScopeEnd( sgtracescope_t *scope );
+    // Record the span of a scope as it is left
+
+#endif
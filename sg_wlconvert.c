@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_wlconvert.c
+//  Description    : This is the converter from the text workload format to the
+//                   binary (memory mappable) workload format replayed by
+//                   sg_sim.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <unistd.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <sg_workload.h>
+
+// Defines
+#define SG_WLCONVERT_ARGUMENTS "hv"
+#define USAGE \
+	"USAGE: sg_wlconvert [-h] [-v] <text workload> <binary workload>\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"    -v - verbose output\n" \
+	"\n" \
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the workload converter
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	int ch, verbose = 0;
+
+	// Process the command line parameters
+	while ((ch = getopt(argc, argv, SG_WLCONVERT_ARGUMENTS)) != -1) {
+
+		switch (ch) {
+		case 'h': // Help, print usage
+			fprintf( stderr, USAGE );
+			return( -1 );
+
+		case 'v': // Verbose Flag
+			verbose = 1;
+			break;
+
+		default:  // Default (unknown)
+			fprintf( stderr, "Unknown command line option (%c), aborting.\n", ch );
+			return( -1 );
+		}
+	}
+
+	// Setup the log, check the filenames
+	initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+	if ( verbose ) {
+		enableLogLevels( LOG_INFO_LEVEL );
+	}
+	if ( (argv[optind] == NULL) || (argv[optind+1] == NULL) ) {
+		fprintf( stderr, "Missing command line parameters, use -h to see usage, aborting.\n" );
+		return( -1 );
+	}
+
+	// Convert the workload
+	if ( sgWorkloadConvert(argv[optind], argv[optind+1]) ) {
+		logMessage( LOG_ERROR_LEVEL, "Workload conversion failed." );
+		return( -1 );
+	}
+	return( 0 );
+}
@@ -0,0 +1,361 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_workload.c
+//  Description    : This file contains the binary workload format of the
+//                   ScatterGather simulator: the memory mapped reader used to
+//                   replay a workload and the converter from the text format.
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmpsc311_log.h>
+#include <cmpsc311_assocarr.h>
+
+// Project Includes
+#include <sg_workload.h>
+
+// Defines
+#define SG_WORKLOAD_ALIGNED(x) (((x) + SG_WORKLOAD_ALIGN - 1) & ~((uint64_t)SG_WORKLOAD_ALIGN - 1))
+#define SG_WORKLOAD_INITIAL_OPS 4096
+
+// Functional Prototypes
+int sgWorkloadWritePad( FILE *fh, uint64_t *offset );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgWorkloadIsBinary
+// Description  : Check if a workload file is in the binary format
+//
+// Inputs       : path - the workload filename
+// Outputs      : 1 if binary, 0 if not (or it can't be read)
+
+int sgWorkloadIsBinary( const char *path ) {
+
+    uint32_t magic = 0;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        return( 0 );
+    }
+    if (read(fd, &magic, sizeof(magic)) != sizeof(magic)) {
+        magic = 0;
+    }
+    close(fd);
+    return( magic == SG_WORKLOAD_MAGIC );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgWorkloadOpen
+// Description  : Map a binary workload and validate its layout
+//
+// Inputs       : wl - the workload to open
+//                path - the workload filename
+// Outputs      : 0 if successful, -1 if failure
+
+int sgWorkloadOpen( sg_workload_t *wl, const char *path ) {
+
+    const sg_workload_header_t *hdr;
+    struct stat st;
+
+    memset(wl, 0x0, sizeof(sg_workload_t));
+    if (((wl->fd = open(path, O_RDONLY)) == -1) || (fstat(wl->fd, &st) == -1)) {
+        logMessage( LOG_ERROR_LEVEL, "sgWorkloadOpen: failed opening workload [%s]", path );
+        if (wl->fd != -1) {
+            close(wl->fd);
+        }
+        return( -1 );
+    }
+    if (st.st_size < (off_t)sizeof(sg_workload_header_t)) {
+        logMessage( LOG_ERROR_LEVEL, "sgWorkloadOpen: workload [%s] too short", path );
+        close(wl->fd);
+        return( -1 );
+    }
+    wl->length = st.st_size;
+    wl->base = mmap(NULL, wl->length, PROT_READ, MAP_PRIVATE, wl->fd, 0);
+    if (wl->base == MAP_FAILED) {
+        logMessage( LOG_ERROR_LEVEL, "sgWorkloadOpen: failed mapping workload [%s]", path );
+        close(wl->fd);
+        return( -1 );
+    }
+    madvise((void *)wl->base, wl->length, MADV_SEQUENTIAL);
+
+    // check the header and that every region lies inside the file
+    hdr = (const sg_workload_header_t *)wl->base;
+    if ((hdr->magic != SG_WORKLOAD_MAGIC) || (hdr->version != SG_WORKLOAD_VERSION) ||
+        (hdr->data_offset > wl->length) || (hdr->data_size > wl->length - hdr->data_offset) ||
+        (hdr->ops_offset % SG_WORKLOAD_ALIGN) || (hdr->ops_offset > wl->length) ||
+        (hdr->num_ops > (wl->length - hdr->ops_offset) / sizeof(sg_workload_op_t)) ||
+        (hdr->names_offset % SG_WORKLOAD_ALIGN) || (hdr->names_offset > wl->length) ||
+        (hdr->names_size > wl->length - hdr->names_offset) ||
+        (hdr->num_objects > hdr->names_size / sizeof(uint32_t))) {
+        logMessage( LOG_ERROR_LEVEL, "sgWorkloadOpen: workload [%s] is corrupt", path );
+        sgWorkloadClose(wl);
+        return( -1 );
+    }
+    wl->hdr = hdr;
+    wl->ops = (const sg_workload_op_t *)(wl->base + hdr->ops_offset);
+    wl->names = (const uint32_t *)(wl->base + hdr->names_offset);
+    for (uint32_t i = 0; i < hdr->num_objects; i++) {
+        if ((wl->names[i] >= hdr->names_size) ||
+            (memchr(wl->base + hdr->names_offset + wl->names[i], '\0', hdr->names_size - wl->names[i]) == NULL)) {
+            logMessage( LOG_ERROR_LEVEL, "sgWorkloadOpen: workload [%s] has a bad object name", path );
+            sgWorkloadClose(wl);
+            return( -1 );
+        }
+    }
+    wl->filename = strdup(path);
+    wl->next = 0;
+    logMessage( LOG_INFO_LEVEL, "Opened binary workload [%s], %lu ops, %u objects.",
+            path, (unsigned long)hdr->num_ops, hdr->num_objects );
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgWorkloadNext
+// Description  : Get the next operation of the workload
+//
+// Inputs       : wl - the workload
+// Outputs      : the operation record, NULL at the end or if it is corrupt
+
+const sg_workload_op_t *sgWorkloadNext( sg_workload_t *wl ) {
+
+    const sg_workload_op_t *op;
+
+    if (wl->next >= wl->hdr->num_ops) {
+        return( NULL );
+    }
+    op = &wl->ops[wl->next];
+    if ((op->object >= wl->hdr->num_objects) || (op->op >= WLT_MAX_WORKLOAD_OP_TYPE) ||
+        (op->data > wl->hdr->data_size) || (op->size > wl->hdr->data_size - op->data)) {
+        logMessage( LOG_ERROR_LEVEL, "sgWorkloadNext: bad operation record [%lu]", (unsigned long)wl->next );
+        return( NULL );
+    }
+    wl->next++;
+    return( op );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgWorkloadObject
+// Description  : Get the object name of an operation
+//
+// Inputs       : wl - the workload
+//                op - the operation record
+// Outputs      : the object name
+
+const char *sgWorkloadObject( sg_workload_t *wl, const sg_workload_op_t *op ) {
+
+    return( wl->base + wl->hdr->names_offset + wl->names[op->object] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgWorkloadData
+// Description  : Get the data of an operation, it points into the mapping
+//
+// Inputs       : wl - the workload
+//                op - the operation record
+// Outputs      : pointer to the data (op->size bytes)
+
+const char *sgWorkloadData( sg_workload_t *wl, const sg_workload_op_t *op ) {
+
+    return( wl->base + wl->hdr->data_offset + op->data );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgWorkloadClose
+// Description  : Unmap a binary workload
+//
+// Inputs       : wl - the workload
+// Outputs      : 0 if successful, -1 if failure
+
+int sgWorkloadClose( sg_workload_t *wl ) {
+
+    if (wl->base != NULL) {
+        munmap((void *)wl->base, wl->length);
+        close(wl->fd);
+    }
+    free(wl->filename);
+    memset(wl, 0x0, sizeof(sg_workload_t));
+    return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgWorkloadConvert
+// Description  : Convert a text workload into a binary workload.  The data is
+//                streamed out behind the header as it is read, the records
+//                and names follow once the whole workload has been read.
+//
+// Inputs       : text - the text workload filename
+//                binary - the binary workload filename
+// Outputs      : 0 if successful, -1 if failure
+
+int sgWorkloadConvert( const char *text, const char *binary ) {
+
+    workload_state state;
+    workload_operation operation;
+    sg_workload_header_t hdr;
+    sg_workload_op_t *ops = NULL;
+    uint64_t max_ops = 0, offset;
+    AssocArray objects;
+    char **names = NULL;
+    uint32_t *name_offsets = NULL, len;
+    uintptr_t index;
+    FILE *fh;
+    int ret = -1;
+
+    if (openCmpsc311Workload(&state, text)) {
+        logMessage( LOG_ERROR_LEVEL, "sgWorkloadConvert: failed opening workload [%s]", text );
+        return( -1 );
+    }
+    if ((fh = fopen(binary, "wb")) == NULL) {
+        logMessage( LOG_ERROR_LEVEL, "sgWorkloadConvert: failed creating [%s]", binary );
+        closeCmpsc311Workload(&state);
+        return( -1 );
+    }
+    init_assoc(&objects, stringCompareCallback, pointerCompareCallback);
+    memset(&hdr, 0x0, sizeof(hdr));
+    hdr.magic = SG_WORKLOAD_MAGIC;
+    hdr.version = SG_WORKLOAD_VERSION;
+    hdr.data_offset = SG_WORKLOAD_ALIGNED(sizeof(hdr));
+
+    // leave room for the header, it is written once the layout is known
+    if (fseek(fh, hdr.data_offset, SEEK_SET) != 0) {
+        goto done;
+    }
+
+    // stream the data out, keeping the records and object names
+    do {
+        if (readCmpsc311Workload(&state, &operation)) {
+            logMessage( LOG_ERROR_LEVEL, "sgWorkloadConvert: failed reading [%s] at line %d", text, state.lineno );
+            goto done;
+        }
+        if (hdr.num_ops == max_ops) {
+            max_ops = (max_ops == 0) ? SG_WORKLOAD_INITIAL_OPS : max_ops * 2;
+            ops = realloc(ops, max_ops * sizeof(sg_workload_op_t));
+        }
+        memset(&ops[hdr.num_ops], 0x0, sizeof(sg_workload_op_t));
+        ops[hdr.num_ops].op = operation.op;
+
+        if (operation.op != WL_EOF) {
+            if ((index = (uintptr_t)find_assoc(&objects, operation.objname)) == 0) {
+                names = realloc(names, (hdr.num_objects + 1) * sizeof(char *));
+                names[hdr.num_objects] = strdup(operation.objname);
+                index = ++hdr.num_objects;
+                insert_assoc(&objects, names[index - 1], (void *)index);
+            }
+            ops[hdr.num_ops].object = index - 1;
+        }
+        if ((operation.op == WL_READ) || (operation.op == WL_WRITE)) {
+            if (operation.size > CMPSC311_MAX_OPSIZE_MAXIMUM) {
+                logMessage( LOG_ERROR_LEVEL, "sgWorkloadConvert: operation too large at line %d", state.lineno );
+                goto done;
+            }
+            ops[hdr.num_ops].pos = operation.pos;
+            ops[hdr.num_ops].size = operation.size;
+            ops[hdr.num_ops].data = hdr.data_size;
+            if (fwrite(operation.data, 1, operation.size, fh) != operation.size) {
+                goto done;
+            }
+            hdr.data_size += operation.size;
+            if (operation.size > hdr.max_opsize) {
+                hdr.max_opsize = operation.size;
+            }
+        }
+        hdr.num_ops++;
+    } while (operation.op != WL_EOF);
+
+    // then the records and the name table
+    offset = hdr.data_offset + hdr.data_size;
+    if (sgWorkloadWritePad(fh, &offset)) {
+        goto done;
+    }
+    hdr.ops_offset = offset;
+    if (fwrite(ops, sizeof(sg_workload_op_t), hdr.num_ops, fh) != hdr.num_ops) {
+        goto done;
+    }
+    offset += hdr.num_ops * sizeof(sg_workload_op_t);
+    if (sgWorkloadWritePad(fh, &offset)) {
+        goto done;
+    }
+    hdr.names_offset = offset;
+    name_offsets = malloc((hdr.num_objects + 1) * sizeof(uint32_t));
+    len = hdr.num_objects * sizeof(uint32_t);
+    for (uint32_t i = 0; i < hdr.num_objects; i++) {
+        name_offsets[i] = len;
+        len += strlen(names[i]) + 1;
+    }
+    hdr.names_size = len;
+    if (fwrite(name_offsets, sizeof(uint32_t), hdr.num_objects, fh) != hdr.num_objects) {
+        goto done;
+    }
+    for (uint32_t i = 0; i < hdr.num_objects; i++) {
+        if (fwrite(names[i], 1, strlen(names[i]) + 1, fh) != strlen(names[i]) + 1) {
+            goto done;
+        }
+    }
+
+    // finally the header
+    if ((fseek(fh, 0, SEEK_SET) != 0) || (fwrite(&hdr, sizeof(hdr), 1, fh) != 1)) {
+        goto done;
+    }
+    logMessage( LOG_INFO_LEVEL, "Converted workload [%s] to [%s], %lu ops, %u objects, %lu data bytes.",
+            text, binary, (unsigned long)hdr.num_ops, hdr.num_objects, (unsigned long)hdr.data_size );
+    ret = 0;
+
+done:
+    if ((fclose(fh) != 0) || (ret != 0)) {
+        logMessage( LOG_ERROR_LEVEL, "sgWorkloadConvert: failed writing [%s]", binary );
+        unlink(binary);
+        ret = -1;
+    }
+    closeCmpsc311Workload(&state);
+    clear_assoc(&objects, 0, 0);
+    for (uint32_t i = 0; i < hdr.num_objects; i++) {
+        free(names[i]);
+    }
+    free(names);
+    free(name_offsets);
+    free(ops);
+    return( ret );
+}
+
+//
+// Workload support functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sgWorkloadWritePad
+// Description  : Pad the output out to the next aligned offset
+//
+// Inputs       : fh - the output file
+//                offset - the current offset (updated)
+// Outputs      : 0 if successful, -1 if failure
+
+int sgWorkloadWritePad( FILE *fh, uint64_t *offset ) {
+
+    static const char zeros[SG_WORKLOAD_ALIGN] = { 0 };
+    uint64_t pad = SG_WORKLOAD_ALIGNED(*offset) - *offset;
+
+    if ((pad > 0) && (fwrite(zeros, 1, pad, fh) != pad)) {
+        return( -1 );
+    }
+    *offset += pad;
+    return( 0 );
+}
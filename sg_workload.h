@@ -0,0 +1,93 @@
+#ifndef SG_WORKLOAD_INCLUDED
+#define SG_WORKLOAD_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : sg_workload.h
+//  Description    : This is the declaration of the binary workload format of
+//                   the ScatterGather simulator.  A binary workload holds the
+//                   operations of a text workload as fixed size records, the
+//                   object names in a table and the operation data in one
+//                   shared region, so that it can be memory mapped and
+//                   replayed without parsing or copying.
+//
+//                   Layout (all values little endian, regions 8 byte aligned)
+//
+//                     header   : sg_workload_header_t
+//                     data     : the operation data, back to back
+//                     ops      : num_ops sg_workload_op_t records
+//                     names    : num_objects uint32_t offsets into the name
+//                                strings, then the NUL terminated strings
+//
+//   Author        : Agha Arib Hyder
+//   Last Modified : 10/19/26
+//
+
+// Includes
+#include <stdint.h>
+#include <stddef.h>
+#include <cmpsc311_workload.h>
+
+// Defines
+#define SG_WORKLOAD_MAGIC 0x42574753   // "SGWB"
+#define SG_WORKLOAD_VERSION 1
+#define SG_WORKLOAD_ALIGN 8
+
+// Type definitions
+typedef struct {
+    uint32_t magic;        // SG_WORKLOAD_MAGIC
+    uint32_t version;      // SG_WORKLOAD_VERSION
+    uint64_t num_ops;      // Number of operation records
+    uint32_t num_objects;  // Number of object names
+    uint32_t max_opsize;   // Largest read/write in the workload
+    uint64_t data_offset;  // File offset of the data region
+    uint64_t data_size;    // Size of the data region
+    uint64_t ops_offset;   // File offset of the operation records
+    uint64_t names_offset; // File offset of the name table
+    uint64_t names_size;   // Size of the name table
+} sg_workload_header_t;
+
+typedef struct {
+    uint64_t data;         // Offset of the op data in the data region
+    uint32_t object;       // Index of the object name
+    uint32_t op;           // The operation (workload_operations_type)
+    uint32_t pos;          // Position in the object
+    uint32_t size;         // Size of the operation
+} sg_workload_op_t;
+
+typedef struct {
+    char *filename;                  // The filename of the workload
+    int fd;                          // The file descriptor of the mapping
+    size_t length;                   // The length of the mapping
+    const char *base;                // The mapped workload
+    const sg_workload_header_t *hdr; // The header
+    const sg_workload_op_t *ops;     // The operation records
+    const uint32_t *names;           // The object name offsets
+    uint64_t next;                   // The next operation to replay
+} sg_workload_t;
+
+//
+// Workload functions
+
+int sgWorkloadIsBinary( const char *path );
+    // Check if a workload file is in the binary format
+
+int sgWorkloadOpen( sg_workload_t *wl, const char *path );
+    // Map a binary workload and validate it
+
+const sg_workload_op_t *sgWorkloadNext( sg_workload_t *wl );
+    // Get the next operation of the workload (NULL at the end)
+
+const char *sgWorkloadObject( sg_workload_t *wl, const sg_workload_op_t *op );
+    // Get the object name of an operation
+
+const char *sgWorkloadData( sg_workload_t *wl, const sg_workload_op_t *op );
+    // Get the data of an operation (in the mapping)
+
+int sgWorkloadClose( sg_workload_t *wl );
+    // Unmap a binary workload
+
+int sgWorkloadConvert( const char *text, const char *binary );
+    // Convert a text workload into a binary workload
+
+#endif